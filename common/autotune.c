@@ -0,0 +1,325 @@
+/*  File:        autotune.c
+    Description: Empirical tuning of the packed-panel multiply and its
+    cache file (see autotune.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "timer.h"
+#include "matrix.h"
+#include "counterRandom.h"
+#include "autotune.h"
+
+#define MAX_LINE 256
+#define INITIAL_RECORDS 64  // records array size; it doubles as needed
+#define MAX_KERNELS 8
+
+static int sizeClass(int n);
+static int validRecord(const AUTOTUNE_CONFIG * record);
+static void cacheFileName(char * name, size_t size);
+static double timeBlocking(MATRIX * A, MATRIX * B, MATRIX * C,
+			   const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel);
+
+static const int kcCandidates[] = {64, 128, 192, 256, 384, 512};
+static const int mcCandidates[] = {48, 96, 144, 192, 288, 384};
+static const int ncCandidates[] = {512, 1024, 2048, 4096, 8192};
+
+
+/*******************************************************************
+ * Function autotuneDefaults fills in the untuned configuration.
+ ********************************************************************/
+void autotuneDefaults(AUTOTUNE_CONFIG * config) {
+  memset(config, 0, sizeof(AUTOTUNE_CONFIG));
+  strncpy(config->kernel, gemmBestKernel()->name, sizeof(config->kernel)-1);
+  gemmDefaultBlocking(&config->blocking);
+} // end autotuneDefaults
+
+
+/*******************************************************************
+ * Function autotuneLoad looks up the record for this host, program
+ * and size class of n.  Returns 1 and fills config if found, else 0
+ * and leaves config alone.  A record this CPU can't run (unknown
+ * kernel, zero blocks, bad loop order) counts as a miss.
+ ********************************************************************/
+int autotuneLoad(const char * program, int n, AUTOTUNE_CONFIG * config) {
+  FILE * cacheFilePtr;
+  char fileName[MAX_LINE], line[MAX_LINE], host[64], myHost[64], name[64];
+  AUTOTUNE_CONFIG record;
+  int found = 0, size;
+
+  cacheFileName(fileName, sizeof(fileName));
+  if ((cacheFilePtr = fopen(fileName, "r")) == NULL) {
+    return 0;
+  } // end if
+  gethostname(myHost, sizeof(myHost));
+  myHost[sizeof(myHost)-1] = '\0';
+
+  while (fgets(line, sizeof(line), cacheFilePtr) != NULL) {
+    memset(&record, 0, sizeof(record));
+    if (line[0] == '#'
+	|| sscanf(line, "%63s %63s %d %15s %d %d %d %d %d %d %lf", host, name, &size,
+		  record.kernel, &record.blocking.kc, &record.blocking.mc,
+		  &record.blocking.nc, &record.blocking.loopOrder,
+		  &record.numberOfThreads, &record.tileSize, &record.gflops) != 11) {
+      continue;
+    } // end if
+    if (strcmp(host, myHost) == 0 && strcmp(name, program) == 0
+	&& size == sizeClass(n) && validRecord(&record)) {
+      *config = record;  // a later line for the same key wins
+      found = 1;
+    } // end if
+  } // end while
+
+  fclose(cacheFilePtr);
+  return found;
+} // end autotuneLoad
+
+
+/*******************************************************************
+ * Function autotuneSave replaces (or adds) the record for this host,
+ * program and size class of n.  The file is rewritten through a
+ * temporary and renamed, so a concurrent reader never sees half of
+ * it.  Returns 1 on success.
+ ********************************************************************/
+int autotuneSave(const char * program, int n, const AUTOTUNE_CONFIG * config) {
+  FILE * cacheFilePtr;
+  char fileName[MAX_LINE], tempName[MAX_LINE+8], myHost[64], host[64], name[64];
+  char ** records;
+  char line[MAX_LINE];
+  int numberOfRecords = 0, maxRecords = INITIAL_RECORDS, size, i;
+
+  cacheFileName(fileName, sizeof(fileName));
+  gethostname(myHost, sizeof(myHost));
+  myHost[sizeof(myHost)-1] = '\0';
+
+  // copy all the records except the one being replaced (and comments)
+  records = (char **) malloc(maxRecords*sizeof(char *));
+  if ((cacheFilePtr = fopen(fileName, "r")) != NULL) {
+    while (fgets(line, sizeof(line), cacheFilePtr) != NULL) {
+      if (line[0] == '#' || sscanf(line, "%63s %63s %d", host, name, &size) != 3
+	  || (strcmp(host, myHost) == 0 && strcmp(name, program) == 0
+	      && size == sizeClass(n))) {
+	continue;
+      } // end if
+      if (numberOfRecords == maxRecords) {
+	maxRecords *= 2;
+	if ((records = (char **) realloc(records, maxRecords*sizeof(char *))) == NULL) {
+	  printf("Could not allocate %d tuning records\n", maxRecords);
+	  exit(-1);
+	} // end if
+      } // end if
+      records[numberOfRecords++] = strdup(line);
+    } // end while
+    fclose(cacheFilePtr);
+  } // end if
+
+  snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+  if ((cacheFilePtr = fopen(tempName, "w")) == NULL) {
+    printf("%s cannot be opened for writing\n", tempName);
+    for (i=0; i < numberOfRecords; i++) {
+      free(records[i]);
+    } // end for
+    free(records);
+    return 0;
+  } // end if
+  fprintf(cacheFilePtr, "# host program sizeClass kernel kc mc nc loopOrder threads tile GFLOP/s\n");
+  for (i=0; i < numberOfRecords; i++) {
+    fputs(records[i], cacheFilePtr);
+    free(records[i]);
+  } // end for
+  free(records);
+  fprintf(cacheFilePtr, "%s %s %d %s %d %d %d %d %d %d %.2f\n", myHost, program,
+	  sizeClass(n), config->kernel, config->blocking.kc, config->blocking.mc,
+	  config->blocking.nc, config->blocking.loopOrder, config->numberOfThreads,
+	  config->tileSize, config->gflops);
+  fclose(cacheFilePtr);
+
+  if (rename(tempName, fileName) != 0) {
+    printf("%s cannot be replaced\n", fileName);
+    return 0;
+  } // end if
+  printf("Saved tuned configuration to %s\n", fileName);
+  return 1;
+} // end autotuneSave
+
+
+/*******************************************************************
+ * Function autotuneBlocking searches the micro-kernel, kc, mc, nc
+ * and loop order for an n x n multiply (sampled at no more than
+ * AUTOTUNE_MAX_TRIAL), one knob at a time starting from config,
+ * and leaves the fastest combination found in config.  The sweep
+ * repeats while a pass still improves things (at most 3 passes).
+ ********************************************************************/
+void autotuneBlocking(int n, AUTOTUNE_CONFIG * config) {
+  const GEMM_KERNEL * kernels[MAX_KERNELS];
+  const GEMM_KERNEL * kernel;
+  GEMM_BLOCKING trial;
+  MATRIX * A, * B, * C;
+  int numberOfKernels, trialSize, pass, i, improved;
+  double rate;
+
+  trialSize = (n < AUTOTUNE_MAX_TRIAL) ? n : AUTOTUNE_MAX_TRIAL;
+  A = allocateMatrix(trialSize, trialSize);
+  B = allocateMatrix(trialSize, trialSize);
+  C = allocateMatrix(trialSize, trialSize);
+  generateCounterRandom2DArray(trialSize, trialSize, -1.0, +1.0, 1, A->row, 0);
+  generateCounterRandom2DArray(trialSize, trialSize, -1.0, +1.0, 2, B->row, 0);
+
+  kernel = gemmKernelByName(config->kernel);
+  config->gflops = timeBlocking(A, B, C, &config->blocking, kernel);
+  printf("Autotune on %d x %d: start %s kc %d mc %d nc %d order %d -> %1.2f GFLOP/s\n",
+	 trialSize, trialSize, kernel->name, config->blocking.kc, config->blocking.mc,
+	 config->blocking.nc, config->blocking.loopOrder, config->gflops);
+
+  // the micro-kernel first: it sets the scale for everything else
+  numberOfKernels = gemmSupportedKernels(kernels, MAX_KERNELS);
+  for (i=0; i < numberOfKernels; i++) {
+    if ((rate = timeBlocking(A, B, C, &config->blocking, kernels[i])) > config->gflops) {
+      kernel = kernels[i];
+      config->gflops = rate;
+    } // end if
+  } // end for
+  strncpy(config->kernel, kernel->name, sizeof(config->kernel)-1);
+
+  for (pass=0, improved=1; pass < 3 && improved; pass++) {
+    improved = 0;
+    for (i=0; i < (int) (sizeof(kcCandidates)/sizeof(int)); i++) {
+      trial = config->blocking;
+      trial.kc = kcCandidates[i];
+      if ((rate = timeBlocking(A, B, C, &trial, kernel)) > config->gflops) {
+	config->blocking = trial;
+	config->gflops = rate;
+	improved = 1;
+      } // end if
+    } // end for
+    for (i=0; i < (int) (sizeof(mcCandidates)/sizeof(int)); i++) {
+      trial = config->blocking;
+      trial.mc = mcCandidates[i];
+      if ((rate = timeBlocking(A, B, C, &trial, kernel)) > config->gflops) {
+	config->blocking = trial;
+	config->gflops = rate;
+	improved = 1;
+      } // end if
+    } // end for
+    for (i=0; i < (int) (sizeof(ncCandidates)/sizeof(int)); i++) {
+      trial = config->blocking;
+      trial.nc = ncCandidates[i];
+      if ((rate = timeBlocking(A, B, C, &trial, kernel)) > config->gflops) {
+	config->blocking = trial;
+	config->gflops = rate;
+	improved = 1;
+      } // end if
+    } // end for
+    trial = config->blocking;
+    trial.loopOrder = (trial.loopOrder == GEMM_LOOP_JR_IR) ? GEMM_LOOP_IR_JR
+      : GEMM_LOOP_JR_IR;
+    if ((rate = timeBlocking(A, B, C, &trial, kernel)) > config->gflops) {
+      config->blocking = trial;
+      config->gflops = rate;
+      improved = 1;
+    } // end if
+  } // end for (pass
+
+  autotunePrint("Autotune best", config);
+  freeMatrix(A);
+  freeMatrix(B);
+  freeMatrix(C);
+} // end autotuneBlocking
+
+
+/*******************************************************************
+ * Function autotunePrint prints a configuration on one line.
+ ********************************************************************/
+void autotunePrint(const char * label, const AUTOTUNE_CONFIG * config) {
+  printf("%s: %s kc %d mc %d nc %d order %s", label, config->kernel,
+	 config->blocking.kc, config->blocking.mc, config->blocking.nc,
+	 (config->blocking.loopOrder == GEMM_LOOP_IR_JR) ? "ir-jr" : "jr-ir");
+  if (config->numberOfThreads > 0) {
+    printf(" threads %d", config->numberOfThreads);
+  } // end if
+  if (config->tileSize > 0) {
+    printf(" tile %d", config->tileSize);
+  } // end if
+  printf(" (%1.2f GFLOP/s)\n", config->gflops);
+} // end autotunePrint
+
+
+/*******************************************************************
+ * Function timeBlocking returns the best GFLOP/s of two runs of
+ * C = A*B with the given blocking and kernel.
+ ********************************************************************/
+static double timeBlocking(MATRIX * A, MATRIX * B, MATRIX * C,
+			   const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel) {
+  double startTime, endTime, best = 0.0, rate;
+  int run;
+
+  for (run=0; run < 2; run++) {
+    GET_TIME(startTime);
+    gemmPacked(A->rows, B->columns, A->columns, A->data, A->ld, B->data, B->ld,
+	       C->data, C->ld, blocking, kernel);
+    GET_TIME(endTime);
+    rate = 2.0*A->rows*(double) B->columns*A->columns / (endTime - startTime) * 1.0e-9;
+    if (rate > best) {
+      best = rate;
+    } // end if
+  } // end for
+  return best;
+} // end timeBlocking
+
+
+/*******************************************************************
+ * Function validRecord returns 1 if a cached record names a kernel
+ * this CPU supports and has block sizes, loop order, thread count
+ * and tile size the multiply can use.
+ ********************************************************************/
+static int validRecord(const AUTOTUNE_CONFIG * record) {
+  const GEMM_KERNEL * kernels[MAX_KERNELS];
+  int numberOfKernels, i, known = 0;
+
+  numberOfKernels = gemmSupportedKernels(kernels, MAX_KERNELS);
+  for (i=0; i < numberOfKernels; i++) {
+    if (strcmp(record->kernel, kernels[i]->name) == 0) {
+      known = 1;
+    } // end if
+  } // end for
+  return known
+    && record->blocking.kc >= 1 && record->blocking.mc >= 1
+    && record->blocking.nc >= 1
+    && (record->blocking.loopOrder == GEMM_LOOP_JR_IR
+	|| record->blocking.loopOrder == GEMM_LOOP_IR_JR)
+    && record->numberOfThreads >= 0 && record->tileSize >= 0;
+} // end validRecord
+
+
+/*******************************************************************
+ * Function sizeClass rounds n up to a power of two, so one record
+ * covers every size that behaves alike in the caches.
+ ********************************************************************/
+static int sizeClass(int n) {
+  int size = 1;
+
+  while (size < n) {
+    size *= 2;
+  } // end while
+  return size;
+} // end sizeClass
+
+
+/*******************************************************************
+ * Function cacheFileName returns the cache path: the environment
+ * override, else a dot file in $HOME, else one in the current
+ * directory.
+ ********************************************************************/
+static void cacheFileName(char * name, size_t size) {
+  const char * path = getenv(AUTOTUNE_CACHE_ENV);
+  const char * home = getenv("HOME");
+
+  if (path != NULL && path[0] != '\0') {
+    snprintf(name, size, "%s", path);
+  } else if (home != NULL && home[0] != '\0') {
+    snprintf(name, size, "%s/%s", home, AUTOTUNE_CACHE_NAME);
+  } else {
+    snprintf(name, size, "%s", AUTOTUNE_CACHE_NAME);
+  } // end if
+} // end cacheFileName
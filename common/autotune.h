@@ -0,0 +1,40 @@
+/*  File:        autotune.h
+    Description: Empirical tuning of the packed-panel multiply for the
+    machine it runs on, with a small text cache so later runs start
+    from the tuned configuration instead of searching again.
+    autotuneBlocking times gemmPacked on a sample multiply and walks
+    each knob in turn (micro-kernel, kc, mc, nc, loop order), keeping
+    whatever is fastest; programs with threads search their own
+    thread count / tile size on top and store them in the same record.
+    Records are keyed by host name, program, and matrix size class
+    (next power of two), one line each:
+      host program sizeClass kernel kc mc nc loopOrder threads tile GFLOP/s
+    The cache is $MMULT_AUTOTUNE_CACHE if set, else ~/.mmult_autotune.
+    Compile the program with:  -I../common ../common/autotune.c
+      ../common/gemm.c ../common/gemmSimd.c ../common/matrix.c
+      ../common/counterRandom.c -lpthread
+*/
+#ifndef _AUTOTUNE_H_
+#define _AUTOTUNE_H_
+
+#include "gemm.h"
+
+#define AUTOTUNE_CACHE_ENV "MMULT_AUTOTUNE_CACHE"
+#define AUTOTUNE_CACHE_NAME ".mmult_autotune"
+#define AUTOTUNE_MAX_TRIAL 1024  // largest sample multiply used while searching
+
+typedef struct {
+  char kernel[16];         // GEMM_KERNEL name
+  GEMM_BLOCKING blocking;
+  int numberOfThreads;     // 0 if the program has no threads to tune
+  int tileSize;            // 0 if the program has no tiles to tune
+  double gflops;           // best rate seen while tuning
+} AUTOTUNE_CONFIG;
+
+void autotuneDefaults(AUTOTUNE_CONFIG * config);
+int autotuneLoad(const char * program, int n, AUTOTUNE_CONFIG * config);
+int autotuneSave(const char * program, int n, const AUTOTUNE_CONFIG * config);
+void autotuneBlocking(int n, AUTOTUNE_CONFIG * config);
+void autotunePrint(const char * label, const AUTOTUNE_CONFIG * config);
+
+#endif
@@ -0,0 +1,269 @@
+/*  File:        barrier.c
+    Description: Sense-reversing central, dissemination and tournament
+    barriers with spin / yield / block waiting (see barrier.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "barrier.h"
+
+static void centralWait(BARRIER * barrier, BARRIER_THREAD * me);
+static void disseminationWait(BARRIER * barrier, BARRIER_THREAD * me, int threadId);
+static void tournamentWait(BARRIER * barrier, BARRIER_THREAD * me, int threadId);
+static void condvarWait(BARRIER * barrier);
+static void setFlag(BARRIER * barrier, atomic_int * flag, int value);
+static void awaitFlag(BARRIER * barrier, atomic_int * flag, int value);
+static void cpuRelax(void);
+static int spinLimit(int numberOfThreads);
+
+static const char * barrierNames[BARRIER_KINDS] =
+  {"central", "dissemination", "tournament", "condvar"};
+
+
+/*******************************************************************
+ * Function barrierCreate returns a barrier of the given kind for
+ * numberOfThreads threads with ids 0..numberOfThreads-1.
+ ********************************************************************/
+BARRIER * barrierCreate(int numberOfThreads, int kind) {
+  BARRIER * barrier;
+  int i;
+
+  if (numberOfThreads < 1 || numberOfThreads > (1 << BARRIER_MAX_ROUNDS)
+      || kind < 0 || kind >= BARRIER_KINDS) {
+    printf("Cannot make a barrier of kind %d for %d threads\n", kind, numberOfThreads);
+    exit(-1);
+  } // end if
+  if (posix_memalign((void **) &barrier, BARRIER_LINE, sizeof(BARRIER)) != 0
+      || posix_memalign((void **) &barrier->threads, BARRIER_LINE,
+			numberOfThreads*sizeof(BARRIER_THREAD)) != 0) {
+    printf("Could not allocate a barrier for %d threads\n", numberOfThreads);
+    exit(-1);
+  } // end if
+  memset(barrier->threads, 0, numberOfThreads*sizeof(BARRIER_THREAD));
+  barrier->kind = kind;
+  barrier->numberOfThreads = numberOfThreads;
+  for (barrier->rounds = 0; (1 << barrier->rounds) < numberOfThreads; barrier->rounds++);
+  for (i=0; i < numberOfThreads; i++) {
+    barrier->threads[i].sense = 1;   // flags start at 0: the first episode sets 1
+  } // end for
+  atomic_init(&barrier->count, numberOfThreads);
+  atomic_init(&barrier->sense, 0);
+  atomic_init(&barrier->sleepers, 0);
+  pthread_mutex_init(&barrier->lock, NULL);
+  pthread_cond_init(&barrier->allHere, NULL);
+  barrier->arrived = 0;
+  barrier->generation = 0;
+  spinLimit(numberOfThreads);
+  return barrier;
+} // end barrierCreate
+
+
+/*******************************************************************
+ * Function barrierWait returns once all the barrier's threads have
+ * called it; threadId is the caller's id, 0..numberOfThreads-1.
+ ********************************************************************/
+void barrierWait(BARRIER * barrier, int threadId) {
+  BARRIER_THREAD * me = &barrier->threads[threadId];
+
+  switch (barrier->kind) {
+  case BARRIER_CENTRAL:
+    centralWait(barrier, me);
+    break;
+  case BARRIER_DISSEMINATION:
+    disseminationWait(barrier, me, threadId);
+    break;
+  case BARRIER_TOURNAMENT:
+    tournamentWait(barrier, me, threadId);
+    break;
+  default:
+    condvarWait(barrier);
+  } // end switch
+} // end barrierWait
+
+
+/*******************************************************************
+ * Function barrierDestroy frees the barrier.
+ ********************************************************************/
+void barrierDestroy(BARRIER * barrier) {
+  pthread_mutex_destroy(&barrier->lock);
+  pthread_cond_destroy(&barrier->allHere);
+  free(barrier->threads);
+  free(barrier);
+} // end barrierDestroy
+
+
+/*******************************************************************
+ * Function barrierName returns the name of a barrier kind.
+ ********************************************************************/
+const char * barrierName(int kind) {
+  return (kind >= 0 && kind < BARRIER_KINDS) ? barrierNames[kind] : "unknown";
+} // end barrierName
+
+
+/*******************************************************************
+ * Function centralWait - the last thread to decrement the count
+ * resets it and flips the shared sense to this episode's; the
+ * others wait for that flip.
+ ********************************************************************/
+static void centralWait(BARRIER * barrier, BARRIER_THREAD * me) {
+  if (atomic_fetch_sub_explicit(&barrier->count, 1, memory_order_acq_rel) == 1) {
+    atomic_store_explicit(&barrier->count, barrier->numberOfThreads,
+			  memory_order_relaxed);
+    setFlag(barrier, &barrier->sense, me->sense);
+  } else {
+    awaitFlag(barrier, &barrier->sense, me->sense);
+  } // end if
+  me->sense = !me->sense;
+} // end centralWait
+
+
+/*******************************************************************
+ * Function disseminationWait - in round k signal thread id + 2^k and
+ * wait for the signal of thread id - 2^k.  Two flag sets used in
+ * turn keep a fast thread's next episode from overwriting a flag its
+ * partner has not read yet; the sense flips every second episode.
+ ********************************************************************/
+static void disseminationWait(BARRIER * barrier, BARRIER_THREAD * me, int threadId) {
+  BARRIER_THREAD * partner;
+  int k;
+
+  for (k=0; k < barrier->rounds; k++) {
+    partner = &barrier->threads[(threadId + (1 << k)) % barrier->numberOfThreads];
+    setFlag(barrier, &partner->flags[me->parity][k], me->sense);
+    awaitFlag(barrier, &me->flags[me->parity][k], me->sense);
+  } // end for
+  if (me->parity == 1) {
+    me->sense = !me->sense;
+  } // end if
+  me->parity = 1 - me->parity;
+} // end disseminationWait
+
+
+/*******************************************************************
+ * Function tournamentWait - in round k the thread whose id is a
+ * multiple of 2^(k+1) waits for its opponent id + 2^k (if there is
+ * one); the opponent reports and waits to be released.  Thread 0
+ * wins the last round, and each thread then releases the opponents
+ * it beat, latest round first.
+ ********************************************************************/
+static void tournamentWait(BARRIER * barrier, BARRIER_THREAD * me, int threadId) {
+  int k, lostRound = barrier->rounds, opponent;
+
+  for (k=0; k < barrier->rounds; k++) {
+    if ((threadId & ((2 << k) - 1)) == 0) {
+      opponent = threadId + (1 << k);
+      if (opponent < barrier->numberOfThreads) {
+	awaitFlag(barrier, &me->flags[0][k], me->sense);
+      } // end if
+    } else {
+      setFlag(barrier, &barrier->threads[threadId - (1 << k)].flags[0][k], me->sense);
+      awaitFlag(barrier, &me->release, me->sense);
+      lostRound = k;
+      break;
+    } // end if
+  } // end for
+  for (k=lostRound-1; k >= 0; k--) {
+    opponent = threadId + (1 << k);
+    if (opponent < barrier->numberOfThreads) {
+      setFlag(barrier, &barrier->threads[opponent].release, me->sense);
+    } // end if
+  } // end for
+  me->sense = !me->sense;
+} // end tournamentWait
+
+
+/*******************************************************************
+ * Function condvarWait - mutex + condition variable barrier; the
+ * generation count makes it safe against spurious wake-ups.
+ ********************************************************************/
+static void condvarWait(BARRIER * barrier) {
+  long myGeneration;
+
+  pthread_mutex_lock(&barrier->lock);
+  myGeneration = barrier->generation;
+  barrier->arrived++;
+  if (barrier->arrived == barrier->numberOfThreads) {
+    barrier->arrived = 0;
+    barrier->generation++;
+    pthread_cond_broadcast(&barrier->allHere);
+  } else {
+    while (barrier->generation == myGeneration) {
+      pthread_cond_wait(&barrier->allHere, &barrier->lock);
+    } // end while
+  } // end if
+  pthread_mutex_unlock(&barrier->lock);
+} // end condvarWait
+
+
+/*******************************************************************
+ * Function setFlag stores value into flag and wakes the threads
+ * blocked on it, if any thread is blocked at all.  With the seq_cst
+ * store and load either this side sees the sleeper count, or the
+ * sleeper sees the new value before it blocks.
+ ********************************************************************/
+static void setFlag(BARRIER * barrier, atomic_int * flag, int value) {
+  atomic_store(flag, value);
+  if (atomic_load(&barrier->sleepers) > 0) {
+    syscall(SYS_futex, (int *) flag, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+  } // end if
+} // end setFlag
+
+
+/*******************************************************************
+ * Function awaitFlag returns once flag == value: spinning, then
+ * yielding, then blocking on the flag's futex.
+ ********************************************************************/
+static void awaitFlag(BARRIER * barrier, atomic_int * flag, int value) {
+  int tries, spin = spinLimit(barrier->numberOfThreads);
+
+  for (tries = 0; tries < spin; tries++) {
+    if (atomic_load_explicit(flag, memory_order_acquire) == value) {
+      return;
+    } // end if
+    cpuRelax();
+  } // end for
+  for (tries = 0; tries < BARRIER_YIELD; tries++) {
+    if (atomic_load_explicit(flag, memory_order_acquire) == value) {
+      return;
+    } // end if
+    sched_yield();
+  } // end for
+  atomic_fetch_add(&barrier->sleepers, 1);
+  while (atomic_load(flag) != value) {
+    // flags only hold 0 or 1: sleep while it still has the other value
+    syscall(SYS_futex, (int *) flag, FUTEX_WAIT_PRIVATE, !value, NULL, NULL, 0);
+  } // end while
+  atomic_fetch_sub(&barrier->sleepers, 1);
+} // end awaitFlag
+
+
+/*******************************************************************
+ * Function cpuRelax - a polite pause inside a spin loop.
+ ********************************************************************/
+static void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  atomic_signal_fence(memory_order_seq_cst);
+#endif
+} // end cpuRelax
+
+
+/*******************************************************************
+ * Function spinLimit returns BARRIER_SPIN, or 0 when there are more
+ * threads than CPUs: the thread being waited for may then need this
+ * thread's CPU, and spinning only delays it.
+ ********************************************************************/
+static int spinLimit(int numberOfThreads) {
+  static int cpus = 0;
+
+  if (cpus == 0) {
+    cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  return (numberOfThreads <= cpus && cpus > 1) ? BARRIER_SPIN : 0;
+} // end spinLimit
@@ -0,0 +1,88 @@
+/*  File:        barrier.h
+    Description: Reusable thread barriers for the programs that sync
+    every iteration (hw7 SOR, lab9 n-body, lab7 maddC, hw9 TSP), to
+    replace their mutex + condition variable barriers, where every
+    episode takes the lock once per thread and ends in a broadcast
+    that wakes all the sleepers through the kernel.
+      BARRIER_CENTRAL        sense-reversing: one atomic counter, the
+                             last thread in flips a shared sense flag
+                             that the others watch.  Cheapest for a
+                             few threads; every arrival hits the same
+                             cache line.
+      BARRIER_DISSEMINATION  ceil(log2 n) rounds; in round k thread i
+                             signals thread i + 2^k (mod n) and waits
+                             for thread i - 2^k.  No shared counter, and
+                             every flag is written by one thread and
+                             read by one.
+      BARRIER_TOURNAMENT     ceil(log2 n) rounds of pairwise games with
+                             fixed winners: the loser of round k reports
+                             to its winner and drops out, thread 0 wins
+                             and the wake-up goes back down the same
+                             tree.  2(n-1) flag writes per episode.
+      BARRIER_CONDVAR        the mutex + condition variable barrier the
+                             programs had (with a generation count), as
+                             the baseline.
+    A waiting thread spins on its flag BARRIER_SPIN times (none on a
+    single CPU, where the thread it waits for cannot run meanwhile),
+    then yields the CPU BARRIER_YIELD times, and then blocks on a
+    futex.  The thread that sets a flag only makes the wake-up system
+    call if somebody is blocked, so a busy barrier never enters the
+    kernel.  Every thread passes its own id 0..n-1 to barrierWait.
+    Programs use BARRIER_DEFAULT unless compiled with, e.g.,
+      -DBARRIER_DEFAULT=BARRIER_DISSEMINATION
+    Compile the program with:  -I../common ../common/barrier.c -lpthread
+*/
+#ifndef _BARRIER_H_
+#define _BARRIER_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define BARRIER_CENTRAL 0
+#define BARRIER_DISSEMINATION 1
+#define BARRIER_TOURNAMENT 2
+#define BARRIER_CONDVAR 3
+#define BARRIER_KINDS 4
+
+#ifndef BARRIER_DEFAULT
+#define BARRIER_DEFAULT BARRIER_CENTRAL
+#endif
+#ifndef BARRIER_SPIN
+#define BARRIER_SPIN 2000   // polls of the flag before yielding
+#endif
+#ifndef BARRIER_YIELD
+#define BARRIER_YIELD 50    // sched_yield calls before blocking
+#endif
+
+#define BARRIER_LINE 64         // cache line: each thread's flags get their own
+#define BARRIER_MAX_ROUNDS 16   // up to 2^16 threads
+
+// one thread's state; flags are written by other threads
+typedef struct {
+  _Alignas(BARRIER_LINE) int sense;         // this thread's episode sense
+  int parity;                               // dissemination: which flag set
+  atomic_int flags[2][BARRIER_MAX_ROUNDS];  // dissemination: [parity][round]
+                                            // tournament: [0][round] arrivals
+  atomic_int release;                       // tournament: wake-up from the winner
+} BARRIER_THREAD;
+
+typedef struct {
+  int kind;
+  int numberOfThreads;
+  int rounds;                  // ceil(log2 numberOfThreads)
+  _Alignas(BARRIER_LINE) atomic_int count;   // central: threads still to arrive
+  _Alignas(BARRIER_LINE) atomic_int sense;   // central: flips once per episode
+  _Alignas(BARRIER_LINE) atomic_int sleepers;  // threads blocked on a futex
+  BARRIER_THREAD * threads;
+  pthread_mutex_t lock;        // condvar kind
+  pthread_cond_t allHere;
+  int arrived;
+  long generation;
+} BARRIER;
+
+BARRIER * barrierCreate(int numberOfThreads, int kind);
+void barrierWait(BARRIER * barrier, int threadId);
+void barrierDestroy(BARRIER * barrier);
+const char * barrierName(int kind);
+
+#endif
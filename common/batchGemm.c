@@ -0,0 +1,219 @@
+/*  File:        batchGemm.c
+    Description: Batched small-matrix multiply on the interleaved
+    BATCH layout (see batchGemm.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batchGemm.h"
+
+#define BATCH_TASK_FLOPS 262144  // aim for at least this much work per pool task
+
+typedef void (*BATCH_KERNEL)(int n, const double * a, const double * b, double * c);
+
+// a batchMultiply job, on the caller's stack
+typedef struct {
+  const BATCH * A;
+  const BATCH * B;
+  BATCH * C;
+  BATCH_KERNEL kernel;
+  int groupsPerTask;
+} BATCH_JOB;
+
+static void batchTask(void * args, int task, int threadId);
+
+
+/*******************************************************************
+ * Function batchKernelBody multiplies one group: c = a*b for the
+ * BATCH_LANES interleaved n x n products.  Row i of c is built up
+ * as a sum of rows of b scaled by a(i,k); the lane loop is the
+ * innermost, so each step is one vector multiply-add over the
+ * group.  Inlined into each kernel below with n a constant.
+ ********************************************************************/
+static inline __attribute__((always_inline))
+void batchKernelBody(int n, const double * restrict a, const double * restrict b,
+		     double * restrict c) {
+  const double * aik, * bk;
+  double * ci;
+  int i, j, k, l;
+
+  for (i=0; i < n; i++) {
+    ci = c + (size_t) i*n*BATCH_LANES;
+    for (j=0; j < n*BATCH_LANES; j++) {
+      ci[j] = 0.0;
+    } // end for (j
+    for (k=0; k < n; k++) {
+      aik = a + ((size_t) i*n + k)*BATCH_LANES;
+      bk = b + (size_t) k*n*BATCH_LANES;
+      for (j=0; j < n; j++) {
+	for (l=0; l < BATCH_LANES; l++) {
+	  ci[j*BATCH_LANES + l] += aik[l] * bk[j*BATCH_LANES + l];
+	} // end for (l
+      } // end for (j
+    } // end for (k
+  } // end for (i
+} // end batchKernelBody
+
+
+// one kernel per specialized size, built for the widest vectors
+// available; n is fixed at N and only kept for the BATCH_KERNEL type
+#define BATCH_KERNEL_FOR(N)						\
+  __attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))	\
+  static void batchKernel##N(int n, const double * a, const double * b,	\
+			     double * c) {				\
+    (void) n;								\
+    batchKernelBody(N, a, b, c);					\
+  }
+
+BATCH_KERNEL_FOR(8)
+BATCH_KERNEL_FOR(16)
+BATCH_KERNEL_FOR(24)
+BATCH_KERNEL_FOR(32)
+BATCH_KERNEL_FOR(48)
+BATCH_KERNEL_FOR(64)
+
+__attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))
+static void batchKernelGeneric(int n, const double * a, const double * b,
+			       double * c) {
+  batchKernelBody(n, a, b, c);
+} // end batchKernelGeneric
+
+static const BATCH_KERNEL specializedKernels[BATCH_MAX_N+1] = {
+  [8] = batchKernel8, [16] = batchKernel16, [24] = batchKernel24,
+  [32] = batchKernel32, [48] = batchKernel48, [64] = batchKernel64
+};
+
+
+/*******************************************************************
+ * Function allocateBatch allocates count zeroed n x n matrices in
+ * the interleaved layout.
+ ********************************************************************/
+BATCH * allocateBatch(int n, int count) {
+  BATCH * batch;
+  void * block;
+  size_t bytes;
+
+  if (n < 1 || n > BATCH_MAX_N || count < 1) {
+    printf("A batch holds 1 or more matrices of size 1 to %d\n", BATCH_MAX_N);
+    exit(-1);
+  } // end if
+  batch = (BATCH *) malloc(sizeof(BATCH));
+  batch->n = n;
+  batch->count = count;
+  batch->groups = (count + BATCH_LANES - 1) / BATCH_LANES;
+  bytes = sizeof(double) * (size_t) batch->groups * n * n * BATCH_LANES;
+  if (posix_memalign(&block, 64, bytes) != 0) {
+    printf("Unable to allocate a batch of %d %d x %d matrices\n", count, n, n);
+    exit(-1);
+  } // end if
+  batch->data = (double *) block;
+  memset(batch->data, 0, bytes);
+
+  return batch;
+} // end allocateBatch
+
+
+/*******************************************************************
+ * Function freeBatch deallocates a batch from allocateBatch.
+ ********************************************************************/
+void freeBatch(BATCH * batch) {
+  if (batch == NULL) {
+    return;
+  } // end if
+  free(batch->data);
+  free(batch);
+} // end freeBatch
+
+
+/*******************************************************************
+ * Function batchSetMatrix copies an n x n 2D array into matrix # i.
+ ********************************************************************/
+void batchSetMatrix(BATCH * batch, int i, double ** matrix) {
+  int r, c;
+
+  for (r=0; r < batch->n; r++) {
+    for (c=0; c < batch->n; c++) {
+      BATCH_ELEMENT(batch, i, r, c) = matrix[r][c];
+    } // end for (c
+  } // end for (r
+} // end batchSetMatrix
+
+
+/*******************************************************************
+ * Function batchGetMatrix copies matrix # i out to an n x n 2D array.
+ ********************************************************************/
+void batchGetMatrix(const BATCH * batch, int i, double ** matrix) {
+  int r, c;
+
+  for (r=0; r < batch->n; r++) {
+    for (c=0; c < batch->n; c++) {
+      matrix[r][c] = BATCH_ELEMENT(batch, i, r, c);
+    } // end for (c
+  } // end for (r
+} // end batchGetMatrix
+
+
+/*******************************************************************
+ * Function batchKernelIsSpecialized returns 1 if n has a kernel of
+ * its own, 0 if it uses the generic one.
+ ********************************************************************/
+int batchKernelIsSpecialized(int n) {
+  return n >= 0 && n <= BATCH_MAX_N && specializedKernels[n] != NULL;
+} // end batchKernelIsSpecialized
+
+
+/*******************************************************************
+ * Function batchMultiply computes C[i] = A[i]*B[i] for every matrix
+ * of the batches.  With a pool the groups are handed out in chunks
+ * of about BATCH_TASK_FLOPS; with pool NULL the calling thread does
+ * them all.  Nothing is allocated.
+ ********************************************************************/
+void batchMultiply(THREAD_POOL * pool, const BATCH * A, const BATCH * B, BATCH * C) {
+  BATCH_JOB job;
+  long groupFlops;
+  int g;
+
+  if (A->n != B->n || A->n != C->n || A->count != B->count || A->count != C->count) {
+    printf("Batches cannot be multiplied -- incompatible sizes!\n");
+    exit(-1);
+  } // end if
+
+  job.A = A;
+  job.B = B;
+  job.C = C;
+  job.kernel = batchKernelIsSpecialized(A->n) ? specializedKernels[A->n]
+    : batchKernelGeneric;
+  groupFlops = 2L * A->n * A->n * A->n * BATCH_LANES;
+  job.groupsPerTask = (int) ((BATCH_TASK_FLOPS + groupFlops - 1) / groupFlops);
+
+  if (pool == NULL) {
+    for (g=0; g < A->groups; g++) {
+      job.kernel(A->n, BATCH_GROUP(A, g), BATCH_GROUP(B, g), BATCH_GROUP(C, g));
+    } // end for
+    return;
+  } // end if
+  threadPoolRun(pool, (A->groups + job.groupsPerTask - 1) / job.groupsPerTask,
+		batchTask, &job);
+} // end batchMultiply
+
+
+/*******************************************************************
+ * Function batchTask is a thread pool task: it multiplies chunk #
+ * task of job.groupsPerTask groups.
+ ********************************************************************/
+static void batchTask(void * args, int task, int threadId) {
+  const BATCH_JOB * job = (const BATCH_JOB *) args;
+  int first = task * job->groupsPerTask;
+  int last = first + job->groupsPerTask;
+  int g;
+
+  (void) threadId;  // groups share no per-worker state
+
+  if (last > job->A->groups) {
+    last = job->A->groups;
+  } // end if
+  for (g=first; g < last; g++) {
+    job->kernel(job->A->n, BATCH_GROUP(job->A, g), BATCH_GROUP(job->B, g),
+		BATCH_GROUP(job->C, g));
+  } // end for
+} // end batchTask
@@ -0,0 +1,48 @@
+/*  File:        batchGemm.h
+    Description: Batched multiply of many small square matrices,
+    C[i] = A[i]*B[i] for i = 0 .. count-1, n from 1 to BATCH_MAX_N.
+    The matrices of a BATCH are stored interleaved: groups of
+    BATCH_LANES matrices with element (r, c) of all of them side by
+    side, so one vector holds the same element of BATCH_LANES
+    matrices and every multiply-add of the kernel works on
+    BATCH_LANES independent products at once, whatever n is:
+      BATCH_ELEMENT(batch, i, r, c) ==
+        data[((i/BATCH_LANES)*n*n + r*n + c)*BATCH_LANES + i%BATCH_LANES]
+    The unused lanes of the last group are zero.  Sizes 8, 16, 24,
+    32, 48 and 64 get kernels compiled for that n (loops fully known
+    to the compiler); other sizes use a generic kernel.
+    batchMultiply spreads the groups over a caller-owned thread pool
+    (NULL runs them in the calling thread) and allocates nothing.
+    Compile the program with:  -I../common ../common/batchGemm.c
+      ../common/threadPool.c -lpthread
+*/
+#ifndef _BATCH_GEMM_H_
+#define _BATCH_GEMM_H_
+
+#include <stddef.h>
+#include "threadPool.h"
+
+#define BATCH_LANES 8   // matrices per group: one AVX-512 register of doubles
+#define BATCH_MAX_N 64
+
+typedef struct {
+  int n;           // every matrix is n x n
+  int count;       // # matrices
+  int groups;      // (count + BATCH_LANES - 1) / BATCH_LANES
+  double * data;   // groups*n*n*BATCH_LANES doubles, 64-byte aligned
+} BATCH;
+
+#define BATCH_GROUP(batch, g) \
+  ((batch)->data + (size_t) (g) * (batch)->n * (batch)->n * BATCH_LANES)
+#define BATCH_ELEMENT(batch, i, r, c) \
+  (BATCH_GROUP(batch, (i) / BATCH_LANES)[((r) * (batch)->n + (c)) * BATCH_LANES \
+					  + (i) % BATCH_LANES])
+
+BATCH * allocateBatch(int n, int count);
+void freeBatch(BATCH * batch);
+void batchSetMatrix(BATCH * batch, int i, double ** matrix);
+void batchGetMatrix(const BATCH * batch, int i, double ** matrix);
+void batchMultiply(THREAD_POOL * pool, const BATCH * A, const BATCH * B, BATCH * C);
+int batchKernelIsSpecialized(int n);
+
+#endif
@@ -0,0 +1,323 @@
+/*  File:        benchmark.c
+    Description: Timing statistics, roofline and result records for
+    the kernel benchmark suite (see benchmark.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "timer.h"
+#include "matrix.h"
+#include "gemm.h"
+#include "benchmark.h"
+
+#define PEAK_ITERATIONS 50  // multiplies per thread in one compute-roof run
+#define ROOF_RUNS 5         // best of this many runs for each roof
+
+// per-thread blocks for the compute roof
+typedef struct {
+  double ** a;
+  double ** b;
+  double ** c;
+  double ** work;      // packing space, so the timing holds no malloc
+  GEMM_BLOCKING blocking;
+  const GEMM_KERNEL * kernel;
+} PEAK_ARGS;
+
+// triad a = b + scalar*c, split into numberOfTasks bands
+typedef struct {
+  double * a;
+  double * b;
+  double * c;
+  double scalar;
+  long count;
+  int numberOfTasks;
+} TRIAD_ARGS;
+
+static int recordCount = 0;  // JSON records written since benchmarkBegin
+
+static int compareDoubles(const void * x, const void * y);
+static void peakInitTask(void * arg, int task, int threadId);
+static void peakTask(void * arg, int task, int threadId);
+static void triadInitTask(void * arg, int task, int threadId);
+static void triadTask(void * arg, int task, int threadId);
+static void jsonSeparator(FILE * out);
+
+
+/*******************************************************************
+ * Function benchmarkTime runs function(arg) warmup times untimed and
+ * then repeats (at most BENCH_MAX_REPEATS) timed times, and fills
+ * stats with the min, median, 95th percentile and mean seconds.
+ ********************************************************************/
+void benchmarkTime(BENCH_FUNCTION function, void * arg, int warmup, int repeats,
+		   BENCH_STATS * stats) {
+  double times[BENCH_MAX_REPEATS];
+  double startTime, endTime, sum = 0.0;
+  int i;
+
+  if (repeats < 1) {
+    repeats = 1;
+  } else if (repeats > BENCH_MAX_REPEATS) {
+    repeats = BENCH_MAX_REPEATS;
+  } // end if
+  for (i=0; i < warmup; i++) {
+    function(arg);
+  } // end for
+  for (i=0; i < repeats; i++) {
+    GET_TIME(startTime);
+    function(arg);
+    GET_TIME(endTime);
+    times[i] = endTime - startTime;
+    sum += times[i];
+  } // end for
+
+  qsort(times, repeats, sizeof(double), compareDoubles);
+  stats->runs = repeats;
+  stats->min = times[0];
+  stats->median = (repeats % 2 == 1) ? times[repeats/2]
+    : 0.5*(times[repeats/2 - 1] + times[repeats/2]);
+  // nearest rank: the smallest time at or above 95% of the runs
+  stats->p95 = times[(95*repeats + 99) / 100 - 1];
+  stats->mean = sum / repeats;
+} // end benchmarkTime
+
+
+/*******************************************************************
+ * Function benchmarkRoofline measures the compute and memory roofs
+ * with all the threads of pool, best of ROOF_RUNS runs each.
+ ********************************************************************/
+void benchmarkRoofline(THREAD_POOL * pool, BENCH_ROOFLINE * roofline) {
+  int numberOfThreads = pool->numberOfThreads;
+  PEAK_ARGS peak;
+  TRIAD_ARGS triad;
+  double startTime, endTime, rate;
+  int i, run;
+
+  roofline->numberOfThreads = numberOfThreads;
+  roofline->peakGflops = 0.0;
+  roofline->bandwidth = 0.0;
+
+  /* compute roof: every thread multiplies its own cache-resident block */
+  gemmDefaultBlocking(&peak.blocking);
+  peak.kernel = gemmBestKernel();
+  peak.a = (double **) malloc(numberOfThreads*sizeof(double *));
+  peak.b = (double **) malloc(numberOfThreads*sizeof(double *));
+  peak.c = (double **) malloc(numberOfThreads*sizeof(double *));
+  peak.work = (double **) malloc(numberOfThreads*sizeof(double *));
+  for (i=0; i < numberOfThreads; i++) {
+    peak.a[i] = allocateAligned((size_t) BENCH_PEAK_N*BENCH_PEAK_N);
+    peak.b[i] = allocateAligned((size_t) BENCH_PEAK_N*BENCH_PEAK_N);
+    peak.c[i] = allocateAligned((size_t) BENCH_PEAK_N*BENCH_PEAK_N);
+    peak.work[i] = allocateAligned(gemmWorkspaceSize(BENCH_PEAK_N, BENCH_PEAK_N,
+						     &peak.blocking, peak.kernel));
+  } // end for
+  threadPoolRun(pool, numberOfThreads, peakInitTask, &peak);
+  for (run=0; run <= ROOF_RUNS; run++) {  // run 0 warms up: not counted
+    GET_TIME(startTime);
+    threadPoolRun(pool, numberOfThreads, peakTask, &peak);
+    GET_TIME(endTime);
+    rate = 2.0*BENCH_PEAK_N*BENCH_PEAK_N*(double) BENCH_PEAK_N*PEAK_ITERATIONS
+      *numberOfThreads / (endTime - startTime) * 1.0e-9;
+    if (run > 0 && rate > roofline->peakGflops) {
+      roofline->peakGflops = rate;
+    } // end if
+  } // end for
+  for (i=0; i < numberOfThreads; i++) {
+    free(peak.a[i]);
+    free(peak.b[i]);
+    free(peak.c[i]);
+    free(peak.work[i]);
+  } // end for
+  free(peak.a);
+  free(peak.b);
+  free(peak.c);
+  free(peak.work);
+
+  /* memory roof: STREAM triad, 24 bytes moved per element */
+  triad.count = BENCH_STREAM_DOUBLES;
+  triad.scalar = 3.0;
+  triad.numberOfTasks = numberOfThreads;
+  triad.a = allocateAligned(triad.count);
+  triad.b = allocateAligned(triad.count);
+  triad.c = allocateAligned(triad.count);
+  threadPoolRun(pool, triad.numberOfTasks, triadInitTask, &triad);
+  for (run=0; run < ROOF_RUNS; run++) {
+    GET_TIME(startTime);
+    threadPoolRun(pool, triad.numberOfTasks, triadTask, &triad);
+    GET_TIME(endTime);
+    rate = 24.0*triad.count / (endTime - startTime) * 1.0e-9;
+    if (rate > roofline->bandwidth) {
+      roofline->bandwidth = rate;
+    } // end if
+  } // end for
+  free(triad.a);
+  free(triad.b);
+  free(triad.c);
+} // end benchmarkRoofline
+
+
+/*******************************************************************
+ * Function benchmarkBegin writes the CSV header (or opens the JSON
+ * object) for one run of the suite on host.
+ ********************************************************************/
+void benchmarkBegin(FILE * out, int format, const char * host) {
+  recordCount = 0;
+  if (format == BENCH_FORMAT_JSON) {
+    fprintf(out, "{\n  \"host\": \"%s\",\n  \"records\": [", host);
+  } else {
+    fprintf(out, "# host %s\n", host);
+    fprintf(out, "kernel,n,threads,runs,min_s,median_s,p95_s,mean_s,"
+	    "gflops,gbytes_s,intensity,roof_gflops,roof_fraction\n");
+  } // end if
+} // end benchmarkBegin
+
+
+/*******************************************************************
+ * Function benchmarkRoofRecord writes the roofs measured for one
+ * thread count (a comment line in CSV).
+ ********************************************************************/
+void benchmarkRoofRecord(FILE * out, int format, const BENCH_ROOFLINE * roofline) {
+  if (format == BENCH_FORMAT_JSON) {
+    jsonSeparator(out);
+    fprintf(out, "{\"type\": \"roofline\", \"threads\": %d, \"peak_gflops\": %.3f,"
+	    " \"gbytes_s\": %.3f, \"ridge\": %.4f}", roofline->numberOfThreads,
+	    roofline->peakGflops, roofline->bandwidth,
+	    roofline->peakGflops / roofline->bandwidth);
+  } else {
+    fprintf(out, "# roofline threads %d peak %.3f GFLOP/s bandwidth %.3f GB/s ridge %.4f flop/byte\n",
+	    roofline->numberOfThreads, roofline->peakGflops, roofline->bandwidth,
+	    roofline->peakGflops / roofline->bandwidth);
+  } // end if
+  fflush(out);
+} // end benchmarkRoofRecord
+
+
+/*******************************************************************
+ * Function benchmarkRecord writes one result.  The rates use the
+ * median time; the roof is min(peak, intensity * bandwidth) for the
+ * same thread count.
+ ********************************************************************/
+void benchmarkRecord(FILE * out, int format, const BENCH_RESULT * result,
+		     const BENCH_ROOFLINE * roofline) {
+  double gflops = result->flops / result->stats.median * 1.0e-9;
+  double gbytes = result->bytes / result->stats.median * 1.0e-9;
+  double intensity = result->flops / result->bytes;
+  double roof = intensity * roofline->bandwidth;
+
+  if (roof > roofline->peakGflops) {
+    roof = roofline->peakGflops;
+  } // end if
+  if (format == BENCH_FORMAT_JSON) {
+    jsonSeparator(out);
+    fprintf(out, "{\"type\": \"kernel\", \"kernel\": \"%s\", \"n\": %d, \"threads\": %d,"
+	    " \"runs\": %d, \"min_s\": %.6e, \"median_s\": %.6e, \"p95_s\": %.6e,"
+	    " \"mean_s\": %.6e, \"gflops\": %.3f, \"gbytes_s\": %.3f,"
+	    " \"intensity\": %.4f, \"roof_gflops\": %.3f, \"roof_fraction\": %.4f}",
+	    result->kernel, result->n, result->numberOfThreads, result->stats.runs,
+	    result->stats.min, result->stats.median, result->stats.p95,
+	    result->stats.mean, gflops, gbytes, intensity, roof, gflops / roof);
+  } else {
+    fprintf(out, "%s,%d,%d,%d,%.6e,%.6e,%.6e,%.6e,%.3f,%.3f,%.4f,%.3f,%.4f\n",
+	    result->kernel, result->n, result->numberOfThreads, result->stats.runs,
+	    result->stats.min, result->stats.median, result->stats.p95,
+	    result->stats.mean, gflops, gbytes, intensity, roof, gflops / roof);
+  } // end if
+  fflush(out);
+} // end benchmarkRecord
+
+
+/*******************************************************************
+ * Function benchmarkEnd closes the JSON object (nothing for CSV).
+ ********************************************************************/
+void benchmarkEnd(FILE * out, int format) {
+  if (format == BENCH_FORMAT_JSON) {
+    fprintf(out, "\n  ]\n}\n");
+  } // end if
+  fflush(out);
+} // end benchmarkEnd
+
+
+/*******************************************************************
+ * Function compareDoubles - qsort order for the run times.
+ ********************************************************************/
+static int compareDoubles(const void * x, const void * y) {
+  double a = *(const double *) x, b = *(const double *) y;
+
+  return (a > b) - (a < b);
+} // end compareDoubles
+
+
+/*******************************************************************
+ * Function peakInitTask first-touches and fills task's blocks.
+ ********************************************************************/
+static void peakInitTask(void * arg, int task, int threadId) {
+  PEAK_ARGS * peak = (PEAK_ARGS *) arg;
+  int i;
+
+  (void) threadId;
+  for (i=0; i < BENCH_PEAK_N*BENCH_PEAK_N; i++) {
+    peak->a[task][i] = 1.0 / (i + 1);
+    peak->b[task][i] = 1.0 / (i + 2);
+    peak->c[task][i] = 0.0;
+  } // end for
+} // end peakInitTask
+
+
+/*******************************************************************
+ * Function peakTask - PEAK_ITERATIONS multiplies on task's blocks.
+ ********************************************************************/
+static void peakTask(void * arg, int task, int threadId) {
+  PEAK_ARGS * peak = (PEAK_ARGS *) arg;
+  int i;
+
+  (void) threadId;
+  for (i=0; i < PEAK_ITERATIONS; i++) {
+    gemmPackedWorkspace(BENCH_PEAK_N, BENCH_PEAK_N, BENCH_PEAK_N, peak->a[task],
+			BENCH_PEAK_N, peak->b[task], BENCH_PEAK_N, peak->c[task],
+			BENCH_PEAK_N, &peak->blocking, peak->kernel, peak->work[task]);
+  } // end for
+} // end peakTask
+
+
+/*******************************************************************
+ * Function triadInitTask first-touches task's band of the arrays.
+ ********************************************************************/
+static void triadInitTask(void * arg, int task, int threadId) {
+  TRIAD_ARGS * triad = (TRIAD_ARGS *) arg;
+  long first = triad->count * task / triad->numberOfTasks;
+  long last = triad->count * (task+1) / triad->numberOfTasks;
+  long i;
+
+  (void) threadId;
+  for (i=first; i < last; i++) {
+    triad->a[i] = 0.0;
+    triad->b[i] = 1.0;
+    triad->c[i] = 2.0;
+  } // end for
+} // end triadInitTask
+
+
+/*******************************************************************
+ * Function triadTask - a = b + scalar*c over task's band.
+ ********************************************************************/
+static void triadTask(void * arg, int task, int threadId) {
+  TRIAD_ARGS * triad = (TRIAD_ARGS *) arg;
+  long first = triad->count * task / triad->numberOfTasks;
+  long last = triad->count * (task+1) / triad->numberOfTasks;
+  double * restrict a = triad->a;
+  const double * restrict b = triad->b;
+  const double * restrict c = triad->c;
+  double scalar = triad->scalar;
+  long i;
+
+  (void) threadId;
+  for (i=first; i < last; i++) {
+    a[i] = b[i] + scalar*c[i];
+  } // end for
+} // end triadTask
+
+
+/*******************************************************************
+ * Function jsonSeparator starts the next element of the records array.
+ ********************************************************************/
+static void jsonSeparator(FILE * out) {
+  fprintf(out, "%s\n    ", (recordCount++ == 0) ? "" : ",");
+} // end jsonSeparator
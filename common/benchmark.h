@@ -0,0 +1,71 @@
+/*  File:        benchmark.h
+    Description: Timing statistics, a measured roofline, and CSV/JSON
+    records for the kernel benchmark suite (lab5/kernelBench.c), so runs
+    can be kept and diffed to catch regressions instead of reading
+    each program's own "seq time / parallel time" line.
+      benchmarkTime      - warmup runs (not kept), then repeats timed
+                           runs reduced to min / median / p95 / mean.
+      benchmarkRoofline  - the two roofs of this host for a thread
+                           count: peak GFLOP/s (gemmPacked with the best
+                           kernel on an L2-resident block, one per
+                           thread) and sustained GB/s (a STREAM-style
+                           triad over arrays far larger than the LLC).
+                           A kernel of arithmetic intensity I (flops
+                           per byte of memory traffic) can reach at
+                           most min(peak, I * bandwidth).
+      benchmarkRecord    - one result line: kernel, size, threads, the
+                           times, GFLOP/s, GB/s, intensity and the
+                           fraction of the roofline bound achieved.
+    Compile the program with:  -I../common ../common/benchmark.c
+      ../common/threadPool.c ../common/gemm.c ../common/gemmSimd.c
+      ../common/matrix.c -lm -lpthread
+*/
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <stdio.h>
+#include "threadPool.h"
+
+#define BENCH_FORMAT_CSV 0
+#define BENCH_FORMAT_JSON 1
+
+#define BENCH_MAX_REPEATS 1000
+#define BENCH_PEAK_N 192              // per-thread multiply for the compute roof
+#define BENCH_STREAM_DOUBLES (8L*1024*1024)  // per triad array (64 MB)
+
+// the timed code: called warmup + repeats times
+typedef void (*BENCH_FUNCTION)(void * arg);
+
+typedef struct {
+  int runs;
+  double min;
+  double median;
+  double p95;
+  double mean;
+} BENCH_STATS;
+
+typedef struct {
+  int numberOfThreads;
+  double peakGflops;
+  double bandwidth;   // GB/s
+} BENCH_ROOFLINE;
+
+typedef struct {
+  const char * kernel;
+  int n;
+  int numberOfThreads;
+  double flops;       // per run
+  double bytes;       // compulsory memory traffic per run
+  BENCH_STATS stats;
+} BENCH_RESULT;
+
+void benchmarkTime(BENCH_FUNCTION function, void * arg, int warmup, int repeats,
+		   BENCH_STATS * stats);
+void benchmarkRoofline(THREAD_POOL * pool, BENCH_ROOFLINE * roofline);
+void benchmarkBegin(FILE * out, int format, const char * host);
+void benchmarkRoofRecord(FILE * out, int format, const BENCH_ROOFLINE * roofline);
+void benchmarkRecord(FILE * out, int format, const BENCH_RESULT * result,
+		     const BENCH_ROOFLINE * roofline);
+void benchmarkEnd(FILE * out, int format);
+
+#endif
@@ -0,0 +1,128 @@
+/*  File:        counterRandom.c
+    Description: Counter-based random matrix generation (see
+    counterRandom.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "counterRandom.h"
+
+typedef struct {
+  double ** array;
+  int columns;
+  int startRow;
+  int endRow;
+  uint64_t seed;
+  double min;
+  double max;
+} RANDOM_BLOCK;
+
+static void * threadGenerateRows(void * arg);
+
+
+/*******************************************************************
+ * Function generateCounterRandomRow fills row[0..length-1] with
+ * elements firstIndex .. firstIndex+length-1 of stream seed, scaled
+ * to [min, max).  No state is carried from one element to the next,
+ * so the loop vectorizes (AVX-512DQ has the 64-bit multiply).  FMA
+ * contraction is off so every clone rounds exactly like
+ * min + counterRandom(seed, index)*(max - min).
+ ********************************************************************/
+__attribute__((target_clones("arch=skylake-avx512", "avx2", "default"),
+	       optimize("fp-contract=off")))
+void generateCounterRandomRow(double * row, int length, uint64_t firstIndex,
+			      uint64_t seed, double min, double max) {
+  uint64_t key = splitMix64(seed + COUNTER_RANDOM_GOLDEN);
+  uint64_t z;
+  double scale = (max - min) * (1.0 / 9007199254740992.0);
+  double unit;
+  int i;
+
+  for (i = 0; i < length; i++) {
+    z = splitMix64(key + (firstIndex + i + 1)*COUNTER_RANDOM_GOLDEN);
+    unit = (double) (int64_t) (z >> 11);
+    row[i] = min + unit*scale;
+  } // end for
+} // end generateCounterRandomRow
+
+
+/*******************************************************************
+ * Function generateCounterRandomBlock fills rows startRow..endRow and
+ * columns startCol..endCol (inclusive, like BLOCK) of a 2D array that
+ * is columns wide.  Element (r, c) is element r*columns + c of the
+ * stream, whatever the block.
+ ********************************************************************/
+void generateCounterRandomBlock(double ** array, int columns,
+				int startRow, int endRow, int startCol, int endCol,
+				uint64_t seed, double min, double max) {
+  int r;
+
+  for (r = startRow; r <= endRow; r++) {
+    generateCounterRandomRow(array[r] + startCol, endCol - startCol + 1,
+			     (uint64_t) r*columns + startCol, seed, min, max);
+  } // end for
+} // end generateCounterRandomBlock
+
+
+/*******************************************************************
+ * Function generateCounterRandom2DArray fills a rows x columns 2D
+ * array using numberOfThreads threads on blocks of whole rows
+ * (numberOfThreads <= 0 means one per online core).  The result does
+ * not depend on the thread count.
+ ********************************************************************/
+void generateCounterRandom2DArray(int rows, int columns, double min, double max,
+				  uint64_t seed, double ** array,
+				  int numberOfThreads) {
+  pthread_t * threadHandles;
+  RANDOM_BLOCK * blocks;
+  int i, errorCode;
+
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  if (numberOfThreads > rows) {
+    numberOfThreads = rows;
+  } // end if
+  if (numberOfThreads <= 1) {
+    generateCounterRandomBlock(array, columns, 0, rows-1, 0, columns-1,
+			       seed, min, max);
+    return;
+  } // end if
+
+  threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+  blocks = (RANDOM_BLOCK *) malloc(numberOfThreads*sizeof(RANDOM_BLOCK));
+  for (i=0; i < numberOfThreads; i++) {
+    blocks[i].array = array;
+    blocks[i].columns = columns;
+    blocks[i].startRow = (int) ((long) i*rows/numberOfThreads);
+    blocks[i].endRow = (int) ((long) (i+1)*rows/numberOfThreads) - 1;
+    blocks[i].seed = seed;
+    blocks[i].min = min;
+    blocks[i].max = max;
+    if ((errorCode = pthread_create(&threadHandles[i], NULL, threadGenerateRows,
+				    &blocks[i])) != 0) {
+      printf("pthread %d failed to be created with error code %d\n", i, errorCode);
+      exit(-1);
+    } // end if
+  } // end for
+
+  for (i=0; i < numberOfThreads; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+  } // end for
+  free(threadHandles);
+  free(blocks);
+} // end generateCounterRandom2DArray
+
+
+/*******************************************************************
+ * Function threadGenerateRows - thread body for one block of rows.
+ ********************************************************************/
+static void * threadGenerateRows(void * arg) {
+  RANDOM_BLOCK * block = (RANDOM_BLOCK *) arg;
+
+  generateCounterRandomBlock(block->array, block->columns, block->startRow,
+			     block->endRow, 0, block->columns-1,
+			     block->seed, block->min, block->max);
+  return NULL;
+} // end threadGenerateRows
@@ -0,0 +1,44 @@
+/*  File:        counterRandom.h
+    Description: Counter-based random doubles.  Element i of a stream
+    is a pure function of (seed, i) -- a SplitMix64 finalizer applied
+    to seed-key + i*golden-ratio -- so any element can be produced on
+    its own, in any order, by any thread.  A matrix element (r, c)
+    uses index r*columns + c, which makes the generated matrix
+    bit-identical for every thread count, block shape, or row order,
+    and leaves the inner loop free of carried state so it vectorizes.
+    Use a different seed for each matrix (e.g. 5 for A, 6 for B).
+    Compile the program with:  -I../common ../common/counterRandom.c
+      -lpthread
+*/
+#ifndef _COUNTER_RANDOM_H_
+#define _COUNTER_RANDOM_H_
+
+#include <stdint.h>
+
+#define COUNTER_RANDOM_GOLDEN 0x9e3779b97f4a7c15ULL
+
+/* SplitMix64 output function (Steele, Lea & Flood) */
+static inline uint64_t splitMix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+} // end splitMix64
+
+/* element index of stream seed as a double in [0, 1) */
+static inline double counterRandom(uint64_t seed, uint64_t index) {
+  uint64_t key = splitMix64(seed + COUNTER_RANDOM_GOLDEN);
+
+  return (double) (int64_t) (splitMix64(key + (index+1)*COUNTER_RANDOM_GOLDEN) >> 11)
+    * (1.0 / 9007199254740992.0);  // 53 random bits / 2^53
+} // end counterRandom
+
+void generateCounterRandomRow(double * row, int length, uint64_t firstIndex,
+			      uint64_t seed, double min, double max);
+void generateCounterRandomBlock(double ** array, int columns,
+				int startRow, int endRow, int startCol, int endCol,
+				uint64_t seed, double min, double max);
+void generateCounterRandom2DArray(int rows, int columns, double min, double max,
+				  uint64_t seed, double ** array,
+				  int numberOfThreads);
+
+#endif
@@ -0,0 +1,387 @@
+/*  File:        gemm.c
+    Description: Cache-blocked matrix multiplication C = A*B (see gemm.h).
+    A is m x k, B is k x n and C is m x n, all row-major with leading
+    dimensions lda, ldb and ldc.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "matrix.h"
+#include "gemm.h"
+
+static void packA(int mc, int kc, int mr, const void * from, int lda,
+		  void * to);
+static void packB(int kc, int nc, int nr, const void * from, int ldb,
+		  void * to);
+static void multiplyDouble(const void * kernel, int kc, const void * a,
+			   const void * b, void * C, int ldc, int rows,
+			   int columns, int first);
+static void microKernel(int kc, const double * restrict a,
+			const double * restrict b, double * C, int ldc,
+			int mr, int nr, int first);
+
+static void gemmDoubleDriver(int m, int n, int k,
+			     const double * A, int lda,
+			     const double * B, int ldb,
+			     double * C, int ldc,
+			     const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel,
+			     int accumulate, double * workspace);
+static void panelSizes(int m, int n, const GEMM_BLOCKING * blocking,
+		       const GEMM_DRIVER * driver, int * mc, int * nc,
+		       size_t * bytesA);
+static void doubleDriver(const GEMM_KERNEL * kernel, GEMM_DRIVER * driver);
+
+static const GEMM_KERNEL scalarKernel = {"scalar", GEMM_MR, GEMM_NR, microKernel};
+
+
+/*******************************************************************
+ * Function gemmDefaultBlocking fills in the default L1/L2/L3 blocks.
+ ********************************************************************/
+void gemmDefaultBlocking(GEMM_BLOCKING * blocking) {
+  blocking->kc = GEMM_DEFAULT_KC;
+  blocking->mc = GEMM_DEFAULT_MC;
+  blocking->nc = GEMM_DEFAULT_NC;
+  blocking->loopOrder = GEMM_LOOP_JR_IR;
+} // end gemmDefaultBlocking
+
+
+/*******************************************************************
+ * Function gemmTiled computes C = A*B with the portable scalar
+ * micro-kernel.
+ ********************************************************************/
+void gemmTiled(int m, int n, int k,
+	       const double * A, int lda,
+	       const double * B, int ldb,
+	       double * C, int ldc,
+	       const GEMM_BLOCKING * blocking) {
+  gemmPacked(m, n, k, A, lda, B, ldb, C, ldc, blocking, &scalarKernel);
+} // end gemmTiled
+
+
+/*******************************************************************
+ * Function gemmPacked computes C = A*B with the given micro-kernel.
+ ********************************************************************/
+void gemmPacked(int m, int n, int k,
+		const double * A, int lda,
+		const double * B, int ldb,
+		double * C, int ldc,
+		const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel) {
+  gemmDoubleDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, kernel, 0, NULL);
+} // end gemmPacked
+
+
+/*******************************************************************
+ * Function gemmPackedAdd computes C += A*B with the given micro-kernel.
+ ********************************************************************/
+void gemmPackedAdd(int m, int n, int k,
+		   const double * A, int lda,
+		   const double * B, int ldb,
+		   double * C, int ldc,
+		   const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel) {
+  gemmDoubleDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, kernel, 1, NULL);
+} // end gemmPackedAdd
+
+
+/*******************************************************************
+ * Function gemmWorkspaceSize returns the # of doubles of packing
+ * space gemmPackedWorkspace needs for any product with at most m
+ * rows and n columns of C.
+ ********************************************************************/
+size_t gemmWorkspaceSize(int m, int n, const GEMM_BLOCKING * blocking,
+			 const GEMM_KERNEL * kernel) {
+  GEMM_DRIVER driver;
+  int mc, nc;
+  size_t bytesA;
+
+  doubleDriver(kernel, &driver);
+  panelSizes(m, n, blocking, &driver, &mc, &nc, &bytesA);
+  return bytesA / sizeof(double) + (size_t) blocking->kc * nc;
+} // end gemmWorkspaceSize
+
+
+/*******************************************************************
+ * Function gemmPackedWorkspace computes C = A*B as gemmPacked does,
+ * packing into the caller's workspace (MATRIX_ALIGNMENT aligned, at
+ * least gemmWorkspaceSize(m, n, ...) doubles) instead of allocating.
+ ********************************************************************/
+void gemmPackedWorkspace(int m, int n, int k,
+			 const double * A, int lda,
+			 const double * B, int ldb,
+			 double * C, int ldc,
+			 const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel,
+			 double * workspace) {
+  gemmDoubleDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, kernel, 0,
+		   workspace);
+} // end gemmPackedWorkspace
+
+
+/*******************************************************************
+ * Function gemmPackedAddWorkspace computes C += A*B in the caller's
+ * workspace (see gemmPackedWorkspace).
+ ********************************************************************/
+void gemmPackedAddWorkspace(int m, int n, int k,
+			    const double * A, int lda,
+			    const double * B, int ldb,
+			    double * C, int ldc,
+			    const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel,
+			    double * workspace) {
+  gemmDoubleDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, kernel, 1,
+		   workspace);
+} // end gemmPackedAddWorkspace
+
+
+/*******************************************************************
+ * Function panelSizes returns the row block mc and column panel nc
+ * (multiples of mr and nr, no larger than an m x n product needs)
+ * and the # of bytes taken by the packed A block, rounded up so the
+ * packed B panel after it stays MATRIX_ALIGNMENT aligned.
+ ********************************************************************/
+static void panelSizes(int m, int n, const GEMM_BLOCKING * blocking,
+		       const GEMM_DRIVER * driver, int * mc, int * nc,
+		       size_t * bytesA) {
+  int mr = driver->mr;
+  int nr = driver->nr;
+
+  *mc = (blocking->mc + mr - 1) / mr * mr;
+  *nc = (blocking->nc + nr - 1) / nr * nr;
+  if (m < *mc) {
+    *mc = (m + mr - 1) / mr * mr;
+  } // end if
+  if (n < *nc) {
+    *nc = (n + nr - 1) / nr * nr;
+  } // end if
+  *bytesA = ((size_t) *mc * blocking->kc * driver->elementSize
+	     + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+} // end panelSizes
+
+
+/*******************************************************************
+ * Function doubleDriver fills in the GEMM_DRIVER of the double
+ * multiplies for kernel.
+ ********************************************************************/
+static void doubleDriver(const GEMM_KERNEL * kernel, GEMM_DRIVER * driver) {
+  driver->mr = kernel->mr;
+  driver->nr = kernel->nr;
+  driver->elementSize = sizeof(double);
+  driver->outputSize = sizeof(double);
+  driver->packA = packA;
+  driver->packB = packB;
+  driver->multiply = multiplyDouble;
+  driver->kernel = kernel;
+} // end doubleDriver
+
+
+/*******************************************************************
+ * Function gemmDoubleDriver runs gemmDriver with a double kernel.
+ ********************************************************************/
+static void gemmDoubleDriver(int m, int n, int k,
+			     const double * A, int lda,
+			     const double * B, int ldb,
+			     double * C, int ldc,
+			     const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel,
+			     int accumulate, double * workspace) {
+  GEMM_DRIVER driver;
+
+  doubleDriver(kernel, &driver);
+  gemmDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, &driver, accumulate,
+	     workspace);
+} // end gemmDoubleDriver
+
+
+/*******************************************************************
+ * Function gemmDriver computes C = A*B, or C += A*B when accumulate
+ * is set, for the element types and kernel driver describes.  The
+ * jc loop cuts B into nc wide panels, the pc loop cuts the inner
+ * dimension into kc deep slices (B slice packed once, reused by
+ * every row block), and the ic loop packs an mc x kc block of A that
+ * the micro-kernel sweeps against each nr wide micro-panel of B, in
+ * the jr/ir order given by blocking->loopOrder.  workspace, if not
+ * NULL, holds the packed A block and B panel (see panelSizes).
+ ********************************************************************/
+void gemmDriver(int m, int n, int k,
+		const void * A, int lda,
+		const void * B, int ldb,
+		void * C, int ldc,
+		const GEMM_BLOCKING * blocking, const GEMM_DRIVER * driver,
+		int accumulate, void * workspace) {
+  size_t in = driver->elementSize;
+  size_t out = driver->outputSize;
+  int mr = driver->mr;
+  int nr = driver->nr;
+  int kc = blocking->kc;
+  int mc, nc;
+  int jc, pc, ic, jr, ir, nb, kb, mb, i;
+  size_t bytesA;
+  char * packedA;
+  char * packedB;
+  const char * a = (const char *) A;
+  const char * b = (const char *) B;
+  char * c = (char *) C;
+
+  if (k == 0 && accumulate) {
+    return;
+  } else if (k == 0) {
+    for (i=0; i < m; i++) {
+      memset(c + (size_t) i*ldc*out, 0, out*n);
+    } // end for
+    return;
+  } // end if
+
+  // packing buffers only as large as this product needs
+  panelSizes(m, n, blocking, driver, &mc, &nc, &bytesA);
+  packedA = (workspace != NULL) ? (char *) workspace
+    : (char *) allocateAligned((bytesA + (size_t) kc * nc * in
+				+ sizeof(double) - 1) / sizeof(double));
+  packedB = packedA + bytesA;
+
+  for (jc=0; jc < n; jc += nc) {
+    nb = (n - jc < nc) ? n - jc : nc;
+    for (pc=0; pc < k; pc += kc) {
+      kb = (k - pc < kc) ? k - pc : kc;
+      driver->packB(kb, nb, nr, b + ((size_t) pc*ldb + jc) * in, ldb, packedB);
+      for (ic=0; ic < m; ic += mc) {
+	mb = (m - ic < mc) ? m - ic : mc;
+	driver->packA(mb, kb, mr, a + ((size_t) ic*lda + pc) * in, lda, packedA);
+	if (blocking->loopOrder == GEMM_LOOP_IR_JR) {
+	  for (ir=0; ir < mb; ir += mr) {
+	    for (jr=0; jr < nb; jr += nr) {
+	      driver->multiply(driver->kernel, kb, packedA + (size_t) ir*kb*in,
+			       packedB + (size_t) jr*kb*in,
+			       c + ((size_t) (ic+ir)*ldc + jc + jr) * out, ldc,
+			       (mb - ir < mr) ? mb - ir : mr,
+			       (nb - jr < nr) ? nb - jr : nr,
+			       pc == 0 && !accumulate);
+	    } // end for (jr
+	  } // end for (ir
+	} else {
+	  for (jr=0; jr < nb; jr += nr) {
+	    for (ir=0; ir < mb; ir += mr) {
+	      driver->multiply(driver->kernel, kb, packedA + (size_t) ir*kb*in,
+			       packedB + (size_t) jr*kb*in,
+			       c + ((size_t) (ic+ir)*ldc + jc + jr) * out, ldc,
+			       (mb - ir < mr) ? mb - ir : mr,
+			       (nb - jr < nr) ? nb - jr : nr,
+			       pc == 0 && !accumulate);
+	    } // end for (ir
+	  } // end for (jr
+	} // end if
+      } // end for (ic
+    } // end for (pc
+  } // end for (jc
+
+  if (workspace == NULL) {
+    free(packedA);
+  } // end if
+
+} // end gemmDriver
+
+
+/*******************************************************************
+ * Function multiplyDouble calls the double micro-kernel of kernel
+ * (a GEMM_KERNEL) for gemmDriver.
+ ********************************************************************/
+static void multiplyDouble(const void * kernel, int kc, const void * a,
+			   const void * b, void * C, int ldc, int rows,
+			   int columns, int first) {
+  ((const GEMM_KERNEL *) kernel)->kernel(kc, (const double *) a, (const double *) b,
+					 (double *) C, ldc, rows, columns, first);
+} // end multiplyDouble
+
+
+/*******************************************************************
+ * Function gemmScalarKernel returns the portable scalar kernel.
+ ********************************************************************/
+const GEMM_KERNEL * gemmScalarKernel(void) {
+  return &scalarKernel;
+} // end gemmScalarKernel
+
+
+/*******************************************************************
+ * Function packA copies an mc x kc block of A into mr row
+ * micro-panels; within a panel the mr values of each column
+ * are adjacent.  Short edge panels are padded with zeros.
+ ********************************************************************/
+static void packA(int mc, int kc, int mr, const void * from, int lda,
+		  void * to) {
+  const double * A = (const double *) from;
+  double * packed = (double *) to;
+  int i, p, r;
+
+  for (i=0; i < mc; i += mr) {
+    for (p=0; p < kc; p++) {
+      for (r=0; r < mr; r++) {
+	*packed++ = (i+r < mc) ? A[(size_t) (i+r)*lda + p] : 0.0;
+      } // end for (r
+    } // end for (p
+  } // end for (i
+
+} // end packA
+
+
+/*******************************************************************
+ * Function packB copies a kc x nc panel of B into nr column
+ * micro-panels; within a panel the nr values of each row are
+ * adjacent.  Short edge panels are padded with zeros.
+ ********************************************************************/
+static void packB(int kc, int nc, int nr, const void * from, int ldb,
+		  void * to) {
+  const double * B = (const double *) from;
+  double * packed = (double *) to;
+  int j, p, c;
+  const double * row;
+
+  for (j=0; j < nc; j += nr) {
+    for (p=0; p < kc; p++) {
+      row = B + (size_t) p*ldb + j;
+      if (j + nr <= nc) {
+	memcpy(packed, row, sizeof(double)*nr);
+      } else {
+	for (c=0; c < nr; c++) {
+	  packed[c] = (j+c < nc) ? row[c] : 0.0;
+	} // end for (c
+      } // end if
+      packed += nr;
+    } // end for (p
+  } // end for (j
+
+} // end packB
+
+
+/*******************************************************************
+ * Function microKernel accumulates a GEMM_MR x GEMM_NR block of C
+ * in registers over the kc deep packed panels, then stores (first
+ * slice) or adds it into the mr x nr corner of C that is in bounds.
+ ********************************************************************/
+static void microKernel(int kc, const double * restrict a,
+			const double * restrict b, double * C, int ldc,
+			int mr, int nr, int first) {
+  double c[GEMM_MR][GEMM_NR];
+  int p, i, j;
+
+  for (i=0; i < GEMM_MR; i++) {
+    for (j=0; j < GEMM_NR; j++) {
+      c[i][j] = 0.0;
+    } // end for (j
+  } // end for (i
+
+  for (p=0; p < kc; p++) {
+    for (i=0; i < GEMM_MR; i++) {
+      for (j=0; j < GEMM_NR; j++) {
+	c[i][j] += a[i]*b[j];
+      } // end for (j
+    } // end for (i
+    a += GEMM_MR;
+    b += GEMM_NR;
+  } // end for (p
+
+  for (i=0; i < mr; i++) {
+    for (j=0; j < nr; j++) {
+      if (first) {
+	C[(size_t) i*ldc + j] = c[i][j];
+      } else {
+	C[(size_t) i*ldc + j] += c[i][j];
+      } // end if
+    } // end for (j
+  } // end for (i
+
+} // end microKernel
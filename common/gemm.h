@@ -0,0 +1,147 @@
+/*  File:        gemm.h
+    Description: Cache-blocked (tiled) matrix multiplication on the
+    contiguous row-major layout of matrix.h.  The three loops around
+    the register-blocked micro-kernel are sized for the cache levels:
+      kc - depth of a packed B micro-panel kept in L1
+      mc - rows of the packed A block kept in L2
+      nc - columns of the packed B panel kept in L3
+    The micro-kernel is pluggable: gemmTiled uses the portable scalar
+    kernel, gemmPacked (C = A*B) and gemmPackedAdd (C += A*B) take any
+    GEMM_KERNEL, and gemmBestKernel picks the widest SIMD kernel the
+    CPU supports at run time.  gemmPackedFloat (all float) and
+    gemmPackedMixed (float A and B, double accumulation and C) pack
+    float panels -- half the cache footprint -- for kernels that hold
+    twice as many elements per register (gemmFloat.c).
+    gemmPacked allocates its packing buffers on every call; code that
+    multiplies many blocks (tiles, recursion leaves) sizes one
+    workspace with gemmWorkspaceSize and passes it to
+    gemmPackedWorkspace / gemmPackedAddWorkspace instead.
+    Compile the program with:
+      -I../common ../common/gemm.c ../common/gemmSimd.c ../common/matrix.c
+      [../common/gemmFloat.c]
+*/
+#ifndef _GEMM_H_
+#define _GEMM_H_
+
+#include <stddef.h>
+
+#define GEMM_MR 4   // rows of C held in registers by the scalar kernel
+#define GEMM_NR 8   // columns of C held in registers by the scalar kernel
+
+#define GEMM_DEFAULT_KC 256
+#define GEMM_DEFAULT_MC 128
+#define GEMM_DEFAULT_NC 4096
+
+// order of the two loops around the micro-kernel
+#define GEMM_LOOP_JR_IR 0  // B micro-panel stays in L1 while A's slivers stream
+#define GEMM_LOOP_IR_JR 1  // A sliver stays in L1 while B's micro-panels stream
+
+typedef struct {
+  int kc;  // L1 block
+  int mc;  // L2 block
+  int nc;  // L3 block
+  int loopOrder;  // GEMM_LOOP_JR_IR or GEMM_LOOP_IR_JR
+} GEMM_BLOCKING;
+
+/* A micro-kernel multiplies an mr-row packed A sliver by an nr-column
+   packed B sliver, both kc deep, and stores (first != 0) or adds the
+   result into the rows x columns corner of C that is in bounds. */
+typedef void (*GEMM_MICRO_KERNEL)(int kc, const double * a, const double * b,
+				  double * C, int ldc, int rows, int columns,
+				  int first);
+
+typedef struct {
+  const char * name;
+  int mr;
+  int nr;
+  GEMM_MICRO_KERNEL kernel;
+} GEMM_KERNEL;
+
+void gemmDefaultBlocking(GEMM_BLOCKING * blocking);
+void gemmTiled(int m, int n, int k,
+	       const double * A, int lda,
+	       const double * B, int ldb,
+	       double * C, int ldc,
+	       const GEMM_BLOCKING * blocking);
+void gemmPacked(int m, int n, int k,
+		const double * A, int lda,
+		const double * B, int ldb,
+		double * C, int ldc,
+		const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel);
+void gemmPackedAdd(int m, int n, int k,
+		   const double * A, int lda,
+		   const double * B, int ldb,
+		   double * C, int ldc,
+		   const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel);
+size_t gemmWorkspaceSize(int m, int n, const GEMM_BLOCKING * blocking,
+			 const GEMM_KERNEL * kernel);
+void gemmPackedWorkspace(int m, int n, int k,
+			 const double * A, int lda,
+			 const double * B, int ldb,
+			 double * C, int ldc,
+			 const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel,
+			 double * workspace);
+void gemmPackedAddWorkspace(int m, int n, int k,
+			    const double * A, int lda,
+			    const double * B, int ldb,
+			    double * C, int ldc,
+			    const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel,
+			    double * workspace);
+
+/* A float micro-kernel reads packed float slivers; C is float * for
+   the single precision kernels and double * for the mixed ones. */
+typedef void (*GEMM_FLOAT_MICRO_KERNEL)(int kc, const float * a, const float * b,
+					void * C, int ldc, int rows, int columns,
+					int first);
+
+typedef struct {
+  const char * name;
+  int mr;
+  int nr;
+  int mixed;  // accumulates into double C
+  GEMM_FLOAT_MICRO_KERNEL kernel;
+} GEMM_FLOAT_KERNEL;
+
+void gemmPackedFloat(int m, int n, int k,
+		     const float * A, int lda,
+		     const float * B, int ldb,
+		     float * C, int ldc,
+		     const GEMM_BLOCKING * blocking, const GEMM_FLOAT_KERNEL * kernel);
+void gemmPackedMixed(int m, int n, int k,
+		     const float * A, int lda,
+		     const float * B, int ldb,
+		     double * C, int ldc,
+		     const GEMM_BLOCKING * blocking, const GEMM_FLOAT_KERNEL * kernel);
+
+/* The blocked loops are shared by the double and the float multiplies:
+   a GEMM_DRIVER gives the element sizes, the packing routines and how
+   to call the kernel, and gemmDriver (gemm.c) runs the loops around it.
+   Only the gemm*.c files build these. */
+typedef struct {
+  int mr;
+  int nr;
+  size_t elementSize;  // bytes of an A / B element, packed or not
+  size_t outputSize;   // bytes of a C element
+  void (*packA)(int mc, int kc, int mr, const void * A, int lda, void * packed);
+  void (*packB)(int kc, int nc, int nr, const void * B, int ldb, void * packed);
+  void (*multiply)(const void * kernel, int kc, const void * a, const void * b,
+		   void * C, int ldc, int rows, int columns, int first);
+  const void * kernel;  // the GEMM_KERNEL or GEMM_FLOAT_KERNEL multiply calls
+} GEMM_DRIVER;
+
+void gemmDriver(int m, int n, int k,
+		const void * A, int lda,
+		const void * B, int ldb,
+		void * C, int ldc,
+		const GEMM_BLOCKING * blocking, const GEMM_DRIVER * driver,
+		int accumulate, void * workspace);
+
+// kernels (gemm.c / gemmSimd.c / gemmFloat.c)
+const GEMM_KERNEL * gemmScalarKernel(void);
+const GEMM_KERNEL * gemmBestKernel(void);
+const GEMM_KERNEL * gemmKernelByName(const char * name);
+int gemmSupportedKernels(const GEMM_KERNEL ** kernels, int max);
+const GEMM_FLOAT_KERNEL * gemmBestFloatKernel(void);
+const GEMM_FLOAT_KERNEL * gemmBestMixedKernel(void);
+
+#endif
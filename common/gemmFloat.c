@@ -0,0 +1,487 @@
+/*  File:        gemmFloat.c
+    Description: Single and mixed precision versions of the packed
+    multiply (see gemm.h).  A and B are float and packed as float, so a
+    kc x nc panel takes half the cache of a double one.  The kernels:
+      float avx512  6 x 32 floats, 12 zmm accumulators, FMA
+      float avx2    6 x 16 floats, 12 ymm accumulators, FMA
+      mixed avx512  6 x 16 doubles, float slivers widened as loaded
+      mixed avx2    6 x  8 doubles, float slivers widened as loaded
+      scalar        4 x  8, portable C, for either
+    A float kernel does twice the multiply-adds per instruction of the
+    double kernel of the same width; a mixed kernel does the same math
+    as the double one but moves half the bytes.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+#include "matrix.h"
+#include "gemm.h"
+
+static void packFloatA(int mc, int kc, int mr, const void * from, int lda,
+		       void * to);
+static void packFloatB(int kc, int nc, int nr, const void * from, int ldb,
+		       void * to);
+static void multiplyFloat(const void * kernel, int kc, const void * a,
+			  const void * b, void * C, int ldc, int rows,
+			  int columns, int first);
+static void floatDriver(const GEMM_FLOAT_KERNEL * kernel, GEMM_DRIVER * driver);
+static void kernelFloatScalar(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first);
+static void kernelMixedScalar(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first);
+static void kernelFloatAvx512(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first);
+static void kernelFloatAvx2(int kc, const float * a, const float * b,
+			    void * C, int ldc, int rows, int columns, int first);
+static void kernelMixedAvx512(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first);
+static void kernelMixedAvx2(int kc, const float * a, const float * b,
+			    void * C, int ldc, int rows, int columns, int first);
+
+#define SCALAR_MR 4
+#define SCALAR_NR 8
+
+static const GEMM_FLOAT_KERNEL floatScalarKernel = {"scalar float", SCALAR_MR, SCALAR_NR, 0, kernelFloatScalar};
+static const GEMM_FLOAT_KERNEL floatAvx512Kernel = {"avx512 float", 6, 32, 0, kernelFloatAvx512};
+static const GEMM_FLOAT_KERNEL floatAvx2Kernel = {"avx2 float", 6, 16, 0, kernelFloatAvx2};
+static const GEMM_FLOAT_KERNEL mixedScalarKernel = {"scalar mixed", SCALAR_MR, SCALAR_NR, 1, kernelMixedScalar};
+static const GEMM_FLOAT_KERNEL mixedAvx512Kernel = {"avx512 mixed", 6, 16, 1, kernelMixedAvx512};
+static const GEMM_FLOAT_KERNEL mixedAvx2Kernel = {"avx2 mixed", 6, 8, 1, kernelMixedAvx2};
+
+
+/*******************************************************************
+ * Function gemmBestFloatKernel returns the widest single precision
+ * kernel this CPU runs.
+ ********************************************************************/
+const GEMM_FLOAT_KERNEL * gemmBestFloatKernel(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return &floatAvx512Kernel;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return &floatAvx2Kernel;
+  } // end if
+  return &floatScalarKernel;
+} // end gemmBestFloatKernel
+
+
+/*******************************************************************
+ * Function gemmBestMixedKernel returns the widest mixed precision
+ * kernel this CPU runs.
+ ********************************************************************/
+const GEMM_FLOAT_KERNEL * gemmBestMixedKernel(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return &mixedAvx512Kernel;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return &mixedAvx2Kernel;
+  } // end if
+  return &mixedScalarKernel;
+} // end gemmBestMixedKernel
+
+
+/*******************************************************************
+ * Function gemmPackedFloat computes C = A*B all in float.
+ ********************************************************************/
+void gemmPackedFloat(int m, int n, int k,
+		     const float * A, int lda,
+		     const float * B, int ldb,
+		     float * C, int ldc,
+		     const GEMM_BLOCKING * blocking, const GEMM_FLOAT_KERNEL * kernel) {
+  GEMM_DRIVER driver;
+
+  if (kernel->mixed) {
+    printf("gemmPackedFloat needs a float kernel, not %s\n", kernel->name);
+    exit(-1);
+  } // end if
+  floatDriver(kernel, &driver);
+  gemmDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, &driver, 0, NULL);
+} // end gemmPackedFloat
+
+
+/*******************************************************************
+ * Function gemmPackedMixed computes C = A*B from float A and B with
+ * every product and sum in double.
+ ********************************************************************/
+void gemmPackedMixed(int m, int n, int k,
+		     const float * A, int lda,
+		     const float * B, int ldb,
+		     double * C, int ldc,
+		     const GEMM_BLOCKING * blocking, const GEMM_FLOAT_KERNEL * kernel) {
+  GEMM_DRIVER driver;
+
+  if (!kernel->mixed) {
+    printf("gemmPackedMixed needs a mixed kernel, not %s\n", kernel->name);
+    exit(-1);
+  } // end if
+  floatDriver(kernel, &driver);
+  gemmDriver(m, n, k, A, lda, B, ldb, C, ldc, blocking, &driver, 0, NULL);
+} // end gemmPackedMixed
+
+
+/*******************************************************************
+ * Function floatDriver fills in the GEMM_DRIVER (gemm.h) of the
+ * float and mixed multiplies: float panels, and C float or double
+ * as the kernel says.
+ ********************************************************************/
+static void floatDriver(const GEMM_FLOAT_KERNEL * kernel, GEMM_DRIVER * driver) {
+  driver->mr = kernel->mr;
+  driver->nr = kernel->nr;
+  driver->elementSize = sizeof(float);
+  driver->outputSize = kernel->mixed ? sizeof(double) : sizeof(float);
+  driver->packA = packFloatA;
+  driver->packB = packFloatB;
+  driver->multiply = multiplyFloat;
+  driver->kernel = kernel;
+} // end floatDriver
+
+
+/*******************************************************************
+ * Function multiplyFloat calls the micro-kernel of kernel (a
+ * GEMM_FLOAT_KERNEL) for gemmDriver.
+ ********************************************************************/
+static void multiplyFloat(const void * kernel, int kc, const void * a,
+			  const void * b, void * C, int ldc, int rows,
+			  int columns, int first) {
+  ((const GEMM_FLOAT_KERNEL *) kernel)->kernel(kc, (const float *) a,
+					       (const float *) b, C, ldc, rows,
+					       columns, first);
+} // end multiplyFloat
+
+
+/*******************************************************************
+ * Function packFloatA - packA (gemm.c) for float.
+ ********************************************************************/
+static void packFloatA(int mc, int kc, int mr, const void * from, int lda,
+		       void * to) {
+  const float * A = (const float *) from;
+  float * packed = (float *) to;
+  int i, p, r;
+
+  for (i=0; i < mc; i += mr) {
+    for (p=0; p < kc; p++) {
+      for (r=0; r < mr; r++) {
+	*packed++ = (i+r < mc) ? A[(size_t) (i+r)*lda + p] : 0.0f;
+      } // end for (r
+    } // end for (p
+  } // end for (i
+
+} // end packFloatA
+
+
+/*******************************************************************
+ * Function packFloatB - packB (gemm.c) for float.
+ ********************************************************************/
+static void packFloatB(int kc, int nc, int nr, const void * from, int ldb,
+		       void * to) {
+  const float * B = (const float *) from;
+  float * packed = (float *) to;
+  int j, p, c;
+  const float * row;
+
+  for (j=0; j < nc; j += nr) {
+    for (p=0; p < kc; p++) {
+      row = B + (size_t) p*ldb + j;
+      if (j + nr <= nc) {
+	memcpy(packed, row, sizeof(float)*nr);
+      } else {
+	for (c=0; c < nr; c++) {
+	  packed[c] = (j+c < nc) ? row[c] : 0.0f;
+	} // end for (c
+      } // end if
+      packed += nr;
+    } // end for (p
+  } // end for (j
+
+} // end packFloatB
+
+
+/*******************************************************************
+ * Functions storeFloatTile / storeDoubleTile store (first != 0) or
+ * add the in-bounds rows x columns corner of a register tile into C.
+ ********************************************************************/
+static void storeFloatTile(const float * tile, int ldt, float * C, int ldc,
+			   int rows, int columns, int first) {
+  int i, j;
+
+  for (i=0; i < rows; i++) {
+    for (j=0; j < columns; j++) {
+      C[(size_t) i*ldc + j] = first ? tile[i*ldt + j]
+	: C[(size_t) i*ldc + j] + tile[i*ldt + j];
+    } // end for (j
+  } // end for (i
+} // end storeFloatTile
+
+static void storeDoubleTile(const double * tile, int ldt, double * C, int ldc,
+			    int rows, int columns, int first) {
+  int i, j;
+
+  for (i=0; i < rows; i++) {
+    for (j=0; j < columns; j++) {
+      C[(size_t) i*ldc + j] = first ? tile[i*ldt + j]
+	: C[(size_t) i*ldc + j] + tile[i*ldt + j];
+    } // end for (j
+  } // end for (i
+} // end storeDoubleTile
+
+
+/*******************************************************************
+ * Function kernelFloatScalar - portable 4 x 8 float kernel.
+ ********************************************************************/
+static void kernelFloatScalar(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first) {
+  float tile[SCALAR_MR*SCALAR_NR];
+  int p, i, j;
+
+  memset(tile, 0, sizeof(tile));
+  for (p=0; p < kc; p++) {
+    for (i=0; i < SCALAR_MR; i++) {
+      for (j=0; j < SCALAR_NR; j++) {
+	tile[i*SCALAR_NR + j] += a[i] * b[j];
+      } // end for (j
+    } // end for (i
+    a += SCALAR_MR;
+    b += SCALAR_NR;
+  } // end for (p
+  storeFloatTile(tile, SCALAR_NR, (float *) C, ldc, rows, columns, first);
+} // end kernelFloatScalar
+
+
+/*******************************************************************
+ * Function kernelMixedScalar - portable 4 x 8 kernel, float inputs,
+ * double products and sums.
+ ********************************************************************/
+static void kernelMixedScalar(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first) {
+  double tile[SCALAR_MR*SCALAR_NR];
+  int p, i, j;
+
+  memset(tile, 0, sizeof(tile));
+  for (p=0; p < kc; p++) {
+    for (i=0; i < SCALAR_MR; i++) {
+      for (j=0; j < SCALAR_NR; j++) {
+	tile[i*SCALAR_NR + j] += (double) a[i] * (double) b[j];
+      } // end for (j
+    } // end for (i
+    a += SCALAR_MR;
+    b += SCALAR_NR;
+  } // end for (p
+  storeDoubleTile(tile, SCALAR_NR, (double *) C, ldc, rows, columns, first);
+} // end kernelMixedScalar
+
+
+/* same register-blocking macros as gemmSimd.c */
+#define ROW_FMA(c0, c1, ai, fmadd)  { c0 = fmadd(ai, b0, c0); c1 = fmadd(ai, b1, c1); }
+#define ROW_STORE(out, c0, c1, w, loadu, storeu, add, first) { \
+  if (!(first)) { \
+    c0 = add(c0, loadu(out)); \
+    c1 = add(c1, loadu((out) + (w))); \
+  } \
+  storeu(out, c0); \
+  storeu((out) + (w), c1); \
+}
+
+
+/*******************************************************************
+ * Function kernelFloatAvx512 - 6 x 32 float tile: each of the kc
+ * steps loads two zmm of B (32 floats) and broadcasts six A values
+ * into 12 FMAs -- 192 multiply-adds against the double kernel's 96.
+ ********************************************************************/
+__attribute__((target("avx512f")))
+static void kernelFloatAvx512(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first) {
+  __m512 c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+  __m512 b0, b1;
+  float tile[6*32];
+  float * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm512_setzero_ps();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm512_setzero_ps();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm512_loadu_ps(b);
+    b1 = _mm512_loadu_ps(b + 16);
+    ROW_FMA(c00, c01, _mm512_set1_ps(a[0]), _mm512_fmadd_ps);
+    ROW_FMA(c10, c11, _mm512_set1_ps(a[1]), _mm512_fmadd_ps);
+    ROW_FMA(c20, c21, _mm512_set1_ps(a[2]), _mm512_fmadd_ps);
+    ROW_FMA(c30, c31, _mm512_set1_ps(a[3]), _mm512_fmadd_ps);
+    ROW_FMA(c40, c41, _mm512_set1_ps(a[4]), _mm512_fmadd_ps);
+    ROW_FMA(c50, c51, _mm512_set1_ps(a[5]), _mm512_fmadd_ps);
+    a += 6;
+    b += 32;
+  } // end for (p
+
+  if (rows == 6 && columns == 32) {
+    out = (float *) C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 32;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, isFirst);
+  ROW_STORE(out + 4*ldo, c40, c41, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, isFirst);
+  ROW_STORE(out + 5*ldo, c50, c51, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, isFirst);
+  if (out == tile) {
+    storeFloatTile(tile, 32, (float *) C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelFloatAvx512
+
+
+/*******************************************************************
+ * Function kernelFloatAvx2 - 6 x 16 float tile: two ymm of B and six
+ * broadcast A values into 12 FMAs per step.
+ ********************************************************************/
+__attribute__((target("avx2,fma")))
+static void kernelFloatAvx2(int kc, const float * a, const float * b,
+			    void * C, int ldc, int rows, int columns, int first) {
+  __m256 c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+  __m256 b0, b1;
+  float tile[6*16];
+  float * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm256_setzero_ps();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm256_setzero_ps();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm256_loadu_ps(b);
+    b1 = _mm256_loadu_ps(b + 8);
+    ROW_FMA(c00, c01, _mm256_broadcast_ss(a), _mm256_fmadd_ps);
+    ROW_FMA(c10, c11, _mm256_broadcast_ss(a + 1), _mm256_fmadd_ps);
+    ROW_FMA(c20, c21, _mm256_broadcast_ss(a + 2), _mm256_fmadd_ps);
+    ROW_FMA(c30, c31, _mm256_broadcast_ss(a + 3), _mm256_fmadd_ps);
+    ROW_FMA(c40, c41, _mm256_broadcast_ss(a + 4), _mm256_fmadd_ps);
+    ROW_FMA(c50, c51, _mm256_broadcast_ss(a + 5), _mm256_fmadd_ps);
+    a += 6;
+    b += 16;
+  } // end for (p
+
+  if (rows == 6 && columns == 16) {
+    out = (float *) C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 16;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, isFirst);
+  ROW_STORE(out + 4*ldo, c40, c41, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, isFirst);
+  ROW_STORE(out + 5*ldo, c50, c51, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, isFirst);
+  if (out == tile) {
+    storeFloatTile(tile, 16, (float *) C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelFloatAvx2
+
+
+/*******************************************************************
+ * Function kernelMixedAvx512 - 6 x 16 double tile from float slivers:
+ * the 16 B floats of a step are widened into two zmm and each A float
+ * is widened as it is broadcast.
+ ********************************************************************/
+__attribute__((target("avx512f")))
+static void kernelMixedAvx512(int kc, const float * a, const float * b,
+			      void * C, int ldc, int rows, int columns, int first) {
+  __m512d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+  __m512d b0, b1;
+  double tile[6*16];
+  double * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm512_setzero_pd();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm512_setzero_pd();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm512_cvtps_pd(_mm256_loadu_ps(b));
+    b1 = _mm512_cvtps_pd(_mm256_loadu_ps(b + 8));
+    ROW_FMA(c00, c01, _mm512_set1_pd((double) a[0]), _mm512_fmadd_pd);
+    ROW_FMA(c10, c11, _mm512_set1_pd((double) a[1]), _mm512_fmadd_pd);
+    ROW_FMA(c20, c21, _mm512_set1_pd((double) a[2]), _mm512_fmadd_pd);
+    ROW_FMA(c30, c31, _mm512_set1_pd((double) a[3]), _mm512_fmadd_pd);
+    ROW_FMA(c40, c41, _mm512_set1_pd((double) a[4]), _mm512_fmadd_pd);
+    ROW_FMA(c50, c51, _mm512_set1_pd((double) a[5]), _mm512_fmadd_pd);
+    a += 6;
+    b += 16;
+  } // end for (p
+
+  if (rows == 6 && columns == 16) {
+    out = (double *) C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 16;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 4*ldo, c40, c41, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 5*ldo, c50, c51, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  if (out == tile) {
+    storeDoubleTile(tile, 16, (double *) C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelMixedAvx512
+
+
+/*******************************************************************
+ * Function kernelMixedAvx2 - 6 x 8 double tile from float slivers.
+ ********************************************************************/
+__attribute__((target("avx2,fma")))
+static void kernelMixedAvx2(int kc, const float * a, const float * b,
+			    void * C, int ldc, int rows, int columns, int first) {
+  __m256d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+  __m256d b0, b1;
+  double tile[6*8];
+  double * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm256_setzero_pd();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm256_setzero_pd();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm256_cvtps_pd(_mm_loadu_ps(b));
+    b1 = _mm256_cvtps_pd(_mm_loadu_ps(b + 4));
+    ROW_FMA(c00, c01, _mm256_set1_pd((double) a[0]), _mm256_fmadd_pd);
+    ROW_FMA(c10, c11, _mm256_set1_pd((double) a[1]), _mm256_fmadd_pd);
+    ROW_FMA(c20, c21, _mm256_set1_pd((double) a[2]), _mm256_fmadd_pd);
+    ROW_FMA(c30, c31, _mm256_set1_pd((double) a[3]), _mm256_fmadd_pd);
+    ROW_FMA(c40, c41, _mm256_set1_pd((double) a[4]), _mm256_fmadd_pd);
+    ROW_FMA(c50, c51, _mm256_set1_pd((double) a[5]), _mm256_fmadd_pd);
+    a += 6;
+    b += 8;
+  } // end for (p
+
+  if (rows == 6 && columns == 8) {
+    out = (double *) C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 8;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 4*ldo, c40, c41, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 5*ldo, c50, c51, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  if (out == tile) {
+    storeDoubleTile(tile, 8, (double *) C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelMixedAvx2
@@ -0,0 +1,283 @@
+/*  File:        gemmSimd.c
+    Description: Explicit SIMD micro-kernels for gemmPacked (see gemm.h)
+    and the run-time CPU-feature dispatch that picks one:
+      avx512  6 x 16 doubles, 12 zmm accumulators, FMA
+      avx2    6 x  8 doubles, 12 ymm accumulators, FMA
+      sse2    4 x  4 doubles,  8 xmm accumulators, mul + add
+      scalar  4 x  8 doubles, portable C (gemm.c)
+    Each kernel is compiled with a function target attribute, so the
+    file builds without -march flags and only runs a kernel the CPU
+    reports support for.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
+#include "gemm.h"
+
+static void storeTile(const double * tile, int ldt, double * C, int ldc,
+		      int rows, int columns, int first);
+static void kernelAvx512(int kc, const double * a, const double * b,
+			 double * C, int ldc, int rows, int columns, int first);
+static void kernelAvx2(int kc, const double * a, const double * b,
+		       double * C, int ldc, int rows, int columns, int first);
+static void kernelSse2(int kc, const double * a, const double * b,
+		       double * C, int ldc, int rows, int columns, int first);
+
+static const GEMM_KERNEL avx512Kernel = {"avx512", 6, 16, kernelAvx512};
+static const GEMM_KERNEL avx2Kernel = {"avx2", 6, 8, kernelAvx2};
+static const GEMM_KERNEL sse2Kernel = {"sse2", 4, 4, kernelSse2};
+
+
+/*******************************************************************
+ * Function gemmBestKernel returns the widest kernel this CPU runs.
+ ********************************************************************/
+const GEMM_KERNEL * gemmBestKernel(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return &avx512Kernel;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return &avx2Kernel;
+  } else if (__builtin_cpu_supports("sse2")) {
+    return &sse2Kernel;
+  } // end if
+  return gemmScalarKernel();
+} // end gemmBestKernel
+
+
+/*******************************************************************
+ * Function gemmKernelByName returns the named kernel ("auto" for
+ * gemmBestKernel), falling back to the best one this CPU supports
+ * when the name is unknown or the CPU lacks the instructions.
+ ********************************************************************/
+const GEMM_KERNEL * gemmKernelByName(const char * name) {
+  const GEMM_KERNEL * best = gemmBestKernel();
+
+  if (name == NULL || strcmp(name, "auto") == 0) {
+    return best;
+  } else if (strcmp(name, "scalar") == 0) {
+    return gemmScalarKernel();
+  } else if (strcmp(name, "sse2") == 0 && best != gemmScalarKernel()) {
+    return &sse2Kernel;
+  } else if (strcmp(name, "avx2") == 0 &&
+	     (best == &avx2Kernel || best == &avx512Kernel)) {
+    return &avx2Kernel;
+  } else if (strcmp(name, "avx512") == 0 && best == &avx512Kernel) {
+    return &avx512Kernel;
+  } // end if
+
+  printf("GEMM kernel %s not available, using %s\n", name, best->name);
+  return best;
+} // end gemmKernelByName
+
+
+/*******************************************************************
+ * Function gemmSupportedKernels fills kernels with up to max kernels
+ * this CPU can run, widest first, and returns how many.
+ ********************************************************************/
+int gemmSupportedKernels(const GEMM_KERNEL ** kernels, int max) {
+  const GEMM_KERNEL * best = gemmBestKernel();
+  int count = 0;
+
+  if (best == &avx512Kernel && count < max) {
+    kernels[count++] = &avx512Kernel;
+  } // end if
+  if ((best == &avx512Kernel || best == &avx2Kernel) && count < max) {
+    kernels[count++] = &avx2Kernel;
+  } // end if
+  if (best != gemmScalarKernel() && count < max) {
+    kernels[count++] = &sse2Kernel;
+  } // end if
+  if (count < max) {
+    kernels[count++] = gemmScalarKernel();
+  } // end if
+  return count;
+} // end gemmSupportedKernels
+
+
+/*******************************************************************
+ * Function storeTile stores (first != 0) or adds the in-bounds
+ * rows x columns corner of a register tile into C.
+ ********************************************************************/
+static void storeTile(const double * tile, int ldt, double * C, int ldc,
+		      int rows, int columns, int first) {
+  int i, j;
+
+  for (i=0; i < rows; i++) {
+    for (j=0; j < columns; j++) {
+      if (first) {
+	C[(size_t) i*ldc + j] = tile[i*ldt + j];
+      } else {
+	C[(size_t) i*ldc + j] += tile[i*ldt + j];
+      } // end if
+    } // end for (j
+  } // end for (i
+
+} // end storeTile
+
+
+/* The accumulators are named variables rather than an array so the
+   compiler keeps every one of them in a register across the k loop. */
+#define ROW_FMA(c0, c1, ai, fmadd)  { c0 = fmadd(ai, b0, c0); c1 = fmadd(ai, b1, c1); }
+#define ROW_STORE(out, c0, c1, w, loadu, storeu, add, first) { \
+  if (!(first)) { \
+    c0 = add(c0, loadu(out)); \
+    c1 = add(c1, loadu((out) + (w))); \
+  } \
+  storeu(out, c0); \
+  storeu((out) + (w), c1); \
+}
+
+
+/*******************************************************************
+ * Function kernelAvx512 - 6 x 16 tile: each of the kc steps loads
+ * two zmm of B and broadcasts six A values into 12 FMAs.
+ ********************************************************************/
+__attribute__((target("avx512f")))
+static void kernelAvx512(int kc, const double * a, const double * b,
+			 double * C, int ldc, int rows, int columns, int first) {
+  __m512d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+  __m512d b0, b1;
+  double tile[6*16];
+  double * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm512_setzero_pd();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm512_setzero_pd();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm512_loadu_pd(b);
+    b1 = _mm512_loadu_pd(b + 8);
+    ROW_FMA(c00, c01, _mm512_set1_pd(a[0]), _mm512_fmadd_pd);
+    ROW_FMA(c10, c11, _mm512_set1_pd(a[1]), _mm512_fmadd_pd);
+    ROW_FMA(c20, c21, _mm512_set1_pd(a[2]), _mm512_fmadd_pd);
+    ROW_FMA(c30, c31, _mm512_set1_pd(a[3]), _mm512_fmadd_pd);
+    ROW_FMA(c40, c41, _mm512_set1_pd(a[4]), _mm512_fmadd_pd);
+    ROW_FMA(c50, c51, _mm512_set1_pd(a[5]), _mm512_fmadd_pd);
+    a += 6;
+    b += 16;
+  } // end for (p
+
+  // full tiles go straight to C, edge tiles through a buffer
+  if (rows == 6 && columns == 16) {
+    out = C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 16;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 4*ldo, c40, c41, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  ROW_STORE(out + 5*ldo, c50, c51, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, isFirst);
+  if (out == tile) {
+    storeTile(tile, 16, C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelAvx512
+
+
+/*******************************************************************
+ * Function kernelAvx2 - 6 x 8 tile: each of the kc steps loads two
+ * ymm of B and broadcasts six A values into 12 FMAs.
+ ********************************************************************/
+__attribute__((target("avx2,fma")))
+static void kernelAvx2(int kc, const double * a, const double * b,
+		       double * C, int ldc, int rows, int columns, int first) {
+  __m256d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51;
+  __m256d b0, b1;
+  double tile[6*8];
+  double * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm256_setzero_pd();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm256_setzero_pd();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm256_loadu_pd(b);
+    b1 = _mm256_loadu_pd(b + 4);
+    ROW_FMA(c00, c01, _mm256_broadcast_sd(a), _mm256_fmadd_pd);
+    ROW_FMA(c10, c11, _mm256_broadcast_sd(a + 1), _mm256_fmadd_pd);
+    ROW_FMA(c20, c21, _mm256_broadcast_sd(a + 2), _mm256_fmadd_pd);
+    ROW_FMA(c30, c31, _mm256_broadcast_sd(a + 3), _mm256_fmadd_pd);
+    ROW_FMA(c40, c41, _mm256_broadcast_sd(a + 4), _mm256_fmadd_pd);
+    ROW_FMA(c50, c51, _mm256_broadcast_sd(a + 5), _mm256_fmadd_pd);
+    a += 6;
+    b += 8;
+  } // end for (p
+
+  // full tiles go straight to C, edge tiles through a buffer
+  if (rows == 6 && columns == 8) {
+    out = C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 8;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 4*ldo, c40, c41, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  ROW_STORE(out + 5*ldo, c50, c51, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, isFirst);
+  if (out == tile) {
+    storeTile(tile, 8, C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelAvx2
+
+
+/*******************************************************************
+ * Function kernelSse2 - 4 x 4 tile: each of the kc steps loads two
+ * xmm of B and broadcasts four A values; SSE2 has no FMA, so each
+ * update is a multiply and an add.
+ ********************************************************************/
+#define SSE2_MADD(x, y, z)  _mm_add_pd(_mm_mul_pd(x, y), z)
+
+__attribute__((target("sse2")))
+static void kernelSse2(int kc, const double * a, const double * b,
+		       double * C, int ldc, int rows, int columns, int first) {
+  __m128d c00, c01, c10, c11, c20, c21, c30, c31;
+  __m128d b0, b1;
+  double tile[4*4];
+  double * out;
+  int p, ldo, isFirst;
+
+  c00 = c01 = c10 = c11 = _mm_setzero_pd();
+  c20 = c21 = c30 = c31 = _mm_setzero_pd();
+
+  for (p=0; p < kc; p++) {
+    b0 = _mm_loadu_pd(b);
+    b1 = _mm_loadu_pd(b + 2);
+    ROW_FMA(c00, c01, _mm_set1_pd(a[0]), SSE2_MADD);
+    ROW_FMA(c10, c11, _mm_set1_pd(a[1]), SSE2_MADD);
+    ROW_FMA(c20, c21, _mm_set1_pd(a[2]), SSE2_MADD);
+    ROW_FMA(c30, c31, _mm_set1_pd(a[3]), SSE2_MADD);
+    a += 4;
+    b += 4;
+  } // end for (p
+
+  // full tiles go straight to C, edge tiles through a buffer
+  if (rows == 4 && columns == 4) {
+    out = C;
+    ldo = ldc;
+    isFirst = first;
+  } else {
+    out = tile;
+    ldo = 4;
+    isFirst = 1;
+  } // end if
+  ROW_STORE(out,         c00, c01, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, isFirst);
+  ROW_STORE(out +   ldo, c10, c11, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, isFirst);
+  ROW_STORE(out + 2*ldo, c20, c21, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, isFirst);
+  ROW_STORE(out + 3*ldo, c30, c31, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, isFirst);
+  if (out == tile) {
+    storeTile(tile, 4, C, ldc, rows, columns, first);
+  } // end if
+
+} // end kernelSse2
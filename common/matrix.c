@@ -0,0 +1,76 @@
+/*  File:        matrix.c
+    Description: Allocation of the contiguous MATRIX type (see matrix.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "matrix.h"
+
+
+/*******************************************************************
+ * Function allocateAligned allocates count doubles starting on a
+ * MATRIX_ALIGNMENT byte boundary.  Release with free().
+ ********************************************************************/
+double * allocateAligned(size_t count) {
+  void * block;
+
+  if (posix_memalign(&block, MATRIX_ALIGNMENT, sizeof(double)*count) != 0) {
+    printf("Unable to allocate %lu doubles\n", (unsigned long) count);
+    exit(-1);
+  } // end if
+
+  return (double *) block;
+} // end allocateAligned
+
+
+/*******************************************************************
+ * Function allocateAlignedFloat allocates count floats starting on a
+ * MATRIX_ALIGNMENT byte boundary.  Release with free().
+ ********************************************************************/
+float * allocateAlignedFloat(size_t count) {
+  void * block;
+
+  if (posix_memalign(&block, MATRIX_ALIGNMENT, sizeof(float)*count) != 0) {
+    printf("Unable to allocate %lu floats\n", (unsigned long) count);
+    exit(-1);
+  } // end if
+
+  return (float *) block;
+} // end allocateAlignedFloat
+
+
+/*******************************************************************
+ * Function allocateMatrix dynamically allocates a rows x columns
+ * matrix as one aligned block.  The leading dimension is rounded up
+ * to a whole number of cache lines so every row starts aligned.
+ ********************************************************************/
+MATRIX * allocateMatrix(int rows, int columns) {
+  MATRIX * matrix;
+  int perLine = MATRIX_ALIGNMENT / sizeof(double);
+  int r;
+
+  matrix = (MATRIX *) malloc(sizeof(MATRIX));
+  matrix->rows = rows;
+  matrix->columns = columns;
+  matrix->ld = (columns + perLine - 1) / perLine * perLine;
+  matrix->data = allocateAligned((size_t) rows * matrix->ld);
+
+  matrix->row = (double **) malloc(sizeof(double *)*rows);
+  for (r=0; r < rows; r++) {
+    matrix->row[r] = MATRIX_ROW(matrix, r);
+  } // end for
+
+  return matrix;
+} // end allocateMatrix
+
+
+/*******************************************************************
+ * Function freeMatrix deallocates a matrix from allocateMatrix.
+ ********************************************************************/
+void freeMatrix(MATRIX * matrix) {
+  if (matrix == NULL) {
+    return;
+  } // end if
+  free(matrix->row);
+  free(matrix->data);
+  free(matrix);
+} // end freeMatrix
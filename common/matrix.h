@@ -0,0 +1,38 @@
+/*  File:        matrix.h
+    Description: Contiguous 2D matrix of doubles shared by the matrix
+    programs.  All rows live in one 64-byte aligned block with an
+    explicit leading dimension, so consecutive rows are adjacent in
+    memory (hardware prefetch runs across row boundaries) and a kernel
+    can walk the data with a single restrict pointer.  The "row" field
+    is a double ** view into the same block, so the existing
+    array[r][c] kernels can switch over by replacing
+        allocate2DArray(rows, columns)
+    with
+        allocateMatrix(rows, columns)->row
+    Compile the program with:  -I../common ../common/matrix.c
+*/
+#ifndef _MATRIX_H_
+#define _MATRIX_H_
+
+#include <stddef.h>
+
+#define MATRIX_ALIGNMENT 64  // bytes -- one cache line / one AVX-512 register
+
+typedef struct {
+  int rows;
+  int columns;
+  int ld;         // leading dimension: # doubles from one row start to the next
+  double * data;  // rows*ld doubles in one MATRIX_ALIGNMENT aligned block
+  double ** row;  // row view: row[r] == data + r*ld
+} MATRIX;
+
+// row-view accessors for kernels working on the contiguous layout
+#define MATRIX_ROW(m, r)        ((m)->data + (size_t) (r) * (m)->ld)
+#define MATRIX_ELEMENT(m, r, c) (MATRIX_ROW(m, r)[c])
+
+MATRIX * allocateMatrix(int rows, int columns);
+void freeMatrix(MATRIX * matrix);
+double * allocateAligned(size_t count);
+float * allocateAlignedFloat(size_t count);
+
+#endif
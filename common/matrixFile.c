@@ -0,0 +1,229 @@
+/*  File:        matrixFile.c
+    Description: Memory-mapped binary matrix files (see matrixFile.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "matrixFile.h"
+
+static void buildRowView(MATRIX_FILE * file, int rows, int columns, int ld,
+			 size_t dataOffset);
+static int validHeader(const MATRIX_FILE_HEADER * header, size_t length);
+
+
+/*******************************************************************
+ * Function matrixFileHeaderSize returns the bytes reserved for the
+ * version 1 header: one page, so the data is page aligned.
+ ********************************************************************/
+size_t matrixFileHeaderSize(void) {
+  long pageSize = sysconf(_SC_PAGESIZE);
+
+  if (pageSize < (long) sizeof(MATRIX_FILE_HEADER)) {
+    pageSize = 4096;
+  } // end if
+  return (size_t) pageSize;
+} // end matrixFileHeaderSize
+
+
+/*******************************************************************
+ * Function mapMatrixFile maps a legacy or version 1 matrix file
+ * read-only and returns a MATRIX view of it, or NULL (with a message)
+ * if the file can't be opened or its size doesn't match its header.
+ * The header is read and checked before anything is mapped.  Pages
+ * are only read from disk when the program touches them.
+ ********************************************************************/
+MATRIX_FILE * mapMatrixFile(const char * fileName) {
+  MATRIX_FILE * file;
+  MATRIX_FILE_HEADER header;
+  struct stat fileStat;
+  int fd, legacySize[2], rows, columns, ld, version;
+  size_t length, expected, dataOffset;
+
+  if ((fd = open(fileName, O_RDONLY)) < 0) {
+    printf("%s cannot be opened for reading\n", fileName);
+    return NULL;
+  } // end if
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t) (2*sizeof(int))) {
+    printf("%s is too short to be a matrix file\n", fileName);
+    close(fd);
+    return NULL;
+  } // end if
+  length = (size_t) fileStat.st_size;
+
+  memset(&header, 0, sizeof(header));
+  if (length >= sizeof(header)
+      && pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)
+      && memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) == 0) {
+    if (!validHeader(&header, length)) {
+      printf("%s has an unsupported or damaged header (version %u)\n",
+	     fileName, header.version);
+      close(fd);
+      return NULL;
+    } // end if
+    version = MATRIX_FILE_VERSION;
+    rows = header.rows;
+    columns = header.columns;
+    ld = header.ld;
+    dataOffset = header.headerSize;
+  } else {
+    if (pread(fd, legacySize, sizeof(legacySize), 0) != (ssize_t) sizeof(legacySize)) {
+      printf("%s cannot be read\n", fileName);
+      close(fd);
+      return NULL;
+    } // end if
+    dataOffset = sizeof(legacySize);
+    expected = dataOffset + (size_t) legacySize[0] * legacySize[1] * sizeof(double);
+    if (legacySize[0] < 0 || legacySize[1] < 0 || length != expected) {
+      printf("%s is not a matrix file (size %lu, expected %lu)\n", fileName,
+	     (unsigned long) length, (unsigned long) expected);
+      close(fd);
+      return NULL;
+    } // end if
+    version = MATRIX_FILE_LEGACY;
+    rows = legacySize[0];
+    columns = legacySize[1];
+    ld = legacySize[1];
+  } // end if
+
+  file = (MATRIX_FILE *) calloc(1, sizeof(MATRIX_FILE));
+  file->fd = fd;
+  file->length = length;
+  file->version = version;
+  file->base = mmap(NULL, file->length, PROT_READ, MAP_SHARED, fd, 0);
+  if (file->base == MAP_FAILED) {
+    printf("%s cannot be mapped\n", fileName);
+    close(fd);
+    free(file);
+    return NULL;
+  } // end if
+  buildRowView(file, rows, columns, ld, dataOffset);
+
+  // most readers stream the rows front to back
+  madvise(file->base, file->length, MADV_SEQUENTIAL);
+
+  return file;
+} // end mapMatrixFile
+
+
+/*******************************************************************
+ * Function createMatrixFile creates (or truncates) a version 1 file
+ * for a rows x columns matrix, sizes it, writes the header, and
+ * returns a writable view; the caller fills matrix.row[r][c] in
+ * place and unmapMatrixFile flushes it.  Returns NULL on failure.
+ ********************************************************************/
+MATRIX_FILE * createMatrixFile(const char * fileName, int rows, int columns) {
+  MATRIX_FILE * file;
+  MATRIX_FILE_HEADER header;
+  int perLine = MATRIX_ALIGNMENT / sizeof(double);
+  int fd, status;
+
+  if ((fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+    printf("%s cannot be opened for writing\n", fileName);
+    return NULL;
+  } // end if
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+  header.version = MATRIX_FILE_VERSION;
+  header.headerSize = (uint32_t) matrixFileHeaderSize();
+  header.rows = rows;
+  header.columns = columns;
+  header.ld = (columns + perLine - 1) / perLine * perLine;
+  header.elementSize = sizeof(double);
+  header.dataBytes = (uint64_t) rows * header.ld * sizeof(double);
+
+  file = (MATRIX_FILE *) calloc(1, sizeof(MATRIX_FILE));
+  file->fd = fd;
+  file->length = header.headerSize + header.dataBytes;
+  file->version = MATRIX_FILE_VERSION;
+  file->writable = 1;
+
+  // reserve the blocks now so a full disk fails here, not with SIGBUS
+  // later; only a file system that can't reserve gets a sparse file
+  status = posix_fallocate(fd, 0, (off_t) file->length);
+  if ((status == EOPNOTSUPP || status == EINVAL)
+      && ftruncate(fd, (off_t) file->length) == 0) {
+    status = 0;
+  } // end if
+  if (status != 0) {
+    printf("%s cannot be sized to %lu bytes: %s\n", fileName,
+	   (unsigned long) file->length, strerror(status));
+    close(fd);
+    free(file);
+    return NULL;
+  } // end if
+  file->base = mmap(NULL, file->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (file->base == MAP_FAILED) {
+    printf("%s cannot be mapped\n", fileName);
+    close(fd);
+    free(file);
+    return NULL;
+  } // end if
+
+  memcpy(file->base, &header, sizeof(header));
+  buildRowView(file, rows, columns, header.ld, header.headerSize);
+
+  return file;
+} // end createMatrixFile
+
+
+/*******************************************************************
+ * Function unmapMatrixFile flushes a writable mapping to disk and
+ * releases the mapping, the file, and the row view.
+ ********************************************************************/
+void unmapMatrixFile(MATRIX_FILE * file) {
+  if (file == NULL) {
+    return;
+  } // end if
+  if (file->writable) {
+    msync(file->base, file->length, MS_SYNC);
+  } // end if
+  munmap(file->base, file->length);
+  close(file->fd);
+  free(file->matrix.row);
+  free(file);
+} // end unmapMatrixFile
+
+
+/*******************************************************************
+ * Function buildRowView points file->matrix at the rows that start
+ * dataOffset bytes into the mapping.
+ ********************************************************************/
+static void buildRowView(MATRIX_FILE * file, int rows, int columns, int ld,
+			 size_t dataOffset) {
+  MATRIX * matrix = &file->matrix;
+  int r;
+
+  file->dataOffset = dataOffset;
+  matrix->rows = rows;
+  matrix->columns = columns;
+  matrix->ld = ld;
+  matrix->data = (double *) ((char *) file->base + dataOffset);
+  matrix->row = (double **) malloc(sizeof(double *)*(rows > 0 ? rows : 1));
+  for (r=0; r < rows; r++) {
+    matrix->row[r] = MATRIX_ROW(matrix, r);
+  } // end for
+} // end buildRowView
+
+
+/*******************************************************************
+ * Function validHeader returns 1 if a version 1 header describes
+ * data that fits a file of length bytes: the header area must hold
+ * the header, keep the rows aligned and leave room for dataBytes.
+ ********************************************************************/
+static int validHeader(const MATRIX_FILE_HEADER * header, size_t length) {
+  return header->version == MATRIX_FILE_VERSION
+    && header->elementSize == (int32_t) sizeof(double)
+    && header->headerSize >= sizeof(MATRIX_FILE_HEADER)
+    && header->headerSize % sizeof(double) == 0
+    && header->headerSize <= length
+    && header->rows >= 0 && header->columns >= 0
+    && header->ld >= header->columns
+    && header->dataBytes == (uint64_t) header->rows * header->ld * sizeof(double)
+    && header->dataBytes <= length - header->headerSize;
+} // end validHeader
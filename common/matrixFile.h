@@ -0,0 +1,54 @@
+/*  File:        matrixFile.h
+    Description: Memory-mapped binary matrix files.  Two layouts are
+    understood:
+      legacy    - what write2DArray (lab5/writeRandom2DArray.c) writes:
+                  int rows, int columns, then rows*columns doubles
+      version 1 - a MATRIX_FILE_HEADER padded out to a full page, then
+                  the rows with a leading dimension rounded up to a
+                  cache line, so the data starts on a page boundary and
+                  every row starts on a cache line
+    mapMatrixFile returns a zero-copy, read-only MATRIX view straight
+    over the file's pages (no fread, no copy); createMatrixFile sizes a
+    version 1 file up front and returns a writable view to fill in
+    place.  Either way release with unmapMatrixFile.
+    Compile the program with:  -I../common ../common/matrixFile.c
+      ../common/matrix.c
+*/
+#ifndef _MATRIX_FILE_H_
+#define _MATRIX_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "matrix.h"
+
+#define MATRIX_FILE_MAGIC "MATRIXF"  // 7 chars + '\0' fill the magic field
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_LEGACY 0         // version reported for write2DArray files
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;   // bytes from file start to the first row
+  int32_t rows;
+  int32_t columns;
+  int32_t ld;            // # doubles from one row start to the next
+  int32_t elementSize;   // sizeof(double)
+  uint64_t dataBytes;    // rows*ld*elementSize
+} MATRIX_FILE_HEADER;
+
+typedef struct {
+  int fd;
+  void * base;        // start of the mapping
+  size_t length;      // bytes mapped
+  int version;        // MATRIX_FILE_VERSION or MATRIX_FILE_LEGACY
+  int writable;
+  size_t dataOffset;  // file offset of row 0, for pread/pwrite of tiles
+  MATRIX matrix;      // view into the mapping; matrix.row is malloc'ed
+} MATRIX_FILE;
+
+MATRIX_FILE * mapMatrixFile(const char * fileName);
+MATRIX_FILE * createMatrixFile(const char * fileName, int rows, int columns);
+void unmapMatrixFile(MATRIX_FILE * file);
+size_t matrixFileHeaderSize(void);
+
+#endif
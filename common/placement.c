@@ -0,0 +1,344 @@
+/*  File:        placement.c
+    Description: NUMA placement helpers (see placement.h).
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "timer.h"
+#include "placement.h"
+
+#define MAX_CPUS 1024
+#define MAX_NODES 64
+#define MAX_SAMPLE_PAGES 1024   // pages checked by placementFractionOnNode
+#define MPOL_INTERLEAVE_MODE 3  // MPOL_INTERLEAVE of <numaif.h>
+
+static pthread_once_t topologyOnce = PTHREAD_ONCE_INIT;
+static int numberOfNodes;
+static int numberOfCpus;
+static int cpuNode[MAX_CPUS];
+static int cpuOrder[MAX_CPUS];    // CPUs grouped by node, ascending
+static unsigned long nodeMask[MAX_NODES / (8*sizeof(unsigned long))];
+static volatile double sink;      // keeps the bandwidth reads alive
+
+static void readTopology(void);
+static double readBandwidth(const double * data, size_t count);
+
+
+/*******************************************************************
+ * Function placementNumberOfNodes returns the # NUMA nodes with CPUs.
+ ********************************************************************/
+int placementNumberOfNodes(void) {
+  pthread_once(&topologyOnce, readTopology);
+  return numberOfNodes;
+} // end placementNumberOfNodes
+
+
+/*******************************************************************
+ * Function placementCpuNode returns the node of a CPU (0 if unknown).
+ ********************************************************************/
+int placementCpuNode(int cpu) {
+  pthread_once(&topologyOnce, readTopology);
+  return (cpu >= 0 && cpu < MAX_CPUS && cpuNode[cpu] >= 0) ? cpuNode[cpu] : 0;
+} // end placementCpuNode
+
+
+/*******************************************************************
+ * Function placementCurrentNode returns the node the calling thread
+ * is running on right now.
+ ********************************************************************/
+int placementCurrentNode(void) {
+  return placementCpuNode(sched_getcpu());
+} // end placementCurrentNode
+
+
+/*******************************************************************
+ * Function placementPinThread pins the calling thread to one CPU.
+ * Thread ids are spread evenly over the CPUs in node order, so
+ * threads 0 .. numberOfThreads/2-1 share the first socket of a two
+ * socket box and the rest the second.  Returns the CPU, or -1 if the
+ * affinity can't be set.
+ ********************************************************************/
+int placementPinThread(int threadId, int numberOfThreads) {
+  cpu_set_t cpus;
+  int cpu;
+
+  pthread_once(&topologyOnce, readTopology);
+  if (numberOfThreads <= numberOfCpus) {
+    cpu = cpuOrder[(long) threadId * numberOfCpus / numberOfThreads];
+  } else {
+    cpu = cpuOrder[threadId % numberOfCpus];
+  } // end if
+
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+    return -1;
+  } // end if
+  return cpu;
+} // end placementPinThread
+
+
+/*******************************************************************
+ * Function placementInterleave asks for the untouched pages of
+ * [start, start+bytes) to be spread round-robin over all nodes when
+ * they are first touched.  Only whole pages inside the range are
+ * affected.  Returns 1 on success (or with only one node).
+ ********************************************************************/
+int placementInterleave(void * start, size_t bytes) {
+  long pageSize = sysconf(_SC_PAGESIZE);
+  unsigned long first, last;
+
+  if (placementNumberOfNodes() <= 1) {
+    return 1;
+  } // end if
+  first = ((unsigned long) start + pageSize - 1) & ~(unsigned long) (pageSize - 1);
+  last = ((unsigned long) start + bytes) & ~(unsigned long) (pageSize - 1);
+  if (last <= first) {
+    return 1;
+  } // end if
+  return syscall(SYS_mbind, (void *) first, last - first, MPOL_INTERLEAVE_MODE,
+		 nodeMask, (unsigned long) MAX_NODES + 1, 0) == 0;
+} // end placementInterleave
+
+
+/*******************************************************************
+ * Function placementPageNode returns the node holding the page of
+ * address, or a negative value if the page hasn't been touched yet.
+ ********************************************************************/
+int placementPageNode(const void * address) {
+  long pageSize = sysconf(_SC_PAGESIZE);
+  void * page = (void *) ((unsigned long) address & ~(unsigned long) (pageSize - 1));
+  int status = -1;
+
+  if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) != 0) {
+    return -1;
+  } // end if
+  return status;
+} // end placementPageNode
+
+
+/*******************************************************************
+ * Function placementFractionOnNode returns the fraction of the
+ * touched pages of [start, start+bytes) that are on node, checking
+ * at most MAX_SAMPLE_PAGES pages spread evenly over the range.
+ ********************************************************************/
+double placementFractionOnNode(const void * start, size_t bytes, int node) {
+  long pageSize = sysconf(_SC_PAGESIZE);
+  void * pages[MAX_SAMPLE_PAGES];
+  int status[MAX_SAMPLE_PAGES];
+  unsigned long first;
+  size_t numberOfPages, sampled, i;
+  int present = 0, onNode = 0;
+
+  first = (unsigned long) start & ~(unsigned long) (pageSize - 1);
+  numberOfPages = ((unsigned long) start + bytes - first + pageSize - 1) / pageSize;
+  sampled = (numberOfPages < MAX_SAMPLE_PAGES) ? numberOfPages : MAX_SAMPLE_PAGES;
+  for (i=0; i < sampled; i++) {
+    pages[i] = (void *) (first + (i * numberOfPages / sampled) * pageSize);
+  } // end for
+  if (sampled == 0
+      || syscall(SYS_move_pages, 0, sampled, pages, NULL, status, 0) != 0) {
+    return 0.0;
+  } // end if
+
+  for (i=0; i < sampled; i++) {
+    present += (status[i] >= 0);
+    onNode += (status[i] == node);
+  } // end for
+  return (present > 0) ? (double) onNode / present : 0.0;
+} // end placementFractionOnNode
+
+
+/*******************************************************************
+ * Function placementProbeCreate sets up a bandwidth probe for
+ * numberOfThreads threads sharing totalBytes of buffers.  No buffer
+ * page is touched here.
+ ********************************************************************/
+PLACEMENT_PROBE * placementProbeCreate(int numberOfThreads, size_t totalBytes) {
+  PLACEMENT_PROBE * probe;
+  void * block;
+  int t;
+
+  probe = (PLACEMENT_PROBE *) calloc(1, sizeof(PLACEMENT_PROBE));
+  probe->numberOfThreads = numberOfThreads;
+  probe->count = totalBytes / numberOfThreads / sizeof(double);
+  probe->buffers = (double **) malloc(sizeof(double *)*numberOfThreads);
+  for (t=0; t < numberOfThreads; t++) {
+    if (posix_memalign(&block, sysconf(_SC_PAGESIZE), probe->count*sizeof(double)) != 0) {
+      printf("Unable to allocate the placement probe buffers\n");
+      exit(-1);
+    } // end if
+    probe->buffers[t] = (double *) block;
+  } // end for
+  pthread_barrier_init(&probe->barrier, NULL, numberOfThreads);
+  probe->cpu = (int *) calloc(numberOfThreads, sizeof(int));
+  probe->node = (int *) calloc(numberOfThreads, sizeof(int));
+  probe->bufferNode = (int *) calloc(numberOfThreads, sizeof(int));
+  probe->local = (double *) calloc(numberOfThreads, sizeof(double));
+  probe->remote = (double *) calloc(numberOfThreads, sizeof(double));
+
+  return probe;
+} // end placementProbeCreate
+
+
+/*******************************************************************
+ * Function placementProbeRun is called by each of the probe's
+ * threads (after any pinning): it first-touches its own buffer,
+ * then all threads time reading their own buffer together, then
+ * their partner's.
+ ********************************************************************/
+void placementProbeRun(PLACEMENT_PROBE * probe, int threadId) {
+  double * mine = probe->buffers[threadId];
+  int partner = (threadId + probe->numberOfThreads/2) % probe->numberOfThreads;
+  size_t i;
+
+  probe->cpu[threadId] = sched_getcpu();
+  probe->node[threadId] = placementCpuNode(probe->cpu[threadId]);
+  for (i=0; i < probe->count; i++) {
+    mine[i] = 1.0;
+  } // end for
+  probe->bufferNode[threadId] = placementPageNode(mine + probe->count/2);
+
+  pthread_barrier_wait(&probe->barrier);
+  probe->local[threadId] = readBandwidth(mine, probe->count);
+  pthread_barrier_wait(&probe->barrier);
+  probe->remote[threadId] = readBandwidth(probe->buffers[partner], probe->count);
+  pthread_barrier_wait(&probe->barrier);
+} // end placementProbeRun
+
+
+/*******************************************************************
+ * Function placementProbeReport prints each thread's local and
+ * remote read bandwidth and the totals.
+ ********************************************************************/
+void placementProbeReport(const PLACEMENT_PROBE * probe) {
+  double localTotal = 0.0, remoteTotal = 0.0;
+  int t, partner;
+
+  printf("Read bandwidth, %d threads at once, %1.1f MB per thread (%d NUMA node%s):\n",
+	 probe->numberOfThreads, probe->count*sizeof(double) / 1.0e6,
+	 placementNumberOfNodes(), (placementNumberOfNodes() == 1) ? "" : "s");
+  for (t=0; t < probe->numberOfThreads; t++) {
+    partner = (t + probe->numberOfThreads/2) % probe->numberOfThreads;
+    printf("  thread %2d (cpu %3d, node %d): own buffer (node %d) %6.2f GB/s,"
+	   " thread %d's buffer (node %d) %6.2f GB/s\n", t, probe->cpu[t],
+	   probe->node[t], probe->bufferNode[t], probe->local[t], partner,
+	   probe->bufferNode[partner], probe->remote[t]);
+    localTotal += probe->local[t];
+    remoteTotal += probe->remote[t];
+  } // end for
+  printf("  total: local %1.2f GB/s, remote %1.2f GB/s (remote/local %1.2f)\n",
+	 localTotal, remoteTotal, (localTotal > 0.0) ? remoteTotal / localTotal : 0.0);
+  if (placementNumberOfNodes() == 1) {
+    printf("  (one node: \"remote\" is only another thread's buffer, not another socket)\n");
+  } // end if
+} // end placementProbeReport
+
+
+/*******************************************************************
+ * Function placementProbeDestroy frees a probe.
+ ********************************************************************/
+void placementProbeDestroy(PLACEMENT_PROBE * probe) {
+  int t;
+
+  for (t=0; t < probe->numberOfThreads; t++) {
+    free(probe->buffers[t]);
+  } // end for
+  pthread_barrier_destroy(&probe->barrier);
+  free(probe->buffers);
+  free(probe->cpu);
+  free(probe->node);
+  free(probe->bufferNode);
+  free(probe->local);
+  free(probe->remote);
+  free(probe);
+} // end placementProbeDestroy
+
+
+/*******************************************************************
+ * Function readBandwidth returns the GB/s of summing count doubles
+ * (best of three passes).
+ ********************************************************************/
+static double readBandwidth(const double * data, size_t count) {
+  double startTime, endTime, sum0, sum1, sum2, sum3, best = 0.0, rate;
+  size_t i;
+  int pass;
+
+  for (pass=0; pass < 3; pass++) {
+    sum0 = sum1 = sum2 = sum3 = 0.0;
+    GET_TIME(startTime);
+    for (i=0; i + 4 <= count; i += 4) {
+      sum0 += data[i];
+      sum1 += data[i+1];
+      sum2 += data[i+2];
+      sum3 += data[i+3];
+    } // end for
+    GET_TIME(endTime);
+    sink = sum0 + sum1 + sum2 + sum3;
+    rate = count*sizeof(double) / (endTime - startTime) * 1.0e-9;
+    best = (rate > best) ? rate : best;
+  } // end for
+  return best;
+} // end readBandwidth
+
+
+/*******************************************************************
+ * Function readTopology fills in the CPU -> node table from sysfs
+ * (cpulist of each node directory), falling back to one node.
+ ********************************************************************/
+static void readTopology(void) {
+  FILE * listFilePtr;
+  char fileName[64], list[4096], * token, * save;
+  int node, first, last, cpu, before, matched;
+
+  for (cpu=0; cpu < MAX_CPUS; cpu++) {
+    cpuNode[cpu] = -1;
+  } // end for
+  for (node=0; node < MAX_NODES; node++) {
+    snprintf(fileName, sizeof(fileName), "/sys/devices/system/node/node%d/cpulist",
+	     node);
+    if ((listFilePtr = fopen(fileName, "r")) == NULL) {
+      continue;
+    } // end if
+    before = numberOfCpus;
+    if (fgets(list, sizeof(list), listFilePtr) != NULL) {
+      for (token = strtok_r(list, ",\n", &save); token != NULL;
+	   token = strtok_r(NULL, ",\n", &save)) {
+	// a range "a-b" or a single CPU "a"; skip anything else
+	matched = sscanf(token, "%d-%d", &first, &last);
+	if (matched == 1) {
+	  last = first;
+	} else if (matched != 2 || first < 0) {
+	  continue;
+	} // end if
+	for (cpu=first; cpu <= last && cpu < MAX_CPUS; cpu++) {
+	  if (cpuNode[cpu] < 0) {
+	    cpuNode[cpu] = node;
+	    cpuOrder[numberOfCpus++] = cpu;
+	  } // end if
+	} // end for (cpu
+      } // end for (token
+      if (numberOfCpus > before) {
+	numberOfNodes++;
+	nodeMask[node / (8*sizeof(unsigned long))] |= 1UL << (node % (8*sizeof(unsigned long)));
+      } // end if
+    } // end if
+    fclose(listFilePtr);
+  } // end for (node
+
+  if (numberOfCpus == 0) {
+    numberOfNodes = 1;
+    nodeMask[0] = 1;
+    numberOfCpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    numberOfCpus = (numberOfCpus > MAX_CPUS) ? MAX_CPUS : numberOfCpus;
+    for (cpu=0; cpu < numberOfCpus; cpu++) {
+      cpuNode[cpu] = 0;
+      cpuOrder[cpu] = cpu;
+    } // end for
+  } // end if
+} // end readTopology
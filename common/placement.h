@@ -0,0 +1,51 @@
+/*  File:        placement.h
+    Description: NUMA placement helpers for the pthread matrix
+    programs, straight on the Linux system calls (no libnuma).
+    Linux puts a page on the node of the CPU that first writes it, so
+    a parallel kernel keeps its data local when each worker writes
+    (first-touches) the rows it will later compute, on the node it
+    will compute them on -- which pinning guarantees.  Data every
+    thread reads (e.g. B of A*B) can instead be interleaved over all
+    nodes so no one memory controller serves everybody.
+    The node topology is read from /sys/devices/system/node; without
+    it everything is node 0.
+    A PLACEMENT_PROBE measures what placement buys: each thread
+    first-touches a buffer, then all threads read their own buffer
+    (local) and then the buffer of the thread half way round the
+    thread ids (remote -- the other socket when threads are pinned in
+    node order) at the same time.
+    Compile the program with:  -I../common ../common/placement.c -lpthread
+*/
+#ifndef _PLACEMENT_H_
+#define _PLACEMENT_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define PLACEMENT_PROBE_BYTES (256L*1024*1024)  // total probe buffers, all threads
+
+typedef struct {
+  int numberOfThreads;
+  size_t count;              // doubles in each thread's buffer
+  double ** buffers;         // buffer t is first-touched by thread t
+  pthread_barrier_t barrier;
+  int * cpu;                 // CPU each thread ran the probe on
+  int * node;                // ... and its node
+  int * bufferNode;          // node holding most of each buffer
+  double * local;            // GB/s reading its own buffer
+  double * remote;           // GB/s reading its partner's buffer
+} PLACEMENT_PROBE;
+
+int placementNumberOfNodes(void);
+int placementCpuNode(int cpu);
+int placementCurrentNode(void);
+int placementPinThread(int threadId, int numberOfThreads);
+int placementInterleave(void * start, size_t bytes);
+int placementPageNode(const void * address);
+double placementFractionOnNode(const void * start, size_t bytes, int node);
+PLACEMENT_PROBE * placementProbeCreate(int numberOfThreads, size_t totalBytes);
+void placementProbeRun(PLACEMENT_PROBE * probe, int threadId);
+void placementProbeReport(const PLACEMENT_PROBE * probe);
+void placementProbeDestroy(PLACEMENT_PROBE * probe);
+
+#endif
@@ -0,0 +1,418 @@
+/*  File:        ringBuffer.c
+    Description: Lock-free bounded MPMC ring buffer with futex parking
+    (see ringBuffer.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ringBuffer.h"
+
+#define TRUE 1
+#define FALSE 0
+
+// the slot header: whose turn the slot is (see ringBuffer.h)
+typedef struct {
+  atomic_size_t sequence;
+} RING_SLOT;
+
+#define SLOT(ring, position) \
+  ((RING_SLOT *) ((ring)->slots + ((position) & (ring)->mask) * (ring)->slotSize))
+#define SLOT_ITEM(slot) ((char *) (slot) + sizeof(RING_SLOT))
+
+static void cpuRelax(void);
+static unsigned int announceParking(atomic_uint * word);
+static void futexWait(atomic_uint * word, unsigned int value);
+static void futexWake(atomic_uint * word);
+static void wakeParked(atomic_uint * word);
+static int spinLimit(void);
+
+
+/*******************************************************************
+ * Function ringBufferCreate returns an empty ring of at least
+ * capacity items of itemSize bytes each.
+ ********************************************************************/
+RING_BUFFER * ringBufferCreate(size_t capacity, size_t itemSize) {
+  RING_BUFFER * ring;
+  size_t i;
+
+  if (posix_memalign((void **) &ring, RING_BUFFER_LINE, sizeof(RING_BUFFER)) != 0) {
+    printf("Could not allocate the ring buffer\n");
+    exit(-1);
+  } // end if
+  memset(ring, 0, sizeof(RING_BUFFER));
+  ring->capacity = 2;
+  while (ring->capacity < capacity) {
+    ring->capacity *= 2;
+  } // end while
+  ring->mask = ring->capacity - 1;
+  ring->itemSize = itemSize;
+  ring->slotSize = (sizeof(RING_SLOT) + itemSize + RING_BUFFER_LINE - 1)
+    / RING_BUFFER_LINE * RING_BUFFER_LINE;
+  if (posix_memalign((void **) &ring->slots, RING_BUFFER_LINE,
+		     ring->capacity * ring->slotSize) != 0) {
+    printf("Could not allocate %lu ring buffer slots\n", (unsigned long) ring->capacity);
+    exit(-1);
+  } // end if
+  for (i=0; i < ring->capacity; i++) {
+    atomic_init(&SLOT(ring, i)->sequence, i);
+  } // end for
+  atomic_init(&ring->enqueuePosition, 0);
+  atomic_init(&ring->dequeuePosition, 0);
+  atomic_init(&ring->notEmpty, 0);
+  atomic_init(&ring->notFull, 0);
+  return ring;
+} // end ringBufferCreate
+
+
+/*******************************************************************
+ * Function ringBufferTryPush copies item into the ring and returns 1,
+ * or returns 0 at once if the ring is full.
+ ********************************************************************/
+int ringBufferTryPush(RING_BUFFER * ring, const void * item) {
+  RING_SLOT * slot;
+  size_t position, sequence;
+
+  position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+  while (TRUE) {
+    slot = SLOT(ring, position);
+    sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence == position) {
+      // free for this ticket: claim it (a failed CAS reloads position)
+      if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position,
+						position + 1, memory_order_relaxed,
+						memory_order_relaxed)) {
+	break;
+      } // end if
+    } else if ((long) (sequence - position) < 0) {
+      return 0;  // the slot still holds the item from one lap ago: full
+    } else {
+      position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    } // end if
+  } // end while
+  memcpy(SLOT_ITEM(slot), item, ring->itemSize);
+  atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+  wakeParked(&ring->notEmpty);
+  return 1;
+} // end ringBufferTryPush
+
+
+/*******************************************************************
+ * Function ringBufferTryPop copies the oldest item out of the ring
+ * and returns 1, or returns 0 at once if the ring is empty.
+ ********************************************************************/
+int ringBufferTryPop(RING_BUFFER * ring, void * item) {
+  RING_SLOT * slot;
+  size_t position, sequence;
+
+  position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+  while (TRUE) {
+    slot = SLOT(ring, position);
+    sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence == position + 1) {
+      if (atomic_compare_exchange_weak_explicit(&ring->dequeuePosition, &position,
+						position + 1, memory_order_relaxed,
+						memory_order_relaxed)) {
+	break;
+      } // end if
+    } else if ((long) (sequence - (position + 1)) < 0) {
+      return 0;  // not yet published for this ticket: empty
+    } else {
+      position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+    } // end if
+  } // end while
+  memcpy(item, SLOT_ITEM(slot), ring->itemSize);
+  atomic_store_explicit(&slot->sequence, position + ring->capacity, memory_order_release);
+  wakeParked(&ring->notFull);
+  return 1;
+} // end ringBufferTryPop
+
+
+/*******************************************************************
+ * Function ringBufferPush copies item into the ring, waiting while it
+ * is full: spin first, then park until a consumer frees a slot.
+ ********************************************************************/
+void ringBufferPush(RING_BUFFER * ring, const void * item) {
+  int spin, spins = spinLimit();
+  unsigned int value;
+
+  for (spin=0; spin < spins; spin++) {
+    if (ringBufferTryPush(ring, item)) {
+      return;
+    } // end if
+    cpuRelax();
+  } // end for
+  while (TRUE) {
+    // announce the wait before the last try: a pop after this point
+    // sees the bit and changes the word, so the wait returns at once
+    value = announceParking(&ring->notFull);
+    if (ringBufferTryPush(ring, item)) {
+      return;
+    } // end if
+    futexWait(&ring->notFull, value);
+  } // end while
+} // end ringBufferPush
+
+
+/*******************************************************************
+ * Function ringBufferPop copies the oldest item out of the ring,
+ * waiting while it is empty: spin first, then park until a producer
+ * publishes an item.
+ ********************************************************************/
+void ringBufferPop(RING_BUFFER * ring, void * item) {
+  int spin, spins = spinLimit();
+  unsigned int value;
+
+  for (spin=0; spin < spins; spin++) {
+    if (ringBufferTryPop(ring, item)) {
+      return;
+    } // end if
+    cpuRelax();
+  } // end for
+  while (TRUE) {
+    value = announceParking(&ring->notEmpty);
+    if (ringBufferTryPop(ring, item)) {
+      return;
+    } // end if
+    futexWait(&ring->notEmpty, value);
+  } // end while
+} // end ringBufferPop
+
+
+/*******************************************************************
+ * Function ringBufferTryPushBatch copies up to count items (itemSize
+ * bytes apart) into the ring with one reservation -- the run of free
+ * slots at the enqueue position is claimed by a single CAS -- and
+ * returns how many went in, 0 at once if the ring is full.
+ ********************************************************************/
+int ringBufferTryPushBatch(RING_BUFFER * ring, const void * items, int count) {
+  RING_SLOT * slot;
+  size_t position, sequence;
+  int run, i;
+
+  position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+  while (TRUE) {
+    sequence = atomic_load_explicit(&SLOT(ring, position)->sequence, memory_order_acquire);
+    if (sequence == position) {
+      // tickets from position on are unclaimed: take the free run
+      for (run=1; run < count; run++) {
+	if (atomic_load_explicit(&SLOT(ring, position + run)->sequence,
+				 memory_order_acquire) != position + run) {
+	  break;
+	} // end if
+      } // end for
+      if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position,
+						position + run, memory_order_relaxed,
+						memory_order_relaxed)) {
+	break;
+      } // end if
+    } else if ((long) (sequence - position) < 0) {
+      return 0;
+    } else {
+      position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    } // end if
+  } // end while
+  for (i=0; i < run; i++) {
+    slot = SLOT(ring, position + i);
+    memcpy(SLOT_ITEM(slot), (const char *) items + (size_t) i*ring->itemSize,
+	   ring->itemSize);
+    atomic_store_explicit(&slot->sequence, position + i + 1, memory_order_release);
+  } // end for
+  wakeParked(&ring->notEmpty);
+  return run;
+} // end ringBufferTryPushBatch
+
+
+/*******************************************************************
+ * Function ringBufferTryPopBatch copies up to max of the oldest items
+ * out of the ring with one reservation and returns how many, 0 at
+ * once if the ring is empty.
+ ********************************************************************/
+int ringBufferTryPopBatch(RING_BUFFER * ring, void * items, int max) {
+  RING_SLOT * slot;
+  size_t position, sequence;
+  int run, i;
+
+  position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+  while (TRUE) {
+    sequence = atomic_load_explicit(&SLOT(ring, position)->sequence, memory_order_acquire);
+    if (sequence == position + 1) {
+      // take the run of published items
+      for (run=1; run < max; run++) {
+	if (atomic_load_explicit(&SLOT(ring, position + run)->sequence,
+				 memory_order_acquire) != position + run + 1) {
+	  break;
+	} // end if
+      } // end for
+      if (atomic_compare_exchange_weak_explicit(&ring->dequeuePosition, &position,
+						position + run, memory_order_relaxed,
+						memory_order_relaxed)) {
+	break;
+      } // end if
+    } else if ((long) (sequence - (position + 1)) < 0) {
+      return 0;
+    } else {
+      position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+    } // end if
+  } // end while
+  for (i=0; i < run; i++) {
+    slot = SLOT(ring, position + i);
+    memcpy((char *) items + (size_t) i*ring->itemSize, SLOT_ITEM(slot), ring->itemSize);
+    atomic_store_explicit(&slot->sequence, position + i + ring->capacity,
+			  memory_order_release);
+  } // end for
+  wakeParked(&ring->notFull);
+  return run;
+} // end ringBufferTryPopBatch
+
+
+/*******************************************************************
+ * Function ringBufferPushBatch copies all count items into the ring,
+ * as many per reservation as there are free slots, waiting (spin,
+ * then park) whenever it is full.
+ ********************************************************************/
+void ringBufferPushBatch(RING_BUFFER * ring, const void * items, int count) {
+  const char * next = (const char *) items;
+  int spin = 0, spins = spinLimit(), pushed;
+  unsigned int value;
+
+  while (count > 0) {
+    pushed = ringBufferTryPushBatch(ring, next, count);
+    if (pushed == 0 && spin < spins) {
+      spin++;
+      cpuRelax();
+      continue;
+    } // end if
+    if (pushed == 0) {
+      value = announceParking(&ring->notFull);
+      pushed = ringBufferTryPushBatch(ring, next, count);
+      if (pushed == 0) {
+	futexWait(&ring->notFull, value);
+	continue;
+      } // end if
+    } // end if
+    next += (size_t) pushed*ring->itemSize;
+    count -= pushed;
+    spin = 0;
+  } // end while
+} // end ringBufferPushBatch
+
+
+/*******************************************************************
+ * Function ringBufferPopBatch copies out between 1 and max of the
+ * oldest items with one reservation, waiting (spin, then park) while
+ * the ring is empty, and returns how many.
+ ********************************************************************/
+int ringBufferPopBatch(RING_BUFFER * ring, void * items, int max) {
+  int spin, spins = spinLimit(), popped;
+  unsigned int value;
+
+  for (spin=0; spin < spins; spin++) {
+    if ((popped = ringBufferTryPopBatch(ring, items, max)) > 0) {
+      return popped;
+    } // end if
+    cpuRelax();
+  } // end for
+  while (TRUE) {
+    value = announceParking(&ring->notEmpty);
+    if ((popped = ringBufferTryPopBatch(ring, items, max)) > 0) {
+      return popped;
+    } // end if
+    futexWait(&ring->notEmpty, value);
+  } // end while
+} // end ringBufferPopBatch
+
+
+/*******************************************************************
+ * Function ringBufferDestroy frees the ring (nobody may be using it).
+ ********************************************************************/
+void ringBufferDestroy(RING_BUFFER * ring) {
+  free(ring->slots);
+  free(ring);
+} // end ringBufferDestroy
+
+
+/*******************************************************************
+ * Function announceParking sets the parked bit of word and returns
+ * the value to sleep on.  The fence orders the bit before the slot
+ * loads of the caller's last try, pairing with the fence in
+ * wakeParked: without it the try could read a stale slot while the
+ * other side still reads the word without the bit, and nobody wakes.
+ ********************************************************************/
+static unsigned int announceParking(atomic_uint * word) {
+  unsigned int value = atomic_fetch_or(word, 1u) | 1u;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  return value;
+} // end announceParking
+
+
+/*******************************************************************
+ * Function wakeParked wakes the threads parked on the event count
+ * word if its low bit says somebody parked.  The count goes up by one
+ * with the bit cleared before the wake-up (a thread about to sleep
+ * then sees the change and tries again instead), so later calls skip
+ * the system call until somebody parks again; woken threads that
+ * find nothing park again.  The fence orders the slot just published
+ * before the load of word; with the fence in announceParking either
+ * this side sees the bit, or the parked thread's own try sees the
+ * slot.  The word is unsigned so the count wraps instead of overflowing.
+ ********************************************************************/
+static void wakeParked(atomic_uint * word) {
+  unsigned int value;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  value = atomic_load_explicit(word, memory_order_relaxed);
+  while (value & 1) {
+    if (atomic_compare_exchange_weak(word, &value, (value + 2) & ~1u)) {
+      futexWake(word);
+      return;
+    } // end if
+  } // end while
+} // end wakeParked
+
+
+/*******************************************************************
+ * Function cpuRelax - a polite pause inside a spin loop.
+ ********************************************************************/
+static void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  atomic_signal_fence(memory_order_seq_cst);
+#endif
+} // end cpuRelax
+
+
+/*******************************************************************
+ * Function futexWait sleeps while *word == value (returns at once if
+ * it already changed, or on a wake-up or signal).
+ ********************************************************************/
+static void futexWait(atomic_uint * word, unsigned int value) {
+  syscall(SYS_futex, (unsigned int *) word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+} // end futexWait
+
+
+/*******************************************************************
+ * Function futexWake wakes every thread sleeping on word.
+ ********************************************************************/
+static void futexWake(atomic_uint * word) {
+  syscall(SYS_futex, (unsigned int *) word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+} // end futexWake
+
+
+/*******************************************************************
+ * Function spinLimit returns RING_BUFFER_SPIN, or 0 on a single CPU
+ * where spinning only burns the time slice the other side needs.
+ ********************************************************************/
+static int spinLimit(void) {
+  static int cpus = 0;
+
+  if (cpus == 0) {
+    cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  return (cpus > 1) ? RING_BUFFER_SPIN : 0;
+} // end spinLimit
@@ -0,0 +1,63 @@
+/*  File:        ringBuffer.h
+    Description: Bounded multi-producer / multi-consumer ring buffer
+    without a lock, to replace the mutex + two condition variable
+    bounded buffers of the producer/consumer programs.
+    Each slot carries a sequence number that says whose turn it is:
+    slot i is free for the producer holding ticket pos when its
+    sequence is pos, and full for the consumer holding ticket pos when
+    it is pos+1.  A producer takes a ticket by compare-and-swap on the
+    enqueue position, copies its item in and publishes it by storing
+    pos+1 into the slot; consumers do the same on the dequeue position
+    and hand the slot back as pos+capacity.  Producers and consumers
+    only meet on the slot they hand over, never on a shared lock.
+    ringBufferPush / ringBufferPop block when the ring is full / empty:
+    they spin (RING_BUFFER_SPIN tries, none on a single CPU where the
+    other side cannot run meanwhile) and then park on a futex.  The
+    futex word is an event count whose low bit says somebody is
+    parked; the other side clears it and wakes the sleepers with one
+    system call, so a busy ring never enters the kernel and a parked
+    thread costs one wake-up, not one per item until it gets to run.
+    The batch calls move several items per reservation: one CAS claims
+    the whole run of free (or published) slots at the position, and
+    one wake-up check covers the batch, so small items cost a fraction
+    of a round trip each.  A consumer's batch may come back short:
+    it takes what is there, at least one item.
+    Items are copied in and out by value (itemSize bytes each); the
+    capacity is rounded up to a power of two.
+    Compile the program with:  -I../common ../common/ringBuffer.c -lpthread
+*/
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifndef RING_BUFFER_SPIN
+#define RING_BUFFER_SPIN 256   // tries before a blocked push / pop parks
+#endif
+#define RING_BUFFER_LINE 64    // cache line: the hot fields each get one
+
+typedef struct {
+  _Alignas(RING_BUFFER_LINE) atomic_size_t enqueuePosition;  // next producer ticket
+  _Alignas(RING_BUFFER_LINE) atomic_size_t dequeuePosition;  // next consumer ticket
+  _Alignas(RING_BUFFER_LINE) atomic_uint notEmpty;  // event count parked consumers sleep on
+  _Alignas(RING_BUFFER_LINE) atomic_uint notFull;   // event count parked producers sleep on
+  _Alignas(RING_BUFFER_LINE) size_t capacity;      // power of two
+  size_t mask;
+  size_t itemSize;
+  size_t slotSize;             // sequence + item, rounded up to a cache line
+  char * slots;
+} RING_BUFFER;
+
+RING_BUFFER * ringBufferCreate(size_t capacity, size_t itemSize);
+int ringBufferTryPush(RING_BUFFER * ring, const void * item);
+int ringBufferTryPop(RING_BUFFER * ring, void * item);
+void ringBufferPush(RING_BUFFER * ring, const void * item);
+void ringBufferPop(RING_BUFFER * ring, void * item);
+int ringBufferTryPushBatch(RING_BUFFER * ring, const void * items, int count);
+int ringBufferTryPopBatch(RING_BUFFER * ring, void * items, int max);
+void ringBufferPushBatch(RING_BUFFER * ring, const void * items, int count);
+int ringBufferPopBatch(RING_BUFFER * ring, void * items, int max);
+void ringBufferDestroy(RING_BUFFER * ring);
+
+#endif
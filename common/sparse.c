@@ -0,0 +1,617 @@
+/*  File:        sparse.c
+    Description: CSR/CSC sparse matrices with nonzero-balanced
+    multithreaded SpMV and SpGEMM (see sparse.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "matrixFile.h"
+#include "sparse.h"
+
+typedef struct {
+  const SPARSE_MATRIX * A;
+  const SPARSE_MATRIX * B;
+  SPARSE_MATRIX * C;
+  const double * x;
+  double * y;          // y (CSR) or this thread's private partial y (CSC)
+  int first;           // rows (columns for CSC SpMV) first .. last-1
+  int last;
+} SPARSE_TASK;
+
+static int threadCount(int numberOfThreads, int work);
+static void runThreads(void * (*body)(void *), SPARSE_TASK * tasks,
+		       int numberOfThreads);
+static void * threadMatVecCsr(void * args);
+static void * threadMatVecCsc(void * args);
+static void * threadCountProduct(void * args);
+static void * threadFillProduct(void * args);
+static SPARSE_MATRIX * multiplyCsr(const SPARSE_MATRIX * A, const SPARSE_MATRIX * B,
+				   int numberOfThreads);
+static int compareInt(const void * a, const void * b);
+
+
+/*******************************************************************
+ * Function allocateSparse allocates an empty sparse matrix with
+ * room for nnz nonzeros; start is zeroed.
+ ********************************************************************/
+SPARSE_MATRIX * allocateSparse(int format, int rows, int columns, long nnz) {
+  SPARSE_MATRIX * sparse;
+  int major = (format == SPARSE_CSR) ? rows : columns;
+
+  sparse = (SPARSE_MATRIX *) malloc(sizeof(SPARSE_MATRIX));
+  sparse->format = format;
+  sparse->rows = rows;
+  sparse->columns = columns;
+  sparse->nnz = nnz;
+  sparse->start = (long *) calloc(major+1, sizeof(long));
+  sparse->index = (int *) malloc(sizeof(int)*(nnz > 0 ? nnz : 1));
+  sparse->value = (double *) malloc(sizeof(double)*(nnz > 0 ? nnz : 1));
+  if (sparse->start == NULL || sparse->index == NULL || sparse->value == NULL) {
+    printf("Unable to allocate a sparse matrix with %ld nonzeros\n", nnz);
+    exit(-1);
+  } // end if
+
+  return sparse;
+} // end allocateSparse
+
+
+/*******************************************************************
+ * Function freeSparse deallocates a matrix from allocateSparse.
+ ********************************************************************/
+void freeSparse(SPARSE_MATRIX * sparse) {
+  if (sparse == NULL) {
+    return;
+  } // end if
+  free(sparse->start);
+  free(sparse->index);
+  free(sparse->value);
+  free(sparse);
+} // end freeSparse
+
+
+/*******************************************************************
+ * Function sparseFromMatrix returns the nonzeros of a dense matrix
+ * in the requested format.  Only exact zeros are dropped.
+ ********************************************************************/
+SPARSE_MATRIX * sparseFromMatrix(const MATRIX * dense, int format) {
+  SPARSE_MATRIX * csr, * converted;
+  const double * row;
+  long nnz = 0, k;
+  int r, c;
+
+  for (r=0; r < dense->rows; r++) {
+    row = MATRIX_ROW(dense, r);
+    for (c=0; c < dense->columns; c++) {
+      nnz += (row[c] != 0.0);
+    } // end for (c
+  } // end for (r
+
+  csr = allocateSparse(SPARSE_CSR, dense->rows, dense->columns, nnz);
+  for (r=0, k=0; r < dense->rows; r++) {
+    row = MATRIX_ROW(dense, r);
+    for (c=0; c < dense->columns; c++) {
+      if (row[c] != 0.0) {
+	csr->index[k] = c;
+	csr->value[k++] = row[c];
+      } // end if
+    } // end for (c
+    csr->start[r+1] = k;
+  } // end for (r
+
+  if (format == SPARSE_CSR) {
+    return csr;
+  } // end if
+  converted = sparseConvert(csr, format);
+  freeSparse(csr);
+  return converted;
+} // end sparseFromMatrix
+
+
+/*******************************************************************
+ * Function sparseToMatrix expands a sparse matrix to a dense one.
+ ********************************************************************/
+MATRIX * sparseToMatrix(const SPARSE_MATRIX * sparse) {
+  MATRIX * dense;
+  int major, majorCount = (sparse->format == SPARSE_CSR) ? sparse->rows
+    : sparse->columns;
+  long k;
+
+  dense = allocateMatrix(sparse->rows, sparse->columns);
+  memset(dense->data, 0, sizeof(double)*(size_t) dense->rows*dense->ld);
+  for (major=0; major < majorCount; major++) {
+    for (k=sparse->start[major]; k < sparse->start[major+1]; k++) {
+      if (sparse->format == SPARSE_CSR) {
+	MATRIX_ELEMENT(dense, major, sparse->index[k]) = sparse->value[k];
+      } else {
+	MATRIX_ELEMENT(dense, sparse->index[k], major) = sparse->value[k];
+      } // end if
+    } // end for (k
+  } // end for (major
+
+  return dense;
+} // end sparseToMatrix
+
+
+/*******************************************************************
+ * Function sparseConvert returns a copy of sparse in the requested
+ * format.  CSR <-> CSC is a counting-sort transpose of the arrays,
+ * so the indices come out ascending within each row/column.
+ ********************************************************************/
+SPARSE_MATRIX * sparseConvert(const SPARSE_MATRIX * sparse, int format) {
+  SPARSE_MATRIX * result;
+  long * next;
+  long k;
+  int major, minor, majorCount, minorCount;
+
+  result = allocateSparse(format, sparse->rows, sparse->columns, sparse->nnz);
+  majorCount = (sparse->format == SPARSE_CSR) ? sparse->rows : sparse->columns;
+  minorCount = (sparse->format == SPARSE_CSR) ? sparse->columns : sparse->rows;
+
+  if (format == sparse->format) {
+    memcpy(result->start, sparse->start, sizeof(long)*(majorCount+1));
+    memcpy(result->index, sparse->index, sizeof(int)*sparse->nnz);
+    memcpy(result->value, sparse->value, sizeof(double)*sparse->nnz);
+    return result;
+  } // end if
+
+  // count the nonzeros of each new major line, then prefix sum
+  for (k=0; k < sparse->nnz; k++) {
+    result->start[sparse->index[k]+1]++;
+  } // end for
+  for (minor=0; minor < minorCount; minor++) {
+    result->start[minor+1] += result->start[minor];
+  } // end for
+
+  next = (long *) malloc(sizeof(long)*(minorCount > 0 ? minorCount : 1));
+  memcpy(next, result->start, sizeof(long)*minorCount);
+  for (major=0; major < majorCount; major++) {
+    for (k=sparse->start[major]; k < sparse->start[major+1]; k++) {
+      minor = sparse->index[k];
+      result->index[next[minor]] = major;
+      result->value[next[minor]++] = sparse->value[k];
+    } // end for (k
+  } // end for (major
+
+  free(next);
+  return result;
+} // end sparseConvert
+
+
+/*******************************************************************
+ * Function readSparseFile reads a write2DArray (or matrixFile.h
+ * version 1) file through a read-only mapping and returns its
+ * nonzeros in the requested format, or NULL if it can't be read.
+ ********************************************************************/
+SPARSE_MATRIX * readSparseFile(const char * fileName, int format) {
+  MATRIX_FILE * file;
+  SPARSE_MATRIX * sparse;
+
+  if ((file = mapMatrixFile(fileName)) == NULL) {
+    return NULL;
+  } // end if
+  sparse = sparseFromMatrix(&file->matrix, format);
+  unmapMatrixFile(file);
+
+  return sparse;
+} // end readSparseFile
+
+
+/*******************************************************************
+ * Function writeSparseFile writes sparse to fileName in the layout
+ * write2DArray uses (int rows, int columns, then the dense rows).
+ * Returns 1 on success.
+ ********************************************************************/
+int writeSparseFile(const SPARSE_MATRIX * sparse, const char * fileName) {
+  FILE * outputFilePtr;
+  SPARSE_MATRIX * csr = NULL;
+  const SPARSE_MATRIX * rows = sparse;
+  double * row;
+  long k;
+  int r, ok;
+
+  if ((outputFilePtr = fopen(fileName, "wb")) == NULL) {
+    printf("%s cannot be opened for writing\n", fileName);
+    return 0;
+  } // end if
+  if (sparse->format == SPARSE_CSC) {
+    rows = csr = sparseConvert(sparse, SPARSE_CSR);
+  } // end if
+
+  row = (double *) calloc(rows->columns > 0 ? rows->columns : 1, sizeof(double));
+  ok = (fwrite(&rows->rows, sizeof(int), 1, outputFilePtr) == 1
+	&& fwrite(&rows->columns, sizeof(int), 1, outputFilePtr) == 1);
+  for (r=0; ok && r < rows->rows; r++) {
+    for (k=rows->start[r]; k < rows->start[r+1]; k++) {
+      row[rows->index[k]] = rows->value[k];
+    } // end for (k
+    ok = (fwrite(row, sizeof(double), rows->columns, outputFilePtr)
+	  == (size_t) rows->columns);
+    for (k=rows->start[r]; k < rows->start[r+1]; k++) {
+      row[rows->index[k]] = 0.0;
+    } // end for (k
+  } // end for (r
+
+  if (fclose(outputFilePtr) != 0 || !ok) {
+    printf("%s could not be written\n", fileName);
+    ok = 0;
+  } // end if
+  free(row);
+  freeSparse(csr);
+  return ok;
+} // end writeSparseFile
+
+
+/*******************************************************************
+ * Function sparsePartition splits items 0 .. count-1 into parts
+ * contiguous ranges of about equal weight, where prefix[i] is the
+ * total weight of the items before i (count+1 entries, like start).
+ * Part p is items bounds[p] .. bounds[p+1]-1.
+ ********************************************************************/
+void sparsePartition(const long * prefix, int count, int parts, int * bounds) {
+  long total = prefix[count] - prefix[0], target;
+  int p, low, high, middle;
+
+  bounds[0] = 0;
+  for (p=1; p < parts; p++) {
+    // first item whose preceding weight reaches p/parts of the total
+    target = prefix[0] + (long) ((double) total * p / parts);
+    low = bounds[p-1];
+    high = count;
+    while (low < high) {
+      middle = low + (high - low) / 2;
+      if (prefix[middle] < target) {
+	low = middle + 1;
+      } else {
+	high = middle;
+      } // end if
+    } // end while
+    bounds[p] = low;
+  } // end for
+  bounds[parts] = count;
+} // end sparsePartition
+
+
+/*******************************************************************
+ * Function sparseMatVec computes y = A*x with numberOfThreads
+ * threads (<= 0 means one per core).  Each thread gets a range of
+ * rows (CSR) or columns (CSC) with about nnz/numberOfThreads
+ * nonzeros; CSC threads scatter into private copies of y that are
+ * summed at the end.
+ ********************************************************************/
+void sparseMatVec(const SPARSE_MATRIX * A, const double * x, double * y,
+		  int numberOfThreads) {
+  SPARSE_TASK * tasks;
+  int * bounds;
+  int major = (A->format == SPARSE_CSR) ? A->rows : A->columns;
+  int i, t;
+
+  numberOfThreads = threadCount(numberOfThreads, major);
+  tasks = (SPARSE_TASK *) calloc(numberOfThreads, sizeof(SPARSE_TASK));
+  bounds = (int *) malloc(sizeof(int)*(numberOfThreads+1));
+  sparsePartition(A->start, major, numberOfThreads, bounds);
+
+  for (t=0; t < numberOfThreads; t++) {
+    tasks[t].A = A;
+    tasks[t].x = x;
+    tasks[t].y = (A->format == SPARSE_CSR || t == 0) ? y
+      : (double *) malloc(sizeof(double)*(A->rows > 0 ? A->rows : 1));
+    tasks[t].first = bounds[t];
+    tasks[t].last = bounds[t+1];
+  } // end for
+  runThreads((A->format == SPARSE_CSR) ? threadMatVecCsr : threadMatVecCsc,
+	     tasks, numberOfThreads);
+
+  if (A->format == SPARSE_CSC) {
+    for (t=1; t < numberOfThreads; t++) {
+      for (i=0; i < A->rows; i++) {
+	y[i] += tasks[t].y[i];
+      } // end for (i
+      free(tasks[t].y);
+    } // end for (t
+  } // end if
+  free(bounds);
+  free(tasks);
+} // end sparseMatVec
+
+
+/*******************************************************************
+ * Function sparseMatMul returns C = A*B with numberOfThreads threads
+ * (<= 0 means one per core): CSC if both operands are CSC, else CSR.
+ * Entries that cancel to 0.0 stay stored.
+ ********************************************************************/
+SPARSE_MATRIX * sparseMatMul(const SPARSE_MATRIX * A, const SPARSE_MATRIX * B,
+			     int numberOfThreads) {
+  SPARSE_MATRIX * C, * csrA = NULL, * csrB = NULL;
+  SPARSE_MATRIX transposeA, transposeB;
+  int swap;
+
+  if (A->columns != B->rows) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
+
+  if (A->format == SPARSE_CSC && B->format == SPARSE_CSC) {
+    // CSC arrays are the CSR arrays of the transpose: C' = B'*A'
+    transposeA = *A;
+    transposeA.format = SPARSE_CSR;
+    transposeA.rows = A->columns;
+    transposeA.columns = A->rows;
+    transposeB = *B;
+    transposeB.format = SPARSE_CSR;
+    transposeB.rows = B->columns;
+    transposeB.columns = B->rows;
+    C = multiplyCsr(&transposeB, &transposeA, numberOfThreads);
+    C->format = SPARSE_CSC;
+    swap = C->rows;
+    C->rows = C->columns;
+    C->columns = swap;
+    return C;
+  } // end if
+
+  if (A->format == SPARSE_CSC) {
+    A = csrA = sparseConvert(A, SPARSE_CSR);
+  } // end if
+  if (B->format == SPARSE_CSC) {
+    B = csrB = sparseConvert(B, SPARSE_CSR);
+  } // end if
+  C = multiplyCsr(A, B, numberOfThreads);
+  freeSparse(csrA);
+  freeSparse(csrB);
+  return C;
+} // end sparseMatMul
+
+
+/*******************************************************************
+ * Function multiplyCsr is Gustavson's C = A*B on CSR operands in
+ * two passes over the same row partition: count the nonzeros of
+ * each row of C, then (after a prefix sum sizes C) fill them in.
+ * Rows are balanced on multiply-adds: row r of A costs the sum of
+ * the lengths of the rows of B its nonzeros select.
+ ********************************************************************/
+static SPARSE_MATRIX * multiplyCsr(const SPARSE_MATRIX * A, const SPARSE_MATRIX * B,
+				   int numberOfThreads) {
+  SPARSE_MATRIX * C;
+  SPARSE_TASK * tasks;
+  long * work;
+  int * bounds;
+  long k;
+  int r, t;
+
+  work = (long *) malloc(sizeof(long)*(A->rows+1));
+  work[0] = 0;
+  for (r=0; r < A->rows; r++) {
+    work[r+1] = work[r] + 1;  // + 1: even an empty row costs a little
+    for (k=A->start[r]; k < A->start[r+1]; k++) {
+      work[r+1] += B->start[A->index[k]+1] - B->start[A->index[k]];
+    } // end for (k
+  } // end for (r
+
+  numberOfThreads = threadCount(numberOfThreads, A->rows);
+  tasks = (SPARSE_TASK *) calloc(numberOfThreads, sizeof(SPARSE_TASK));
+  bounds = (int *) malloc(sizeof(int)*(numberOfThreads+1));
+  sparsePartition(work, A->rows, numberOfThreads, bounds);
+
+  C = allocateSparse(SPARSE_CSR, A->rows, B->columns, 0);
+  for (t=0; t < numberOfThreads; t++) {
+    tasks[t].A = A;
+    tasks[t].B = B;
+    tasks[t].C = C;
+    tasks[t].first = bounds[t];
+    tasks[t].last = bounds[t+1];
+  } // end for
+
+  runThreads(threadCountProduct, tasks, numberOfThreads);  // C->start[r+1] = row length
+  for (r=0; r < C->rows; r++) {
+    C->start[r+1] += C->start[r];
+  } // end for
+  C->nnz = C->start[C->rows];
+  free(C->index);
+  free(C->value);
+  C->index = (int *) malloc(sizeof(int)*(C->nnz > 0 ? C->nnz : 1));
+  C->value = (double *) malloc(sizeof(double)*(C->nnz > 0 ? C->nnz : 1));
+  if (C->index == NULL || C->value == NULL) {
+    printf("Unable to allocate a sparse product with %ld nonzeros\n", C->nnz);
+    exit(-1);
+  } // end if
+  runThreads(threadFillProduct, tasks, numberOfThreads);
+
+  free(work);
+  free(bounds);
+  free(tasks);
+  return C;
+} // end multiplyCsr
+
+
+/*******************************************************************
+ * Function threadMatVecCsr - thread body: y[r] for its rows.
+ ********************************************************************/
+static void * threadMatVecCsr(void * args) {
+  SPARSE_TASK * task = (SPARSE_TASK *) args;
+  const SPARSE_MATRIX * A = task->A;
+  const double * x = task->x;
+  double sum;
+  long k;
+  int r;
+
+  for (r=task->first; r < task->last; r++) {
+    sum = 0.0;
+    for (k=A->start[r]; k < A->start[r+1]; k++) {
+      sum += A->value[k] * x[A->index[k]];
+    } // end for (k
+    task->y[r] = sum;
+  } // end for (r
+
+  return NULL;
+} // end threadMatVecCsr
+
+
+/*******************************************************************
+ * Function threadMatVecCsc - thread body: scatters its columns'
+ * contributions into its own (zeroed) copy of y.
+ ********************************************************************/
+static void * threadMatVecCsc(void * args) {
+  SPARSE_TASK * task = (SPARSE_TASK *) args;
+  const SPARSE_MATRIX * A = task->A;
+  double * y = task->y;
+  double xc;
+  long k;
+  int c;
+
+  memset(y, 0, sizeof(double)*A->rows);
+  for (c=task->first; c < task->last; c++) {
+    xc = task->x[c];
+    for (k=A->start[c]; k < A->start[c+1]; k++) {
+      y[A->index[k]] += A->value[k] * xc;
+    } // end for (k
+  } // end for (c
+
+  return NULL;
+} // end threadMatVecCsc
+
+
+/*******************************************************************
+ * Function threadCountProduct - thread body, first pass: the #
+ * distinct columns of each of its rows of C, into C->start[r+1].
+ ********************************************************************/
+static void * threadCountProduct(void * args) {
+  SPARSE_TASK * task = (SPARSE_TASK *) args;
+  const SPARSE_MATRIX * A = task->A, * B = task->B;
+  int * marker;
+  long k, kb, count;
+  int r, c;
+
+  marker = (int *) malloc(sizeof(int)*(B->columns > 0 ? B->columns : 1));
+  for (c=0; c < B->columns; c++) {
+    marker[c] = -1;
+  } // end for
+
+  for (r=task->first; r < task->last; r++) {
+    count = 0;
+    for (k=A->start[r]; k < A->start[r+1]; k++) {
+      for (kb=B->start[A->index[k]]; kb < B->start[A->index[k]+1]; kb++) {
+	if (marker[B->index[kb]] != r) {
+	  marker[B->index[kb]] = r;
+	  count++;
+	} // end if
+      } // end for (kb
+    } // end for (k
+    task->C->start[r+1] = count;
+  } // end for (r
+
+  free(marker);
+  return NULL;
+} // end threadCountProduct
+
+
+/*******************************************************************
+ * Function threadFillProduct - thread body, second pass: each row
+ * of C is accumulated in a dense row with a list of the columns
+ * touched, then written out in column order.
+ ********************************************************************/
+static void * threadFillProduct(void * args) {
+  SPARSE_TASK * task = (SPARSE_TASK *) args;
+  const SPARSE_MATRIX * A = task->A, * B = task->B;
+  SPARSE_MATRIX * C = task->C;
+  double * accumulator, a;
+  int * marker, * touched;
+  long k, kb, out;
+  int r, c, j, count;
+
+  accumulator = (double *) malloc(sizeof(double)*(B->columns > 0 ? B->columns : 1));
+  marker = (int *) malloc(sizeof(int)*(B->columns > 0 ? B->columns : 1));
+  touched = (int *) malloc(sizeof(int)*(B->columns > 0 ? B->columns : 1));
+  for (c=0; c < B->columns; c++) {
+    marker[c] = -1;
+  } // end for
+
+  for (r=task->first; r < task->last; r++) {
+    count = 0;
+    for (k=A->start[r]; k < A->start[r+1]; k++) {
+      a = A->value[k];
+      for (kb=B->start[A->index[k]]; kb < B->start[A->index[k]+1]; kb++) {
+	j = B->index[kb];
+	if (marker[j] != r) {
+	  marker[j] = r;
+	  accumulator[j] = a * B->value[kb];
+	  touched[count++] = j;
+	} else {
+	  accumulator[j] += a * B->value[kb];
+	} // end if
+      } // end for (kb
+    } // end for (k
+
+    out = C->start[r];
+    if (count > B->columns / 8) {
+      // a dense row: a scan of the marker beats sorting the list
+      for (c=0; c < B->columns; c++) {
+	if (marker[c] == r) {
+	  C->index[out] = c;
+	  C->value[out++] = accumulator[c];
+	} // end if
+      } // end for (c
+    } else {
+      qsort(touched, count, sizeof(int), compareInt);
+      for (c=0; c < count; c++) {
+	C->index[out] = touched[c];
+	C->value[out++] = accumulator[touched[c]];
+      } // end for (c
+    } // end if
+  } // end for (r
+
+  free(accumulator);
+  free(marker);
+  free(touched);
+  return NULL;
+} // end threadFillProduct
+
+
+/*******************************************************************
+ * Function threadCount returns the # threads to use for work items:
+ * numberOfThreads (<= 0 means one per core), but at least 1 and no
+ * more than work.
+ ********************************************************************/
+static int threadCount(int numberOfThreads, int work) {
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  if (numberOfThreads > work) {
+    numberOfThreads = work;
+  } // end if
+  return (numberOfThreads < 1) ? 1 : numberOfThreads;
+} // end threadCount
+
+
+/*******************************************************************
+ * Function runThreads runs body on each task in its own thread and
+ * waits for them all.
+ ********************************************************************/
+static void runThreads(void * (*body)(void *), SPARSE_TASK * tasks,
+		       int numberOfThreads) {
+  pthread_t * threadHandles;
+  int i, errorCode;
+
+  threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+  for (i=0; i < numberOfThreads; i++) {
+    if ((errorCode = pthread_create(&threadHandles[i], NULL, body, &tasks[i])) != 0) {
+      printf("pthread %d failed to be created with error code %d\n", i, errorCode);
+      exit(-1);
+    } // end if
+  } // end for
+
+  for (i=0; i < numberOfThreads; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+  } // end for
+  free(threadHandles);
+} // end runThreads
+
+
+/*******************************************************************
+ * Function compareInt orders ints for qsort.
+ ********************************************************************/
+static int compareInt(const void * a, const void * b) {
+  int first = *(const int *) a, second = *(const int *) b;
+
+  return (first > second) - (first < second);
+} // end compareInt
@@ -0,0 +1,51 @@
+/*  File:        sparse.h
+    Description: Compressed sparse matrices of doubles for the mostly
+    zero inputs the dense kernels waste their time on.
+      CSR - start[r] .. start[r+1]-1 are the nonzeros of row r; index
+            holds their column #s (ascending) and value their values
+      CSC - the same arrays by column: index holds row #s
+    A CSC matrix is laid out exactly like the CSR form of its
+    transpose, which is what sparseConvert and sparseMatMul lean on.
+    readSparseFile / writeSparseFile convert from and to the binary
+    files write2DArray (lab5/writeRandom2DArray.c) writes, so the
+    dense and sparse programs share their inputs.
+    sparseMatVec (y = A*x) and sparseMatMul (C = A*B, Gustavson's
+    row-by-row product) run on pthreads that each get a contiguous
+    range of rows holding about the same # of nonzeros (for the
+    multiply: multiply-adds), not the same # of rows, so a few dense
+    rows can't leave the other threads idle.
+    Compile the program with:  -I../common ../common/sparse.c
+      ../common/matrixFile.c ../common/matrix.c -lpthread
+*/
+#ifndef _SPARSE_H_
+#define _SPARSE_H_
+
+#include "matrix.h"
+
+#define SPARSE_CSR 0
+#define SPARSE_CSC 1
+
+typedef struct {
+  int format;      // SPARSE_CSR or SPARSE_CSC
+  int rows;
+  int columns;
+  long nnz;        // # stored nonzeros
+  long * start;    // rows+1 (CSR) or columns+1 (CSC) offsets into index/value
+  int * index;     // column # (CSR) or row # (CSC) of each nonzero
+  double * value;
+} SPARSE_MATRIX;
+
+SPARSE_MATRIX * allocateSparse(int format, int rows, int columns, long nnz);
+void freeSparse(SPARSE_MATRIX * sparse);
+SPARSE_MATRIX * sparseFromMatrix(const MATRIX * dense, int format);
+MATRIX * sparseToMatrix(const SPARSE_MATRIX * sparse);
+SPARSE_MATRIX * sparseConvert(const SPARSE_MATRIX * sparse, int format);
+SPARSE_MATRIX * readSparseFile(const char * fileName, int format);
+int writeSparseFile(const SPARSE_MATRIX * sparse, const char * fileName);
+void sparsePartition(const long * prefix, int count, int parts, int * bounds);
+void sparseMatVec(const SPARSE_MATRIX * A, const double * x, double * y,
+		  int numberOfThreads);
+SPARSE_MATRIX * sparseMatMul(const SPARSE_MATRIX * A, const SPARSE_MATRIX * B,
+			     int numberOfThreads);
+
+#endif
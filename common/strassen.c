@@ -0,0 +1,325 @@
+/*  File:        strassen.c
+    Description: Strassen-Winograd multiply (see strassen.h).  With
+    A, B and C split into quadrants the Winograd form is
+      S1 = A21 + A22   S2 = S1 - A11   S3 = A11 - A21   S4 = A12 - S2
+      T1 = B12 - B11   T2 = B22 - T1   T3 = B22 - B12   T4 = T2 - B21
+      P1 = A11 B11  P2 = A12 B21  P3 = S4 B22  P4 = A22 T4
+      P5 = S1 T1    P6 = S2 T2    P7 = S3 T3
+      U2 = P1 + P6  U3 = U2 + P7
+      C11 = P1 + P2   C12 = U2 + P5 + P3   C21 = U3 - P4   C22 = U3 + P5
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "matrix.h"
+#include "gemm.h"
+#include "threadPool.h"
+#include "strassen.h"
+
+// one of the seven products: dest = left * right, with its own arena
+typedef struct {
+  const double * left;
+  int ldl;
+  const double * right;
+  int ldr;
+  double * dest;
+  int ldd;
+  ARENA arena;
+} PRODUCT;
+
+typedef struct {
+  int n;
+  int cutoff;
+  PRODUCT products[7];
+} PRODUCT_JOB;
+
+static size_t quadrantSize(int h);
+static size_t sequentialScratch(int n, int cutoff);
+static double * arenaAlloc(ARENA * arena, size_t count);
+static void addBlocks(int n, const double * X, int ldx, const double * Y,
+		      int ldy, double * Z, int ldz, double sign);
+static void classicMultiply(int n, const double * A, int lda, const double * B,
+			    int ldb, double * C, int ldc, ARENA * arena);
+static size_t classicScratch(int n);
+static void winograd(int n, const double * A, int lda, const double * B,
+		     int ldb, double * C, int ldc, int cutoff, ARENA * arena);
+static void productTask(void * args, int task, int threadId);
+
+
+/*******************************************************************
+ * Function strassenScratchSize returns the # doubles of arena the
+ * recursion needs: 2 quadrant temporaries per sequential level and
+ * the packing buffers of the classic kernel at the leaf, or 11
+ * quadrants at a parallel top level (S1-S4, T1-T4, P1, P6, P7) plus
+ * a sequential arena for each of the seven products.
+ ********************************************************************/
+size_t strassenScratchSize(int n, int cutoff, int parallel) {
+  int h = n / 2;
+
+  if (parallel && n > cutoff && n % 2 == 0) {
+    return 11*quadrantSize(h) + 7*sequentialScratch(h, cutoff);
+  } // end if
+  return sequentialScratch(n, cutoff);
+} // end strassenScratchSize
+
+
+/*******************************************************************
+ * Function strassenMultiply computes C = A*B for n x n matrices.
+ * Given a pool of more than one thread the seven top-level products
+ * run on it in parallel; with NULL the whole recursion is sequential.
+ ********************************************************************/
+void strassenMultiply(int n, const double * A, int lda, const double * B,
+		      int ldb, double * C, int ldc, int cutoff,
+		      THREAD_POOL * pool) {
+  int h = n / 2;
+  int parallel = (pool != NULL && pool->numberOfThreads > 1
+		  && n > cutoff && n % 2 == 0);
+  ARENA arena;
+  PRODUCT_JOB job;
+  const double * A11, * A12, * A21, * A22, * B11, * B12, * B21, * B22;
+  double * C11, * C12, * C21, * C22;
+  double * S1, * S2, * S3, * S4, * T1, * T2, * T3, * T4, * P1, * P6, * P7;
+  int i;
+
+  arena.size = strassenScratchSize(n, cutoff, parallel);
+  arena.used = 0;
+  arena.base = allocateAligned(arena.size);
+
+  if (!parallel) {
+    winograd(n, A, lda, B, ldb, C, ldc, cutoff, &arena);
+    free(arena.base);
+    return;
+  } // end if
+
+  A11 = A;  A12 = A + h;  A21 = A + (size_t) h*lda;  A22 = A21 + h;
+  B11 = B;  B12 = B + h;  B21 = B + (size_t) h*ldb;  B22 = B21 + h;
+  C11 = C;  C12 = C + h;  C21 = C + (size_t) h*ldc;  C22 = C21 + h;
+
+  S1 = arenaAlloc(&arena, quadrantSize(h));
+  S2 = arenaAlloc(&arena, quadrantSize(h));
+  S3 = arenaAlloc(&arena, quadrantSize(h));
+  S4 = arenaAlloc(&arena, quadrantSize(h));
+  T1 = arenaAlloc(&arena, quadrantSize(h));
+  T2 = arenaAlloc(&arena, quadrantSize(h));
+  T3 = arenaAlloc(&arena, quadrantSize(h));
+  T4 = arenaAlloc(&arena, quadrantSize(h));
+  P1 = arenaAlloc(&arena, quadrantSize(h));
+  P6 = arenaAlloc(&arena, quadrantSize(h));
+  P7 = arenaAlloc(&arena, quadrantSize(h));
+
+  addBlocks(h, A21, lda, A22, lda, S1, h, +1.0);
+  addBlocks(h, S1, h, A11, lda, S2, h, -1.0);
+  addBlocks(h, A11, lda, A21, lda, S3, h, -1.0);
+  addBlocks(h, A12, lda, S2, h, S4, h, -1.0);
+  addBlocks(h, B12, ldb, B11, ldb, T1, h, -1.0);
+  addBlocks(h, B22, ldb, T1, h, T2, h, -1.0);
+  addBlocks(h, B22, ldb, B12, ldb, T3, h, -1.0);
+  addBlocks(h, T2, h, B21, ldb, T4, h, -1.0);
+
+  // P2..P5 land directly in the C quadrants they feed
+  job.n = h;
+  job.cutoff = cutoff;
+  job.products[0] = (PRODUCT) {.left = A11, .ldl = lda, .right = B11, .ldr = ldb,
+			       .dest = P1, .ldd = h};
+  job.products[1] = (PRODUCT) {.left = A12, .ldl = lda, .right = B21, .ldr = ldb,
+			       .dest = C11, .ldd = ldc};
+  job.products[2] = (PRODUCT) {.left = S4, .ldl = h, .right = B22, .ldr = ldb,
+			       .dest = C12, .ldd = ldc};
+  job.products[3] = (PRODUCT) {.left = A22, .ldl = lda, .right = T4, .ldr = h,
+			       .dest = C21, .ldd = ldc};
+  job.products[4] = (PRODUCT) {.left = S1, .ldl = h, .right = T1, .ldr = h,
+			       .dest = C22, .ldd = ldc};
+  job.products[5] = (PRODUCT) {.left = S2, .ldl = h, .right = T2, .ldr = h,
+			       .dest = P6, .ldd = h};
+  job.products[6] = (PRODUCT) {.left = S3, .ldl = h, .right = T3, .ldr = h,
+			       .dest = P7, .ldd = h};
+  for (i=0; i < 7; i++) {
+    job.products[i].arena.size = sequentialScratch(h, cutoff);
+    job.products[i].arena.used = 0;
+    job.products[i].arena.base = arenaAlloc(&arena, job.products[i].arena.size);
+  } // end for
+
+  threadPoolRun(pool, 7, productTask, &job);
+
+  addBlocks(h, P6, h, P1, h, P6, h, +1.0);     // U2
+  addBlocks(h, P7, h, P6, h, P7, h, +1.0);     // U3
+  addBlocks(h, C11, ldc, P1, h, C11, ldc, +1.0);
+  addBlocks(h, C12, ldc, P6, h, C12, ldc, +1.0);
+  addBlocks(h, C12, ldc, C22, ldc, C12, ldc, +1.0);
+  addBlocks(h, P7, h, C21, ldc, C21, ldc, -1.0);
+  addBlocks(h, C22, ldc, P7, h, C22, ldc, +1.0);
+
+  free(arena.base);
+
+} // end strassenMultiply
+
+
+/*******************************************************************
+ * Function productTask is a thread pool task computing one of the
+ * seven top-level products with the sequential recursion.
+ ********************************************************************/
+static void productTask(void * args, int task, int threadId) {
+  PRODUCT_JOB * job = (PRODUCT_JOB *) args;
+  PRODUCT * product = &job->products[task];
+
+  (void) threadId;  // each product carries its own arena
+
+  winograd(job->n, product->left, product->ldl, product->right, product->ldr,
+	   product->dest, product->ldd, job->cutoff, &product->arena);
+
+} // end productTask
+
+
+/*******************************************************************
+ * Function winograd computes C = A*B sequentially with the schedule
+ * of Boyer, Dumas, Pernet and Zhou that needs only two quadrant
+ * temporaries per level: X for A-side sums and Y for B-side sums.
+ ********************************************************************/
+static void winograd(int n, const double * A, int lda, const double * B,
+		     int ldb, double * C, int ldc, int cutoff, ARENA * arena) {
+  int h = n / 2;
+  size_t mark;
+  const double * A11, * A12, * A21, * A22, * B11, * B12, * B21, * B22;
+  double * C11, * C12, * C21, * C22, * X, * Y;
+
+  if (n <= cutoff || n % 2 != 0) {
+    classicMultiply(n, A, lda, B, ldb, C, ldc, arena);
+    return;
+  } // end if
+
+  A11 = A;  A12 = A + h;  A21 = A + (size_t) h*lda;  A22 = A21 + h;
+  B11 = B;  B12 = B + h;  B21 = B + (size_t) h*ldb;  B22 = B21 + h;
+  C11 = C;  C12 = C + h;  C21 = C + (size_t) h*ldc;  C22 = C21 + h;
+
+  mark = arena->used;
+  X = arenaAlloc(arena, quadrantSize(h));
+  Y = arenaAlloc(arena, quadrantSize(h));
+
+  addBlocks(h, A11, lda, A21, lda, X, h, -1.0);              // S3
+  addBlocks(h, B22, ldb, B12, ldb, Y, h, -1.0);              // T3
+  winograd(h, X, h, Y, h, C21, ldc, cutoff, arena);          // P7
+  addBlocks(h, A21, lda, A22, lda, X, h, +1.0);              // S1
+  addBlocks(h, B12, ldb, B11, ldb, Y, h, -1.0);              // T1
+  winograd(h, X, h, Y, h, C22, ldc, cutoff, arena);          // P5
+  addBlocks(h, X, h, A11, lda, X, h, -1.0);                  // S2
+  addBlocks(h, B22, ldb, Y, h, Y, h, -1.0);                  // T2
+  winograd(h, X, h, Y, h, C12, ldc, cutoff, arena);          // P6
+  addBlocks(h, A12, lda, X, h, X, h, -1.0);                  // S4
+  winograd(h, X, h, B22, ldb, C11, ldc, cutoff, arena);      // P3
+  winograd(h, A11, lda, B11, ldb, X, h, cutoff, arena);      // P1
+  addBlocks(h, X, h, C12, ldc, C12, ldc, +1.0);              // U2 = P1 + P6
+  addBlocks(h, C12, ldc, C21, ldc, C21, ldc, +1.0);          // U3 = U2 + P7
+  addBlocks(h, C12, ldc, C22, ldc, C12, ldc, +1.0);          // U4 = U2 + P5
+  addBlocks(h, C21, ldc, C22, ldc, C22, ldc, +1.0);          // C22 = U3 + P5
+  addBlocks(h, C12, ldc, C11, ldc, C12, ldc, +1.0);          // C12 = U4 + P3
+  addBlocks(h, Y, h, B21, ldb, Y, h, -1.0);                  // T4
+  winograd(h, A22, lda, Y, h, C11, ldc, cutoff, arena);      // P4
+  addBlocks(h, C21, ldc, C11, ldc, C21, ldc, -1.0);          // C21 = U3 - P4
+  winograd(h, A12, lda, B21, ldb, C11, ldc, cutoff, arena);  // P2
+  addBlocks(h, X, h, C11, ldc, C11, ldc, +1.0);              // C11 = P1 + P2
+
+  arena->used = mark;
+
+} // end winograd
+
+
+/*******************************************************************
+ * Function classicMultiply is the base case: the tiled O(n^3) kernel
+ * with the best SIMD micro-kernel for this CPU, packing into buffers
+ * taken from the arena.
+ ********************************************************************/
+static void classicMultiply(int n, const double * A, int lda, const double * B,
+			    int ldb, double * C, int ldc, ARENA * arena) {
+  GEMM_BLOCKING blocking;
+  size_t mark = arena->used;
+  double * workspace;
+
+  gemmDefaultBlocking(&blocking);
+  workspace = arenaAlloc(arena, classicScratch(n));
+  gemmPackedWorkspace(n, n, n, A, lda, B, ldb, C, ldc, &blocking,
+		      gemmBestKernel(), workspace);
+  arena->used = mark;
+
+} // end classicMultiply
+
+
+/*******************************************************************
+ * Function classicScratch returns the # doubles of packing buffers
+ * classicMultiply(n) takes from the arena.
+ ********************************************************************/
+static size_t classicScratch(int n) {
+  GEMM_BLOCKING blocking;
+
+  gemmDefaultBlocking(&blocking);
+  return gemmWorkspaceSize(n, n, &blocking, gemmBestKernel());
+} // end classicScratch
+
+
+/*******************************************************************
+ * Function addBlocks computes Z = X + sign*Y for n x n blocks.
+ * Z may be the same block as X or Y.
+ ********************************************************************/
+static void addBlocks(int n, const double * X, int ldx, const double * Y,
+		      int ldy, double * Z, int ldz, double sign) {
+  int i, j;
+  const double * x;
+  const double * y;
+  double * z;
+
+  for (i=0; i < n; i++) {
+    x = X + (size_t) i*ldx;
+    y = Y + (size_t) i*ldy;
+    z = Z + (size_t) i*ldz;
+    if (sign > 0.0) {
+      for (j=0; j < n; j++) {
+	z[j] = x[j] + y[j];
+      } // end for (j
+    } else {
+      for (j=0; j < n; j++) {
+	z[j] = x[j] - y[j];
+      } // end for (j
+    } // end if
+  } // end for (i
+
+} // end addBlocks
+
+
+/*******************************************************************
+ * Function quadrantSize returns the arena footprint of an h x h
+ * temporary, rounded to whole cache lines to keep blocks aligned.
+ ********************************************************************/
+static size_t quadrantSize(int h) {
+  size_t perLine = MATRIX_ALIGNMENT / sizeof(double);
+
+  return ((size_t) h*h + perLine - 1) / perLine * perLine;
+} // end quadrantSize
+
+
+/*******************************************************************
+ * Function sequentialScratch returns the arena size of winograd(n).
+ * Temporaries are released when a level returns, so a level needs
+ * its own two quadrants plus the deepest child's scratch; the leaf
+ * needs the classic kernel's packing buffers.
+ ********************************************************************/
+static size_t sequentialScratch(int n, int cutoff) {
+  if (n <= cutoff || n % 2 != 0) {
+    return classicScratch(n);
+  } // end if
+  return 2*quadrantSize(n/2) + sequentialScratch(n/2, cutoff);
+} // end sequentialScratch
+
+
+/*******************************************************************
+ * Function arenaAlloc hands out the next count doubles of the arena.
+ ********************************************************************/
+static double * arenaAlloc(ARENA * arena, size_t count) {
+  double * block;
+
+  if (arena->used + count > arena->size) {
+    printf("Strassen arena exhausted (%lu of %lu doubles)\n",
+	   (unsigned long) (arena->used + count), (unsigned long) arena->size);
+    exit(-1);
+  } // end if
+  block = arena->base + arena->used;
+  arena->used += count;
+  return block;
+} // end arenaAlloc
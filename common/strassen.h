@@ -0,0 +1,33 @@
+/*  File:        strassen.h
+    Description: Strassen-Winograd multiply of square matrices on the
+    contiguous layout of matrix.h.  Each level does 7 half-size
+    products and 15 additions instead of 8 products; below the cutoff
+    (or when the size is odd) it drops to the tiled classic kernel of
+    gemm.h.  The seven top-level products run as parallel tasks on a
+    thread pool the caller passes in.  All temporaries, including the
+    classic kernel's packing buffers, come from one arena sized up
+    front, so the recursion itself never calls malloc.
+    Compile the program with:  -I../common ../common/strassen.c
+      ../common/gemm.c ../common/gemmSimd.c ../common/matrix.c
+      ../common/threadPool.c -lpthread
+*/
+#ifndef _STRASSEN_H_
+#define _STRASSEN_H_
+
+#include <stddef.h>
+#include "threadPool.h"
+
+#define STRASSEN_DEFAULT_CUTOFF 512
+
+typedef struct {
+  double * base;
+  size_t size;  // # doubles
+  size_t used;  // # doubles handed out
+} ARENA;
+
+void strassenMultiply(int n, const double * A, int lda, const double * B,
+		      int ldb, double * C, int ldc, int cutoff,
+		      THREAD_POOL * pool);
+size_t strassenScratchSize(int n, int cutoff, int parallel);
+
+#endif
@@ -0,0 +1,172 @@
+/*  File:        threadPool.c
+    Description: Persistent pthread worker pool (see threadPool.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "timer.h"
+#include "threadPool.h"
+
+typedef struct {
+  THREAD_POOL * pool;
+  int threadId;
+} WORKER_ARGS;
+
+static void * poolWorker(void * args);
+
+
+/*******************************************************************
+ * Function threadPoolCreate starts numberOfThreads parked workers.
+ ********************************************************************/
+THREAD_POOL * threadPoolCreate(int numberOfThreads) {
+  THREAD_POOL * pool;
+  WORKER_ARGS * workerArgs;
+  int i, errorCode;
+
+  pool = (THREAD_POOL *) calloc(1, sizeof(THREAD_POOL));
+  pool->numberOfThreads = numberOfThreads;
+  pool->threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+  pool->busyTime = (double *) calloc(numberOfThreads, sizeof(double));
+  pool->tasksRun = (long *) calloc(numberOfThreads, sizeof(long));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->jobReady, NULL);
+  pthread_cond_init(&pool->jobDone, NULL);
+  atomic_init(&pool->nextTask, 0);
+
+  for (i=0; i < numberOfThreads; i++) {
+    workerArgs = (WORKER_ARGS *) malloc(sizeof(WORKER_ARGS));
+    workerArgs->pool = pool;
+    workerArgs->threadId = i;
+    if ((errorCode = pthread_create(&pool->threadHandles[i], NULL, poolWorker,
+				    workerArgs)) != 0) {
+      printf("pthread %d failed to be created with error code %d\n", i, errorCode);
+      exit(-1);
+    } // end if
+  } // end for
+
+  return pool;
+} // end threadPoolCreate
+
+
+/*******************************************************************
+ * Function threadPoolRun runs task(arg, t, threadId) for every
+ * t in [0, numberOfTasks) on the pool and returns when all are done.
+ ********************************************************************/
+void threadPoolRun(THREAD_POOL * pool, int numberOfTasks, POOL_TASK task,
+		   void * arg) {
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->arg = arg;
+  pool->numberOfTasks = numberOfTasks;
+  atomic_store(&pool->nextTask, 0);
+  pool->activeThreads = pool->numberOfThreads;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->jobReady);
+
+  while (pool->activeThreads > 0) {
+    pthread_cond_wait(&pool->jobDone, &pool->lock);
+  } // end while
+  pthread_mutex_unlock(&pool->lock);
+} // end threadPoolRun
+
+
+/*******************************************************************
+ * Function poolWorker - each worker waits for a new job generation,
+ * claims tasks until the counter runs past the end, then reports in.
+ ********************************************************************/
+static void * poolWorker(void * args) {
+  WORKER_ARGS * workerArgs = (WORKER_ARGS *) args;
+  THREAD_POOL * pool = workerArgs->pool;
+  int threadId = workerArgs->threadId;
+  long seenGeneration = 0;
+  POOL_TASK task;
+  void * arg;
+  int numberOfTasks, t;
+  double startTime, endTime;
+
+  free(workerArgs);
+
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == seenGeneration && !pool->shutdown) {
+      pthread_cond_wait(&pool->jobReady, &pool->lock);
+    } // end while
+    if (pool->shutdown) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    } // end if
+    seenGeneration = pool->generation;
+    task = pool->task;
+    arg = pool->arg;
+    numberOfTasks = pool->numberOfTasks;
+    pthread_mutex_unlock(&pool->lock);
+
+    while ((t = atomic_fetch_add(&pool->nextTask, 1)) < numberOfTasks) {
+      GET_TIME(startTime);
+      task(arg, t, threadId);
+      GET_TIME(endTime);
+      pool->busyTime[threadId] += endTime - startTime;
+      pool->tasksRun[threadId]++;
+    } // end while
+
+    pthread_mutex_lock(&pool->lock);
+    pool->activeThreads--;
+    if (pool->activeThreads == 0) {
+      pthread_cond_signal(&pool->jobDone);
+    } // end if
+    pthread_mutex_unlock(&pool->lock);
+  } // end while
+
+  return NULL;
+} // end poolWorker
+
+
+/*******************************************************************
+ * Function threadPoolResetStats zeroes the per-worker busy times.
+ ********************************************************************/
+void threadPoolResetStats(THREAD_POOL * pool) {
+  int i;
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    pool->busyTime[i] = 0.0;
+    pool->tasksRun[i] = 0;
+  } // end for
+} // end threadPoolResetStats
+
+
+/*******************************************************************
+ * Function threadPoolPrintStats prints each worker's busy time and
+ * task count since the last reset.
+ ********************************************************************/
+void threadPoolPrintStats(THREAD_POOL * pool) {
+  int i;
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    printf("  thread %2d busy %10.4f seconds, %6ld tasks\n", i,
+	   pool->busyTime[i], pool->tasksRun[i]);
+  } // end for
+} // end threadPoolPrintStats
+
+
+/*******************************************************************
+ * Function threadPoolDestroy wakes the workers to exit and joins them.
+ ********************************************************************/
+void threadPoolDestroy(THREAD_POOL * pool) {
+  int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->jobReady);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    pthread_join(pool->threadHandles[i], (void **) NULL);
+  } // end for
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->jobReady);
+  pthread_cond_destroy(&pool->jobDone);
+  free(pool->threadHandles);
+  free(pool->busyTime);
+  free(pool->tasksRun);
+  free(pool);
+} // end threadPoolDestroy
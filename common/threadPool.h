@@ -0,0 +1,44 @@
+/*  File:        threadPool.h
+    Description: Persistent pthread worker pool.  The threads are
+    created once and parked on a condition variable between jobs; a
+    job is a count of independent tasks that the workers claim one at
+    a time through an atomic counter, so uneven tasks balance
+    themselves and any number of jobs can run back to back without
+    paying for pthread_create/pthread_join.  Each worker accumulates
+    the time it spends inside tasks (its busy time).
+    Compile the program with:  -I../common ../common/threadPool.c -lpthread
+*/
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// a task is passed the job argument, its task #, and the worker's id
+typedef void (*POOL_TASK)(void * arg, int task, int threadId);
+
+typedef struct {
+  int numberOfThreads;
+  pthread_t * threadHandles;
+  pthread_mutex_t lock;
+  pthread_cond_t jobReady;      // main -> workers: new job (or shutdown)
+  pthread_cond_t jobDone;       // last worker -> main: job finished
+  long generation;              // bumped once per job
+  int shutdown;
+  int activeThreads;            // workers still running the current job
+  POOL_TASK task;               // current job
+  void * arg;
+  int numberOfTasks;
+  atomic_int nextTask;          // next unclaimed task #
+  double * busyTime;            // seconds inside tasks, per worker
+  long * tasksRun;              // # tasks run, per worker
+} THREAD_POOL;
+
+THREAD_POOL * threadPoolCreate(int numberOfThreads);
+void threadPoolRun(THREAD_POOL * pool, int numberOfTasks, POOL_TASK task,
+		   void * arg);
+void threadPoolResetStats(THREAD_POOL * pool);
+void threadPoolPrintStats(THREAD_POOL * pool);
+void threadPoolDestroy(THREAD_POOL * pool);
+
+#endif
@@ -0,0 +1,271 @@
+/*  File:        transpose.c
+    Description: Cache-oblivious in-place and blocked out-of-place
+    transposes (see transpose.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "transpose.h"
+
+// one recursive call run on its own thread
+typedef struct {
+  double * a;
+  double * b;         // swap: the mirrored block
+  int lda;
+  int rows;
+  int columns;
+  int numberOfThreads;
+} TRANSPOSE_TASK;
+
+// one band of tile rows for transposeBlocked
+typedef struct {
+  const double * a;
+  int lda;
+  double * b;
+  int ldb;
+  int rows;
+  int columns;
+  int firstRow;       // first source row of the band
+  int lastRow;        // one past its last
+} TRANSPOSE_BAND;
+
+static void transposeDiagonal(double * a, int lda, int n, int numberOfThreads);
+static void transposeSwap(double * a, double * b, int lda, int rows, int columns,
+			  int numberOfThreads);
+static void * threadSwap(void * args);
+static void * threadBand(void * args);
+
+
+/*******************************************************************
+ * Function transposeInPlace transposes the n x n matrix at a (rows
+ * lda doubles apart) in place with up to numberOfThreads threads
+ * (<= 0 means one per core).
+ ********************************************************************/
+void transposeInPlace(int n, double * a, int lda, int numberOfThreads) {
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  transposeDiagonal(a, lda, n, numberOfThreads);
+} // end transposeInPlace
+
+
+/*******************************************************************
+ * Function transposeBlocked writes the transpose of the rows x
+ * columns matrix a into the columns x rows matrix b, a tile at a
+ * time, with numberOfThreads threads (<= 0 means one per core) each
+ * taking a band of whole tile rows of a.
+ ********************************************************************/
+void transposeBlocked(int rows, int columns, const double * a, int lda,
+		      double * b, int ldb, int numberOfThreads) {
+  pthread_t * threadHandles;
+  TRANSPOSE_BAND * bands;
+  int tileRows = (rows + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+  int i, errorCode;
+
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  if ((long) rows*columns < (long) TRANSPOSE_MIN_PARALLEL*TRANSPOSE_MIN_PARALLEL) {
+    numberOfThreads = 1;
+  } // end if
+  if (numberOfThreads > tileRows) {
+    numberOfThreads = (tileRows > 0) ? tileRows : 1;
+  } // end if
+
+  bands = (TRANSPOSE_BAND *) malloc(numberOfThreads*sizeof(TRANSPOSE_BAND));
+  for (i=0; i < numberOfThreads; i++) {
+    bands[i].a = a;
+    bands[i].lda = lda;
+    bands[i].b = b;
+    bands[i].ldb = ldb;
+    bands[i].rows = rows;
+    bands[i].columns = columns;
+    bands[i].firstRow = (int) ((long) i*tileRows/numberOfThreads) * TRANSPOSE_BLOCK;
+    bands[i].lastRow = (int) ((long) (i+1)*tileRows/numberOfThreads) * TRANSPOSE_BLOCK;
+    if (bands[i].lastRow > rows) {
+      bands[i].lastRow = rows;
+    } // end if
+  } // end for
+  if (numberOfThreads == 1) {
+    threadBand(&bands[0]);
+    free(bands);
+    return;
+  } // end if
+
+  threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+  for (i=0; i < numberOfThreads; i++) {
+    if ((errorCode = pthread_create(&threadHandles[i], NULL, threadBand, &bands[i])) != 0) {
+      printf("pthread %d failed to be created with error code %d\n", i, errorCode);
+      exit(-1);
+    } // end if
+  } // end for
+  for (i=0; i < numberOfThreads; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+  } // end for
+  free(threadHandles);
+  free(bands);
+} // end transposeBlocked
+
+
+/*******************************************************************
+ * Function transposeRowStride returns the # doubles between rows of
+ * a row view if every row follows the one before it at the same
+ * distance (one strided block), else -1.
+ ********************************************************************/
+int transposeRowStride(double ** array, int rows) {
+  long stride;
+  int r;
+
+  if (rows < 2) {
+    return 0;
+  } // end if
+  stride = array[1] - array[0];
+  if (stride <= 0) {
+    return -1;
+  } // end if
+  for (r=2; r < rows; r++) {
+    if (array[r] - array[r-1] != stride) {
+      return -1;
+    } // end if
+  } // end for
+  return (int) stride;
+} // end transposeRowStride
+
+
+/*******************************************************************
+ * Function transposeDiagonal transposes the n x n block at a, which
+ * straddles the diagonal: its two diagonal halves in place, and its
+ * off-diagonal pair by swapping.  The swap (half the work) gets a
+ * thread and half the budget; the diagonal halves share the rest.
+ ********************************************************************/
+static void transposeDiagonal(double * a, int lda, int n, int numberOfThreads) {
+  pthread_t swapThread;
+  TRANSPOSE_TASK swap;
+  double temp;
+  int i, j, half = n / 2;
+
+  if (n <= TRANSPOSE_LEAF) {
+    for (i=0; i < n; i++) {
+      for (j=i+1; j < n; j++) {
+	temp = a[(long) i*lda + j];
+	a[(long) i*lda + j] = a[(long) j*lda + i];
+	a[(long) j*lda + i] = temp;
+      } // end for (j
+    } // end for (i
+    return;
+  } // end if
+
+  // upper right half x (n-half) block <-> lower left (n-half) x half block
+  swap.a = a + half;
+  swap.b = a + (long) half*lda;
+  swap.lda = lda;
+  swap.rows = half;
+  swap.columns = n - half;
+  swap.numberOfThreads = numberOfThreads / 2;
+  if (numberOfThreads > 1 && n >= TRANSPOSE_MIN_PARALLEL
+      && pthread_create(&swapThread, NULL, threadSwap, &swap) == 0) {
+    transposeDiagonal(a, lda, half, numberOfThreads - swap.numberOfThreads);
+    transposeDiagonal(a + (long) half*lda + half, lda, n - half,
+		      numberOfThreads - swap.numberOfThreads);
+    pthread_join(swapThread, (void **) NULL);
+    return;
+  } // end if
+
+  transposeDiagonal(a, lda, half, 1);
+  transposeDiagonal(a + (long) half*lda + half, lda, n - half, 1);
+  transposeSwap(swap.a, swap.b, lda, swap.rows, swap.columns, 1);
+} // end transposeDiagonal
+
+
+/*******************************************************************
+ * Function transposeSwap swaps the rows x columns block at a with
+ * the transpose of the columns x rows block at b: a[i][j] <->
+ * b[j][i].  The longer side is halved until the blocks are leaf
+ * sized; the two halves run in parallel while threads remain.
+ ********************************************************************/
+static void transposeSwap(double * a, double * b, int lda, int rows, int columns,
+			  int numberOfThreads) {
+  pthread_t otherThread;
+  TRANSPOSE_TASK other;
+  double temp;
+  int i, j, half;
+
+  if (rows <= TRANSPOSE_LEAF && columns <= TRANSPOSE_LEAF) {
+    for (i=0; i < rows; i++) {
+      for (j=0; j < columns; j++) {
+	temp = a[(long) i*lda + j];
+	a[(long) i*lda + j] = b[(long) j*lda + i];
+	b[(long) j*lda + i] = temp;
+      } // end for (j
+    } // end for (i
+    return;
+  } // end if
+
+  other.lda = lda;
+  other.numberOfThreads = numberOfThreads / 2;
+  if (rows >= columns) {
+    half = rows / 2;
+    other.a = a + (long) half*lda;
+    other.b = b + half;
+    other.rows = rows - half;
+    other.columns = columns;
+    rows = half;
+  } else {
+    half = columns / 2;
+    other.a = a + half;
+    other.b = b + (long) half*lda;
+    other.rows = rows;
+    other.columns = columns - half;
+    columns = half;
+  } // end if
+
+  if (numberOfThreads > 1
+      && (long) rows*columns >= (long) TRANSPOSE_MIN_PARALLEL*TRANSPOSE_MIN_PARALLEL
+      && pthread_create(&otherThread, NULL, threadSwap, &other) == 0) {
+    transposeSwap(a, b, lda, rows, columns, numberOfThreads - other.numberOfThreads);
+    pthread_join(otherThread, (void **) NULL);
+    return;
+  } // end if
+
+  transposeSwap(a, b, lda, rows, columns, 1);
+  transposeSwap(other.a, other.b, lda, other.rows, other.columns, 1);
+} // end transposeSwap
+
+
+/*******************************************************************
+ * Function threadSwap - thread body for transposeSwap.
+ ********************************************************************/
+static void * threadSwap(void * args) {
+  TRANSPOSE_TASK * task = (TRANSPOSE_TASK *) args;
+
+  transposeSwap(task->a, task->b, task->lda, task->rows, task->columns,
+		task->numberOfThreads);
+  return NULL;
+} // end threadSwap
+
+
+/*******************************************************************
+ * Function threadBand - thread body for transposeBlocked: every
+ * tile of its band of source rows.
+ ********************************************************************/
+static void * threadBand(void * args) {
+  TRANSPOSE_BAND * band = (TRANSPOSE_BAND *) args;
+  const double * a = band->a;
+  double * b = band->b;
+  int r0, c0, rEnd, cEnd, i, j;
+
+  for (r0=band->firstRow; r0 < band->lastRow; r0 += TRANSPOSE_BLOCK) {
+    rEnd = (r0 + TRANSPOSE_BLOCK < band->lastRow) ? r0 + TRANSPOSE_BLOCK : band->lastRow;
+    for (c0=0; c0 < band->columns; c0 += TRANSPOSE_BLOCK) {
+      cEnd = (c0 + TRANSPOSE_BLOCK < band->columns) ? c0 + TRANSPOSE_BLOCK : band->columns;
+      // within the tile (in L1) write b's rows in order
+      for (j=c0; j < cEnd; j++) {
+	for (i=r0; i < rEnd; i++) {
+	  b[(long) j*band->ldb + i] = a[(long) i*band->lda + j];
+	} // end for (i
+      } // end for (j
+    } // end for (c0
+  } // end for (r0
+  return NULL;
+} // end threadBand
@@ -0,0 +1,33 @@
+/*  File:        transpose.h
+    Description: Matrix transposes for the contiguous (leading
+    dimension) layout of matrix.h, both run on pthreads.
+      transposeInPlace  - square n x n, in place.  Cache oblivious:
+                          the matrix is cut in half recursively into
+                          two diagonal blocks (transposed in place) and
+                          an off-diagonal pair (swapped transposed),
+                          so at some depth every block fits each level
+                          of cache without knowing the cache sizes.
+                          The halves run on separate threads until the
+                          thread budget is used up.
+      transposeBlocked  - rows x columns into a separate array, one
+                          TRANSPOSE_BLOCK square tile at a time (source
+                          and destination tile both stay in L1), tile
+                          rows split over the threads.
+    transposeRowStride tells whether a double ** row view is a single
+    evenly strided block (as from allocateMatrix), i.e. whether the
+    raw-pointer transposes can be used on it.
+    Compile the program with:  -I../common ../common/transpose.c -lpthread
+*/
+#ifndef _TRANSPOSE_H_
+#define _TRANSPOSE_H_
+
+#define TRANSPOSE_LEAF 32         // recursion stops at blocks this wide
+#define TRANSPOSE_BLOCK 32        // tile side of transposeBlocked
+#define TRANSPOSE_MIN_PARALLEL 128  // don't start threads for smaller blocks
+
+void transposeInPlace(int n, double * a, int lda, int numberOfThreads);
+void transposeBlocked(int rows, int columns, const double * a, int lda,
+		      double * b, int ldb, int numberOfThreads);
+int transposeRowStride(double ** array, int rows);
+
+#endif
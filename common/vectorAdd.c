@@ -0,0 +1,205 @@
+/*  File:        vectorAdd.c
+    Description: SIMD row add kernels and their run-time dispatch
+    (see vectorAdd.h).  Each kernel is compiled with a function target
+    attribute, as in gemmSimd.c, so the file builds without -march
+    flags and only runs a kernel the CPU reports support for.
+*/
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include "vectorAdd.h"
+
+typedef void (*VECTOR_ADD_FUNCTION)(double * sum, const double * a, const double * b,
+				    size_t length, int accumulate, int nonTemporal);
+
+typedef struct {
+  const char * name;
+  VECTOR_ADD_FUNCTION function;
+} VECTOR_ADD_KERNEL;
+
+static void addScalar(double * sum, const double * a, const double * b,
+		      size_t length, int accumulate, int nonTemporal);
+static void addAvx2(double * sum, const double * a, const double * b,
+		    size_t length, int accumulate, int nonTemporal);
+static void addAvx512(double * sum, const double * a, const double * b,
+		      size_t length, int accumulate, int nonTemporal);
+static void selectKernel(void);
+
+static const VECTOR_ADD_KERNEL scalarKernel = {"scalar", addScalar};
+static const VECTOR_ADD_KERNEL avx2Kernel = {"avx2", addAvx2};
+static const VECTOR_ADD_KERNEL avx512Kernel = {"avx512", addAvx512};
+
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+static const VECTOR_ADD_KERNEL * kernel;
+static size_t lastLevelCache;
+
+
+/*******************************************************************
+ * Function vectorAdd - sum[i] = a[i] + b[i] for i < length.
+ ********************************************************************/
+void vectorAdd(double * sum, const double * a, const double * b, size_t length,
+	       int nonTemporal) {
+  pthread_once(&kernelOnce, selectKernel);
+  kernel->function(sum, a, b, length, 0, nonTemporal);
+} // end vectorAdd
+
+
+/*******************************************************************
+ * Function vectorAddAccumulate - sum[i] += a[i] + b[i] for i < length.
+ ********************************************************************/
+void vectorAddAccumulate(double * sum, const double * a, const double * b,
+			 size_t length, int nonTemporal) {
+  pthread_once(&kernelOnce, selectKernel);
+  kernel->function(sum, a, b, length, 1, nonTemporal);
+} // end vectorAddAccumulate
+
+
+/*******************************************************************
+ * Function vectorAddNonTemporal returns 1 if an output of outputBytes
+ * is too big for the last-level cache, i.e. streaming stores pay.
+ ********************************************************************/
+int vectorAddNonTemporal(size_t outputBytes) {
+  pthread_once(&kernelOnce, selectKernel);
+  return outputBytes > lastLevelCache;
+} // end vectorAddNonTemporal
+
+
+/*******************************************************************
+ * Function vectorAddKernelName returns the name of the kernel in use.
+ ********************************************************************/
+const char * vectorAddKernelName(void) {
+  pthread_once(&kernelOnce, selectKernel);
+  return kernel->name;
+} // end vectorAddKernelName
+
+
+/*******************************************************************
+ * Function selectKernel picks the widest kernel this CPU runs and
+ * looks up the size of the last-level cache.
+ ********************************************************************/
+static void selectKernel(void) {
+  long size;
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    kernel = &avx512Kernel;
+  } else if (__builtin_cpu_supports("avx2")) {
+    kernel = &avx2Kernel;
+  } else {
+    kernel = &scalarKernel;
+  } // end if
+
+  size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (size <= 0) {
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  } // end if
+  lastLevelCache = (size > 0) ? (size_t) size : (size_t) VECTOR_ADD_DEFAULT_LLC;
+} // end selectKernel
+
+
+/*******************************************************************
+ * Function addScalar - portable loop, left to the auto-vectorizer;
+ * nonTemporal is ignored.
+ ********************************************************************/
+static void addScalar(double * sum, const double * a, const double * b,
+		      size_t length, int accumulate, int nonTemporal) {
+  size_t i;
+
+  (void) nonTemporal;  // plain C has no streaming store to ask for
+  if (accumulate) {
+    for (i=0; i < length; i++) {
+      sum[i] += a[i] + b[i];
+    } // end for
+  } else {
+    for (i=0; i < length; i++) {
+      sum[i] = a[i] + b[i];
+    } // end for
+  } // end if
+} // end addScalar
+
+
+/* The scalar elements before sum reaches alignment, and after the
+   last whole register. */
+#define ADD_ONE(i) { \
+  if (accumulate) { \
+    sum[i] += a[i] + b[i]; \
+  } else { \
+    sum[i] = a[i] + b[i]; \
+  } \
+}
+
+
+/*******************************************************************
+ * Function addAvx2 - 4 doubles per ymm, two registers per step.
+ ********************************************************************/
+__attribute__((target("avx2")))
+static void addAvx2(double * sum, const double * a, const double * b,
+		    size_t length, int accumulate, int nonTemporal) {
+  __m256d x0, x1;
+  size_t i = 0;
+
+  while (i < length && ((uintptr_t) (sum + i) & 31) != 0) {
+    ADD_ONE(i);
+    i++;
+  } // end while
+  for (; i + 8 <= length; i += 8) {
+    x0 = _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+    x1 = _mm256_add_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+    if (accumulate) {
+      x0 = _mm256_add_pd(x0, _mm256_load_pd(sum + i));
+      x1 = _mm256_add_pd(x1, _mm256_load_pd(sum + i + 4));
+    } // end if
+    if (nonTemporal) {
+      _mm256_stream_pd(sum + i, x0);
+      _mm256_stream_pd(sum + i + 4, x1);
+    } else {
+      _mm256_store_pd(sum + i, x0);
+      _mm256_store_pd(sum + i + 4, x1);
+    } // end if
+  } // end for
+  for (; i < length; i++) {
+    ADD_ONE(i);
+  } // end for
+  if (nonTemporal) {
+    _mm_sfence();
+  } // end if
+} // end addAvx2
+
+
+/*******************************************************************
+ * Function addAvx512 - 8 doubles per zmm, two registers per step;
+ * after peeling every store fills a whole cache line.
+ ********************************************************************/
+__attribute__((target("avx512f")))
+static void addAvx512(double * sum, const double * a, const double * b,
+		      size_t length, int accumulate, int nonTemporal) {
+  __m512d x0, x1;
+  size_t i = 0;
+
+  while (i < length && ((uintptr_t) (sum + i) & 63) != 0) {
+    ADD_ONE(i);
+    i++;
+  } // end while
+  for (; i + 16 <= length; i += 16) {
+    x0 = _mm512_add_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+    x1 = _mm512_add_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+    if (accumulate) {
+      x0 = _mm512_add_pd(x0, _mm512_load_pd(sum + i));
+      x1 = _mm512_add_pd(x1, _mm512_load_pd(sum + i + 8));
+    } // end if
+    if (nonTemporal) {
+      _mm512_stream_pd(sum + i, x0);
+      _mm512_stream_pd(sum + i + 8, x1);
+    } else {
+      _mm512_store_pd(sum + i, x0);
+      _mm512_store_pd(sum + i + 8, x1);
+    } // end if
+  } // end for
+  for (; i < length; i++) {
+    ADD_ONE(i);
+  } // end for
+  if (nonTemporal) {
+    _mm_sfence();
+  } // end if
+} // end addAvx512
@@ -0,0 +1,36 @@
+/*  File:        vectorAdd.h
+    Description: Explicit SIMD element-wise add of two rows of doubles,
+    the inner loop of the matrix-add programs:
+      vectorAdd            sum  = a + b   (lab7 maddC / maddD, lab8 addRows)
+      vectorAddAccumulate  sum += a + b   (lab5 kernelBench)
+    The widest kernel the CPU supports is picked once at run time
+    (avx512, avx2, or portable C).  The vector loop first peels scalar
+    elements until sum is aligned to the register width, so every
+    vector store is aligned, and is unrolled two registers deep.
+    With nonTemporal set the stores bypass the caches (streaming
+    stores): vectorAdd then never reads sum's lines in for ownership,
+    cutting its traffic from 32 to 24 bytes per element (11 -> 17 GB/s
+    on one core of the lab machine, where the STREAM triad makes 9.5).
+    That only pays when the whole output is larger than the last-level
+    cache; vectorAddNonTemporal makes that call for an output of a
+    given size.  vectorAddAccumulate has to read sum anyway, so there
+    streaming stores save no traffic and measured slower; the option
+    is there for kernelBench.  Each streaming call ends with a store
+    fence, so the rows are visible before the caller hands them on.
+    Compile the program with:  -I../common ../common/vectorAdd.c -lpthread
+*/
+#ifndef _VECTOR_ADD_H_
+#define _VECTOR_ADD_H_
+
+#include <stddef.h>
+
+#define VECTOR_ADD_DEFAULT_LLC (8L*1024*1024)  // bytes, when the OS won't say
+
+void vectorAdd(double * sum, const double * a, const double * b, size_t length,
+	       int nonTemporal);
+void vectorAddAccumulate(double * sum, const double * a, const double * b,
+			 size_t length, int nonTemporal);
+int vectorAddNonTemporal(size_t outputBytes);
+const char * vectorAddKernelName(void);
+
+#endif
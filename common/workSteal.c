@@ -0,0 +1,455 @@
+/*  File:        workSteal.c
+    Description: Work-stealing task pool on Chase-Lev deques (see
+    workSteal.h).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "workSteal.h"
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct {
+  WORK_STEAL_POOL * pool;
+  int threadId;
+} WORKER_ARGS;
+
+static void * stealWorker(void * args);
+static STEAL_ARRAY * newArray(long capacity);
+static void dequePush(STEAL_DEQUE * deque, const STEAL_ITEM * item);
+static int dequeTake(STEAL_DEQUE * deque, STEAL_ITEM * item);
+static int dequeSteal(STEAL_DEQUE * deque, STEAL_ITEM * item);
+static int stealFromOthers(WORK_STEAL_POOL * pool, int threadId,
+			   unsigned int * seed, STEAL_ITEM * item);
+static void parkIdle(WORK_STEAL_POOL * pool);
+static void wakeIdle(WORK_STEAL_POOL * pool, int everyone);
+static int workVisible(WORK_STEAL_POOL * pool);
+static void slotStore(STEAL_SLOT * slot, const STEAL_ITEM * item);
+static void slotLoad(STEAL_SLOT * slot, STEAL_ITEM * item);
+
+
+/*******************************************************************
+ * Function workStealCreate starts numberOfThreads parked workers,
+ * each with an empty deque.
+ ********************************************************************/
+WORK_STEAL_POOL * workStealCreate(int numberOfThreads) {
+  WORK_STEAL_POOL * pool;
+  WORKER_ARGS * workerArgs;
+  int i, errorCode;
+
+  if (posix_memalign((void **) &pool, STEAL_LINE, sizeof(WORK_STEAL_POOL)) != 0) {
+    printf("Could not allocate the work-stealing pool\n");
+    exit(-1);
+  } // end if
+  memset(pool, 0, sizeof(WORK_STEAL_POOL));
+  if (posix_memalign((void **) &pool->deques, STEAL_LINE,
+		     numberOfThreads*sizeof(STEAL_DEQUE)) != 0) {
+    printf("Could not allocate %d deques\n", numberOfThreads);
+    exit(-1);
+  } // end if
+  memset(pool->deques, 0, numberOfThreads*sizeof(STEAL_DEQUE));
+  pool->numberOfThreads = numberOfThreads;
+  pool->threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+  for (i=0; i < numberOfThreads; i++) {
+    atomic_init(&pool->deques[i].top, 0);
+    atomic_init(&pool->deques[i].bottom, 0);
+    atomic_init(&pool->deques[i].array, newArray(STEAL_INITIAL_CAPACITY));
+  } // end for
+  atomic_init(&pool->pending, 0);
+  atomic_init(&pool->idleThreads, 0);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->jobReady, NULL);
+  pthread_cond_init(&pool->jobDone, NULL);
+  pthread_cond_init(&pool->workReady, NULL);
+
+  for (i=0; i < numberOfThreads; i++) {
+    workerArgs = (WORKER_ARGS *) malloc(sizeof(WORKER_ARGS));
+    workerArgs->pool = pool;
+    workerArgs->threadId = i;
+    if ((errorCode = pthread_create(&pool->threadHandles[i], NULL, stealWorker,
+				    workerArgs)) != 0) {
+      printf("pthread %d failed to be created with error code %d\n", i, errorCode);
+      exit(-1);
+    } // end if
+  } // end for
+
+  return pool;
+} // end workStealCreate
+
+
+/*******************************************************************
+ * Function workStealRun runs function(pool, arg, start, end, id) on
+ * the pool and returns when it and all the tasks it spawned are done.
+ ********************************************************************/
+void workStealRun(WORK_STEAL_POOL * pool, STEAL_TASK function, void * arg,
+		  int start, int end) {
+  pthread_mutex_lock(&pool->lock);
+  pool->root.function = function;
+  pool->root.arg = arg;
+  pool->root.start = start;
+  pool->root.end = end;
+  atomic_store(&pool->pending, 1);   // worker 0 pushes the root
+  pool->activeThreads = pool->numberOfThreads;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->jobReady);
+
+  while (pool->activeThreads > 0) {
+    pthread_cond_wait(&pool->jobDone, &pool->lock);
+  } // end while
+  pthread_mutex_unlock(&pool->lock);
+} // end workStealRun
+
+
+/*******************************************************************
+ * Function workStealSpawn - called from a running task on worker
+ * threadId: pushes the task function(arg, start, end) on that
+ * worker's own deque, and wakes a parked worker if there is one.
+ ********************************************************************/
+void workStealSpawn(WORK_STEAL_POOL * pool, int threadId, STEAL_TASK function,
+		    void * arg, int start, int end) {
+  STEAL_ITEM item;
+
+  item.function = function;
+  item.arg = arg;
+  item.start = start;
+  item.end = end;
+  atomic_fetch_add_explicit(&pool->pending, 1, memory_order_relaxed);
+  dequePush(&pool->deques[threadId], &item);
+  wakeIdle(pool, FALSE);
+} // end workStealSpawn
+
+
+/*******************************************************************
+ * Function stealWorker - each worker waits for a new run, then runs
+ * tasks from its own deque, stealing when it is empty, until every
+ * task of the run has finished.
+ ********************************************************************/
+static void * stealWorker(void * args) {
+  WORKER_ARGS * workerArgs = (WORKER_ARGS *) args;
+  WORK_STEAL_POOL * pool = workerArgs->pool;
+  int threadId = workerArgs->threadId;
+  STEAL_DEQUE * myDeque = &pool->deques[threadId];
+  unsigned int seed = 2*threadId + 1;
+  long seenGeneration = 0;
+  int emptyRounds;
+  STEAL_ITEM item;
+
+  free(workerArgs);
+
+  while (TRUE) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == seenGeneration && !pool->shutdown) {
+      pthread_cond_wait(&pool->jobReady, &pool->lock);
+    } // end while
+    if (pool->shutdown) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    } // end if
+    seenGeneration = pool->generation;
+    if (threadId == 0) {
+      dequePush(myDeque, &pool->root);
+    } // end if
+    pthread_mutex_unlock(&pool->lock);
+
+    emptyRounds = 0;
+    while (atomic_load_explicit(&pool->pending, memory_order_acquire) > 0) {
+      if (dequeTake(myDeque, &item)) {
+	item.function(pool, item.arg, item.start, item.end, threadId);
+      } else if (stealFromOthers(pool, threadId, &seed, &item)) {
+	myDeque->tasksStolen++;
+	item.function(pool, item.arg, item.start, item.end, threadId);
+      } else if (++emptyRounds < STEAL_ROUNDS) {
+	sched_yield();   // nothing to steal: let a busy worker have the CPU
+	continue;
+      } else {
+	parkIdle(pool);  // still nothing: sleep until a spawn or the end
+	emptyRounds = 0;
+	continue;
+      } // end if
+      emptyRounds = 0;
+      myDeque->tasksRun++;
+      if (atomic_fetch_sub_explicit(&pool->pending, 1, memory_order_acq_rel) == 1) {
+	wakeIdle(pool, TRUE);  // the run is over: release the parked workers
+      } // end if
+    } // end while
+
+    pthread_mutex_lock(&pool->lock);
+    pool->activeThreads--;
+    if (pool->activeThreads == 0) {
+      pthread_cond_signal(&pool->jobDone);
+    } // end if
+    pthread_mutex_unlock(&pool->lock);
+  } // end while
+
+  return NULL;
+} // end stealWorker
+
+
+/*******************************************************************
+ * Function stealFromOthers tries each other worker once, starting at
+ * a random one, and returns TRUE with the stolen task in item.
+ ********************************************************************/
+static int stealFromOthers(WORK_STEAL_POOL * pool, int threadId,
+			   unsigned int * seed, STEAL_ITEM * item) {
+  int n = pool->numberOfThreads, first, i, victim;
+
+  if (n == 1) {
+    return FALSE;
+  } // end if
+  first = rand_r(seed) % n;
+  for (i=0; i < n; i++) {
+    victim = (first + i) % n;
+    if (victim != threadId && dequeSteal(&pool->deques[victim], item)) {
+      return TRUE;
+    } // end if
+  } // end for
+  return FALSE;
+} // end stealFromOthers
+
+
+/*******************************************************************
+ * Function parkIdle blocks an idle worker until a task is spawned or
+ * the run ends.  The worker counts itself idle before it looks for
+ * work one last time, and the fences pair with wakeIdle's: either
+ * the spawner sees the count, or this worker sees the new task.
+ * Spurious or early wake-ups are harmless: the caller just looks
+ * for work again.
+ ********************************************************************/
+static void parkIdle(WORK_STEAL_POOL * pool) {
+  pthread_mutex_lock(&pool->lock);
+  atomic_fetch_add(&pool->idleThreads, 1);
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load(&pool->pending) > 0 && !workVisible(pool)) {
+    pthread_cond_wait(&pool->workReady, &pool->lock);
+  } // end if
+  atomic_fetch_sub(&pool->idleThreads, 1);
+  pthread_mutex_unlock(&pool->lock);
+} // end parkIdle
+
+
+/*******************************************************************
+ * Function wakeIdle wakes one parked worker (every one at the end of
+ * a run), taking the lock only when some worker is parked.  The lock
+ * makes the signal wait until a worker that has counted itself idle
+ * is really waiting.
+ ********************************************************************/
+static void wakeIdle(WORK_STEAL_POOL * pool, int everyone) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&pool->idleThreads, memory_order_relaxed) == 0) {
+    return;
+  } // end if
+  pthread_mutex_lock(&pool->lock);
+  if (everyone) {
+    pthread_cond_broadcast(&pool->workReady);
+  } else {
+    pthread_cond_signal(&pool->workReady);
+  } // end if
+  pthread_mutex_unlock(&pool->lock);
+} // end wakeIdle
+
+
+/*******************************************************************
+ * Function workVisible returns TRUE if any deque holds a task.
+ ********************************************************************/
+static int workVisible(WORK_STEAL_POOL * pool) {
+  int i;
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    if (atomic_load(&pool->deques[i].top) < atomic_load(&pool->deques[i].bottom)) {
+      return TRUE;
+    } // end if
+  } // end for
+  return FALSE;
+} // end workVisible
+
+
+/*******************************************************************
+ * Function slotStore writes item into a deque slot, field by field.
+ ********************************************************************/
+static void slotStore(STEAL_SLOT * slot, const STEAL_ITEM * item) {
+  atomic_store_explicit(&slot->function, item->function, memory_order_relaxed);
+  atomic_store_explicit(&slot->arg, item->arg, memory_order_relaxed);
+  atomic_store_explicit(&slot->start, item->start, memory_order_relaxed);
+  atomic_store_explicit(&slot->end, item->end, memory_order_relaxed);
+} // end slotStore
+
+
+/*******************************************************************
+ * Function slotLoad reads a deque slot into item, field by field.
+ * A thief's copy may mix two tasks if the owner reused the slot
+ * meanwhile, but then its CAS on top fails and the copy is dropped.
+ ********************************************************************/
+static void slotLoad(STEAL_SLOT * slot, STEAL_ITEM * item) {
+  item->function = atomic_load_explicit(&slot->function, memory_order_relaxed);
+  item->arg = atomic_load_explicit(&slot->arg, memory_order_relaxed);
+  item->start = atomic_load_explicit(&slot->start, memory_order_relaxed);
+  item->end = atomic_load_explicit(&slot->end, memory_order_relaxed);
+} // end slotLoad
+
+
+/*******************************************************************
+ * Function newArray allocates a deque array of capacity tasks.
+ ********************************************************************/
+static STEAL_ARRAY * newArray(long capacity) {
+  STEAL_ARRAY * array;
+
+  array = (STEAL_ARRAY *) malloc(sizeof(STEAL_ARRAY) + capacity*sizeof(STEAL_SLOT));
+  if (array == NULL) {
+    printf("Could not allocate a deque of %ld tasks\n", capacity);
+    exit(-1);
+  } // end if
+  array->capacity = capacity;
+  array->retired = NULL;
+  return array;
+} // end newArray
+
+
+/*******************************************************************
+ * Function dequePush - owner only: adds item at the bottom, doubling
+ * the array first if it is full.
+ ********************************************************************/
+static void dequePush(STEAL_DEQUE * deque, const STEAL_ITEM * item) {
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  STEAL_ARRAY * array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+  STEAL_ARRAY * bigger;
+  STEAL_ITEM moved;
+  long i;
+
+  if (bottom - top > array->capacity - 1) {
+    bigger = newArray(2*array->capacity);
+    for (i=top; i < bottom; i++) {
+      slotLoad(&array->slots[i & (array->capacity-1)], &moved);
+      slotStore(&bigger->slots[i & (bigger->capacity-1)], &moved);
+    } // end for
+    bigger->retired = array;
+    atomic_store_explicit(&deque->array, bigger, memory_order_release);
+    array = bigger;
+  } // end if
+  slotStore(&array->slots[bottom & (array->capacity-1)], item);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+} // end dequePush
+
+
+/*******************************************************************
+ * Function dequeTake - owner only: pops the newest task into item
+ * and returns TRUE, or FALSE if the deque is empty.  Only a race
+ * with a thief for the very last task needs a CAS.
+ ********************************************************************/
+static int dequeTake(STEAL_DEQUE * deque, STEAL_ITEM * item) {
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  STEAL_ARRAY * array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+  long top;
+  int found = TRUE;
+
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+  if (top <= bottom) {
+    slotLoad(&array->slots[bottom & (array->capacity-1)], item);
+    if (top == bottom) {
+      // last task: whoever moves top first gets it
+      found = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+						      memory_order_seq_cst,
+						      memory_order_relaxed);
+      atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    } // end if
+  } else {
+    found = FALSE;
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  } // end if
+  return found;
+} // end dequeTake
+
+
+/*******************************************************************
+ * Function dequeSteal - any thread: takes the oldest task into item
+ * and returns TRUE, or FALSE if the deque is empty or another thread
+ * got there first.
+ ********************************************************************/
+static int dequeSteal(STEAL_DEQUE * deque, STEAL_ITEM * item) {
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  long bottom;
+  STEAL_ARRAY * array;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+  if (top >= bottom) {
+    return FALSE;
+  } // end if
+  array = atomic_load_explicit(&deque->array, memory_order_acquire);
+  slotLoad(&array->slots[top & (array->capacity-1)], item);
+  // the copy only counts if top has not moved since
+  return atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+						 memory_order_seq_cst,
+						 memory_order_relaxed);
+} // end dequeSteal
+
+
+/*******************************************************************
+ * Function workStealResetStats zeroes the per-worker task counts.
+ ********************************************************************/
+void workStealResetStats(WORK_STEAL_POOL * pool) {
+  int i;
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    pool->deques[i].tasksRun = 0;
+    pool->deques[i].tasksStolen = 0;
+  } // end for
+} // end workStealResetStats
+
+
+/*******************************************************************
+ * Function workStealPrintStats prints each worker's task counts
+ * since the last reset.
+ ********************************************************************/
+void workStealPrintStats(WORK_STEAL_POOL * pool) {
+  long run = 0, stolen = 0;
+  int i;
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    printf("  thread %2d ran %6ld tasks, %6ld stolen\n", i,
+	   pool->deques[i].tasksRun, pool->deques[i].tasksStolen);
+    run += pool->deques[i].tasksRun;
+    stolen += pool->deques[i].tasksStolen;
+  } // end for
+  printf("  total     ran %6ld tasks, %6ld stolen\n", run, stolen);
+} // end workStealPrintStats
+
+
+/*******************************************************************
+ * Function workStealDestroy wakes the workers to exit, joins them
+ * and frees the deques with every array they ever used.
+ ********************************************************************/
+void workStealDestroy(WORK_STEAL_POOL * pool) {
+  STEAL_ARRAY * array, * retired;
+  int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = TRUE;
+  pthread_cond_broadcast(&pool->jobReady);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    pthread_join(pool->threadHandles[i], (void **) NULL);
+  } // end for
+
+  for (i=0; i < pool->numberOfThreads; i++) {
+    array = atomic_load(&pool->deques[i].array);
+    while (array != NULL) {
+      retired = array->retired;
+      free(array);
+      array = retired;
+    } // end while
+  } // end for
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->jobReady);
+  pthread_cond_destroy(&pool->jobDone);
+  pthread_cond_destroy(&pool->workReady);
+  free(pool->threadHandles);
+  free(pool->deques);
+  free(pool);
+} // end workStealDestroy
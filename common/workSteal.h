@@ -0,0 +1,102 @@
+/*  File:        workSteal.h
+    Description: Work-stealing task pool.  Every worker owns a
+    Chase-Lev deque (Chase & Lev 2005, with the C11 orderings of Le,
+    Pop, Cohen & Zappa Nardelli 2013): the owner pushes and pops tasks
+    at the bottom without any lock or CAS except on the last task,
+    and an idle worker steals the oldest task from the top of a
+    random victim with one CAS.  A running task spawns its subtasks
+    onto its own deque, so the work a task creates is usually run by
+    the same worker right after, while its data is still in cache,
+    and only idle workers ever touch another worker's deque -- there
+    is no shared queue or lock for the workers to line up on.
+    A task covers a range [start, end) of some index space (rows of a
+    matrix, say); the usual pattern splits a big range in half,
+    spawns one half and keeps working on the other, so a thief always
+    takes a big piece.  workStealRun runs one root task, and returns
+    when it and every task spawned from it have finished.  Idle
+    workers back off by yielding the CPU between rounds of steal
+    attempts; after STEAL_ROUNDS empty rounds they park on a condition
+    variable until a task is spawned or the run ends, and between runs
+    they park as the threads of threadPool.h do.
+    The deque slots are atomics copied field by field with relaxed
+    loads and stores, so a thief reading a slot the owner is reusing
+    is no data race: the thief's CAS on top then fails and it drops
+    the copy.
+    The deque grows when full; retired arrays are freed by
+    workStealDestroy, since a thief may still be reading one.
+    Compile the program with:  -I../common ../common/workSteal.c -lpthread
+*/
+#ifndef _WORK_STEAL_H_
+#define _WORK_STEAL_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define STEAL_LINE 64               // cache line: the hot fields each get one
+#define STEAL_INITIAL_CAPACITY 64   // tasks per deque before it grows
+#ifndef STEAL_ROUNDS
+#define STEAL_ROUNDS 64             // empty steal rounds before an idle worker parks
+#endif
+
+typedef struct WORK_STEAL_POOL WORK_STEAL_POOL;
+
+// a task is passed the pool (to spawn more), its argument and range,
+// and the id of the worker running it
+typedef void (*STEAL_TASK)(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+			   int threadId);
+
+typedef struct {
+  STEAL_TASK function;
+  void * arg;
+  int start;
+  int end;
+} STEAL_ITEM;
+
+// a deque slot: a STEAL_ITEM a thief may read while the owner writes
+typedef struct {
+  _Atomic(STEAL_TASK) function;
+  _Atomic(void *) arg;
+  atomic_int start;
+  atomic_int end;
+} STEAL_SLOT;
+
+typedef struct STEAL_ARRAY {
+  long capacity;                // power of two
+  struct STEAL_ARRAY * retired; // the array this one replaced
+  STEAL_SLOT slots[];
+} STEAL_ARRAY;
+
+typedef struct {
+  _Alignas(STEAL_LINE) atomic_long top;      // thieves take from here
+  _Alignas(STEAL_LINE) atomic_long bottom;   // the owner pushes / pops here
+  _Atomic(STEAL_ARRAY *) array;
+  long tasksRun;                // # tasks this worker ran
+  long tasksStolen;             // # of them it stole
+} STEAL_DEQUE;
+
+struct WORK_STEAL_POOL {
+  int numberOfThreads;
+  pthread_t * threadHandles;
+  STEAL_DEQUE * deques;         // one per worker
+  _Alignas(STEAL_LINE) atomic_long pending;  // tasks spawned, not yet finished
+  _Alignas(STEAL_LINE) atomic_int idleThreads; // workers parked in a run
+  _Alignas(STEAL_LINE) pthread_mutex_t lock; // run start / end and parking
+  pthread_cond_t jobReady;      // main -> workers: new run (or shutdown)
+  pthread_cond_t jobDone;       // last worker -> main: run finished
+  pthread_cond_t workReady;     // spawner / last task -> parked workers
+  long generation;              // bumped once per run
+  int shutdown;
+  int activeThreads;            // workers still in the current run
+  STEAL_ITEM root;              // the current run's first task
+};
+
+WORK_STEAL_POOL * workStealCreate(int numberOfThreads);
+void workStealRun(WORK_STEAL_POOL * pool, STEAL_TASK function, void * arg,
+		  int start, int end);
+void workStealSpawn(WORK_STEAL_POOL * pool, int threadId, STEAL_TASK function,
+		    void * arg, int start, int end);
+void workStealResetStats(WORK_STEAL_POOL * pool);
+void workStealPrintStats(WORK_STEAL_POOL * pool);
+void workStealDestroy(WORK_STEAL_POOL * pool);
+
+#endif
@@ -2,8 +2,22 @@
    Author:    Mark Fienup
    Program to generate two square 2D arrays of random doubles and
    time their multiplication. Edited to use pthreads.
-   Compile by:  gcc -o mmult -O3 mmultHW6.c -lm -lpthread
-   Run by:  ./mmult 1000
+   Compile by:  gcc -o mmult -O3 -I../common mmultHW6.c ../common/gemm.c
+                ../common/gemmSimd.c ../common/gemmFloat.c ../common/matrix.c
+                ../common/threadPool.c ../common/placement.c ../common/transpose.c
+                ../common/counterRandom.c ../common/autotune.c -lm -lpthread
+   Run by:  ./mmult 1000 8
+            ./mmult 1000 8 simd [auto | avx512 | avx2 | sse2 | scalar]
+            ./mmult 1000 8 pool [<tile size> [<# repeats>]]
+            ./mmult 1000 8 float      (float A, B and product)
+            ./mmult 1000 8 mixed      (float A and B, double sums)
+            ./mmult 4000 16 numa [pin] (each thread first-touches its rows
+                                       of A and the product; B interleaved;
+                                       pin: one CPU per thread, node order)
+            ./mmult 1000 0 autotune   (search kernel, blocks, loop order,
+                                       threads and tile size for pool mode)
+            ./mmult 1000 0 pool       (# threads 0 / no tile size or kernel:
+                                       use the tuned configuration)
 */
 
 #include <stdio.h>
@@ -11,38 +25,93 @@
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
 #include <pthread.h>
+#include <unistd.h>  // sysconf
+#include <string.h>
+#include <float.h>  // FLT_EPSILON for the float tolerances
+#include "timer.h"
+#include "matrix.h"  // contiguous MATRIX type
+#include "transpose.h"  // cache-oblivious transposes
+#include "counterRandom.h"  // counter-based random numbers
+#include "placement.h"      // NUMA first touch, pinning, bandwidth probe
+#include "gemm.h"    // packed-panel multiply with SIMD micro-kernels
+#include "threadPool.h"  // persistent worker pool
+#include "autotune.h"    // tuned configuration cache
 
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
 
 // function prototypes (removed matrixMultiplication)
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
-void generateRandom2DArray(int rows, int columns, 
-			   double min, double max, double ** random2DArray);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
 void matrixMultiplicationAlt(int rows1, int columns1, double ** array1, 
 			     int rows2, int columns2, double ** array2,
-			     double ** product);
+			     double ** product, BOOL array2Private);
+void matrixMultiplicationSimd(int rows1, int columns1, MATRIX * array1,
+			      int rows2, int columns2, MATRIX * array2,
+			      MATRIX * product, const GEMM_KERNEL * kernel);
+void printError2DArrays(int rows, int columns, double ** reference,
+			double ** array2D);
 				
 void * threadPartialProduct(void * args); // added treadPartialProduct
+void * threadNumaProduct(void * rank);
+void tileProduct(void * args, int tile, int threadId);
+void allocateTileWorkspaces(int threads, int tileSize);
+void freeTileWorkspaces(int threads);
+void autotunePool(AUTOTUNE_CONFIG * tuned, int maxThreads);
 	
 // global vars for pthreads
 int gRows, gColumns, numberOfThreads;
 double ** gArray1, ** gArray2, ** gProduct;
+BOOL gUseSimd = FALSE;            // simd mode: threads run gemmPacked on their rows
+const GEMM_KERNEL * gKernel;
+MATRIX * gMatrix1, * gMatrix2, * gMatrixProduct;  // contiguous A, B (not transposed), product
+BOOL gUsePool = FALSE;            // pool mode: persistent workers claim 2D output tiles
+int gTileSize = 128;
+int gTilesPerRow;
+double ** gTileWorkspace;         // pool mode: each worker's gemm packing space
+GEMM_BLOCKING gBlocking;          // block sizes for every gemmPacked call
+const GEMM_FLOAT_KERNEL * gFloatKernel = NULL;  // float/mixed mode kernel
+float * gFloat1, * gFloat2, * gFloatProduct;    // float copies (ld as the MATRIXs)
+BOOL gNuma = FALSE;               // numa mode: threads first-touch their own rows
+BOOL gPin = FALSE;                // ... and are pinned to one CPU each
+uint64_t gSeed;
+pthread_barrier_t gStartBarrier, gDoneBarrier;  // numa mode: main + workers
+int * gCpu;                       // numa mode: CPU of each thread (-1 if not pinned)
+double * gLocalShare;             // ... share of its rows' pages on its own node
+PLACEMENT_PROBE * gProbe;
 
 int main(int argc, char ** argv) {
   pthread_t * threadHandles; // added treadHandles
   double ** A;
   double ** B;
   double ** C_alt;
-  int rows, columns, j, errorCode; //added j, errorCode
-  long startTime, endTime,seqTime, i; //added i (seqTime somewhat poorly used, but oh well)
+  MATRIX * matrixC_alt, * matrix2Transposed;
+  int rows, columns, errorCode; //added errorCode
+  double startTime, endTime, seqTime; // (seqTime somewhat poorly used, but oh well)
+  long i; //added i
+  int j;
+  MATRIX * C_simd;
+  THREAD_POOL * pool;
+  int repeats = 1, numberOfTiles;
+  uint64_t seed;
+  AUTOTUNE_CONFIG tuned;
+  BOOL autotune, haveTuned;
+  double tolerance = 0.000001;
   
-  if (argc !=3) {
-    printf("Usage: %s <# integer matrix size> <# of threads>\n", argv[0]);
+  autotune = (argc == 4 && strcmp(argv[3], "autotune") == 0);
+  gNuma = (argc > 3 && strcmp(argv[3], "numa") == 0);
+  gPin = (gNuma && argc == 5 && strcmp(argv[4], "pin") == 0);
+  if (argc < 3 || argc > 6
+      || (argc > 3 && strcmp(argv[3], "simd") != 0 && strcmp(argv[3], "pool") != 0
+	  && strcmp(argv[3], "float") != 0 && strcmp(argv[3], "mixed") != 0
+	  && !autotune && !gNuma)
+      || (argc > 4 && (strcmp(argv[3], "float") == 0 || strcmp(argv[3], "mixed") == 0))
+      || (gNuma && argc > 4 && !gPin)
+      || (argc == 6 && strcmp(argv[3], "pool") != 0)) {
+    printf("Usage: %s <# integer matrix size> <# of threads> [simd [<kernel>] | pool [<tile size> [<# repeats>]]\n"
+	   "         | float | mixed | numa [pin] | autotune]\n", argv[0]);
     exit(-1);     
   } // end if
 
@@ -50,67 +119,230 @@ int main(int argc, char ** argv) {
   columns = rows;
   sscanf(argv[2], "%d", &numberOfThreads);
 
-  // seed the random number generator
-  srand( time(NULL) );
+  // # threads 0 asks for this host's tuned configuration; any other
+  // run keeps the defaults so the cache never overrides the command line
+  autotuneDefaults(&tuned);
+  haveTuned = (!autotune && numberOfThreads <= 0
+	       && autotuneLoad("mmultHW6", rows, &tuned));
+  if (haveTuned) {
+    autotunePrint("Tuned configuration", &tuned);
+  } // end if
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (tuned.numberOfThreads > 0) ? tuned.numberOfThreads
+      : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  gKernel = gemmKernelByName(tuned.kernel);
+  gBlocking = tuned.blocking;
+  if (argc > 3 && strcmp(argv[3], "simd") == 0) {
+    gUseSimd = TRUE;
+    if (argc == 5) {
+      gKernel = gemmKernelByName(argv[4]);
+    } // end if
+  } else if (argc > 3 && strcmp(argv[3], "float") == 0) {
+    gFloatKernel = gemmBestFloatKernel();
+  } else if (argc > 3 && strcmp(argv[3], "mixed") == 0) {
+    gFloatKernel = gemmBestMixedKernel();
+  } else if (gNuma) {
+    gUseSimd = TRUE;  // the threads run gemmPacked on rows they placed
+  } else if (argc > 3) {
+    gUsePool = TRUE;
+    if (tuned.tileSize > 0) {
+      gTileSize = tuned.tileSize;
+    } // end if
+    if (argc > 4 && (sscanf(argv[4], "%d", &gTileSize) != 1 || gTileSize < 1)) {
+      printf("The tile size must be at least 1\n");
+      exit(-1);
+    } // end if
+    if (argc > 5) {
+      sscanf(argv[5], "%d", &repeats);
+    } // end if
+  } // end if
 
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  gProduct = allocate2DArray(rows, columns);
-  C_alt = allocate2DArray(rows, columns);
+  // seed the counter-based generator: stream seed for A, seed+1 for B
+  seed = (uint64_t) time(NULL);
+  gSeed = seed;
+
+  gMatrix1 = allocateMatrix(rows, columns);
+  gMatrix2 = allocateMatrix(rows, columns);
+  gMatrixProduct = allocateMatrix(rows, columns);
+  A = gMatrix1->row;
+  B = gMatrix2->row;
+  gProduct = gMatrixProduct->row;
+  matrixC_alt = allocateMatrix(rows, columns);
+  C_alt = matrixC_alt->row;
   gArray1 = A;
   gArray2 = B;
   gRows = rows;
   gColumns = columns;
-  generateRandom2DArray(rows, columns, -1.0, +1.0, A);
-  generateRandom2DArray(rows, columns, -1.0, +1.0, B);
-
-  // transpose gArray2 for use in parallel
-  /* I would typically put this in its own function and edit
-     matrixMultiplicationAlt to clean up main a bit, but since
-     it wasn't required I figured a comment to explain would
-     be easier. */
-  gArray2 = allocate2DArray(rows, columns);
-  for (i=0; i < rows; i++) {
-    for (j=0; j < columns; j++) {
-      gArray2[j][i] = B[i][j];
-    } /* end for (j */
-  } /* end for (i */
+  if (gNuma) {
+    // every thread reads all of B: spread its pages over the nodes;
+    // A and the product are left untouched for the threads to place
+    placementInterleave(gMatrix2->data, sizeof(double)*(size_t) rows*gMatrix2->ld);
+  } else {
+    generateCounterRandom2DArray(rows, columns, -1.0, +1.0, seed, A, numberOfThreads);
+  } // end if
+  generateCounterRandom2DArray(rows, columns, -1.0, +1.0, seed+1, B, numberOfThreads);
+
+  // transpose gArray2 for use in parallel (B itself is still needed)
+  matrix2Transposed = allocateMatrix(columns, rows);
+  gArray2 = matrix2Transposed->row;
+  transposeBlocked(rows, columns, gMatrix2->data, gMatrix2->ld, gArray2[0],
+		   transposeRowStride(gArray2, columns), numberOfThreads);
+
+  if (gFloatKernel != NULL) {
+    // the jobs this models hold their inputs as float already
+    gFloat1 = allocateAlignedFloat((size_t) rows*gMatrix1->ld);
+    gFloat2 = allocateAlignedFloat((size_t) rows*gMatrix2->ld);
+    gFloatProduct = allocateAlignedFloat((size_t) rows*gMatrixProduct->ld);
+    // logical columns only: the ld padding is never written
+    for (i=0; i < rows; i++) {
+      for (j=0; j < columns; j++) {
+	gFloat1[i*gMatrix1->ld + j] = (float) gMatrix1->row[i][j];
+	gFloat2[i*gMatrix2->ld + j] = (float) gMatrix2->row[i][j];
+      } // end for (j
+    } // end for (i
+  } // end if
 
   printf("after initializing matrices\n");
+
+  if (autotune) {
+    // sequential kernel/blocking search, then threads x tile on this product
+    autotuneBlocking(rows, &tuned);
+    gKernel = gemmKernelByName(tuned.kernel);
+    gBlocking = tuned.blocking;
+    autotunePool(&tuned, 2 * (int) sysconf(_SC_NPROCESSORS_ONLN));
+    autotuneSave("mmultHW6", rows, &tuned);
+    numberOfThreads = tuned.numberOfThreads;
+    gTileSize = tuned.tileSize;
+  } // end if
   
-  // Generate arrays for threads handles
-  threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+  if (gUsePool) {
+    // workers are created once and reused by every multiply
+    pool = threadPoolCreate(numberOfThreads);
+    allocateTileWorkspaces(numberOfThreads, gTileSize);
+    gTilesPerRow = (columns + gTileSize - 1) / gTileSize;
+    numberOfTiles = gTilesPerRow * ((rows + gTileSize - 1) / gTileSize);
+
+    GET_TIME(startTime);
+
+    for (i=0; i < repeats; i++) {
+      threadPoolRun(pool, numberOfTiles, tileProduct, NULL);
+    } // end for
+
+    GET_TIME(endTime);
+    seqTime = (endTime-startTime) / repeats;
+    printf("Matrix Multiplication time (parallel, pool of %d threads, %d %dx%d tiles, %s) = %1.3f per multiply over %d\n",
+	   numberOfThreads, numberOfTiles, gTileSize, gTileSize, gKernel->name,
+	   seqTime, repeats);
+    threadPoolPrintStats(pool);
+    threadPoolDestroy(pool);
+    freeTileWorkspaces(numberOfThreads);
+  } else if (gNuma) {
+    threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+    gCpu = (int *) malloc(numberOfThreads*sizeof(int));
+    gLocalShare = (double *) malloc(numberOfThreads*sizeof(double));
+    gProbe = placementProbeCreate(numberOfThreads, PLACEMENT_PROBE_BYTES);
+    pthread_barrier_init(&gStartBarrier, NULL, numberOfThreads+1);
+    pthread_barrier_init(&gDoneBarrier, NULL, numberOfThreads+1);
+    for (i=0; i < numberOfThreads; i++) {
+      if ((errorCode = pthread_create(&threadHandles[i], NULL, threadNumaProduct, (void *) i)) != 0) {
+        printf("pthread %ld failed to be created with error code %d\n", i, errorCode);
+        exit(-1);
+      } // end if
+    } // end for
+
+    // time the multiply only: placement before, probe after
+    pthread_barrier_wait(&gStartBarrier);
+    GET_TIME(startTime);
+    pthread_barrier_wait(&gDoneBarrier);
+    GET_TIME(endTime);
+    for (i=0; i < numberOfThreads; i++) {
+      pthread_join(threadHandles[i], (void **) NULL);
+    } // end for
+    seqTime = endTime-startTime;
+    printf("Matrix Multiplication time (parallel, numa first touch%s, simd %s, with %d threads) = %1.3f\n",
+	   gPin ? ", pinned" : "", gKernel->name, numberOfThreads, seqTime);
+    for (i=0; i < numberOfThreads; i++) {
+      printf("  thread %2ld: cpu %3d, %5.1f%% of its A and product pages on its node\n",
+	     i, gCpu[i], 100.0*gLocalShare[i]);
+    } // end for
+    placementProbeReport(gProbe);
+    placementProbeDestroy(gProbe);
+  } else {
+    // Generate arrays for threads handles
+    threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
 
-  time(&startTime);
+    GET_TIME(startTime);
  
-  for (i=0; i < numberOfThreads; i++) {
-    if (errorCode = pthread_create(&threadHandles[i], NULL, threadPartialProduct, (void *) i) != 0) {
-      printf("pthread %d failed to be created with error code %d\n", i, errorCode);
-    } // end if
-  } // end for
+    for (i=0; i < numberOfThreads; i++) {
+      if (errorCode = pthread_create(&threadHandles[i], NULL, threadPartialProduct, (void *) i) != 0) {
+        printf("pthread %d failed to be created with error code %d\n", i, errorCode);
+      } // end if
+    } // end for
     
-  for (i=0; i < numberOfThreads; i++) {
-    if (errorCode = pthread_join(threadHandles[i], (void **) NULL) != 0) {
-      printf("pthread %d failed to be joined with error code %d\n", i, errorCode);
+    for (i=0; i < numberOfThreads; i++) {
+      if (errorCode = pthread_join(threadHandles[i], (void **) NULL) != 0) {
+        printf("pthread %d failed to be joined with error code %d\n", i, errorCode);
+      } // end if
+    } // end for
+
+    GET_TIME(endTime);
+    seqTime = endTime-startTime;
+    if (gFloatKernel != NULL) {
+      printf("Matrix Multiplication time (parallel, %s, with %d threads) = %1.3f (%1.2f GFLOP/s)\n",
+	     gFloatKernel->name, numberOfThreads, seqTime,
+	     2.0*rows*(double) rows*columns / seqTime * 1.0e-9);
+    } else {
+      printf("Matrix Multiplication time (parallel%s%s, with %d threads) = %1.3f\n",
+	     gUseSimd ? ", simd " : "", gUseSimd ? gKernel->name : "", numberOfThreads, seqTime);
     } // end if
-  } // end for
+  } // end if
 
-  time(&endTime);
-  seqTime = endTime-startTime;
-  printf("Matrix Multiplication time (parallel, with %d threads) = %ld\n", numberOfThreads, seqTime);
+  if (gFloatKernel != NULL && !gFloatKernel->mixed) {
+    for (i=0; i < rows; i++) {
+      for (j=0; j < columns; j++) {
+	gProduct[i][j] = gFloatProduct[i*gMatrixProduct->ld + j];
+      } // end for (j
+    } // end for (i
+  } // end if
 
-  time(&startTime);
+  GET_TIME(startTime);
 
-  matrixMultiplicationAlt(rows, columns, A, rows, columns, B, C_alt);
+  // the threads are joined: nothing else reads B while it is transposed
+  matrixMultiplicationAlt(rows, columns, A, rows, columns, B, C_alt, TRUE);
 
-  time(&endTime);
+  GET_TIME(endTime);
   seqTime = endTime-startTime;
-  printf("Matrix Multiplication Alt. time (sequential) = %ld\n",seqTime);
+  printf("Matrix Multiplication Alt. time (sequential) = %1.3f\n",seqTime);
+
+  if (gUseSimd) {
+    C_simd = allocateMatrix(rows, columns);
+    GET_TIME(startTime);
+
+    matrixMultiplicationSimd(rows, columns, gMatrix1, rows, columns, gMatrix2,
+			     C_simd, gKernel);
+
+    GET_TIME(endTime);
+    seqTime = endTime-startTime;
+    printf("Matrix Multiplication SIMD time (sequential, %s) = %1.3f\n",
+	   gKernel->name, seqTime);
+    if (!equal2DArrays(rows, columns, C_simd->row, C_alt, tolerance)) {
+      printf("SIMD sequential product DOESN'T match with tolerance of %.10f\n",
+	     tolerance);
+    } // end if
+    freeMatrix(C_simd);
+  } // end if
 
-  if (equal2DArrays(rows, columns, gProduct, C_alt, 0.000001)) {
-    printf("Arrays match with tolerance of %.10f\n", 0.000001);
+  if (gFloatKernel != NULL) {
+    printError2DArrays(rows, columns, C_alt, gProduct);
+    // float inputs cost ~2 eps per product; float sums add ~1 eps per term
+    tolerance = (gFloatKernel->mixed ? 2.0 : 4.0) * columns * FLT_EPSILON;
+  } // end if
+
+  if (equal2DArrays(rows, columns, gProduct, C_alt, tolerance)) {
+    printf("Arrays match with tolerance of %.10f\n", tolerance);
   } else {
-    printf("Arrays DON'T match with tolerance of %.10f\n", 0.000001);
+    printf("Arrays DON'T match with tolerance of %.10f\n", tolerance);
   } // end if
 
   // if small enough, print to screen
@@ -121,6 +353,17 @@ int main(int argc, char ** argv) {
     print2DArray(rows, columns, C_alt);
   } // end if
 
+  freeMatrix(gMatrix1);
+  freeMatrix(gMatrix2);
+  freeMatrix(gMatrixProduct);
+  freeMatrix(matrixC_alt);
+  freeMatrix(matrix2Transposed);
+  if (gFloatKernel != NULL) {
+    free(gFloat1);
+    free(gFloat2);
+    free(gFloatProduct);
+  } // end if
+
   return 0;
 
 } // end main
@@ -139,6 +382,30 @@ void * threadPartialProduct(void * rank) {
     lastRow = blockSize * (myRank+1);
   } // end if
 
+  if (gUseSimd) {
+    // packed-panel multiply of this thread's block of rows
+    gemmPacked(lastRow - firstRow, gColumns, gColumns,
+	       MATRIX_ROW(gMatrix1, firstRow), gMatrix1->ld,
+	       gMatrix2->data, gMatrix2->ld,
+	       MATRIX_ROW(gMatrixProduct, firstRow), gMatrixProduct->ld,
+	       &gBlocking, gKernel);
+    return NULL;
+  } else if (gFloatKernel != NULL && gFloatKernel->mixed) {
+    gemmPackedMixed(lastRow - firstRow, gColumns, gColumns,
+		    gFloat1 + firstRow*gMatrix1->ld, gMatrix1->ld,
+		    gFloat2, gMatrix2->ld,
+		    MATRIX_ROW(gMatrixProduct, firstRow), gMatrixProduct->ld,
+		    &gBlocking, gFloatKernel);
+    return NULL;
+  } else if (gFloatKernel != NULL) {
+    gemmPackedFloat(lastRow - firstRow, gColumns, gColumns,
+		    gFloat1 + firstRow*gMatrix1->ld, gMatrix1->ld,
+		    gFloat2, gMatrix2->ld,
+		    gFloatProduct + firstRow*gMatrixProduct->ld, gMatrixProduct->ld,
+		    &gBlocking, gFloatKernel);
+    return NULL;
+  } // end if
+
   for (i=firstRow; i < lastRow; i++) {
     for (j=0; j < gColumns; j++) {
       gProduct[i][j] = 0.0;
@@ -151,14 +418,161 @@ void * threadPartialProduct(void * rank) {
   return NULL;
 } // end threadPartialSum
 
+/*******************************************************************
+ * Function threadNumaProduct is the numa mode thread body.  The
+ * thread (pinned first, with pin) writes its own block of rows of A
+ * -- the same values generateCounterRandom2DArray would give -- and
+ * zeroes its rows of the product, so those pages are allocated on
+ * its node.  After main starts the clock it multiplies the block,
+ * and once main has stopped it runs its part of the bandwidth probe.
+ ********************************************************************/
+void * threadNumaProduct(void * rank) {
+  long myRank = (long) rank;
+  long blockSize, firstRow, lastRow;
+  size_t bytes;
+
+  blockSize = gRows / numberOfThreads;
+  firstRow = blockSize * myRank;
+  if (myRank == numberOfThreads-1) { //last thread gets the rest
+    lastRow = gRows;
+  } else {
+    lastRow = blockSize * (myRank+1);
+  } // end if
+
+  gCpu[myRank] = gPin ? placementPinThread(myRank, numberOfThreads) : -1;
+  if (lastRow > firstRow) {
+    generateCounterRandomBlock(gArray1, gColumns, firstRow, lastRow-1, 0, gColumns-1,
+			       gSeed, -1.0, +1.0);
+  } // end if
+  bytes = sizeof(double) * (size_t) (lastRow - firstRow) * gMatrixProduct->ld;
+  memset(MATRIX_ROW(gMatrixProduct, firstRow), 0, bytes);
+  gLocalShare[myRank] = (placementFractionOnNode(MATRIX_ROW(gMatrix1, firstRow), bytes,
+						 placementCurrentNode())
+			 + placementFractionOnNode(MATRIX_ROW(gMatrixProduct, firstRow),
+						   bytes, placementCurrentNode())) / 2.0;
+  pthread_barrier_wait(&gStartBarrier);
+
+  gemmPacked(lastRow - firstRow, gColumns, gColumns,
+	     MATRIX_ROW(gMatrix1, firstRow), gMatrix1->ld,
+	     gMatrix2->data, gMatrix2->ld,
+	     MATRIX_ROW(gMatrixProduct, firstRow), gMatrixProduct->ld,
+	     &gBlocking, gKernel);
+
+  pthread_barrier_wait(&gDoneBarrier);
+  placementProbeRun(gProbe, (int) myRank);
+  return NULL;
+} // end threadNumaProduct
+
+/*******************************************************************
+ * Function tileProduct is a thread pool task: it computes output
+ * tile # tile (row-major order of gTileSize x gTileSize tiles of
+ * gProduct) with the packed-panel multiply, packing into the
+ * worker's own workspace.
+ ********************************************************************/
+void tileProduct(void * args, int tile, int threadId) {
+  int firstRow = (tile / gTilesPerRow) * gTileSize;
+  int firstColumn = (tile % gTilesPerRow) * gTileSize;
+  int tileRows = (gRows - firstRow < gTileSize) ? gRows - firstRow : gTileSize;
+  int tileColumns = (gColumns - firstColumn < gTileSize) ? gColumns - firstColumn : gTileSize;
+
+  (void) args;  // every tile reads the globals
+  gemmPackedWorkspace(tileRows, tileColumns, gColumns,
+		      MATRIX_ROW(gMatrix1, firstRow), gMatrix1->ld,
+		      gMatrix2->data + firstColumn, gMatrix2->ld,
+		      MATRIX_ROW(gMatrixProduct, firstRow) + firstColumn, gMatrixProduct->ld,
+		      &gBlocking, gKernel, gTileWorkspace[threadId]);
+
+} // end tileProduct
+
+
+/*******************************************************************
+ * Function allocateTileWorkspaces gives each of threads workers a
+ * gemm packing workspace big enough for a tileSize x tileSize tile,
+ * so tileProduct never allocates.
+ ********************************************************************/
+void allocateTileWorkspaces(int threads, int tileSize) {
+  size_t size = gemmWorkspaceSize(tileSize, tileSize, &gBlocking, gKernel);
+  int i;
+
+  gTileWorkspace = (double **) malloc(threads*sizeof(double *));
+  for (i=0; i < threads; i++) {
+    gTileWorkspace[i] = allocateAligned(size);
+  } // end for
+} // end allocateTileWorkspaces
+
+
+/*******************************************************************
+ * Function freeTileWorkspaces frees the workers' workspaces.
+ ********************************************************************/
+void freeTileWorkspaces(int threads) {
+  int i;
+
+  for (i=0; i < threads; i++) {
+    free(gTileWorkspace[i]);
+  } // end for
+  free(gTileWorkspace);
+} // end freeTileWorkspaces
+
+
+/*******************************************************************
+ * Function autotunePool times the pool multiply of gMatrix1 *
+ * gMatrix2 for 1, 2, 4, ... maxThreads threads and a range of tile
+ * sizes (best of two runs each) and stores the fastest pair and its
+ * rate in tuned.  Leaves gProduct holding a correct product.
+ ********************************************************************/
+void autotunePool(AUTOTUNE_CONFIG * tuned, int maxThreads) {
+  static const int tileCandidates[] = {64, 96, 128, 192, 256, 384};
+  THREAD_POOL * pool;
+  int threads, i, run, numberOfTiles;
+  double startTime, endTime, rate, best;
+
+  tuned->gflops = 0.0;
+  for (threads = 1; threads <= maxThreads; threads *= 2) {
+    pool = threadPoolCreate(threads);
+    for (i=0; i < (int) (sizeof(tileCandidates)/sizeof(int)); i++) {
+      if (tileCandidates[i] > gRows && i > 0) {
+	break;
+      } // end if
+      gTileSize = tileCandidates[i];
+      allocateTileWorkspaces(threads, gTileSize);
+      gTilesPerRow = (gColumns + gTileSize - 1) / gTileSize;
+      numberOfTiles = gTilesPerRow * ((gRows + gTileSize - 1) / gTileSize);
+      best = 0.0;
+      for (run=0; run < 2; run++) {
+	GET_TIME(startTime);
+	threadPoolRun(pool, numberOfTiles, tileProduct, NULL);
+	GET_TIME(endTime);
+	rate = 2.0*gRows*(double) gColumns*gColumns / (endTime - startTime) * 1.0e-9;
+	best = (rate > best) ? rate : best;
+      } // end for (run
+      freeTileWorkspaces(threads);
+      printf("  %2d threads, %3d x %3d tiles: %1.2f GFLOP/s\n", threads,
+	     gTileSize, gTileSize, best);
+      if (best > tuned->gflops) {
+	tuned->gflops = best;
+	tuned->numberOfThreads = threads;
+	tuned->tileSize = gTileSize;
+      } // end if
+    } // end for (i
+    threadPoolDestroy(pool);
+  } // end for (threads
+  autotunePrint("Autotune best", tuned);
+
+} // end autotunePool
+
 /*******************************************************************
  * Function matrixMultiplicationAlt passed two matrices and returns
- * their product.
+ * their product.  The inner loop wants array2 transposed.  When the
+ * caller says array2 is private (not array1, and nobody else reads
+ * it meanwhile) and it is square in one strided block, it is
+ * transposed in place and back afterwards, costing no memory;
+ * otherwise a transposed copy is made a tile at a time.
  ********************************************************************/
 void matrixMultiplicationAlt(int rows1, int columns1, double ** array1, 
 			     int rows2, int columns2, double ** array2,
-			     double ** product) {
-  int i, j, k;
+			     double ** product, BOOL array2Private) {
+  int i, j, k, stride;
+  MATRIX * transpose = NULL;
   double ** array2_transpose;
   
   if (columns1 != rows2) {
@@ -167,12 +581,24 @@ void matrixMultiplicationAlt(int rows1, int columns1, double ** array1,
   } // end if
 
   // Transposes array2
-  array2_transpose = allocate2DArray(columns2, rows2);
-  for (i=0; i < rows2; i++) {
-    for (j=0; j < columns2; j++) {
-      array2_transpose[j][i] = array2[i][j];
-    } /* end for (j */
-  } /* end for (i */
+  stride = transposeRowStride(array2, rows2);
+  if (array2Private && array2 != array1 && rows2 == columns2 && stride >= 0) {
+    transposeInPlace(rows2, array2[0], stride, 1);
+    array2_transpose = array2;
+  } else {
+    transpose = allocateMatrix(columns2, rows2);
+    array2_transpose = transpose->row;
+    if (stride >= 0) {
+      transposeBlocked(rows2, columns2, array2[0], stride, transpose->data,
+		       transpose->ld, 1);
+    } else {
+      for (i=0; i < rows2; i++) {
+	for (j=0; j < columns2; j++) {
+	  array2_transpose[j][i] = array2[i][j];
+	} /* end for (j */
+      } /* end for (i */
+    } // end if
+  } // end if
 
   // Matrix Multiplication uses array1 and array2_transpose
   for (i=0; i < rows1; i++) {
@@ -184,47 +610,39 @@ void matrixMultiplicationAlt(int rows1, int columns1, double ** array1,
     } /* end for (j */
   } /* end for (i */
 
+  if (transpose == NULL) {
+    transposeInPlace(rows2, array2[0], stride, 1);  // restore array2
+  } else {
+    freeMatrix(transpose);
+  } // end if
+
 } // end matrixMultiplicationAlt
 
 
 
 /*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
+ * Function matrixMultiplicationSimd passed two contiguous matrices
+ * and a SIMD micro-kernel, and returns their product computed by the
+ * packed-panel multiply in gemm.c with that kernel.
  ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
+void matrixMultiplicationSimd(int rows1, int columns1, MATRIX * array1,
+			      int rows2, int columns2, MATRIX * array2,
+			      MATRIX * product, const GEMM_KERNEL * kernel) {
+  GEMM_BLOCKING blocking;
 
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
+  if (columns1 != rows2) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
 
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
+  gemmDefaultBlocking(&blocking);
+  gemmPacked(rows1, columns2, columns1, array1->data, array1->ld,
+	     array2->data, array2->ld, product->data, product->ld,
+	     &blocking, kernel);
 
-  return local2DArray;
-} // end allocate2DArray
+} // end matrixMultiplicationSimd
 
 
-/*******************************************************************
- * Function generateRandom2DArray is passed the # rows, the # columns,
- * min. value, max. value, and returns random2DArray containing 
- * randomly generated doubles.
- ********************************************************************/
-void generateRandom2DArray(int rows, int columns, 
-			   double min, double max, double ** random2DArray) {
-  int r, c;
-  double range, div;
-
-  for (r = 0; r < rows; r++) {
-    for (c = 0; c < columns; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      random2DArray[r][c] = min + (rand() / div);
-    } // end for (c...
-  } // end for (r...
-} // end generateRandom2DArray
-
 
 /*******************************************************************
  * Function print2DArray is passed the # rows, # columns, and the
@@ -267,5 +685,28 @@ BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 
 
 
+/*******************************************************************
+ * Function printError2DArrays is passed the # rows, # columns, a
+ * reference array2D, and an array2D to judge.  It prints the largest
+ * absolute difference and that difference relative to the largest
+ * reference element.
+ ********************************************************************/
+void printError2DArrays(int rows, int columns, double ** reference,
+			double ** array2D) {
+  int r, c;
+  double maxError = 0.0, maxReference = 0.0;
 
+  for(r = 0; r < rows; r++) {
+    for (c = 0; c < columns; c++) {
+      if (fabs(reference[r][c] - array2D[r][c]) > maxError) {
+        maxError = fabs(reference[r][c] - array2D[r][c]);
+      } // end if
+      if (fabs(reference[r][c]) > maxReference) {
+        maxReference = fabs(reference[r][c]);
+      } // end if
+    } // end for (c...
+  } // end for(r...
+  printf("Max. error vs matrixMultiplicationAlt = %e (relative %e)\n",
+	 maxError, (maxReference > 0.0) ? maxError / maxReference : 0.0);
 
+} // end printError2DArrays
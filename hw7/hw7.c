@@ -1,9 +1,26 @@
 /*  Edited by:   Vincent T. Mossman
 	Programmer:  Mark Fienup
     File:        hw7.c
-    Compiled by: gcc -o sor -O3 hw7.c -lpthread -lm
+    Compiled by: gcc -o sor -O3 -I../common hw7.c ../common/matrix.c
+                   ../common/placement.c ../common/barrier.c -lpthread -lm
     Run by:      ./sor 1000 0.00001 8
+                 ./sor 4000 0.00001 16 numa [pin]
+                 ./sor 1000 0.00001 8 redblack [omega]
     Description:  2D SOR (successive over-relaxation) program written using POSIX threads.
+    With "numa" the parallel run gets its own arrays, and each thread
+    initializes (first-touches) the rows it updates so they are
+    allocated on its NUMA node; "pin" also pins each thread to one CPU.
+    The local vs. remote read bandwidth the threads see is reported.
+    The default sweeps are really Jacobi iterations: every point gets
+    the average of its neighbours from the last sweep, stored into a
+    second grid.  With "redblack" the Jacobi runs are followed by
+    red-black SOR runs: the points with i+j even (red) are updated in
+    place from their black neighbours, then the black ones from the
+    new red values, each moved omega times the way to the average.
+    One grid is enough, both colours split over the same row blocks,
+    and the result does not depend on the number of threads.  omega
+    defaults to 2/(1 + sin(pi/(n+1))), the best one for this grid.
+    Sweeps and time to the threshold are reported for both methods.
 */
 #include <math.h>
 #include <stdio.h>
@@ -11,35 +28,58 @@
 #include <time.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include "timer.h"
+#include "matrix.h"  // contiguous MATRIX type
+#include "placement.h"  // NUMA first touch, pinning, bandwidth probe
+#include "barrier.h"    // sense-reversing spin barriers
 
 #define MAXTHREADS 16	/* Assume max. # threads */
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
 
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
 void * thread_main(void *);
 void initializeData(double ** val, int n);
+void initializeRows(double ** array, int n, int firstRow, int lastRow);
 void sequential2D_SOR();
-
-/* BARRIER prototype, mutex, condition variable, if needed */
+void sequentialRedBlackSOR();
+void * redBlack_main(void *);
+double redBlackSweep(double ** array, int n, int firstRow, int lastRow,
+		     int color, double omega);
+void compareRedBlack(pthread_attr_t * attr, double seqTime, int seqSweeps,
+		     double parTime, int parSweeps);
+
+/* BARRIER prototype, mutex, if needed */
 void barrier();
 pthread_mutex_t update_lock;
-pthread_mutex_t barrier_lock;	/* mutex for the barrier */
-pthread_cond_t all_here;	/* condition variable for barrier */
-int count=0;			/* counter for barrier */
+BARRIER * sorBarrier;		/* the t threads sync here twice a sweep */
 
 /* Global SOR variables */
 int n, t;
 double threshold;
 double **val, **new;
+MATRIX * valMatrix, * newMatrix;	/* the blocks behind val and new */
 double delta = 0.0;
 double deltaNew = 0.0;
 double globalDelta = 0.0;
+int sweeps;			/* sweeps of the last run to converge */
+
+/* redblack mode */
+#define RED 0
+#define BLACK 1
+BOOL redBlack = FALSE;
+double omega;			/* relaxation factor, 0 < omega < 2 */
+double threadDelta[MAXTHREADS];	/* each thread's largest change in a sweep */
+
+/* numa mode */
+BOOL numa = FALSE, pin = FALSE;
+int cpu[MAXTHREADS];
+PLACEMENT_PROBE * probe;
+double parStart, parEnd;	/* set by thread 0 around the iterations */
 
 /* Command line args: matrix size, threshold, number of threads */
 int main(int argc, char * argv[]) {
@@ -50,19 +90,22 @@ int main(int argc, char * argv[]) {
   long i, j;
   float myThreshold;
   double startTime, endTime, seqTime, parTime;
+  int seqSweeps;
   
   /* set global thread attributes */
   pthread_attr_init(&attr);
   pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
   
-  /* initial mutex and condition variable */
+  /* initial mutex */
   pthread_mutex_init(&update_lock, NULL);
-  pthread_mutex_init(&barrier_lock, NULL);
-  pthread_cond_init(&all_here, NULL);
   
   /* read command line arguments */
-  if (argc != 4) {
-    printf("usage: %s <matrix size> <threshold> <number of threads>\n",
+  numa = (argc > 4 && strcmp(argv[4], "numa") == 0);
+  pin = (numa && argc == 6 && strcmp(argv[5], "pin") == 0);
+  redBlack = (argc > 4 && strcmp(argv[4], "redblack") == 0);
+  if (argc < 4 || argc > 6 || (argc > 4 && !numa && !redBlack)
+      || (argc == 6 && !pin && !redBlack)) {
+    printf("usage: %s <matrix size> <threshold> <number of threads> [numa [pin] | redblack [omega]]\n",
 	   argv[0]);
     exit(1);
   } // end if
@@ -70,10 +113,23 @@ int main(int argc, char * argv[]) {
   sscanf(argv[1], "%d", &n);
   sscanf(argv[2], "%f", &myThreshold);
   sscanf(argv[3], "%d", &t);
+  if (t < 1 || t > MAXTHREADS) {
+    printf("number of threads must be 1 to %d\n", MAXTHREADS);
+    exit(1);
+  } // end if
   threshold = (double) myThreshold;
+  omega = 2.0 / (1.0 + sin(M_PI / (n+1)));
+  if (redBlack && argc == 6 && (sscanf(argv[5], "%lf", &omega) != 1
+				|| omega <= 0.0 || omega >= 2.0)) {
+    printf("omega must be between 0 and 2\n");
+    exit(1);
+  } // end if
+  sorBarrier = barrierCreate(t, BARRIER_DEFAULT);
 
-  val = allocate2DArray(n+2, n+2);
-  new = allocate2DArray(n+2, n+2);
+  valMatrix = allocateMatrix(n+2, n+2);
+  newMatrix = allocateMatrix(n+2, n+2);
+  val = valMatrix->row;
+  new = newMatrix->row;
   initializeData(val, n);
   initializeData(new, n);
   printf("InitializeData done\n");
@@ -82,12 +138,26 @@ int main(int argc, char * argv[]) {
   GET_TIME(startTime);
   sequential2D_SOR();
   GET_TIME(endTime);
+  seqTime = endTime-startTime;
+  seqSweeps = sweeps;
   printf("Sequential Time = %1.5f\n", endTime-startTime);
   printf("maximum difference:  %e\n\n", delta);
 
   /* Time parallel SOR using pthreads */
-  initializeData(val, n);
-  initializeData(new, n);
+  if (numa) {
+    /* fresh, untouched arrays: the threads initialize their own rows */
+    freeMatrix(valMatrix);
+    freeMatrix(newMatrix);
+    valMatrix = allocateMatrix(n+2, n+2);
+    newMatrix = allocateMatrix(n+2, n+2);
+    val = valMatrix->row;
+    new = newMatrix->row;
+    probe = placementProbeCreate(t, PLACEMENT_PROBE_BYTES);
+  } else {
+    initializeData(val, n);
+    initializeData(new, n);
+  } // end if
+  sweeps = 0;
   GET_TIME(startTime);
   for(i=0; i<t; i++) {
     pthread_create(&tid[i], &attr, thread_main, (void *) i);
@@ -97,8 +167,26 @@ int main(int argc, char * argv[]) {
     pthread_join(tid[i], NULL);
   } // end for
   GET_TIME(endTime);
-  printf("Parallel Time with %d threads = %1.5f\n", t, endTime-startTime);
-  printf("maximum difference:  %e\n\n", delta);
+  if (numa) {
+    printf("Parallel Time with %d threads (numa first touch%s) = %1.5f\n", t,
+	   pin ? ", pinned" : "", parEnd-parStart);
+    printf("maximum difference:  %e\n\n", delta);
+    for (i=0; i < t; i++) {
+      printf("  thread %2ld: cpu %3d\n", i, cpu[i]);
+    } // end for
+    placementProbeReport(probe);
+    placementProbeDestroy(probe);
+  } else {
+    printf("Parallel Time with %d threads = %1.5f\n", t, endTime-startTime);
+    printf("maximum difference:  %e\n\n", delta);
+  } // end if
+  if (redBlack) {
+    parTime = endTime-startTime;
+    compareRedBlack(&attr, seqTime, seqSweeps, parTime, sweeps);
+  } // end if
+  barrierDestroy(sorBarrier);
+  freeMatrix(valMatrix);
+  freeMatrix(newMatrix);
   
 } // end main
 
@@ -118,8 +206,10 @@ void sequential2D_SOR() {
   double ** temp;
   int i, j;
   
+  sweeps = 0;
   do {
     maxDelta = 0.0;
+    sweeps++;
     
     for (i = 1; i <= n; i++) {
       for (j = 1; j <= n; j++) {
@@ -162,6 +252,18 @@ void* thread_main(void * arg) {
   } else {
     endRow = n;
   }
+
+  if (numa) {
+    /* first touch: this thread's rows (and the edge rows next to the
+       first and last block) land on the node it runs on */
+    cpu[id] = pin ? placementPinThread(id, t) : -1;
+    initializeRows(val, n, (id == 0) ? 0 : startRow, (id == t-1) ? n+1 : endRow);
+    initializeRows(new, n, (id == 0) ? 0 : startRow, (id == t-1) ? n+1 : endRow);
+    barrier(id);
+    if (id == 0) {
+      GET_TIME(parStart);
+    }
+  }
     
   do {
     maxDelta = 0.0;
@@ -182,6 +284,9 @@ void* thread_main(void * arg) {
   
     barrier(id);
  
+    if (id == 0) {
+      sweeps++;
+    }
     if (id == t-1) {
       temp = new; /* prepare for next iteration */
       new = val;
@@ -199,28 +304,188 @@ void* thread_main(void * arg) {
     // printf("thread %d delta = %8.6f\n", id, delta);
   } while (delta >= threshold); //end do-while
 
+  if (numa) {
+    if (id == 0) {
+      GET_TIME(parEnd);
+    }
+    placementProbeRun(probe, (int) id);
+  }
+
   // printf("Hello from thread %d! I'm done!\n",id);
   
 } // end thread_main
 
 
+/***********************************************************************
+ * Function compareRedBlack - after the Jacobi runs, times red-black SOR
+ * sequentially and with t threads, each in place in val from a fresh
+ * start, and prints the sweeps and time to the threshold of all four
+ * runs.  No grid is added: the Jacobi result moves to new while the
+ * sequential run works in Jacobi's spare grid, and once the two
+ * solutions are compared the Jacobi grid is re-initialized for the
+ * threaded run, whose result is checked against the sequential one
+ * (left in new).  Both red-black runs are compared with sequential
+ * Jacobi: the threaded Jacobi stops when the first thread's block
+ * converges, so its sweep count is no baseline.
+ **********************************************************************/
+void compareRedBlack(pthread_attr_t * attr, double seqTime, int seqSweeps,
+		     double parTime, int parSweeps) {
+  pthread_t tid[MAXTHREADS];
+  double ** temp;
+  double startTime, endTime, rbSeqTime, rbParTime, difference;
+  int rbSeqSweeps, i, j;
+  long id;
 
-/*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
- ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
+  temp = new;  /* new <- Jacobi result, val <- the spare grid */
+  new = val;
+  val = temp;
+  initializeData(val, n);
+  GET_TIME(startTime);
+  sequentialRedBlackSOR();
+  GET_TIME(endTime);
+  rbSeqTime = endTime-startTime;
+  rbSeqSweeps = sweeps;
+
+  difference = 0.0;
+  for (i = 1; i <= n; i++) {
+    for (j = 1; j <= n; j++) {
+      if (difference < fabs(new[i][j] - val[i][j])) {
+	difference = fabs(new[i][j] - val[i][j]);
+      } // end if
+    } // end for j
+  } // end for i
 
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
+  temp = new;  /* new <- sequential red-black result, val <- Jacobi's grid */
+  new = val;
+  val = temp;
+  initializeData(val, n);
+  sweeps = 0;
+  GET_TIME(startTime);
+  for (id=0; id < t; id++) {
+    pthread_create(&tid[id], attr, redBlack_main, (void *) id);
+  } // end for
+  for (id=0; id < t; id++) {
+    pthread_join(tid[id], NULL);
   } // end for
+  GET_TIME(endTime);
+  rbParTime = endTime-startTime;
+
+  printf("Red-black SOR, omega = %.4f (grid %.1f MB, Jacobi needs two)\n", omega,
+	 (n+2.0)*(n+2.0)*sizeof(double)/1.0e6);
+  printf("                           sweeps     time (s)   time/sweep (ms)\n");
+  printf("Jacobi sequential       %9d   %10.5f   %15.4f\n", seqSweeps, seqTime,
+	 seqTime / seqSweeps * 1.0e3);
+  printf("Jacobi %2d threads       %9d   %10.5f   %15.4f\n", t, parSweeps, parTime,
+	 parTime / parSweeps * 1.0e3);
+  printf("Red-black sequential    %9d   %10.5f   %15.4f   (%.1fx fewer sweeps, %.2fx faster)\n",
+	 rbSeqSweeps, rbSeqTime, rbSeqTime / rbSeqSweeps * 1.0e3,
+	 (double) seqSweeps / rbSeqSweeps, seqTime / rbSeqTime);
+  printf("Red-black %2d threads    %9d   %10.5f   %15.4f   (%.1fx fewer sweeps, %.2fx faster)\n",
+	 t, sweeps, rbParTime, rbParTime / sweeps * 1.0e3,
+	 (double) seqSweeps / sweeps, seqTime / rbParTime);
+  printf("(ratios are against Jacobi sequential)\n");
+
+  if (!equal2DArrays(n+2, n+2, new, val, 0.0)) {
+    printf("Parallel red-black result DOESN'T match the sequential one\n");
+  } // end if
+  printf("largest difference from the Jacobi result:  %e\n", difference);
+
+} // end compareRedBlack
+
+
+/***********************************************************************
+ * Function sequentialRedBlackSOR - performs a sequential red-black SOR
+ * calculation in place in val, a red sweep then a black sweep each
+ * iteration, until the largest change a sweep makes falls below
+ * threshold.  Sets the globals delta and sweeps.
+ **********************************************************************/
+void sequentialRedBlackSOR() {
+  double maxDelta, thisDelta;
+
+  sweeps = 0;
+  do {
+    maxDelta = redBlackSweep(val, n, 1, n, RED, omega);
+    thisDelta = redBlackSweep(val, n, 1, n, BLACK, omega);
+    if (maxDelta < thisDelta) {
+      maxDelta = thisDelta;
+    } // end if
+    sweeps++;
+  } while (maxDelta > threshold);  // end do-while
+
+  delta = maxDelta;
+
+} // end sequentialRedBlackSOR
+
+
+/***********************************************************************
+ * Function redBlack_main - one thread of the parallel red-black SOR,
+ * over the same block of rows thread_main uses.  The red points only
+ * read black ones and vice versa, so a barrier between the colours is
+ * all the threads need; after the black sweep every thread takes the
+ * largest of the threads' changes, so they all stop on the same sweep.
+ **********************************************************************/
+void * redBlack_main(void * arg) {
+  long id = (long) arg;
+  double maxDelta, thisDelta;
+  int i, blockSize, startRow, endRow;
+
+  blockSize = n/t;
+  startRow = (blockSize*id)+1;
+  if (id < t-1) {
+    endRow = (blockSize*(id+1));
+  } else {
+    endRow = n;
+  }
+
+  do {
+    maxDelta = redBlackSweep(val, n, startRow, endRow, RED, omega);
+    barrier(id);
+    thisDelta = redBlackSweep(val, n, startRow, endRow, BLACK, omega);
+    threadDelta[id] = (maxDelta < thisDelta) ? thisDelta : maxDelta;
+    barrier(id);
+
+    /* nobody writes threadDelta again until after the next red sweep's barrier */
+    maxDelta = 0.0;
+    for (i = 0; i < t; i++) {
+      if (maxDelta < threadDelta[i]) {
+	maxDelta = threadDelta[i];
+      }
+    }
+    if (id == 0) {
+      sweeps++;
+      delta = maxDelta;
+    }
+  } while (maxDelta > threshold);
+
+  return NULL;
+} // end redBlack_main
+
+
+/***********************************************************************
+ * Function redBlackSweep updates the points of one colour (RED: i+j
+ * even, BLACK: i+j odd) in rows firstRow..lastRow of array, moving
+ * each omega times the way from its value to the average of its four
+ * neighbours, and returns the largest |average - value| it saw.
+ **********************************************************************/
+double redBlackSweep(double ** array, int n, int firstRow, int lastRow,
+		     int color, double omega) {
+  double average, thisDelta, maxDelta = 0.0;
+  int i, j;
+
+  for (i = firstRow; i <= lastRow; i++) {
+    for (j = 1 + ((i + 1 + color) & 1); j <= n; j += 2) {
+      average = (array[i-1][j] + array[i][j+1] + array[i+1][j] + array[i][j-1])/4;
+      thisDelta = fabs(average - array[i][j]);
+      if (maxDelta < thisDelta) {
+	maxDelta = thisDelta;
+      } // end if
+      array[i][j] += omega*(average - array[i][j]);
+    } // end for j
+  } // end for i
+
+  return maxDelta;
+} // end redBlackSweep
 
-  return local2DArray;
-} // end allocate2DArray
 
 
 /*******************************************************************
@@ -228,20 +493,31 @@ double ** allocate2DArray(int rows, int columns) {
  * everywhere, except 1.0s down column 0.
  ********************************************************************/
 void initializeData(double ** array, int n) {
+
+  initializeRows(array, n, 0, n+1);
+
+} // end initializeData
+
+
+/*******************************************************************
+ * Function initializeRows initializes rows firstRow..lastRow of a
+ * 2D array for SOR, as initializeData does for all of them.
+ ********************************************************************/
+void initializeRows(double ** array, int n, int firstRow, int lastRow) {
   int i, j;
   
   /* initialize to 0.0 except for 1.0s along the left boundary */
-  for (i = 0; i < n+2; i++) {
+  for (i = firstRow; i <= lastRow; i++) {
     array[i][0] = 1.0;
   } // end for i
 
-  for (i = 0; i < n+2; i++) {
+  for (i = firstRow; i <= lastRow; i++) {
     for (j = 1; j < n+2; j++) {
       array[i][j] = 0.0;
     } // end for j
   } // end for i
 
-} // end initializeData
+} // end initializeRows
 
 
 /*******************************************************************
@@ -286,23 +562,11 @@ BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 
 
 /*******************************************************************
- * Function barrier passed the thread id for debugging purposes.
- * Implements barrier synchronization using global variables:
- * count - # of thread that have arrived at the barrier
- * t - # of threads we are synchronizing
- * barrier_lock - the mutex ensuring mutual exclusion
- * all_here - the condition variable where threads wait for all to arrive
+ * Function barrier passed the thread id, which the barrier module
+ * needs (see barrier.h): returns once all t threads have arrived
+ * at sorBarrier.
  ********************************************************************/
 void barrier(long id) {
-  pthread_mutex_lock(&barrier_lock);
-  count++;
-  // printf("count %d, id %d\n", count, id);
-  if (count == t) {
-    count = 0;
-    pthread_cond_broadcast(&all_here);
-  } else {
-    while(pthread_cond_wait(&all_here, &barrier_lock) != 0);
-  } // end if
-  pthread_mutex_unlock(&barrier_lock);
+  barrierWait(sorBarrier, (int) id);
 } // end barrier
 
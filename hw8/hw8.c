@@ -1,7 +1,7 @@
 /*  Edited by:   Vincent T. Mossman
     Programmer:  Mark Fienup
     File:        seqChromakey.c
-    Compiled by: gcc -O3 -o hw8 hw8.c -lpthread -lm
+    Compiled by: gcc -O3 -I../common -o hw8 hw8.c ../common/ringBuffer.c -lpthread -lm
     Description: Performs chroma key/green-screen replace of a background
 	image (swans.ppm) over a sequence of green-screen "loch ness" monster
 	pictures (nessie001.ppm, nessie002.ppm, ..., nessie099.ppm).  This program
@@ -14,8 +14,9 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include "ringBuffer.h"  // lock-free bounded buffer
 
-#define SIZE 10
+#define SIZE 10    // # of slots asked for: the ring rounds it up to 16
 #define MAX_FRAME 99
 #define TRUE 1
 #define FALSE 0
@@ -45,14 +46,9 @@ int nextFrameNumber = 0;
 int consumedCount = 0;
 
 // Global Bounded Buffer
-PICTURE buffer[SIZE];
-int count = 0;
-int front = -1;
-int rear = 0;
+RING_BUFFER * buffer;  // lock-free MPMC ring of SIZE (rounded up) PICTUREs
 
-pthread_mutex_t lock;
-pthread_cond_t nonFull;
-pthread_cond_t nonEmpty;
+pthread_mutex_t lock;  // frame counters
 
 // prototypes
 unsigned char ** allocate2DArray(int rows, int columns);
@@ -71,8 +67,7 @@ PICTURE bufferRemove();
 int main(int argc, char * argv[]) {
 
   pthread_mutex_init(&lock, NULL);
-  pthread_cond_init(&nonFull, NULL);
-  pthread_cond_init(&nonEmpty, NULL);
+  buffer = ringBufferCreate(SIZE, sizeof(PICTURE));
 
   pthread_t threadProdHandle[64];
   pthread_attr_t attrProd[64];
@@ -310,35 +305,14 @@ void writePicture(PICTURE picture, char * fileName) {
 
 void bufferAdd(PICTURE item) {
 
-  pthread_mutex_lock(&lock);
-  while(count == SIZE) {
-    while(pthread_cond_wait(&nonFull, &lock) != 0);
-  } // end while
-  if (count == 0) {
-    front = 0;
-    rear = 0;
-  } else {
-    rear = (rear + 1) % SIZE;
-  } // end if
-  buffer[rear] = item;
-  count++;
-  pthread_cond_signal(&nonEmpty);
-  pthread_mutex_unlock(&lock);
+  ringBufferPush(buffer, &item);
 
 } // end bufferAdd
 
 PICTURE bufferRemove() {
   PICTURE returnValue;
 
-  pthread_mutex_lock(&lock);
-  while(count == 0) {
-    while(pthread_cond_wait(&nonEmpty, &lock) != 0);
-  } // end while
-  returnValue = buffer[front];
-  front = (front + 1) % SIZE;
-  count--;
-  pthread_cond_signal(&nonFull);
-  pthread_mutex_unlock(&lock);
+  ringBufferPop(buffer, &returnValue);
   return returnValue;
 
 } // end bufferRemove
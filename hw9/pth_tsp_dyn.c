@@ -9,7 +9,8 @@
  *           wait until the program terminates or another thread
  *           gives it additional work.
  *
- * Compile:  gcc -O3 -Wall -o pth_tsp_dyn pth_tsp_dyn.c -lpthread
+ * Compile:  gcc -O3 -Wall -I../common -o pth_tsp_dyn pth_tsp_dyn.c
+ *              ../common/barrier.c -lpthread
  *           Needs timer.h
  * Usage:    pth_tsp_dyn <thread count> <matrix_file> <min split size>
  *
@@ -41,6 +42,7 @@
 #include <string.h>
 #include <pthread.h>
 #include "timer.h"
+#include "barrier.h"
 
 const int INFINITY = 1000000;
 const int NO_CITY = -1;
@@ -82,13 +84,7 @@ typedef queue_struct* my_queue_t;
 #define Queue_elt(queue,i) \
    (queue->list[(queue->head + (i)) % queue->list_alloc])
 
-typedef struct {
-   int curr_tc;  // Number of threads that have entered the barrier
-   int max_tc;   // Number of threads that need to enter the barrier
-   pthread_mutex_t mutex;
-   pthread_cond_t ok_to_go;
-}  barrier_struct;
-typedef barrier_struct* my_barrier_t;
+typedef BARRIER* my_barrier_t;  // see barrier.h
 
 typedef struct {
    my_stack_t stack;
@@ -164,7 +160,7 @@ long long Fact(int k);
 /* Barrier */
 my_barrier_t My_barrier_init(int thr_count);
 void My_barrier_destroy(my_barrier_t bar);
-void My_barrier(my_barrier_t bar);
+void My_barrier(my_barrier_t bar, long my_rank);
 
 /*------------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
@@ -390,14 +386,14 @@ void Partition_tree(long my_rank, my_stack_t stack) {
    int my_first_tour, my_last_tour, i;
 
    if (my_rank == 0) queue_size = Get_upper_bd_queue_sz();
-   My_barrier(bar_str);
+   My_barrier(bar_str, my_rank);
 #  ifdef DEBUG
    printf("Th %ld > queue_size = %d\n", my_rank, queue_size);
 #  endif
    if (queue_size == 0) pthread_exit(NULL);
 
    if (my_rank == 0) Build_initial_queue();
-   My_barrier(bar_str);
+   My_barrier(bar_str, my_rank);
    Set_init_tours(my_rank, &my_first_tour, &my_last_tour);
 #  ifdef DEBUG
    printf("Th %ld > init_tour_count = %d, first = %d, last = %d\n",
@@ -1050,13 +1046,7 @@ long long Fact(int k) {
  *    Pointer to initialized barrier struct
  */
 my_barrier_t My_barrier_init(int thr_count) {
-   my_barrier_t bar = malloc(sizeof(barrier_struct));
-   bar->curr_tc = 0;
-   bar->max_tc = thr_count;
-   pthread_mutex_init(&bar->mutex, NULL);
-   pthread_cond_init(&bar->ok_to_go, NULL);
-
-   return bar;
+   return barrierCreate(thr_count, BARRIER_DEFAULT);
 }  /* My_barrier_init */
 
 
@@ -1066,33 +1056,18 @@ my_barrier_t My_barrier_init(int thr_count) {
  * Out arg:   bar
  */
 void My_barrier_destroy(my_barrier_t bar) {
-   pthread_mutex_destroy(&bar->mutex);
-   pthread_cond_destroy(&bar->ok_to_go);
-   free(bar);
+   barrierDestroy(bar);
 }  /* My_barrier_destroy */
 
 
 /*------------------------------------------------------------------
  * Function:  My_barrier
- * Purpose:   Implement a barrier using a condition variable
+ * Purpose:   Block until all the threads have entered the barrier
+ * In arg:      my_rank
  * In/out arg:  bar
  */
-void My_barrier(my_barrier_t bar) {
-   pthread_mutex_lock(&bar->mutex);
-   bar->curr_tc++;
-   if (bar->curr_tc == bar->max_tc) {
-      bar->curr_tc = 0;
-      pthread_cond_broadcast(&bar->ok_to_go);
-   } else {
-      // Wait unlocks mutex and puts thread to sleep.
-      //    Put wait in while loop in case some other
-      // event awakens thread.
-      while (pthread_cond_wait(&bar->ok_to_go,
-             &bar->mutex) != 0);
-      // Mutex is relocked at this point.
-   }
-   pthread_mutex_unlock(&bar->mutex);
-
+void My_barrier(my_barrier_t bar, long my_rank) {
+   barrierWait(bar, (int) my_rank);
 }  /* My_barrier */
 
 
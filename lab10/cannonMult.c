@@ -0,0 +1,300 @@
+/*  File:        cannonMult.c
+ *  Compile as:  mpicc -o cannonMult -O3 -I../common cannonMult.c ../common/gemm.c
+ *                 ../common/gemmSimd.c ../common/matrix.c -lm
+ *  Run by:      mpirun -np 4 ./cannonMult 2000           (strong: n fixed)
+ *               mpirun -np 4 ./cannonMult 1000 weak      (weak: n = 1000 on
+ *                                                         one process, grown
+ *                                                         with the cube root of
+ *                                                         the # of processes)
+ *               (or qsub qsub.cannonMult for the whole scaling series)
+ *  Description:  An MPI matrix multiply C = A*B using Cannon's algorithm
+ *  on a q x q periodic process grid (the # of processes must be a
+ *  perfect square).  n is padded with zeros up to a multiple of q so
+ *  every block is b x b.  Root hands out the blocks already aligned
+ *  (process (i,j) starts with A(i,i+j) and B(i+j,j)), then in each of
+ *  the q steps every process multiplies its current pair into its C
+ *  block while the pair travels on: A one process left, B one process
+ *  up, with MPI_Isend/MPI_Irecv into a second pair of buffers posted
+ *  before the local multiply so the shift overlaps the work.
+ *  The scaling report gives the multiply time (slowest process, no
+ *  distribute/gather), the time spent waiting on the shifts, GFLOP/s
+ *  per process and the parallel efficiency against gemmPacked on one
+ *  process -- the same kernel as  ./mmult <n> <T> simd  in hw6, so the
+ *  per-process rate compares directly with the per-thread rate there.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+#include "timer.h"
+#include "matrix.h"
+#include "gemm.h"
+
+#define RootProcess 0
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+const int tag = 1;
+
+int gridSide(int numProcs);
+void copyBlock(int rows, int columns, const double * from, int ldFrom,
+	       double * to, int ldTo);
+void generateRandomMatrix(MATRIX * matrix, int n, double min, double max);
+
+int main(int argc, char* argv[]) {
+  int myID, numProcs, p, i, j, n, baseN, paddedN, q, b, step, current;
+  int dims[2], periods[2] = {TRUE, TRUE}, coords[2];
+  int left, right, up, down;
+  BOOL weak = FALSE;
+  MPI_Comm gridComm;
+  MPI_Request requests[4];
+  MPI_Status status;
+  MATRIX * A = NULL, * B = NULL, * C = NULL, * C_seq;
+  double * blockA[2], * blockB[2], * blockC, * buffer;
+  double clockStart, clockEnd, totalTime, seqTime, baseTime, maxError;
+  double multiplyStart, waitStart, times[2], maxTimes[2], flops;
+  GEMM_BLOCKING blocking;
+  const GEMM_KERNEL * kernel;
+
+  MPI_Init(&argc, &argv);  /* Initialize MPI */
+  MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &myID);
+
+  if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "weak") != 0
+			       && strcmp(argv[2], "strong") != 0)) {
+    if (myID == RootProcess) {
+      printf("Usage: %s <# integer matrix size> [strong | weak]\n", argv[0]);
+    } // end if
+    MPI_Finalize();
+    return 0;
+  } // end if
+  q = gridSide(numProcs);
+  if (q == 0) {
+    if (myID == RootProcess) {
+      printf("Cannon's algorithm needs a square # of processes, not %d\n", numProcs);
+    } // end if
+    MPI_Finalize();
+    return 0;
+  } // end if
+
+  // all processes have access to argc and argv
+  sscanf(argv[1], "%d", &baseN);
+  weak = (argc == 3 && strcmp(argv[2], "weak") == 0);
+  // weak scaling keeps the flops per process (n^3 / P) constant
+  n = weak ? (int) (baseN * cbrt((double) numProcs) + 0.5) : baseN;
+  b = (n + q - 1) / q;
+  paddedN = b * q;
+
+  // periodic q x q grid; A shifts along dimension 1, B along dimension 0
+  dims[0] = dims[1] = q;
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, FALSE, &gridComm);
+  MPI_Comm_rank(gridComm, &myID);
+  MPI_Cart_shift(gridComm, 1, -1, &right, &left);  // A: receive from right, send left
+  MPI_Cart_shift(gridComm, 0, -1, &down, &up);     // B: receive from below, send up
+
+  for (i=0; i < 2; i++) {
+    blockA[i] = allocateAligned((size_t) b*b);
+    blockB[i] = allocateAligned((size_t) b*b);
+  } // end for i
+  blockC = allocateAligned((size_t) b*b);
+  buffer = allocateAligned((size_t) b*b);
+
+  if (myID == RootProcess) {
+    printf("n = %d (%s scaling, padded to %d) on a %d x %d process grid, %d x %d blocks\n",
+	   n, weak ? "weak" : "strong", paddedN, q, q, b, b);
+    A = allocateMatrix(paddedN, paddedN);
+    B = allocateMatrix(paddedN, paddedN);
+    C = allocateMatrix(paddedN, paddedN);
+    srand(5);
+    generateRandomMatrix(A, n, -1.0, +1.0);
+    generateRandomMatrix(B, n, -1.0, +1.0);
+  } // end if
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  GET_TIME(clockStart);
+
+  /* Distribute pre-aligned: process (i,j) gets A(i,(i+j)%q) and B((i+j)%q,j) */
+  if (myID == RootProcess) {
+    for (p=0; p < numProcs; p++) {
+      MPI_Cart_coords(gridComm, p, 2, coords);
+      i = coords[0];
+      j = coords[1];
+      if (p == RootProcess) {
+	copyBlock(b, b, MATRIX_ROW(A, i*b) + ((i+j)%q)*b, A->ld, blockA[0], b);
+	copyBlock(b, b, MATRIX_ROW(B, ((i+j)%q)*b) + j*b, B->ld, blockB[0], b);
+      } else {
+	copyBlock(b, b, MATRIX_ROW(A, i*b) + ((i+j)%q)*b, A->ld, buffer, b);
+	MPI_Send(buffer, b*b, MPI_DOUBLE, p, tag, gridComm);
+	copyBlock(b, b, MATRIX_ROW(B, ((i+j)%q)*b) + j*b, B->ld, buffer, b);
+	MPI_Send(buffer, b*b, MPI_DOUBLE, p, tag, gridComm);
+      } // end if
+    } // end for p
+  } else {
+    MPI_Recv(blockA[0], b*b, MPI_DOUBLE, RootProcess, tag, gridComm, &status);
+    MPI_Recv(blockB[0], b*b, MPI_DOUBLE, RootProcess, tag, gridComm, &status);
+  } // end if
+
+  /* Cannon: multiply the current pair while the next one arrives */
+  gemmDefaultBlocking(&blocking);
+  kernel = gemmBestKernel();
+  memset(blockC, 0, sizeof(double) * (size_t) b*b);
+  MPI_Barrier(gridComm);
+  GET_TIME(multiplyStart);
+  times[1] = 0.0;
+  for (step=0; step < q; step++) {
+    current = step % 2;
+    if (step+1 < q) {
+      MPI_Irecv(blockA[1-current], b*b, MPI_DOUBLE, right, tag, gridComm, &requests[0]);
+      MPI_Irecv(blockB[1-current], b*b, MPI_DOUBLE, down, tag, gridComm, &requests[1]);
+      MPI_Isend(blockA[current], b*b, MPI_DOUBLE, left, tag, gridComm, &requests[2]);
+      MPI_Isend(blockB[current], b*b, MPI_DOUBLE, up, tag, gridComm, &requests[3]);
+    } // end if
+    gemmPackedAdd(b, b, b, blockA[current], b, blockB[current], b, blockC, b,
+		  &blocking, kernel);
+    if (step+1 < q) {
+      GET_TIME(waitStart);
+      MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+      GET_TIME(clockEnd);
+      times[1] += clockEnd - waitStart;
+    } // end if
+  } // end for step
+  GET_TIME(clockEnd);
+  times[0] = clockEnd - multiplyStart;
+
+  /* Gather C blocks back to root */
+  if (myID == RootProcess) {
+    for (p=0; p < numProcs; p++) {
+      MPI_Cart_coords(gridComm, p, 2, coords);
+      if (p == RootProcess) {
+	copyBlock(b, b, blockC, b, MATRIX_ROW(C, coords[0]*b) + coords[1]*b, C->ld);
+      } else {
+	MPI_Recv(buffer, b*b, MPI_DOUBLE, p, tag, gridComm, &status);
+	copyBlock(b, b, buffer, b, MATRIX_ROW(C, coords[0]*b) + coords[1]*b, C->ld);
+      } // end if
+    } // end for p
+  } else {
+    MPI_Send(blockC, b*b, MPI_DOUBLE, RootProcess, tag, gridComm);
+  } // end if
+
+  GET_TIME(clockEnd);
+  totalTime = clockEnd - clockStart;
+  // the slowest process sets the pace
+  MPI_Reduce(times, maxTimes, 2, MPI_DOUBLE, MPI_MAX, RootProcess, gridComm);
+
+  if (myID == RootProcess) {
+    flops = 2.0*n*(double) n*n;
+    printf("Time for Cannon multiply with %d processes (incl. distribute/gather) %3.5f seconds\n",
+	   numProcs, totalTime);
+
+    C_seq = allocateMatrix(n, n);
+    GET_TIME(clockStart);
+    gemmPacked(n, n, n, A->data, A->ld, B->data, B->ld, C_seq->data, C_seq->ld,
+	       &blocking, kernel);
+    GET_TIME(clockEnd);
+    seqTime = clockEnd - clockStart;
+    printf("Time for sequential multiply %3.5f seconds\n", seqTime);
+
+    maxError = 0.0;
+    for (i=0; i < n; i++) {
+      for (j=0; j < n; j++) {
+	if (fabs(MATRIX_ELEMENT(C, i, j) - MATRIX_ELEMENT(C_seq, i, j)) > maxError) {
+	  maxError = fabs(MATRIX_ELEMENT(C, i, j) - MATRIX_ELEMENT(C_seq, i, j));
+	} // end if
+      } // end for j
+    } // end for i
+    if (maxError <= 0.000001) {
+      printf("Arrays match with tolerance of %.10f\n", 0.000001);
+    } else {
+      printf("Arrays DON'T match with tolerance of %.10f (max. error %e)\n",
+	     0.000001, maxError);
+    } // end if
+    freeMatrix(C_seq);
+
+    /* Scaling report.  Strong: the same n on one process takes seqTime,
+       ideal is seqTime / P.  Weak: every process does the flops of one
+       baseN multiply, ideal is the one-process time for baseN. */
+    if (weak) {
+      C_seq = allocateMatrix(baseN, baseN);
+      GET_TIME(clockStart);
+      gemmPacked(baseN, baseN, baseN, A->data, A->ld, B->data, B->ld,
+		 C_seq->data, C_seq->ld, &blocking, kernel);
+      GET_TIME(clockEnd);
+      baseTime = clockEnd - clockStart;
+      freeMatrix(C_seq);
+    } else {
+      baseTime = seqTime / numProcs;
+    } // end if
+    printf("Scaling report (%s, P = %d, n = %d):\n", weak ? "weak" : "strong",
+	   numProcs, n);
+    printf("  multiply time %3.5f seconds (shift wait %3.5f, %4.1f%%)\n",
+	   maxTimes[0], maxTimes[1], 100.0 * maxTimes[1] / maxTimes[0]);
+    printf("  %1.2f GFLOP/s total, %1.2f GFLOP/s per process\n",
+	   flops / maxTimes[0] * 1.0e-9, flops / maxTimes[0] / numProcs * 1.0e-9);
+    printf("  %s efficiency %4.1f%% (ideal time %3.5f seconds)\n",
+	   weak ? "weak" : "strong", 100.0 * baseTime / maxTimes[0], baseTime);
+    printf("  compare: ../hw6/mmult %d %d simd  (GFLOP/s per thread)\n", n, numProcs);
+    freeMatrix(A);
+    freeMatrix(B);
+    freeMatrix(C);
+  } // end if
+
+  for (i=0; i < 2; i++) {
+    free(blockA[i]);
+    free(blockB[i]);
+  } // end for i
+  free(blockC);
+  free(buffer);
+  MPI_Comm_free(&gridComm);
+
+  MPI_Finalize();
+  return 0;
+} /* end main */
+
+
+/*******************************************************************
+ * Function gridSide returns q if numProcs == q*q, else 0.
+ ********************************************************************/
+int gridSide(int numProcs) {
+  int q = (int) (sqrt((double) numProcs) + 0.5);
+
+  return (q*q == numProcs) ? q : 0;
+} // end gridSide
+
+
+/*******************************************************************
+ * Function copyBlock copies a rows x columns block between two
+ * row-major arrays with the given leading dimensions.
+ ********************************************************************/
+void copyBlock(int rows, int columns, const double * from, int ldFrom,
+	       double * to, int ldTo) {
+  int r;
+
+  for (r=0; r < rows; r++) {
+    memcpy(to + (size_t) r*ldTo, from + (size_t) r*ldFrom, sizeof(double)*columns);
+  } // end for r
+} // end copyBlock
+
+
+/*******************************************************************
+ * Function generateRandomMatrix fills the leading n x n of a matrix
+ * with random doubles between min and max and zeros the padding.
+ ********************************************************************/
+void generateRandomMatrix(MATRIX * matrix, int n, double min, double max) {
+  int r, c;
+  double range, div;
+
+  for (r = 0; r < matrix->rows; r++) {
+    for (c = 0; c < matrix->columns; c++) {
+      if (r < n && c < n) {
+	range = max - min;
+	div = RAND_MAX / range;
+	MATRIX_ELEMENT(matrix, r, c) = min + (rand() / div);
+      } else {
+	MATRIX_ELEMENT(matrix, r, c) = 0.0;
+      } // end if
+    } // end for (c...
+  } // end for (r...
+} // end generateRandomMatrix
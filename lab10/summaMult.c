@@ -0,0 +1,383 @@
+/*  File:        summaMult.c
+ *  Compile as:  mpicc -o summaMult -O3 -I../common summaMult.c ../common/gemm.c
+ *                 ../common/gemmSimd.c ../common/matrix.c -lm
+ *  Run by:      mpirun -np 4 ./summaMult 2000 128    (or qsub qsub.summaMult)
+ *  Description:  An MPI matrix multiply C = A*B using SUMMA on a 2D
+ *  process grid.  A, B and C are split into blocks of rows and columns,
+ *  one block per process.  For each panel of the inner dimension the
+ *  process column owning that slice of A broadcasts it along its grid
+ *  row, the process row owning that slice of B broadcasts it down its
+ *  grid column, and every process adds the panel product into its C
+ *  block.  The next panel's broadcasts (MPI_Ibcast) are posted before
+ *  the current panel's local multiply so communication overlaps work.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+#include "timer.h"
+#include "matrix.h"
+#include "gemm.h"
+
+#define RootProcess 0
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+const int tag = 1;
+
+// one panel of the inner dimension: global columns of A / rows of B
+typedef struct {
+  int start;
+  int width;
+  int ownerColumn;  // grid column holding these columns of A
+  int ownerRow;     // grid row holding these rows of B
+} PANEL;
+
+int blockStart(int length, int parts, int index);
+int blockOwner(int length, int parts, int global);
+int buildPanels(int n, int gridRows, int gridColumns, int panelWidth,
+		PANEL * panels);
+void postPanel(PANEL * panel, MATRIX * localA, MATRIX * localB,
+	       int myRow, int myColumn, int localRows, int localColumns,
+	       int kStartA, int kStartB, double * panelA, double * panelB,
+	       MPI_Comm rowComm, MPI_Comm columnComm, MPI_Request * requests);
+void copyBlock(int rows, int columns, const double * from, int ldFrom,
+	       double * to, int ldTo);
+void generateRandomMatrix(MATRIX * matrix, double min, double max);
+
+int main(int argc, char* argv[]) {
+  int myID, numProcs, p, i, n, panelWidth = 128, maxPanelWidth;
+  int dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2], keep[2];
+  int gridRows, gridColumns, myRow, myColumn;
+  int localRows, localColumns, localInnerA, localInnerB, kStartA, kStartB;
+  int numberOfPanels, current, pRows, pColumns, pRowStart, pColumnStart;
+  MPI_Comm gridComm, rowComm, columnComm;
+  MPI_Request requests[2][2];
+  MPI_Status status;
+  MATRIX * A = NULL, * B = NULL, * C = NULL, * C_seq;
+  MATRIX * localA, * localB, * localC;
+  PANEL * panels;
+  double * panelA[2], * panelB[2], * buffer;
+  double clockStart, clockEnd, parallelTime, seqTime, maxError;
+  GEMM_BLOCKING blocking;
+  const GEMM_KERNEL * kernel;
+  BOOL badArgs;
+
+  MPI_Init(&argc, &argv);  /* Initialize MPI */
+  MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &myID);
+
+  // all processes have access to argc and argv, and all decide alike
+  badArgs = (argc < 2 || argc > 3 || sscanf(argv[1], "%d", &n) != 1 || n < 1
+	     || (argc == 3 && sscanf(argv[2], "%d", &panelWidth) != 1));
+
+  // 2D process grid with row and column sub-communicators
+  MPI_Dims_create(numProcs, 2, dims);
+  // a panel never crosses a block of either split, so the first (widest)
+  // blocks bound its width; a width < 1 never advances buildPanels
+  maxPanelWidth = blockStart(n, dims[0], 1);
+  if (blockStart(n, dims[1], 1) < maxPanelWidth) {
+    maxPanelWidth = blockStart(n, dims[1], 1);
+  } // end if
+  if (argc == 2 && panelWidth > maxPanelWidth) {
+    panelWidth = maxPanelWidth;  // only a width asked for is rejected
+  } // end if
+  if (badArgs || panelWidth < 1 || panelWidth > maxPanelWidth) {
+    if (myID == RootProcess) {
+      printf("Usage: %s <# integer matrix size> [<panel width>]\n", argv[0]);
+      if (!badArgs) {
+	printf("       the panel width must be 1..%d on a %d x %d process grid\n",
+	       maxPanelWidth, dims[0], dims[1]);
+      } // end if
+    } // end if
+    MPI_Finalize();
+    return 0;
+  } // end if
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, FALSE, &gridComm);
+  MPI_Cart_coords(gridComm, myID, 2, coords);
+  gridRows = dims[0];
+  gridColumns = dims[1];
+  myRow = coords[0];
+  myColumn = coords[1];
+  keep[0] = FALSE;  keep[1] = TRUE;
+  MPI_Cart_sub(gridComm, keep, &rowComm);     // my grid row; rank == column
+  keep[0] = TRUE;   keep[1] = FALSE;
+  MPI_Cart_sub(gridComm, keep, &columnComm);  // my grid column; rank == row
+
+  // my blocks: A is rows(myRow) x cols(myColumn), likewise B and C
+  localRows = blockStart(n, gridRows, myRow+1) - blockStart(n, gridRows, myRow);
+  localColumns = blockStart(n, gridColumns, myColumn+1)
+    - blockStart(n, gridColumns, myColumn);
+  localInnerA = localColumns;  // A columns follow the grid columns
+  localInnerB = localRows;     // B rows follow the grid rows
+  kStartA = blockStart(n, gridColumns, myColumn);
+  kStartB = blockStart(n, gridRows, myRow);
+  localA = allocateMatrix(localRows, localInnerA);
+  localB = allocateMatrix(localInnerB, localColumns);
+  localC = allocateMatrix(localRows, localColumns);
+
+  if (myID == RootProcess) {
+    printf("n = %d on a %d x %d process grid, panel width %d\n",
+	   n, gridRows, gridColumns, panelWidth);
+    A = allocateMatrix(n, n);
+    B = allocateMatrix(n, n);
+    C = allocateMatrix(n, n);
+    srand(5);
+    generateRandomMatrix(A, -1.0, +1.0);
+    generateRandomMatrix(B, -1.0, +1.0);
+  } // end if
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  GET_TIME(clockStart);
+
+  /* Distribute: root packs each process's blocks of A and B and sends them */
+  if (myID == RootProcess) {
+    buffer = (double *) malloc(sizeof(double) * ((size_t) (n/gridRows+1) * (n/gridColumns+1)));
+    for (p=0; p < numProcs; p++) {
+      MPI_Cart_coords(gridComm, p, 2, coords);
+      pRowStart = blockStart(n, gridRows, coords[0]);
+      pRows = blockStart(n, gridRows, coords[0]+1) - pRowStart;
+      pColumnStart = blockStart(n, gridColumns, coords[1]);
+      pColumns = blockStart(n, gridColumns, coords[1]+1) - pColumnStart;
+      if (p == RootProcess) {
+	copyBlock(pRows, pColumns, MATRIX_ROW(A, pRowStart) + pColumnStart, A->ld,
+		  localA->data, localA->ld);
+	copyBlock(pRows, pColumns, MATRIX_ROW(B, pRowStart) + pColumnStart, B->ld,
+		  localB->data, localB->ld);
+      } else {
+	copyBlock(pRows, pColumns, MATRIX_ROW(A, pRowStart) + pColumnStart, A->ld,
+		  buffer, pColumns);
+	MPI_Send(buffer, pRows*pColumns, MPI_DOUBLE, p, tag, MPI_COMM_WORLD);
+	copyBlock(pRows, pColumns, MATRIX_ROW(B, pRowStart) + pColumnStart, B->ld,
+		  buffer, pColumns);
+	MPI_Send(buffer, pRows*pColumns, MPI_DOUBLE, p, tag, MPI_COMM_WORLD);
+      } // end if
+    } // end for p
+  } else {
+    buffer = (double *) malloc(sizeof(double) * ((size_t) localRows * localColumns + 1));
+    MPI_Recv(buffer, localRows*localColumns, MPI_DOUBLE, RootProcess, tag,
+	     MPI_COMM_WORLD, &status);
+    copyBlock(localRows, localColumns, buffer, localColumns, localA->data, localA->ld);
+    MPI_Recv(buffer, localRows*localColumns, MPI_DOUBLE, RootProcess, tag,
+	     MPI_COMM_WORLD, &status);
+    copyBlock(localRows, localColumns, buffer, localColumns, localB->data, localB->ld);
+  } // end if
+
+  /* SUMMA with double-buffered panels */
+  panels = (PANEL *) malloc(sizeof(PANEL) * (2*n + 1));
+  numberOfPanels = buildPanels(n, gridRows, gridColumns, panelWidth, panels);
+  for (i=0; i < 2; i++) {
+    panelA[i] = allocateAligned((size_t) localRows * panelWidth + 1);
+    panelB[i] = allocateAligned((size_t) panelWidth * localColumns + 1);
+  } // end for i
+  gemmDefaultBlocking(&blocking);
+  kernel = gemmBestKernel();
+  memset(localC->data, 0, sizeof(double) * (size_t) localC->rows * localC->ld);
+
+  postPanel(&panels[0], localA, localB, myRow, myColumn, localRows, localColumns,
+	    kStartA, kStartB, panelA[0], panelB[0], rowComm, columnComm, requests[0]);
+  for (i=0; i < numberOfPanels; i++) {
+    current = i % 2;
+    if (i+1 < numberOfPanels) {
+      postPanel(&panels[i+1], localA, localB, myRow, myColumn, localRows,
+		localColumns, kStartA, kStartB, panelA[1-current], panelB[1-current],
+		rowComm, columnComm, requests[1-current]);
+    } // end if
+    MPI_Waitall(2, requests[current], MPI_STATUSES_IGNORE);
+    gemmPackedAdd(localRows, localColumns, panels[i].width,
+		  panelA[current], panels[i].width, panelB[current], localColumns,
+		  localC->data, localC->ld, &blocking, kernel);
+  } // end for i
+
+  /* Gather C blocks back to root */
+  if (myID == RootProcess) {
+    for (p=0; p < numProcs; p++) {
+      MPI_Cart_coords(gridComm, p, 2, coords);
+      pRowStart = blockStart(n, gridRows, coords[0]);
+      pRows = blockStart(n, gridRows, coords[0]+1) - pRowStart;
+      pColumnStart = blockStart(n, gridColumns, coords[1]);
+      pColumns = blockStart(n, gridColumns, coords[1]+1) - pColumnStart;
+      if (p == RootProcess) {
+	copyBlock(pRows, pColumns, localC->data, localC->ld,
+		  MATRIX_ROW(C, pRowStart) + pColumnStart, C->ld);
+      } else {
+	MPI_Recv(buffer, pRows*pColumns, MPI_DOUBLE, p, tag, MPI_COMM_WORLD, &status);
+	copyBlock(pRows, pColumns, buffer, pColumns,
+		  MATRIX_ROW(C, pRowStart) + pColumnStart, C->ld);
+      } // end if
+    } // end for p
+  } else {
+    copyBlock(localRows, localColumns, localC->data, localC->ld, buffer, localColumns);
+    MPI_Send(buffer, localRows*localColumns, MPI_DOUBLE, RootProcess, tag, MPI_COMM_WORLD);
+  } // end if
+
+  GET_TIME(clockEnd);
+  parallelTime = clockEnd - clockStart;
+
+  if (myID == RootProcess) {
+    printf("Time for SUMMA multiply with %d processes (incl. distribute/gather) %3.5f seconds (%1.2f GFLOP/s)\n",
+	   numProcs, parallelTime, 2.0*n*(double) n*n / parallelTime * 1.0e-9);
+
+    C_seq = allocateMatrix(n, n);
+    GET_TIME(clockStart);
+    gemmPacked(n, n, n, A->data, A->ld, B->data, B->ld, C_seq->data, C_seq->ld,
+	       &blocking, kernel);
+    GET_TIME(clockEnd);
+    seqTime = clockEnd - clockStart;
+    printf("Time for sequential multiply %3.5f seconds\n", seqTime);
+
+    maxError = 0.0;
+    for (i=0; i < n; i++) {
+      for (p=0; p < n; p++) {
+	if (fabs(MATRIX_ELEMENT(C, i, p) - MATRIX_ELEMENT(C_seq, i, p)) > maxError) {
+	  maxError = fabs(MATRIX_ELEMENT(C, i, p) - MATRIX_ELEMENT(C_seq, i, p));
+	} // end if
+      } // end for p
+    } // end for i
+    if (maxError <= 0.000001) {
+      printf("Arrays match with tolerance of %.10f\n", 0.000001);
+    } else {
+      printf("Arrays DON'T match with tolerance of %.10f (max. error %e)\n",
+	     0.000001, maxError);
+    } // end if
+    freeMatrix(A);
+    freeMatrix(B);
+    freeMatrix(C);
+    freeMatrix(C_seq);
+  } // end if
+
+  for (i=0; i < 2; i++) {
+    free(panelA[i]);
+    free(panelB[i]);
+  } // end for i
+  free(panels);
+  free(buffer);
+  freeMatrix(localA);
+  freeMatrix(localB);
+  freeMatrix(localC);
+  MPI_Comm_free(&rowComm);
+  MPI_Comm_free(&columnComm);
+  MPI_Comm_free(&gridComm);
+
+  MPI_Finalize();
+  return 0;
+} /* end main */
+
+
+/*******************************************************************
+ * Function blockStart returns the first global index of block index
+ * when length items are split into parts nearly equal blocks (the
+ * first length % parts blocks get one extra).  blockStart(.., parts)
+ * is length.
+ ********************************************************************/
+int blockStart(int length, int parts, int index) {
+  int base = length / parts;
+  int extra = length % parts;
+
+  return index*base + ((index < extra) ? index : extra);
+} // end blockStart
+
+
+/*******************************************************************
+ * Function blockOwner returns the block that holds global index.
+ ********************************************************************/
+int blockOwner(int length, int parts, int global) {
+  int owner = 0;
+
+  while (blockStart(length, parts, owner+1) <= global) {
+    owner++;
+  } // end while
+  return owner;
+} // end blockOwner
+
+
+/*******************************************************************
+ * Function buildPanels cuts the inner dimension into panels of at
+ * most panelWidth that never cross a block boundary of either A's
+ * column split or B's row split, and returns the # of panels.
+ ********************************************************************/
+int buildPanels(int n, int gridRows, int gridColumns, int panelWidth,
+		PANEL * panels) {
+  int k = 0, count = 0, end, endA, endB;
+
+  while (k < n) {
+    panels[count].ownerColumn = blockOwner(n, gridColumns, k);
+    panels[count].ownerRow = blockOwner(n, gridRows, k);
+    endA = blockStart(n, gridColumns, panels[count].ownerColumn+1);
+    endB = blockStart(n, gridRows, panels[count].ownerRow+1);
+    end = k + panelWidth;
+    if (endA < end) {
+      end = endA;
+    } // end if
+    if (endB < end) {
+      end = endB;
+    } // end if
+    panels[count].start = k;
+    panels[count].width = end - k;
+    count++;
+    k = end;
+  } // end while
+  return count;
+} // end buildPanels
+
+
+/*******************************************************************
+ * Function postPanel starts the two broadcasts of a panel: the owner
+ * column copies its slice of A into panelA and broadcasts it along
+ * the grid row, and the owner row copies its slice of B into panelB
+ * and broadcasts it down the grid column.
+ ********************************************************************/
+void postPanel(PANEL * panel, MATRIX * localA, MATRIX * localB,
+	       int myRow, int myColumn, int localRows, int localColumns,
+	       int kStartA, int kStartB, double * panelA, double * panelB,
+	       MPI_Comm rowComm, MPI_Comm columnComm, MPI_Request * requests) {
+
+  if (myColumn == panel->ownerColumn) {
+    copyBlock(localRows, panel->width, MATRIX_ROW(localA, 0) + panel->start - kStartA,
+	      localA->ld, panelA, panel->width);
+  } // end if
+  if (myRow == panel->ownerRow) {
+    copyBlock(panel->width, localColumns, MATRIX_ROW(localB, panel->start - kStartB),
+	      localB->ld, panelB, localColumns);
+  } // end if
+  MPI_Ibcast(panelA, localRows*panel->width, MPI_DOUBLE, panel->ownerColumn,
+	     rowComm, &requests[0]);
+  MPI_Ibcast(panelB, panel->width*localColumns, MPI_DOUBLE, panel->ownerRow,
+	     columnComm, &requests[1]);
+
+} // end postPanel
+
+
+/*******************************************************************
+ * Function copyBlock copies a rows x columns block between two
+ * row-major arrays with the given leading dimensions.
+ ********************************************************************/
+void copyBlock(int rows, int columns, const double * from, int ldFrom,
+	       double * to, int ldTo) {
+  int r;
+
+  for (r=0; r < rows; r++) {
+    memcpy(to + (size_t) r*ldTo, from + (size_t) r*ldFrom, sizeof(double)*columns);
+  } // end for r
+} // end copyBlock
+
+
+/*******************************************************************
+ * Function generateRandomMatrix fills a matrix with random doubles
+ * between min and max.
+ ********************************************************************/
+void generateRandomMatrix(MATRIX * matrix, double min, double max) {
+  int r, c;
+  double range, div;
+
+  for (r = 0; r < matrix->rows; r++) {
+    for (c = 0; c < matrix->columns; c++) {
+      range = max - min;
+      div = RAND_MAX / range;
+      MATRIX_ELEMENT(matrix, r, c) = min + (rand() / div);
+    } // end for (c...
+  } // end for (r...
+} // end generateRandomMatrix
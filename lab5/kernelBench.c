@@ -0,0 +1,460 @@
+/*  File:        kernelBench.c
+    Description: Benchmark suite for the matrix multiply and add
+    kernels used by the lab5, hw6, lab7 and lab8 programs.  Every
+    kernel runs over each size and thread count with warmup runs and
+    timed repeats, and one record per (kernel, size, threads) gives
+    the min / median / p95 / mean time, GFLOP/s, GB/s and arithmetic
+    intensity against the roofline measured on this host for that
+    thread count (see benchmark.h).  Output is CSV or JSON on stdout
+    so runs can be saved and compared for regressions.
+    Threads split the rows of the result into one band each on a
+    thread pool.  Kernels:
+      mult-naive        i-j-k triple loop (lab5 matrixMultiplication),
+                        only up to NAIVE_MAX_N
+      mult-alt          transpose B, then row-by-row dot products
+                        (matrixMultiplicationAlt), transpose included
+      mult-tiled        gemmTiled, portable scalar micro-kernel
+      mult-<kernel>     gemmPacked with each micro-kernel this CPU runs
+      add               Sum = A + B        (lab8 addRows before vectorAdd)
+      add-accumulate    Sum += A + B       (lab7 maddC / maddD before it)
+      add-<kernel>, add-<kernel>-nt, add-accumulate-<kernel>[-nt]
+                        the same with vectorAdd.h's SIMD kernel, with
+                        ordinary and with non-temporal stores
+    Bytes are the compulsory traffic: each matrix read or written
+    once (8 bytes per element), write-allocate reads not counted.
+    The memory roof is DRAM bandwidth measured by a STREAM triad, so
+    an add's roof_fraction is its GB/s against the triad's, and above
+    1 means the operands stayed in cache at that size.
+    Compile by:  gcc -O3 -march=native -I../common -o kernelBench kernelBench.c
+                 ../common/benchmark.c ../common/threadPool.c ../common/gemm.c
+                 ../common/gemmSimd.c ../common/matrix.c ../common/transpose.c
+                 ../common/vectorAdd.c -lm -lpthread
+    Run by:      ./kernelBench csv > bench.csv
+                 ./kernelBench json 256,512,1024,2048 1,2,4,8 1 9 > bench.json
+                 (format, sizes, thread counts, # warmup runs, # timed runs)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "timer.h"
+#include "matrix.h"
+#include "gemm.h"
+#include "transpose.h"
+#include "threadPool.h"
+#include "benchmark.h"
+#include "vectorAdd.h"
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+#define MAX_LIST 32       // most sizes / thread counts on the command line
+#define MAX_KERNELS 8     // most gemmPacked micro-kernels
+#define NAIVE_MAX_N 512   // the triple loop is skipped above this size
+
+// everything one timed call needs
+typedef struct {
+  THREAD_POOL * pool;
+  int n;
+  MATRIX * A;
+  MATRIX * B;
+  MATRIX * C;
+  MATRIX * BT;                  // mult-alt: transpose of B
+  GEMM_BLOCKING blocking;
+  const GEMM_KERNEL * kernel;   // mult-<kernel>
+  BOOL nonTemporal;             // add-<kernel>-nt: streaming stores
+  double ** workspace;          // mult-<kernel>: each worker's packing space
+  void (*band)(void * arg, int task, int threadId);  // work on one row band
+} BENCH_ARGS;
+
+// function prototypes
+int parseList(const char * text, int * list);
+void runKernel(FILE * out, int format, const char * name, BENCH_ARGS * args,
+	       double flops, double bytes, int warmup, int repeats,
+	       const BENCH_ROOFLINE * roofline);
+void runBands(void * arg);
+void runAlt(void * arg);
+void bandRows(BENCH_ARGS * args, int task, int * first, int * last);
+void naiveBand(void * arg, int task, int threadId);
+void altBand(void * arg, int task, int threadId);
+void tiledBand(void * arg, int task, int threadId);
+void packedBand(void * arg, int task, int threadId);
+void addBand(void * arg, int task, int threadId);
+void accumulateBand(void * arg, int task, int threadId);
+void vectorAddBand(void * arg, int task, int threadId);
+void vectorAccumulateBand(void * arg, int task, int threadId);
+void fillMatrix(MATRIX * matrix, unsigned int seed);
+
+int main(int argc, char ** argv) {
+  int sizes[MAX_LIST] = {256, 512, 1024}, threads[MAX_LIST] = {1, 0};
+  int numberOfSizes = 3, numberOfThreadCounts = 2, warmup = 1, repeats = 5;
+  int format, s, t, k, n, numberOfKernels;
+  const GEMM_KERNEL * kernels[MAX_KERNELS];
+  BENCH_ROOFLINE roofline;
+  BENCH_ARGS args;
+  char host[256], name[64];
+  double n3, n2;
+  size_t workspaceSize;
+
+  if (argc < 2 || argc == 5 || argc > 6
+      || (strcmp(argv[1], "csv") != 0 && strcmp(argv[1], "json") != 0)) {
+    printf("Usage: %s <csv | json> [<sizes, e.g. 256,512,1024> [<thread counts, e.g. 1,4> [<# warmup runs> <# timed runs>]]]\n",
+	   argv[0]);
+    exit(-1);
+  } // end if
+  format = (strcmp(argv[1], "json") == 0) ? BENCH_FORMAT_JSON : BENCH_FORMAT_CSV;
+  threads[1] = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads[1] == 1) {
+    numberOfThreadCounts = 1;
+  } // end if
+  if (argc >= 3) {
+    numberOfSizes = parseList(argv[2], sizes);
+  } // end if
+  if (argc >= 4) {
+    numberOfThreadCounts = parseList(argv[3], threads);
+  } // end if
+  if (argc == 6) {
+    sscanf(argv[4], "%d", &warmup);
+    sscanf(argv[5], "%d", &repeats);
+  } // end if
+  if (numberOfSizes == 0 || numberOfThreadCounts == 0) {
+    printf("Sizes and thread counts must be positive integers separated by commas\n");
+    exit(-1);
+  } // end if
+
+  if (gethostname(host, sizeof(host)) != 0) {
+    strcpy(host, "unknown");
+  } // end if
+  host[sizeof(host)-1] = '\0';
+  numberOfKernels = gemmSupportedKernels(kernels, MAX_KERNELS);
+  gemmDefaultBlocking(&args.blocking);
+
+  benchmarkBegin(stdout, format, host);
+  for (t=0; t < numberOfThreadCounts; t++) {
+    args.pool = threadPoolCreate(threads[t]);
+    benchmarkRoofline(args.pool, &roofline);
+    benchmarkRoofRecord(stdout, format, &roofline);
+
+    for (s=0; s < numberOfSizes; s++) {
+      n = sizes[s];
+      n3 = (double) n*n*n;
+      n2 = (double) n*n;
+      args.n = n;
+      args.A = allocateMatrix(n, n);
+      args.B = allocateMatrix(n, n);
+      args.C = allocateMatrix(n, n);
+      args.BT = allocateMatrix(n, n);
+      fillMatrix(args.A, 5);
+      fillMatrix(args.B, 7);
+      fillMatrix(args.C, 11);
+      // packing space for the widest kernel, allocated outside the timing
+      args.workspace = (double **) malloc(threads[t]*sizeof(double *));
+      workspaceSize = 0;
+      for (k=0; k < numberOfKernels; k++) {
+	if (gemmWorkspaceSize(n, n, &args.blocking, kernels[k]) > workspaceSize) {
+	  workspaceSize = gemmWorkspaceSize(n, n, &args.blocking, kernels[k]);
+	} // end if
+      } // end for k
+      for (k=0; k < threads[t]; k++) {
+	args.workspace[k] = allocateAligned(workspaceSize);
+      } // end for k
+
+      if (n <= NAIVE_MAX_N) {
+	args.band = naiveBand;
+	runKernel(stdout, format, "mult-naive", &args, 2.0*n3, 24.0*n2, warmup,
+		  repeats, &roofline);
+      } // end if
+      args.band = altBand;
+      runKernel(stdout, format, "mult-alt", &args, 2.0*n3, 24.0*n2, warmup,
+		repeats, &roofline);
+      args.band = tiledBand;
+      runKernel(stdout, format, "mult-tiled", &args, 2.0*n3, 24.0*n2, warmup,
+		repeats, &roofline);
+      for (k=0; k < numberOfKernels; k++) {
+	args.kernel = kernels[k];
+	args.band = packedBand;
+	snprintf(name, sizeof(name), "mult-%s", kernels[k]->name);
+	runKernel(stdout, format, name, &args, 2.0*n3, 24.0*n2, warmup,
+		  repeats, &roofline);
+      } // end for k
+      args.band = addBand;
+      runKernel(stdout, format, "add", &args, n2, 24.0*n2, warmup,
+		repeats, &roofline);
+      args.band = accumulateBand;
+      runKernel(stdout, format, "add-accumulate", &args, 2.0*n2, 32.0*n2, warmup,
+		repeats, &roofline);
+      for (k=0; k < 2; k++) {
+	args.nonTemporal = k;
+	args.band = vectorAddBand;
+	snprintf(name, sizeof(name), "add-%s%s", vectorAddKernelName(), k ? "-nt" : "");
+	runKernel(stdout, format, name, &args, n2, 24.0*n2, warmup,
+		  repeats, &roofline);
+	args.band = vectorAccumulateBand;
+	snprintf(name, sizeof(name), "add-accumulate-%s%s", vectorAddKernelName(),
+		 k ? "-nt" : "");
+	runKernel(stdout, format, name, &args, 2.0*n2, 32.0*n2, warmup,
+		  repeats, &roofline);
+      } // end for k
+
+      freeMatrix(args.A);
+      freeMatrix(args.B);
+      freeMatrix(args.C);
+      freeMatrix(args.BT);
+      for (k=0; k < threads[t]; k++) {
+	free(args.workspace[k]);
+      } // end for k
+      free(args.workspace);
+    } // end for s
+    threadPoolDestroy(args.pool);
+  } // end for t
+  benchmarkEnd(stdout, format);
+
+  return 0;
+} // end main
+
+
+/*******************************************************************
+ * Function parseList reads a comma-separated list of positive ints
+ * (at most MAX_LIST) into list and returns how many, 0 if any is bad.
+ ********************************************************************/
+int parseList(const char * text, int * list) {
+  int count = 0, value, used;
+
+  while (count < MAX_LIST && sscanf(text, "%d%n", &value, &used) == 1) {
+    if (value <= 0) {
+      return 0;
+    } // end if
+    list[count++] = value;
+    text += used;
+    if (*text != ',') {
+      break;
+    } // end if
+    text++;
+  } // end while
+  return (*text == '\0') ? count : 0;
+} // end parseList
+
+
+/*******************************************************************
+ * Function runKernel times one kernel and writes its record.
+ ********************************************************************/
+void runKernel(FILE * out, int format, const char * name, BENCH_ARGS * args,
+	       double flops, double bytes, int warmup, int repeats,
+	       const BENCH_ROOFLINE * roofline) {
+  BENCH_RESULT result;
+
+  result.kernel = name;
+  result.n = args->n;
+  result.numberOfThreads = args->pool->numberOfThreads;
+  result.flops = flops;
+  result.bytes = bytes;
+  benchmarkTime((args->band == altBand) ? runAlt : runBands, args, warmup, repeats,
+		&result.stats);
+  benchmarkRecord(out, format, &result, roofline);
+} // end runKernel
+
+
+/*******************************************************************
+ * Function runBands - one timed call: every row band on the pool.
+ ********************************************************************/
+void runBands(void * arg) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+
+  threadPoolRun(args->pool, args->pool->numberOfThreads, args->band, args);
+} // end runBands
+
+
+/*******************************************************************
+ * Function runAlt - one timed mult-alt call: the transpose of B is
+ * part of the kernel, as in matrixMultiplicationAlt.
+ ********************************************************************/
+void runAlt(void * arg) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+
+  transposeBlocked(args->n, args->n, args->B->data, args->B->ld,
+		   args->BT->data, args->BT->ld, args->pool->numberOfThreads);
+  runBands(arg);
+} // end runAlt
+
+
+/*******************************************************************
+ * Function bandRows returns the rows [first, last) of band task.
+ ********************************************************************/
+void bandRows(BENCH_ARGS * args, int task, int * first, int * last) {
+  int bands = args->pool->numberOfThreads;
+
+  *first = (int) ((long) args->n * task / bands);
+  *last = (int) ((long) args->n * (task+1) / bands);
+} // end bandRows
+
+
+/*******************************************************************
+ * Function naiveBand - i-j-k loops over the band's rows of C.
+ ********************************************************************/
+void naiveBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  double ** a = args->A->row, ** b = args->B->row, ** c = args->C->row;
+  int first, last, i, j, k, n = args->n;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  for (i=first; i < last; i++) {
+    for (j=0; j < n; j++) {
+      c[i][j] = 0.0;
+      for (k=0; k < n; k++) {
+	c[i][j] += a[i][k]*b[k][j];
+      } // end for (k
+    } // end for (j
+  } // end for (i
+} // end naiveBand
+
+
+/*******************************************************************
+ * Function altBand - dot products of the band's rows of A with the
+ * rows of B's transpose.
+ ********************************************************************/
+void altBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  double ** a = args->A->row, ** bt = args->BT->row, ** c = args->C->row;
+  double sum;
+  int first, last, i, j, k, n = args->n;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  for (i=first; i < last; i++) {
+    for (j=0; j < n; j++) {
+      sum = 0.0;
+      for (k=0; k < n; k++) {
+	sum += a[i][k]*bt[j][k];
+      } // end for (k
+      c[i][j] = sum;
+    } // end for (j
+  } // end for (i
+} // end altBand
+
+
+/*******************************************************************
+ * Function tiledBand - gemmTiled on the band's rows.
+ ********************************************************************/
+void tiledBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  int first, last;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  gemmTiled(last - first, args->n, args->n, MATRIX_ROW(args->A, first), args->A->ld,
+	    args->B->data, args->B->ld, MATRIX_ROW(args->C, first), args->C->ld,
+	    &args->blocking);
+} // end tiledBand
+
+
+/*******************************************************************
+ * Function packedBand - gemmPacked with args->kernel on the band,
+ * packing into the worker's own workspace.
+ ********************************************************************/
+void packedBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  int first, last;
+
+  bandRows(args, task, &first, &last);
+  gemmPackedWorkspace(last - first, args->n, args->n, MATRIX_ROW(args->A, first),
+		      args->A->ld, args->B->data, args->B->ld,
+		      MATRIX_ROW(args->C, first), args->C->ld, &args->blocking,
+		      args->kernel, args->workspace[threadId]);
+} // end packedBand
+
+
+/*******************************************************************
+ * Function addBand - C = A + B over the band's rows.
+ ********************************************************************/
+void addBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  const double * restrict a;
+  const double * restrict b;
+  double * restrict c;
+  int first, last, r, j, n = args->n;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  for (r=first; r < last; r++) {
+    a = MATRIX_ROW(args->A, r);
+    b = MATRIX_ROW(args->B, r);
+    c = MATRIX_ROW(args->C, r);
+    for (j=0; j < n; j++) {
+      c[j] = a[j] + b[j];
+    } // end for (j
+  } // end for (r
+} // end addBand
+
+
+/*******************************************************************
+ * Function accumulateBand - C += A + B over the band's rows.
+ ********************************************************************/
+void accumulateBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  const double * restrict a;
+  const double * restrict b;
+  double * restrict c;
+  int first, last, r, j, n = args->n;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  for (r=first; r < last; r++) {
+    a = MATRIX_ROW(args->A, r);
+    b = MATRIX_ROW(args->B, r);
+    c = MATRIX_ROW(args->C, r);
+    for (j=0; j < n; j++) {
+      c[j] += a[j] + b[j];
+    } // end for (j
+  } // end for (r
+} // end accumulateBand
+
+
+/*******************************************************************
+ * Function vectorAddBand - C = A + B over the band's rows with
+ * vectorAdd (one call per row, rows are padded to the ld).
+ ********************************************************************/
+void vectorAddBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  int first, last, r;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  for (r=first; r < last; r++) {
+    vectorAdd(MATRIX_ROW(args->C, r), MATRIX_ROW(args->A, r), MATRIX_ROW(args->B, r),
+	      args->n, args->nonTemporal);
+  } // end for (r
+} // end vectorAddBand
+
+
+/*******************************************************************
+ * Function vectorAccumulateBand - C += A + B over the band's rows
+ * with vectorAddAccumulate.
+ ********************************************************************/
+void vectorAccumulateBand(void * arg, int task, int threadId) {
+  BENCH_ARGS * args = (BENCH_ARGS *) arg;
+  int first, last, r;
+
+  (void) threadId;
+  bandRows(args, task, &first, &last);
+  for (r=first; r < last; r++) {
+    vectorAddAccumulate(MATRIX_ROW(args->C, r), MATRIX_ROW(args->A, r),
+			MATRIX_ROW(args->B, r), args->n, args->nonTemporal);
+  } // end for (r
+} // end vectorAccumulateBand
+
+
+/*******************************************************************
+ * Function fillMatrix fills a matrix with random doubles in [-1, 1).
+ ********************************************************************/
+void fillMatrix(MATRIX * matrix, unsigned int seed) {
+  int r, c;
+
+  srand(seed);
+  for (r=0; r < matrix->rows; r++) {
+    for (c=0; c < matrix->columns; c++) {
+      MATRIX_ELEMENT(matrix, r, c) = -1.0 + 2.0 * rand() / ((double) RAND_MAX + 1.0);
+    } // end for (c
+  } // end for (r
+} // end fillMatrix
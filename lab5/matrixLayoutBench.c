@@ -0,0 +1,269 @@
+/*  File:        matrixLayoutBench.c
+    Description: Compares the old row-pointer layout (one malloc per row
+    from allocate2DArray) against the contiguous MATRIX layout on a
+    square multiply and add.  Both layouts run the same i-k-j loop
+    order; only the storage and the pointer aliasing differ.
+    Compile by:  gcc -O3 -march=native -I../common -o layoutBench matrixLayoutBench.c
+                 ../common/matrix.c -lm
+    Run by:      ./layoutBench 4096
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "timer.h"
+#include "matrix.h"
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+// function prototypes
+double ** allocate2DArray(int rows, int columns);
+void free2DArray(int rows, double ** array2D);
+void fill2DArray(int rows, int columns, double ** array2D, unsigned int seed);
+void multiplyRowPointers(int n, double ** array1, double ** array2,
+			 double ** product);
+void multiplyContiguous(MATRIX * array1, MATRIX * array2, MATRIX * product);
+void addRowPointers(int n, double ** array1, double ** array2,
+		    double ** arraySum);
+void addContiguous(MATRIX * array1, MATRIX * array2, MATRIX * arraySum);
+BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
+		   double tolerance);
+
+int main(int argc, char ** argv) {
+  double ** A_old, ** B_old, ** C_old;
+  MATRIX * A, * B, * C;
+  int n;
+  double startTime, endTime, oldTime, newTime, flops, bytes;
+
+  if (argc != 2) {
+    printf("Usage: %s <# integer matrix size>\n", argv[0]);
+    exit(-1);
+  } // end if
+
+  sscanf(argv[1], "%d", &n);
+
+  A_old = allocate2DArray(n, n);
+  B_old = allocate2DArray(n, n);
+  C_old = allocate2DArray(n, n);
+  A = allocateMatrix(n, n);
+  B = allocateMatrix(n, n);
+  C = allocateMatrix(n, n);
+
+  // same values in both layouts
+  fill2DArray(n, n, A_old, 5);
+  fill2DArray(n, n, B_old, 7);
+  fill2DArray(n, n, A->row, 5);
+  fill2DArray(n, n, B->row, 7);
+
+  printf("after initializing matrices\n");
+
+  flops = 2.0 * n * (double) n * n;
+  GET_TIME(startTime);
+  multiplyRowPointers(n, A_old, B_old, C_old);
+  GET_TIME(endTime);
+  oldTime = endTime - startTime;
+
+  GET_TIME(startTime);
+  multiplyContiguous(A, B, C);
+  GET_TIME(endTime);
+  newTime = endTime - startTime;
+
+  printf("Multiply row-pointer time = %10.4f  (%6.2f GFLOP/s)\n",
+	 oldTime, flops / oldTime * 1.0e-9);
+  printf("Multiply contiguous time  = %10.4f  (%6.2f GFLOP/s)  speedup %.2fx\n",
+	 newTime, flops / newTime * 1.0e-9, oldTime / newTime);
+  if (!equal2DArrays(n, n, C_old, C->row, 0.0)) {
+    printf("Multiply results DON'T match\n");
+  } // end if
+
+  bytes = 3.0 * sizeof(double) * n * (double) n;
+  GET_TIME(startTime);
+  addRowPointers(n, A_old, B_old, C_old);
+  GET_TIME(endTime);
+  oldTime = endTime - startTime;
+
+  GET_TIME(startTime);
+  addContiguous(A, B, C);
+  GET_TIME(endTime);
+  newTime = endTime - startTime;
+
+  printf("Add row-pointer time      = %10.4f  (%6.2f GB/s)\n",
+	 oldTime, bytes / oldTime * 1.0e-9);
+  printf("Add contiguous time       = %10.4f  (%6.2f GB/s)  speedup %.2fx\n",
+	 newTime, bytes / newTime * 1.0e-9, oldTime / newTime);
+  if (!equal2DArrays(n, n, C_old, C->row, 0.0)) {
+    printf("Add results DON'T match\n");
+  } // end if
+
+  free2DArray(n, A_old);
+  free2DArray(n, B_old);
+  free2DArray(n, C_old);
+  freeMatrix(A);
+  freeMatrix(B);
+  freeMatrix(C);
+  return 0;
+
+} // end main
+
+
+/*******************************************************************
+ * Function multiplyRowPointers computes product = array1*array2 in
+ * i-k-j order through the double ** row pointers.
+ ********************************************************************/
+void multiplyRowPointers(int n, double ** array1, double ** array2,
+			 double ** product) {
+  int i, j, k;
+  double a;
+
+  for (i=0; i < n; i++) {
+    for (j=0; j < n; j++) {
+      product[i][j] = 0.0;
+    } // end for (j
+    for (k=0; k < n; k++) {
+      a = array1[i][k];
+      for (j=0; j < n; j++) {
+        product[i][j] += a*array2[k][j];
+      } // end for (j
+    } // end for (k
+  } // end for (i
+
+} // end multiplyRowPointers
+
+
+/*******************************************************************
+ * Function multiplyContiguous computes product = array1*array2 in
+ * i-k-j order on the contiguous layout.  The restrict row pointers
+ * tell the compiler the rows cannot alias, so the j loop vectorizes.
+ ********************************************************************/
+void multiplyContiguous(MATRIX * array1, MATRIX * array2, MATRIX * product) {
+  int n = product->rows;
+  int i, j, k;
+  double a;
+  double * restrict productRow;
+  const double * restrict array2Row;
+
+  for (i=0; i < n; i++) {
+    productRow = MATRIX_ROW(product, i);
+    for (j=0; j < n; j++) {
+      productRow[j] = 0.0;
+    } // end for (j
+    for (k=0; k < n; k++) {
+      a = MATRIX_ELEMENT(array1, i, k);
+      array2Row = MATRIX_ROW(array2, k);
+      for (j=0; j < n; j++) {
+        productRow[j] += a*array2Row[j];
+      } // end for (j
+    } // end for (k
+  } // end for (i
+
+} // end multiplyContiguous
+
+
+/*******************************************************************
+ * Function addRowPointers computes arraySum = array1+array2 through
+ * the double ** row pointers.
+ ********************************************************************/
+void addRowPointers(int n, double ** array1, double ** array2,
+		    double ** arraySum) {
+  int r, c;
+
+  for (r = 0; r < n; r++) {
+    for (c = 0; c < n; c++) {
+      arraySum[r][c] = array1[r][c] + array2[r][c];
+    } // end for (c...
+  } // end for (r...
+
+} // end addRowPointers
+
+
+/*******************************************************************
+ * Function addContiguous computes arraySum = array1+array2 on the
+ * contiguous layout, row by row over the logical columns only (the
+ * row padding is never initialized).
+ ********************************************************************/
+void addContiguous(MATRIX * array1, MATRIX * array2, MATRIX * arraySum) {
+  int r, c;
+  const double * restrict a;
+  const double * restrict b;
+  double * restrict sum;
+
+  for (r = 0; r < arraySum->rows; r++) {
+    a = MATRIX_ROW(array1, r);
+    b = MATRIX_ROW(array2, r);
+    sum = MATRIX_ROW(arraySum, r);
+    for (c = 0; c < arraySum->columns; c++) {
+      sum[c] = a[c] + b[c];
+    } // end for (c...
+  } // end for (r...
+
+} // end addContiguous
+
+
+/*******************************************************************
+ * Function allocate2DArray dynamically allocates a 2D array of
+ * size rows x columns, and returns it.  (The old layout.)
+ ********************************************************************/
+double ** allocate2DArray(int rows, int columns) {
+  double ** local2DArray;
+  int r;
+
+  local2DArray = (double **) malloc(sizeof(double *)*rows);
+
+  for (r=0; r < rows; r++) {
+    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
+  } // end for
+
+  return local2DArray;
+} // end allocate2DArray
+
+
+/*******************************************************************
+ * Function free2DArray frees a 2D array from allocate2DArray.
+ ********************************************************************/
+void free2DArray(int rows, double ** array2D) {
+  int r;
+
+  for (r=0; r < rows; r++) {
+    free(array2D[r]);
+  } // end for
+  free(array2D);
+} // end free2DArray
+
+
+/*******************************************************************
+ * Function fill2DArray fills a 2D array with random doubles in
+ * [-1, +1] from the given seed.
+ ********************************************************************/
+void fill2DArray(int rows, int columns, double ** array2D, unsigned int seed) {
+  int r, c;
+
+  for (r = 0; r < rows; r++) {
+    for (c = 0; c < columns; c++) {
+      array2D[r][c] = -1.0 + rand_r(&seed) / (RAND_MAX / 2.0);
+    } // end for (c...
+  } // end for (r...
+} // end fill2DArray
+
+
+/*******************************************************************
+ * Function equal2DArrays is passed the # rows, # columns, two
+ * array2Ds, and tolerance.  It returns TRUE if corresponding array
+ * elements are equal within the specified tolerance; otherwise it
+ * returns FALSE.
+ ********************************************************************/
+BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
+		   double tolerance) {
+
+  int r, c;
+
+  for(r = 0; r < rows; r++) {
+    for (c = 0; c < columns; c++) {
+      if (fabs(array1[r][c] - array2[r][c]) > tolerance) {
+        return FALSE;
+      } // end if
+    } // end for (c...
+  } // end for(r...
+  return TRUE;
+
+} // end equal2DArray
@@ -0,0 +1,181 @@
+/* Program to time many small independent products C[i] = A[i]*B[i]
+   (8x8 to 64x64), one matrixMultiplicationAlt call per product
+   against the batched multiply of batchGemm.h, which keeps the
+   matrices interleaved so each vector instruction works on 8
+   products at once, uses a kernel compiled for the size, and spreads
+   the batch over a thread pool without allocating anything per call.
+   Compile by:  gcc -O3 -march=native -I../common -o mmultBatch mmultBatch.c
+                ../common/batchGemm.c ../common/threadPool.c ../common/matrix.c
+                ../common/counterRandom.c -lm -lpthread
+   Run by:  ./mmultBatch 8 200000 4     (matrix size, # products, # threads)
+            ./mmultBatch 64 2000 4
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "timer.h"
+#include "matrix.h"         // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
+#include "threadPool.h"     // persistent worker pool
+#include "batchGemm.h"      // batched small-matrix multiply
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+// function prototypes
+void matrixMultiplicationAlt(int rows1, int columns1, double ** array1,
+			     int rows2, int columns2, double ** array2,
+			     double ** product);
+void printRate(const char * label, double seconds, int n, int count);
+
+int main(int argc, char ** argv) {
+  MATRIX ** A, ** B, ** C;
+  MATRIX * product;
+  BATCH * batchA, * batchB, * batchC;
+  THREAD_POOL * pool;
+  int n, count, numberOfThreads, i, r, c;
+  double startTime, endTime, error = 0.0;
+  uint64_t seed;
+
+  if (argc != 4) {
+    printf("Usage: %s <matrix size 1-%d> <# products> <# of threads>\n", argv[0],
+	   BATCH_MAX_N);
+    exit(-1);
+  } // end if
+  sscanf(argv[1], "%d", &n);
+  sscanf(argv[2], "%d", &count);
+  sscanf(argv[3], "%d", &numberOfThreads);
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+
+  // seed the counter-based generator: stream seed for A, seed+1 for B
+  seed = (uint64_t) time(NULL);
+
+  A = (MATRIX **) malloc(sizeof(MATRIX *)*count);
+  B = (MATRIX **) malloc(sizeof(MATRIX *)*count);
+  C = (MATRIX **) malloc(sizeof(MATRIX *)*count);
+  batchA = allocateBatch(n, count);
+  batchB = allocateBatch(n, count);
+  batchC = allocateBatch(n, count);
+  for (i=0; i < count; i++) {
+    A[i] = allocateMatrix(n, n);
+    B[i] = allocateMatrix(n, n);
+    C[i] = allocateMatrix(n, n);
+    generateCounterRandomBlock(A[i]->row, n, 0, n-1, 0, n-1, seed + 2*(uint64_t) i,
+			       -1.0, +1.0);
+    generateCounterRandomBlock(B[i]->row, n, 0, n-1, 0, n-1, seed + 2*(uint64_t) i+1,
+			       -1.0, +1.0);
+    batchSetMatrix(batchA, i, A[i]->row);
+    batchSetMatrix(batchB, i, B[i]->row);
+  } // end for
+  printf("after initializing %d pairs of %d x %d matrices (%s kernel)\n", count, n, n,
+	 batchKernelIsSpecialized(n) ? "size-specialized" : "generic");
+
+  GET_TIME(startTime);
+  for (i=0; i < count; i++) {
+    matrixMultiplicationAlt(n, n, A[i]->row, n, n, B[i]->row, C[i]->row);
+  } // end for
+  GET_TIME(endTime);
+  printRate("matrixMultiplicationAlt per call", endTime - startTime, n, count);
+
+  GET_TIME(startTime);
+  batchMultiply(NULL, batchA, batchB, batchC);
+  GET_TIME(endTime);
+  printRate("Batched (sequential)", endTime - startTime, n, count);
+
+  pool = threadPoolCreate(numberOfThreads);
+  GET_TIME(startTime);
+  batchMultiply(pool, batchA, batchB, batchC);
+  GET_TIME(endTime);
+  printf("%d threads: ", numberOfThreads);
+  printRate("Batched (pool)", endTime - startTime, n, count);
+  threadPoolDestroy(pool);
+
+  product = allocateMatrix(n, n);
+  for (i=0; i < count; i++) {
+    batchGetMatrix(batchC, i, product->row);
+    for (r=0; r < n; r++) {
+      for (c=0; c < n; c++) {
+	if (fabs(product->row[r][c] - C[i]->row[r][c]) > error) {
+	  error = fabs(product->row[r][c] - C[i]->row[r][c]);
+	} // end if
+      } // end for (c
+    } // end for (r
+  } // end for (i
+  if (error <= 0.000001) {
+    printf("Arrays match with tolerance of %.10f (max. error %e)\n", 0.000001, error);
+  } else {
+    printf("Arrays DON'T match with tolerance of %.10f (max. error %e)\n", 0.000001,
+	   error);
+  } // end if
+
+  for (i=0; i < count; i++) {
+    freeMatrix(A[i]);
+    freeMatrix(B[i]);
+    freeMatrix(C[i]);
+  } // end for
+  free(A);
+  free(B);
+  free(C);
+  freeMatrix(product);
+  freeBatch(batchA);
+  freeBatch(batchB);
+  freeBatch(batchC);
+
+  return 0;
+} // end main
+
+
+/*******************************************************************
+ * Function printRate prints a time for count n x n products with the
+ * time per product and the GFLOP/s.
+ ********************************************************************/
+void printRate(const char * label, double seconds, int n, int count) {
+  printf("%s time = %1.4f (%1.3f usec per product, %1.2f GFLOP/s)\n", label,
+	 seconds, seconds / count * 1.0e6,
+	 2.0*n*(double) n*n*count / seconds * 1.0e-9);
+} // end printRate
+
+
+/*******************************************************************
+ * Function matrixMultiplicationAlt passed two matrices and returns
+ * their product.
+ ********************************************************************/
+void matrixMultiplicationAlt(int rows1, int columns1, double ** array1,
+			     int rows2, int columns2, double ** array2,
+			     double ** product) {
+  int i, j, k;
+  MATRIX * transpose;
+  double ** array2_transpose;
+
+  if (columns1 != rows2) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
+
+  // Transposes array2
+  transpose = allocateMatrix(columns2, rows2);
+  array2_transpose = transpose->row;
+  for (i=0; i < rows2; i++) {
+    for (j=0; j < columns2; j++) {
+      array2_transpose[j][i] = array2[i][j];
+    } /* end for (j */
+  } /* end for (i */
+
+  // Matrix Multiplication uses array1 and array2_transpose
+  for (i=0; i < rows1; i++) {
+    for (j=0; j < columns2; j++) {
+      product[i][j] = 0.0;
+      for (k=0; k < columns1; k++) {
+        product[i][j] += array1[i][k]*array2_transpose[j][k];
+      } /* end for (k */
+    } /* end for (j */
+  } /* end for (i */
+
+  freeMatrix(transpose);
+
+} // end matrixMultiplicationAlt
@@ -0,0 +1,399 @@
+/* Program to multiply two matrices that live in files written by
+   writeRandom2DArray (either layout in matrixFile.h) when they don't
+   fit in memory.  C = A*B is computed one T x T tile of C at a time,
+   streaming the A and B tiles it needs from disk.  Only five tiles are
+   ever in memory -- two A/B pairs and the C tile -- plus the packing
+   buffers of the multiply, so T is picked from the memory budget.  A
+   loader thread reads the next A/B pair while the current pair is
+   multiplied (a two-slot bounded buffer, as in lab8), and each
+   finished C tile is written to a version 1 file.
+   Compile by:  gcc -O3 -I../common -o mmultOOC mmultOutOfCore.c
+                ../common/matrixFile.c ../common/gemm.c ../common/gemmSimd.c
+                ../common/matrix.c -lm -lpthread
+   Run by:  ./write2D 4000 4000 A.dat -1.0 1.0
+            ./write2D 4000 4000 B.dat -1.0 1.0
+            ./mmultOOC A.dat B.dat C.dat 64 [verify]   (memory budget in MB)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "timer.h"
+#include "matrix.h"      // contiguous MATRIX type
+#include "matrixFile.h"  // matrix file layouts
+#include "gemm.h"        // packed-panel multiply
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+#define SLOTS 2          // A/B tile pairs in flight: one in use, one loading
+#define TILES_IN_MEMORY (2*SLOTS + 1)
+
+// one A/B tile pair of the schedule
+typedef struct {
+  double * a;       // T x T, leading dimension T
+  double * b;
+} SLOT;
+
+// state shared by the compute (main) thread and the loader thread
+typedef struct {
+  MATRIX_FILE * fileA;
+  MATRIX_FILE * fileB;
+  int m, n, k;              // C is m x n, inner dimension k
+  int tile;                 // T
+  int mTiles, nTiles, kTiles;
+  long numberOfSteps;       // mTiles*nTiles*kTiles
+  SLOT slots[SLOTS];
+  int numberFull;
+  pthread_mutex_t lock;
+  pthread_cond_t nonFull;
+  pthread_cond_t nonEmpty;
+  double readTime;          // seconds the loader spent in pread
+  double bytesRead;
+} OUT_OF_CORE;
+
+// function prototypes
+void * loaderWork(void * args);
+void stepToTile(OUT_OF_CORE * ooc, long step, int * it, int * jt, int * kt);
+void readTile(int fd, size_t dataOffset, int ld, int row, int column,
+	      int rows, int columns, double * tile, int tileLd);
+void writeTile(int fd, size_t dataOffset, int ld, int row, int column,
+	       int rows, int columns, double * tile, int tileLd);
+int tileSizeForBudget(double budgetMB, int m, int n, int k,
+		      const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel);
+double footprintMB(int tile, const GEMM_BLOCKING * blocking,
+		   const GEMM_KERNEL * kernel);
+double maxError2DArrays(int rows, int columns, MATRIX * reference,
+			MATRIX * array2D);
+
+
+int main(int argc, char ** argv) {
+  OUT_OF_CORE ooc;
+  MATRIX_FILE * fileC;
+  MATRIX * C_seq;
+  SLOT * slot;
+  pthread_t loaderHandle;
+  GEMM_BLOCKING blocking;
+  const GEMM_KERNEL * kernel;
+  double * tileC;
+  double * workspace;
+  double budgetMB, startTime, endTime, wallTime, computeTime = 0.0;
+  double waitTime = 0.0, writeTime = 0.0, bytesWritten = 0.0;
+  double tStart, tEnd, maxError;
+  long step;
+  int i, it, jt, kt, tileRows, tileColumns, depth;
+  BOOL verify;
+
+  if (argc < 5 || argc > 6 || (argc == 6 && strcmp(argv[5], "verify") != 0)) {
+    printf("Usage: %s <A file> <B file> <C file> <memory budget MB> [verify]\n",
+	   argv[0]);
+    exit(-1);
+  } // end if
+  sscanf(argv[4], "%lf", &budgetMB);
+  verify = (argc == 6);
+
+  if ((ooc.fileA = mapMatrixFile(argv[1])) == NULL
+      || (ooc.fileB = mapMatrixFile(argv[2])) == NULL) {
+    exit(-1);
+  } // end if
+  ooc.m = ooc.fileA->matrix.rows;
+  ooc.k = ooc.fileA->matrix.columns;
+  ooc.n = ooc.fileB->matrix.columns;
+  if (ooc.fileB->matrix.rows != ooc.k) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
+
+  gemmDefaultBlocking(&blocking);
+  kernel = gemmBestKernel();
+  ooc.tile = tileSizeForBudget(budgetMB, ooc.m, ooc.n, ooc.k, &blocking, kernel);
+  ooc.mTiles = (ooc.m + ooc.tile - 1) / ooc.tile;
+  ooc.nTiles = (ooc.n + ooc.tile - 1) / ooc.tile;
+  ooc.kTiles = (ooc.k + ooc.tile - 1) / ooc.tile;
+  ooc.numberOfSteps = (long) ooc.mTiles * ooc.nTiles * ooc.kTiles;
+  for (i=0; i < SLOTS; i++) {
+    ooc.slots[i].a = allocateAligned((size_t) ooc.tile * ooc.tile);
+    ooc.slots[i].b = allocateAligned((size_t) ooc.tile * ooc.tile);
+  } // end for
+  tileC = allocateAligned((size_t) ooc.tile * ooc.tile);
+  workspace = allocateAligned(gemmWorkspaceSize(ooc.tile, ooc.tile, &blocking, kernel));
+  ooc.numberFull = 0;
+  ooc.readTime = 0.0;
+  ooc.bytesRead = 0.0;
+  pthread_mutex_init(&ooc.lock, NULL);
+  pthread_cond_init(&ooc.nonFull, NULL);
+  pthread_cond_init(&ooc.nonEmpty, NULL);
+
+  printf("C (%d x %d) = A (%d x %d) * B (%d x %d), %d x %d tiles, %.1f MB of tiles and packing\n",
+	 ooc.m, ooc.n, ooc.m, ooc.k, ooc.k, ooc.n, ooc.tile, ooc.tile,
+	 footprintMB(ooc.tile, &blocking, kernel));
+
+  if ((fileC = createMatrixFile(argv[3], ooc.m, ooc.n)) == NULL) {
+    exit(-1);
+  } // end if
+
+  GET_TIME(startTime);
+  pthread_create(&loaderHandle, NULL, loaderWork, &ooc);
+
+  for (step = 0; step < ooc.numberOfSteps; step++) {
+    // wait for the loader to fill this step's slot
+    GET_TIME(tStart);
+    pthread_mutex_lock(&ooc.lock);
+    while (ooc.numberFull == 0) {
+      pthread_cond_wait(&ooc.nonEmpty, &ooc.lock);
+    } // end while
+    pthread_mutex_unlock(&ooc.lock);
+    GET_TIME(tEnd);
+    waitTime += tEnd - tStart;
+
+    slot = &ooc.slots[step % SLOTS];
+    stepToTile(&ooc, step, &it, &jt, &kt);
+    tileRows = (it+1)*ooc.tile < ooc.m ? ooc.tile : ooc.m - it*ooc.tile;
+    tileColumns = (jt+1)*ooc.tile < ooc.n ? ooc.tile : ooc.n - jt*ooc.tile;
+    depth = (kt+1)*ooc.tile < ooc.k ? ooc.tile : ooc.k - kt*ooc.tile;
+
+    GET_TIME(tStart);
+    if (kt == 0) {
+      gemmPackedWorkspace(tileRows, tileColumns, depth, slot->a, ooc.tile, slot->b,
+			  ooc.tile, tileC, ooc.tile, &blocking, kernel, workspace);
+    } else {
+      gemmPackedAddWorkspace(tileRows, tileColumns, depth, slot->a, ooc.tile, slot->b,
+			     ooc.tile, tileC, ooc.tile, &blocking, kernel, workspace);
+    } // end if
+    GET_TIME(tEnd);
+    computeTime += tEnd - tStart;
+
+    // hand the slot back to the loader
+    pthread_mutex_lock(&ooc.lock);
+    ooc.numberFull--;
+    pthread_cond_signal(&ooc.nonFull);
+    pthread_mutex_unlock(&ooc.lock);
+
+    if (kt == ooc.kTiles - 1) {
+      GET_TIME(tStart);
+      writeTile(fileC->fd, fileC->dataOffset, fileC->matrix.ld, it*ooc.tile,
+		jt*ooc.tile, tileRows, tileColumns, tileC, ooc.tile);
+      GET_TIME(tEnd);
+      writeTime += tEnd - tStart;
+      bytesWritten += (double) tileRows * tileColumns * sizeof(double);
+    } // end if
+  } // end for
+
+  pthread_join(loaderHandle, NULL);
+  GET_TIME(endTime);
+  wallTime = endTime - startTime;
+
+  printf("Out-of-core multiply time = %1.3f (%1.2f GFLOP/s)\n", wallTime,
+	 2.0*ooc.m*(double) ooc.n*ooc.k / wallTime * 1.0e-9);
+  printf("  compute   %8.3f s  utilization %5.1f%%  (%1.2f GFLOP/s while computing)\n",
+	 computeTime, 100.0*computeTime / wallTime,
+	 2.0*ooc.m*(double) ooc.n*ooc.k / computeTime * 1.0e-9);
+  printf("  read      %8.3f s  %8.1f MB  %8.1f MB/s  (loader thread, overlapped)\n",
+	 ooc.readTime, ooc.bytesRead / 1.0e6, ooc.bytesRead / 1.0e6 / ooc.readTime);
+  printf("  write     %8.3f s  %8.1f MB  %8.1f MB/s\n", writeTime,
+	 bytesWritten / 1.0e6, bytesWritten / 1.0e6 / writeTime);
+  printf("  stalled   %8.3f s  waiting for tiles\n", waitTime);
+
+  if (verify) {
+    C_seq = allocateMatrix(ooc.m, ooc.n);
+    gemmPacked(ooc.m, ooc.n, ooc.k, ooc.fileA->matrix.data, ooc.fileA->matrix.ld,
+	       ooc.fileB->matrix.data, ooc.fileB->matrix.ld, C_seq->data, C_seq->ld,
+	       &blocking, kernel);
+    maxError = maxError2DArrays(ooc.m, ooc.n, C_seq, &fileC->matrix);
+    if (maxError <= 0.000001) {
+      printf("Arrays match with tolerance of %.10f\n", 0.000001);
+    } else {
+      printf("Arrays DON'T match with tolerance of %.10f (max. error %e)\n",
+	     0.000001, maxError);
+    } // end if
+    freeMatrix(C_seq);
+  } // end if
+
+  unmapMatrixFile(fileC);
+  unmapMatrixFile(ooc.fileA);
+  unmapMatrixFile(ooc.fileB);
+  for (i=0; i < SLOTS; i++) {
+    free(ooc.slots[i].a);
+    free(ooc.slots[i].b);
+  } // end for
+  free(tileC);
+  free(workspace);
+
+  return 0;
+
+} // end main
+
+
+/*******************************************************************
+ * Function loaderWork - the loader thread walks the same schedule
+ * as main, reading each step's A and B tiles into the next free
+ * slot, so the reads for step s+1 overlap the multiply of step s.
+ ********************************************************************/
+void * loaderWork(void * args) {
+  OUT_OF_CORE * ooc = (OUT_OF_CORE *) args;
+  MATRIX_FILE * fileA = ooc->fileA;
+  MATRIX_FILE * fileB = ooc->fileB;
+  SLOT * slot;
+  long step;
+  int it, jt, kt, tileRows, tileColumns, depth;
+  double tStart, tEnd;
+
+  for (step = 0; step < ooc->numberOfSteps; step++) {
+    pthread_mutex_lock(&ooc->lock);
+    while (ooc->numberFull == SLOTS) {
+      pthread_cond_wait(&ooc->nonFull, &ooc->lock);
+    } // end while
+    pthread_mutex_unlock(&ooc->lock);
+
+    slot = &ooc->slots[step % SLOTS];
+    stepToTile(ooc, step, &it, &jt, &kt);
+    tileRows = (it+1)*ooc->tile < ooc->m ? ooc->tile : ooc->m - it*ooc->tile;
+    tileColumns = (jt+1)*ooc->tile < ooc->n ? ooc->tile : ooc->n - jt*ooc->tile;
+    depth = (kt+1)*ooc->tile < ooc->k ? ooc->tile : ooc->k - kt*ooc->tile;
+
+    GET_TIME(tStart);
+    readTile(fileA->fd, fileA->dataOffset, fileA->matrix.ld, it*ooc->tile,
+	     kt*ooc->tile, tileRows, depth, slot->a, ooc->tile);
+    readTile(fileB->fd, fileB->dataOffset, fileB->matrix.ld, kt*ooc->tile,
+	     jt*ooc->tile, depth, tileColumns, slot->b, ooc->tile);
+    GET_TIME(tEnd);
+
+    pthread_mutex_lock(&ooc->lock);
+    ooc->readTime += tEnd - tStart;
+    ooc->bytesRead += (double) depth * (tileRows + tileColumns) * sizeof(double);
+    ooc->numberFull++;
+    pthread_cond_signal(&ooc->nonEmpty);
+    pthread_mutex_unlock(&ooc->lock);
+  } // end for
+
+  return NULL;
+} // end loaderWork
+
+
+/*******************************************************************
+ * Function stepToTile maps a schedule step to tile indices: C tiles
+ * in row order, and for each C tile every k tile in turn.
+ ********************************************************************/
+void stepToTile(OUT_OF_CORE * ooc, long step, int * it, int * jt, int * kt) {
+  *kt = (int) (step % ooc->kTiles);
+  *jt = (int) ((step / ooc->kTiles) % ooc->nTiles);
+  *it = (int) (step / ((long) ooc->kTiles * ooc->nTiles));
+} // end stepToTile
+
+
+/*******************************************************************
+ * Function readTile reads the rows x columns block at (row, column)
+ * of a matrix file whose rows are ld doubles apart into tile, one
+ * pread per tile row.
+ ********************************************************************/
+void readTile(int fd, size_t dataOffset, int ld, int row, int column,
+	      int rows, int columns, double * tile, int tileLd) {
+  int r;
+  size_t want, done;
+  ssize_t got;
+  off_t offset;
+
+  for (r = 0; r < rows; r++) {
+    offset = (off_t) (dataOffset + ((size_t) (row + r) * ld + column) * sizeof(double));
+    want = (size_t) columns * sizeof(double);
+    for (done = 0; done < want; done += (size_t) got) {
+      got = pread(fd, (char *) (tile + (size_t) r*tileLd) + done, want - done,
+		  offset + (off_t) done);
+      if (got <= 0) {
+	printf("Read of tile row %d failed\n", row + r);
+	exit(-1);
+      } // end if
+    } // end for
+  } // end for
+} // end readTile
+
+
+/*******************************************************************
+ * Function writeTile writes tile to the rows x columns block at
+ * (row, column) of a matrix file, one pwrite per tile row.
+ ********************************************************************/
+void writeTile(int fd, size_t dataOffset, int ld, int row, int column,
+	       int rows, int columns, double * tile, int tileLd) {
+  int r;
+  size_t want, done;
+  ssize_t put;
+  off_t offset;
+
+  for (r = 0; r < rows; r++) {
+    offset = (off_t) (dataOffset + ((size_t) (row + r) * ld + column) * sizeof(double));
+    want = (size_t) columns * sizeof(double);
+    for (done = 0; done < want; done += (size_t) put) {
+      put = pwrite(fd, (char *) (tile + (size_t) r*tileLd) + done, want - done,
+		   offset + (off_t) done);
+      if (put <= 0) {
+	printf("Write of tile row %d failed\n", row + r);
+	exit(-1);
+      } // end if
+    } // end for
+  } // end for
+} // end writeTile
+
+
+/*******************************************************************
+ * Function tileSizeForBudget returns the largest tile edge T (a
+ * multiple of 8, at least 8) whose TILES_IN_MEMORY tiles and packing
+ * workspace fit in budgetMB, no bigger than the largest matrix
+ * dimension.
+ ********************************************************************/
+int tileSizeForBudget(double budgetMB, int m, int n, int k,
+		      const GEMM_BLOCKING * blocking, const GEMM_KERNEL * kernel) {
+  int tile, largest;
+
+  tile = (int) sqrt(budgetMB * 1.0e6 / (TILES_IN_MEMORY * sizeof(double)));
+  tile = tile / 8 * 8;
+  // the packing buffers grow with T only up to the mc x kc and kc x nc
+  // panels, so shrinking T a step at a time soon makes room for them
+  while (tile > 8 && footprintMB(tile, blocking, kernel) > budgetMB) {
+    tile -= 8;
+  } // end while
+  if (tile < 8) {
+    tile = 8;
+  } // end if
+  largest = m > n ? m : n;
+  largest = largest > k ? largest : k;
+  if (tile > largest) {
+    tile = largest;
+  } // end if
+  return tile;
+} // end tileSizeForBudget
+
+
+/*******************************************************************
+ * Function footprintMB returns the MB held by TILES_IN_MEMORY T x T
+ * tiles plus the multiply's packing workspace for a T x T tile.
+ ********************************************************************/
+double footprintMB(int tile, const GEMM_BLOCKING * blocking,
+		   const GEMM_KERNEL * kernel) {
+  return (TILES_IN_MEMORY * (double) tile * tile
+	  + gemmWorkspaceSize(tile, tile, blocking, kernel)) * sizeof(double) / 1.0e6;
+} // end footprintMB
+
+
+/*******************************************************************
+ * Function maxError2DArrays returns the largest absolute difference
+ * between corresponding elements of two matrices.
+ ********************************************************************/
+double maxError2DArrays(int rows, int columns, MATRIX * reference,
+			MATRIX * array2D) {
+  int r, c;
+  double maxError = 0.0;
+
+  for (r = 0; r < rows; r++) {
+    for (c = 0; c < columns; c++) {
+      if (fabs(MATRIX_ELEMENT(reference, r, c) - MATRIX_ELEMENT(array2D, r, c))
+	  > maxError) {
+	maxError = fabs(MATRIX_ELEMENT(reference, r, c) - MATRIX_ELEMENT(array2D, r, c));
+      } // end if
+    } // end for (c...
+  } // end for (r...
+  return maxError;
+
+} // end maxError2DArrays
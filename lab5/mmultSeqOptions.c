@@ -1,22 +1,40 @@
 /* Program to generate two square 2D arrays of random doubles and
    time their multiplication.
-   Compile by:  gcc -O5 -o mmult mmultSeqOptions.c -lm
+   Compile by:  gcc -O5 -march=native -I../common -o mmult mmultSeqOptions.c
+                ../common/gemm.c ../common/gemmSimd.c ../common/gemmFloat.c
+                ../common/matrix.c ../common/transpose.c
+                ../common/strassen.c ../common/threadPool.c
+                ../common/counterRandom.c ../common/autotune.c -lm -lpthread
    Run by:  ./mmult 1000
+            ./mmult 1000 tiled 256 128 4096   (L1, L2, L3 block sizes)
+            ./mmult 1000 simd avx2            (auto, avx512, avx2, sse2, scalar)
+            ./mmult 1000 autotune             (search kernel, blocks and loop
+                                               order; later "simd" runs with no
+                                               kernel load the result)
+            ./mmult 8192 strassen 512 8       (recursion cutoff, # threads)
+            ./mmult 1000 float                (float A, B and C)
+            ./mmult 1000 mixed                (float A and B, double sums)
 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
+#include <string.h>
+#include <float.h>  // FLT_EPSILON for the float tolerances
+#include "timer.h"
+#include "matrix.h"  // contiguous MATRIX type
+#include "transpose.h"  // cache-oblivious transposes
+#include "counterRandom.h"  // counter-based random numbers
+#include "gemm.h"    // cache-blocked multiply
+#include "strassen.h"  // Strassen-Winograd multiply
+#include "autotune.h"  // tuned kernel/blocking cache
 
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
 
 // function prototypes
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
-void generateRandom2DArray(int rows, int columns, 
-			   double min, double max, double ** random2DArray);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
 void matrixMultiplication(int rows1, int columns1, double ** array1, 
@@ -24,56 +42,212 @@ void matrixMultiplication(int rows1, int columns1, double ** array1,
 			  double ** product);
 void matrixMultiplicationAlt(int rows1, int columns1, double ** array1, 
 			     int rows2, int columns2, double ** array2,
-			     double ** product);
+			     double ** product, BOOL array2Private);
+void matrixMultiplicationTiled(int rows1, int columns1, MATRIX * array1,
+			       int rows2, int columns2, MATRIX * array2,
+			       MATRIX * product, GEMM_BLOCKING * blocking);
+void matrixMultiplicationSimd(int rows1, int columns1, MATRIX * array1,
+			      int rows2, int columns2, MATRIX * array2,
+			      MATRIX * product, const GEMM_KERNEL * kernel,
+			      GEMM_BLOCKING * blocking);
+void matrixMultiplicationStrassen(int rows1, int columns1, MATRIX * array1,
+				  int rows2, int columns2, MATRIX * array2,
+				  MATRIX * product, int cutoff, THREAD_POOL * pool);
+void matrixMultiplicationFloat(int rows1, int columns1, MATRIX * array1,
+			       const float * A, int rows2, int columns2,
+			       MATRIX * array2, const float * B, MATRIX * product,
+			       float * C, const GEMM_FLOAT_KERNEL * kernel,
+			       GEMM_BLOCKING * blocking);
+float * narrowMatrix(MATRIX * matrix);
+void widenMatrix(const float * source, MATRIX * matrix);
+void printError2DArrays(int rows, int columns, double ** reference,
+			double ** array2D);
 
 int main(int argc, char ** argv) {
+  MATRIX * matrixA;
+  MATRIX * matrixB;
+  MATRIX * matrixC;
+  MATRIX * matrixC_alt;
   double ** A;
   double ** B;
   double ** C;
   double ** C_alt;
   int rows, columns;
-  long startTime, endTime,seqTime;
+  char * mode;
+  GEMM_BLOCKING blocking;
+  const GEMM_KERNEL * kernel = NULL;
+  const GEMM_FLOAT_KERNEL * floatKernel = NULL;
+  float * floatA = NULL, * floatB = NULL, * floatC = NULL;
+  int cutoff = STRASSEN_DEFAULT_CUTOFF;
+  int numberOfThreads = 7;
+  THREAD_POOL * pool = NULL;
+  BOOL badArgs;
+  AUTOTUNE_CONFIG tuned;
+  double startTime, endTime, seqTime, tolerance;
+  uint64_t seed;
   
-  if (argc !=2) {
-    printf("Usage: %s <# integer matrix size>\n", argv[0]);
+  mode = (argc > 2) ? argv[2] : "alt";
+  gemmDefaultBlocking(&blocking);
+  if (strcmp(mode, "tiled") == 0) {
+    badArgs = (argc != 3 && argc != 6);
+    if (argc == 6) {
+      // a zero block never advances gemmTiled's loops
+      badArgs = (sscanf(argv[3], "%d", &blocking.kc) != 1
+		 || sscanf(argv[4], "%d", &blocking.mc) != 1
+		 || sscanf(argv[5], "%d", &blocking.nc) != 1
+		 || blocking.kc < 1
+		 || blocking.mc < 1 || blocking.mc % GEMM_MR != 0
+		 || blocking.nc < 1 || blocking.nc % GEMM_NR != 0);
+    } // end if
+  } else if (strcmp(mode, "simd") == 0) {
+    badArgs = (argc > 4);
+  } else if (strcmp(mode, "strassen") == 0) {
+    badArgs = (argc > 5);
+  } else if (strcmp(mode, "autotune") == 0) {
+    badArgs = (argc != 3);
+  } else if (strcmp(mode, "float") == 0 || strcmp(mode, "mixed") == 0) {
+    badArgs = (argc != 3);
+  } else {
+    badArgs = (argc < 2 || argc > 3 || strcmp(mode, "alt") != 0);
+  } // end if
+  if (badArgs) {
+    printf("Usage: %s <# integer matrix size> [alt | tiled [<L1 block> <L2 block> <L3 block>]\n"
+	   "         | simd [auto | avx512 | avx2 | sse2 | scalar]\n"
+	   "         | strassen [<cutoff> [<# threads>]] | autotune | float | mixed]\n"
+	   "       blocks are positive; the L2 block a multiple of %d, the L3 block of %d\n",
+	   argv[0], GEMM_MR, GEMM_NR);
     exit(-1);     
   } // end if
 
   sscanf(argv[1], "%d", &rows);
   columns = rows;
+  if (strcmp(mode, "simd") == 0 && argc == 4) {
+    kernel = gemmKernelByName(argv[3]);
+  } else if (strcmp(mode, "simd") == 0) {
+    // no kernel given: use this host's tuned configuration if there is one
+    autotuneDefaults(&tuned);
+    if (autotuneLoad("mmultSeqOptions", rows, &tuned)) {
+      autotunePrint("Using tuned configuration", &tuned);
+    } // end if
+    kernel = gemmKernelByName(tuned.kernel);
+    blocking = tuned.blocking;
+  } else if (strcmp(mode, "autotune") == 0) {
+    autotuneDefaults(&tuned);
+    autotuneBlocking(rows, &tuned);
+    autotuneSave("mmultSeqOptions", rows, &tuned);
+    kernel = gemmKernelByName(tuned.kernel);
+    blocking = tuned.blocking;
+  } else if (strcmp(mode, "float") == 0) {
+    floatKernel = gemmBestFloatKernel();
+  } else if (strcmp(mode, "mixed") == 0) {
+    floatKernel = gemmBestMixedKernel();
+  } else if (strcmp(mode, "strassen") == 0) {
+    if (argc > 3) {
+      sscanf(argv[3], "%d", &cutoff);
+    } // end if
+    if (argc > 4) {
+      sscanf(argv[4], "%d", &numberOfThreads);
+    } // end if
+    // the pool outlives the multiply: only the 7 products use threads
+    if (numberOfThreads > 1) {
+      pool = threadPoolCreate((numberOfThreads < 7) ? numberOfThreads : 7);
+    } // end if
+  } // end if
 
-  // seed the random number generator
-  srand( time(NULL) );
+  // seed the counter-based generator: stream seed for A, seed+1 for B
+  seed = (uint64_t) time(NULL);
 
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  C = allocate2DArray(rows, columns);
-  C_alt = allocate2DArray(rows, columns);
-  generateRandom2DArray(rows, columns, -1.0, +1.0, A);
-  generateRandom2DArray(rows, columns, -1.0, +1.0, B);
+  matrixA = allocateMatrix(rows, columns);
+  matrixB = allocateMatrix(rows, columns);
+  matrixC = allocateMatrix(rows, columns);
+  matrixC_alt = allocateMatrix(rows, columns);
+  A = matrixA->row;
+  B = matrixB->row;
+  C = matrixC->row;
+  C_alt = matrixC_alt->row;
+  generateCounterRandom2DArray(rows, columns, -1.0, +1.0, seed, A, 0);
+  generateCounterRandom2DArray(rows, columns, -1.0, +1.0, seed+1, B, 0);
 
   printf("after initializing matrices\n");
 
-  time(&startTime);
+  GET_TIME(startTime);
 
   matrixMultiplication(rows, columns, A, rows, columns, B, C);
 
-  time(&endTime);
+  GET_TIME(endTime);
   seqTime = endTime-startTime;
-  printf("Matrix Multiplication time = %ld\n",seqTime);
-
-  time(&startTime);
+  printf("Matrix Multiplication time = %1.3f\n",seqTime);
+
+  // the float copies are made outside the timing, as in hw6
+  if (floatKernel != NULL) {
+    floatA = narrowMatrix(matrixA);
+    floatB = narrowMatrix(matrixB);
+    if (!floatKernel->mixed) {
+      floatC = allocateAlignedFloat((size_t) rows*matrixC_alt->ld);
+    } // end if
+  } // end if
 
-  matrixMultiplicationAlt(rows, columns, A, rows, columns, B, C_alt);
+  GET_TIME(startTime);
+
+  if (strcmp(mode, "tiled") == 0) {
+    matrixMultiplicationTiled(rows, columns, matrixA, rows, columns, matrixB,
+			      matrixC_alt, &blocking);
+  } else if (strcmp(mode, "simd") == 0 || strcmp(mode, "autotune") == 0) {
+    matrixMultiplicationSimd(rows, columns, matrixA, rows, columns, matrixB,
+			     matrixC_alt, kernel, &blocking);
+  } else if (strcmp(mode, "strassen") == 0) {
+    matrixMultiplicationStrassen(rows, columns, matrixA, rows, columns, matrixB,
+				 matrixC_alt, cutoff, pool);
+  } else if (floatKernel != NULL) {
+    matrixMultiplicationFloat(rows, columns, matrixA, floatA, rows, columns,
+			      matrixB, floatB, matrixC_alt, floatC, floatKernel,
+			      &blocking);
+  } else {
+    // B is main's own and not read again until it is freed
+    matrixMultiplicationAlt(rows, columns, A, rows, columns, B, C_alt, TRUE);
+  } // end if
 
-  time(&endTime);
+  GET_TIME(endTime);
   seqTime = endTime-startTime;
-  printf("Matrix Multiplication Alt. time = %ld\n",seqTime);
+  if (floatC != NULL) {
+    widenMatrix(floatC, matrixC_alt);
+  } // end if
+  if (strcmp(mode, "tiled") == 0) {
+    printf("Matrix Multiplication Tiled (L1 %d, L2 %d, L3 %d) time = %1.3f (%1.2f GFLOP/s)\n",
+	   blocking.kc, blocking.mc, blocking.nc, seqTime,
+	   2.0*rows*(double) rows*columns / seqTime * 1.0e-9);
+    tolerance = 0.000001;  // blocking changes the order of the k sum
+  } else if (strcmp(mode, "simd") == 0 || strcmp(mode, "autotune") == 0) {
+    printf("Matrix Multiplication SIMD (%s %dx%d, kc %d mc %d nc %d) time = %1.3f (%1.2f GFLOP/s)\n",
+	   kernel->name, kernel->mr, kernel->nr, blocking.kc, blocking.mc,
+	   blocking.nc, seqTime,
+	   2.0*rows*(double) rows*columns / seqTime * 1.0e-9);
+    tolerance = 0.000001;
+  } else if (strcmp(mode, "strassen") == 0) {
+    printf("Matrix Multiplication Strassen-Winograd (cutoff %d, %d threads) time = %1.3f (%1.2f classical GFLOP/s)\n",
+	   cutoff, numberOfThreads, seqTime,
+	   2.0*rows*(double) rows*columns / seqTime * 1.0e-9);
+    printError2DArrays(rows, columns, C, C_alt);
+    tolerance = 0.000001;
+  } else if (floatKernel != NULL) {
+    printf("Matrix Multiplication %s (%s %dx%d) time = %1.3f (%1.2f GFLOP/s)\n",
+	   floatKernel->mixed ? "Mixed" : "Float", floatKernel->name,
+	   floatKernel->mr, floatKernel->nr, seqTime,
+	   2.0*rows*(double) rows*columns / seqTime * 1.0e-9);
+    printError2DArrays(rows, columns, C, C_alt);
+    // each product carries the float rounding of A and B (~2 eps); a
+    // float sum adds up to columns more roundings of a partial sum
+    tolerance = floatKernel->mixed ? 2.0*columns*FLT_EPSILON
+      : 4.0*columns*FLT_EPSILON;
+  } else {
+    printf("Matrix Multiplication Alt. time = %1.3f\n",seqTime);
+    tolerance = 0.0;
+  } // end if
 
-  if (equal2DArrays(rows, columns, C, C_alt, 0.0)) {
-    printf("Arrays match with tolerance of %.10f\n", 0.0);
+  if (equal2DArrays(rows, columns, C, C_alt, tolerance)) {
+    printf("Arrays match with tolerance of %.10f\n", tolerance);
   } else {
-    printf("Arrays DON'T match with tolerance of %.10f\n", 0.0);
+    printf("Arrays DON'T match with tolerance of %.10f\n", tolerance);
   } // end if
 
   // if small enough, print to screen
@@ -81,7 +255,18 @@ int main(int argc, char ** argv) {
     printf("C 2D array of doubles:\n");
     print2DArray(rows, columns, C);
     printf("\nC_alt 2D array of doubles:\n");
-    print2DArray(rows, columns, C);
+    print2DArray(rows, columns, C_alt);
+  } // end if
+
+  freeMatrix(matrixA);
+  freeMatrix(matrixB);
+  freeMatrix(matrixC);
+  freeMatrix(matrixC_alt);
+  free(floatA);
+  free(floatB);
+  free(floatC);
+  if (pool != NULL) {
+    threadPoolDestroy(pool);
   } // end if
 
   return 0;
@@ -118,12 +303,17 @@ void matrixMultiplication(int rows1, int columns1, double ** array1,
 
 /*******************************************************************
  * Function matrixMultiplicationAlt passed two matrices and returns
- * their product.
+ * their product.  The inner loop wants array2 transposed.  When the
+ * caller says array2 is private (not array1, and nobody else reads
+ * it meanwhile) and it is square in one strided block, it is
+ * transposed in place and back afterwards, costing no memory;
+ * otherwise a transposed copy is made a tile at a time.
  ********************************************************************/
 void matrixMultiplicationAlt(int rows1, int columns1, double ** array1, 
 			     int rows2, int columns2, double ** array2,
-			     double ** product) {
-  int i, j, k;
+			     double ** product, BOOL array2Private) {
+  int i, j, k, stride;
+  MATRIX * transpose = NULL;
   double ** array2_transpose;
   
   if (columns1 != rows2) {
@@ -132,12 +322,24 @@ void matrixMultiplicationAlt(int rows1, int columns1, double ** array1,
   } // end if
 
   // Transposes array2
-  array2_transpose = allocate2DArray(columns2, rows2);
-  for (i=0; i < rows2; i++) {
-    for (j=0; j < columns2; j++) {
-      array2_transpose[j][i] = array2[i][j];
-    } /* end for (j */
-  } /* end for (i */
+  stride = transposeRowStride(array2, rows2);
+  if (array2Private && array2 != array1 && rows2 == columns2 && stride >= 0) {
+    transposeInPlace(rows2, array2[0], stride, 1);
+    array2_transpose = array2;
+  } else {
+    transpose = allocateMatrix(columns2, rows2);
+    array2_transpose = transpose->row;
+    if (stride >= 0) {
+      transposeBlocked(rows2, columns2, array2[0], stride, transpose->data,
+		       transpose->ld, 1);
+    } else {
+      for (i=0; i < rows2; i++) {
+	for (j=0; j < columns2; j++) {
+	  array2_transpose[j][i] = array2[i][j];
+	} /* end for (j */
+      } /* end for (i */
+    } // end if
+  } // end if
 
   // Matrix Multiplication uses array1 and array2_transpose
   for (i=0; i < rows1; i++) {
@@ -149,46 +351,143 @@ void matrixMultiplicationAlt(int rows1, int columns1, double ** array1,
     } /* end for (j */
   } /* end for (i */
 
+  if (transpose == NULL) {
+    transposeInPlace(rows2, array2[0], stride, 1);  // restore array2
+  } else {
+    freeMatrix(transpose);
+  } // end if
+
 } // end matrixMultiplicationAlt
 
 
 
 /*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
+ * Function matrixMultiplicationTiled passed two contiguous matrices
+ * and the L1/L2/L3 block sizes, and returns their product computed
+ * by the cache-blocked kernel in gemm.c.
  ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
+void matrixMultiplicationTiled(int rows1, int columns1, MATRIX * array1,
+			       int rows2, int columns2, MATRIX * array2,
+			       MATRIX * product, GEMM_BLOCKING * blocking) {
 
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
+  if (columns1 != rows2) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
 
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
+  gemmTiled(rows1, columns2, columns1, array1->data, array1->ld,
+	    array2->data, array2->ld, product->data, product->ld, blocking);
+
+} // end matrixMultiplicationTiled
 
-  return local2DArray;
-} // end allocate2DArray
 
 
 /*******************************************************************
- * Function generateRandom2DArray is passed the # rows, the # columns,
- * min. value, max. value, and returns random2DArray containing 
- * randomly generated doubles.
+ * Function matrixMultiplicationSimd passed two contiguous matrices,
+ * a SIMD micro-kernel and the block sizes, and returns their product
+ * computed by the packed-panel multiply in gemm.c.
  ********************************************************************/
-void generateRandom2DArray(int rows, int columns, 
-			   double min, double max, double ** random2DArray) {
-  int r, c;
-  double range, div;
+void matrixMultiplicationSimd(int rows1, int columns1, MATRIX * array1,
+			      int rows2, int columns2, MATRIX * array2,
+			      MATRIX * product, const GEMM_KERNEL * kernel,
+			      GEMM_BLOCKING * blocking) {
+
+  if (columns1 != rows2) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
+
+  gemmPacked(rows1, columns2, columns1, array1->data, array1->ld,
+	     array2->data, array2->ld, product->data, product->ld,
+	     blocking, kernel);
+
+} // end matrixMultiplicationSimd
+
+
+
+/*******************************************************************
+ * Function matrixMultiplicationStrassen passed two square contiguous
+ * matrices, the size below which to use the classic tiled kernel,
+ * and the thread pool for the seven top-level products (NULL for a
+ * sequential run), and returns their product computed by
+ * Strassen-Winograd.
+ ********************************************************************/
+void matrixMultiplicationStrassen(int rows1, int columns1, MATRIX * array1,
+				  int rows2, int columns2, MATRIX * array2,
+				  MATRIX * product, int cutoff, THREAD_POOL * pool) {
+
+  if (rows1 != columns1 || rows2 != columns2 || columns1 != rows2) {
+    printf("Strassen needs square matrices of the same size!\n");
+    exit(-1);
+  } // end if
+
+  strassenMultiply(rows1, array1->data, array1->ld, array2->data, array2->ld,
+		   product->data, product->ld, cutoff, pool);
+
+} // end matrixMultiplicationStrassen
+
+
+
+/*******************************************************************
+ * Function matrixMultiplicationFloat passed two contiguous matrices
+ * with their float copies A and B (same ld), a float or mixed
+ * micro-kernel and the block sizes, and returns their product.  A
+ * mixed kernel sums in double straight into product; a float kernel
+ * sums in float into C (product's ld), which the caller widens.
+ ********************************************************************/
+void matrixMultiplicationFloat(int rows1, int columns1, MATRIX * array1,
+			       const float * A, int rows2, int columns2,
+			       MATRIX * array2, const float * B, MATRIX * product,
+			       float * C, const GEMM_FLOAT_KERNEL * kernel,
+			       GEMM_BLOCKING * blocking) {
+  if (columns1 != rows2) {
+    printf("Matrices cannot be multiplied -- incompatible dimensions!\n");
+    exit(-1);
+  } // end if
+
+  if (kernel->mixed) {
+    gemmPackedMixed(rows1, columns2, columns1, A, array1->ld, B, array2->ld,
+		    product->data, product->ld, blocking, kernel);
+  } else {
+    gemmPackedFloat(rows1, columns2, columns1, A, array1->ld, B, array2->ld,
+		    C, product->ld, blocking, kernel);
+  } // end if
+} // end matrixMultiplicationFloat
+
+
+/*******************************************************************
+ * Function narrowMatrix returns a float copy of matrix with the same
+ * ld; only the rows x columns elements are converted, the padding
+ * is left alone.
+ ********************************************************************/
+float * narrowMatrix(MATRIX * matrix) {
+  float * copy;
+  int i, j;
+
+  copy = allocateAlignedFloat((size_t) matrix->rows*matrix->ld);
+  for (i=0; i < matrix->rows; i++) {
+    for (j=0; j < matrix->columns; j++) {
+      copy[(size_t) i*matrix->ld + j] = (float) matrix->row[i][j];
+    } // end for j
+  } // end for i
+  return copy;
+} // end narrowMatrix
+
+
+/*******************************************************************
+ * Function widenMatrix copies the rows x columns elements of the
+ * float array source (matrix's ld) back into matrix.
+ ********************************************************************/
+void widenMatrix(const float * source, MATRIX * matrix) {
+  int i, j;
+
+  for (i=0; i < matrix->rows; i++) {
+    for (j=0; j < matrix->columns; j++) {
+      matrix->row[i][j] = source[(size_t) i*matrix->ld + j];
+    } // end for j
+  } // end for i
+} // end widenMatrix
 
-  for (r = 0; r < rows; r++) {
-    for (c = 0; c < columns; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      random2DArray[r][c] = min + (rand() / div);
-    } // end for (c...
-  } // end for (r...
-} // end generateRandom2DArray
 
 
 /*******************************************************************
@@ -232,5 +531,33 @@ BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 
 
 
+/*******************************************************************
+ * Function printError2DArrays is passed the # rows, # columns, a
+ * reference array2D, and an array2D to judge.  It prints the largest
+ * absolute difference and that difference relative to the largest
+ * reference element.
+ ********************************************************************/
+void printError2DArrays(int rows, int columns, double ** reference,
+			double ** array2D) {
+  int r, c;
+  double maxError = 0.0, maxReference = 0.0;
+
+  for(r = 0; r < rows; r++) {
+    for (c = 0; c < columns; c++) {
+      if (fabs(reference[r][c] - array2D[r][c]) > maxError) {
+        maxError = fabs(reference[r][c] - array2D[r][c]);
+      } // end if
+      if (fabs(reference[r][c]) > maxReference) {
+        maxReference = fabs(reference[r][c]);
+      } // end if
+    } // end for (c...
+  } // end for(r...
+  printf("Max. error vs matrixMultiplication = %e (relative %e)\n",
+	 maxError, (maxReference > 0.0) ? maxError / maxReference : 0.0);
+
+} // end printError2DArrays
+
+
+
 
 
@@ -0,0 +1,319 @@
+/* Program to compare the sparse (CSR/CSC) kernels of sparse.h with
+   the dense ones as the fraction of nonzeros varies.  For each
+   density an n x n A and B are generated with that fraction of
+   nonzeros (the rest exact zeros), and the program times
+     y = A*x  dense row dot products  vs  sparseMatVec (CSR and CSC)
+     C = A*B  gemmPacked              vs  sparseMatMul (CSR)
+   sequentially and with the given # threads, checks the sparse
+   results against the dense ones, and reports how far a row-count
+   split of A would be from a nonzero-count split.  With "skewed" the
+   first tenth of the rows are ten times denser than the rest.
+   The "file" form converts a write2DArray file to CSR and CSC and
+   back, and optionally writes the round trip out again.
+   Compile by:  gcc -O3 -march=native -I../common -o sparse sparseBench.c
+                ../common/sparse.c ../common/matrixFile.c ../common/gemm.c
+                ../common/gemmSimd.c ../common/matrix.c ../common/counterRandom.c
+                -lm -lpthread
+   Run by:  ./sparse 2000 4            (matrix size, # threads)
+            ./sparse 2000 4 skewed
+            ./sparse file A.dat [out.dat]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "timer.h"
+#include "matrix.h"         // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
+#include "gemm.h"           // dense packed-panel multiply
+#include "sparse.h"         // CSR/CSC kernels
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+#define MATVEC_REPEATS 20   // a single SpMV is too quick to time
+
+static const double densities[] = {0.001, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2};
+
+// function prototypes
+MATRIX * generateSparseMatrix(int rows, int columns, double density,
+			      BOOL skewed, uint64_t seed);
+void denseMatVec(const MATRIX * A, const double * x, double * y);
+double timeMatVec(const SPARSE_MATRIX * A, const double * x, double * y,
+		  int numberOfThreads);
+double maxError(const double * reference, const double * array, long count);
+double partitionImbalance(const SPARSE_MATRIX * A, int parts, BOOL byNonzeros);
+int convertFile(int argc, char ** argv);
+
+int main(int argc, char ** argv) {
+  MATRIX * A, * B, * C, * sparseProduct;
+  SPARSE_MATRIX * csrA, * csrB, * cscA, * csrC;
+  GEMM_BLOCKING blocking;
+  double * x, * y, * ySparse;
+  double startTime, endTime, denseMV, denseMM, csrMV, csrMVThreads, cscMV;
+  double spgemm, spgemmThreads, error, productError, rowError;
+  int n, numberOfThreads, i, d, rep;
+  BOOL skewed;
+  uint64_t seed;
+
+  if (argc > 1 && strcmp(argv[1], "file") == 0) {
+    return convertFile(argc, argv);
+  } // end if
+  if (argc < 3 || argc > 4 || (argc == 4 && strcmp(argv[3], "skewed") != 0)) {
+    printf("Usage: %s <# integer matrix size> <# of threads> [skewed]\n"
+	   "       %s file <matrix file> [<output file>]\n", argv[0], argv[0]);
+    exit(-1);
+  } // end if
+  sscanf(argv[1], "%d", &n);
+  sscanf(argv[2], "%d", &numberOfThreads);
+  if (numberOfThreads <= 0) {
+    numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  } // end if
+  skewed = (argc == 4);
+  seed = (uint64_t) time(NULL);
+  gemmDefaultBlocking(&blocking);
+
+  x = allocateAligned(n);
+  y = allocateAligned(n);
+  ySparse = allocateAligned(n);
+  generateCounterRandomRow(x, n, 0, seed+2, -1.0, +1.0);
+  C = allocateMatrix(n, n);
+
+  printf("%d x %d, %d threads%s; times in seconds (SpMV per multiply)\n", n, n,
+	 numberOfThreads, skewed ? ", skewed rows" : "");
+  printf("%8s %10s | %9s %9s %9s %9s | %8s %8s %8s | %9s %9s | %s\n",
+	 "density", "nnz", "dense MV", "CSR MV", "CSR MV/T", "CSC MV/T",
+	 "dense MM", "SpGEMM", "SpGEMM/T", "MV error", "MM error",
+	 "imbalance rows/nnz");
+
+  for (d=0; d < (int) (sizeof(densities)/sizeof(double)); d++) {
+    A = generateSparseMatrix(n, n, densities[d], skewed, seed);
+    B = generateSparseMatrix(n, n, densities[d], FALSE, seed+1);
+    csrA = sparseFromMatrix(A, SPARSE_CSR);
+    csrB = sparseFromMatrix(B, SPARSE_CSR);
+    cscA = sparseConvert(csrA, SPARSE_CSC);
+
+    GET_TIME(startTime);
+    for (rep=0; rep < MATVEC_REPEATS; rep++) {
+      denseMatVec(A, x, y);
+    } // end for
+    GET_TIME(endTime);
+    denseMV = (endTime - startTime) / MATVEC_REPEATS;
+    csrMV = timeMatVec(csrA, x, ySparse, 1);
+    csrMVThreads = timeMatVec(csrA, x, ySparse, numberOfThreads);
+    error = maxError(y, ySparse, n);
+    cscMV = timeMatVec(cscA, x, ySparse, numberOfThreads);
+    if (maxError(y, ySparse, n) > error) {
+      error = maxError(y, ySparse, n);
+    } // end if
+
+    GET_TIME(startTime);
+    gemmPacked(n, n, n, A->data, A->ld, B->data, B->ld, C->data, C->ld,
+	       &blocking, gemmBestKernel());
+    GET_TIME(endTime);
+    denseMM = endTime - startTime;
+
+    GET_TIME(startTime);
+    csrC = sparseMatMul(csrA, csrB, 1);
+    GET_TIME(endTime);
+    spgemm = endTime - startTime;
+    freeSparse(csrC);
+    GET_TIME(startTime);
+    csrC = sparseMatMul(csrA, csrB, numberOfThreads);
+    GET_TIME(endTime);
+    spgemmThreads = endTime - startTime;
+    sparseProduct = sparseToMatrix(csrC);
+    for (i=0, productError=0.0; i < n; i++) {
+      rowError = maxError(MATRIX_ROW(C, i), MATRIX_ROW(sparseProduct, i), n);
+      productError = (rowError > productError) ? rowError : productError;
+    } // end for
+
+    printf("%7.1f%% %10ld | %9.2e %9.2e %9.2e %9.2e | %8.4f %8.4f %8.4f | %9.2e %9.2e | %5.2f / %4.2f\n",
+	   100.0*densities[d], csrA->nnz, denseMV, csrMV, csrMVThreads, cscMV,
+	   denseMM, spgemm, spgemmThreads, error, productError,
+	   partitionImbalance(csrA, numberOfThreads, FALSE),
+	   partitionImbalance(csrA, numberOfThreads, TRUE));
+
+    freeMatrix(sparseProduct);
+    freeSparse(csrC);
+    freeSparse(cscA);
+    freeSparse(csrB);
+    freeSparse(csrA);
+    freeMatrix(B);
+    freeMatrix(A);
+  } // end for (d
+
+  freeMatrix(C);
+  free(x);
+  free(y);
+  free(ySparse);
+  return 0;
+} // end main
+
+
+/*******************************************************************
+ * Function generateSparseMatrix returns a dense rows x columns
+ * matrix in which each element is, independently, nonzero (uniform
+ * in [-1, 1)) with probability density -- ten times that in the
+ * first tenth of the rows if skewed.
+ ********************************************************************/
+MATRIX * generateSparseMatrix(int rows, int columns, double density,
+			      BOOL skewed, uint64_t seed) {
+  MATRIX * matrix;
+  double * row, rowDensity;
+  uint64_t index;
+  int r, c;
+
+  matrix = allocateMatrix(rows, columns);
+  for (r=0; r < rows; r++) {
+    row = MATRIX_ROW(matrix, r);
+    rowDensity = (skewed && r < rows/10) ? 10.0*density : density;
+    for (c=0; c < columns; c++) {
+      index = (uint64_t) r*columns + c;
+      row[c] = (counterRandom(seed, index) < rowDensity)
+	? 2.0*counterRandom(seed + 0x5eed, index) - 1.0 : 0.0;
+    } // end for (c
+  } // end for (r
+
+  return matrix;
+} // end generateSparseMatrix
+
+
+/*******************************************************************
+ * Function denseMatVec computes y = A*x one row dot product at a
+ * time.
+ ********************************************************************/
+void denseMatVec(const MATRIX * A, const double * x, double * y) {
+  const double * row;
+  double sum;
+  int r, c;
+
+  for (r=0; r < A->rows; r++) {
+    row = MATRIX_ROW(A, r);
+    sum = 0.0;
+    for (c=0; c < A->columns; c++) {
+      sum += row[c] * x[c];
+    } // end for (c
+    y[r] = sum;
+  } // end for (r
+} // end denseMatVec
+
+
+/*******************************************************************
+ * Function timeMatVec returns the seconds per sparseMatVec, averaged
+ * over MATVEC_REPEATS calls.
+ ********************************************************************/
+double timeMatVec(const SPARSE_MATRIX * A, const double * x, double * y,
+		  int numberOfThreads) {
+  double startTime, endTime;
+  int rep;
+
+  GET_TIME(startTime);
+  for (rep=0; rep < MATVEC_REPEATS; rep++) {
+    sparseMatVec(A, x, y, numberOfThreads);
+  } // end for
+  GET_TIME(endTime);
+  return (endTime - startTime) / MATVEC_REPEATS;
+} // end timeMatVec
+
+
+/*******************************************************************
+ * Function maxError returns the largest absolute difference between
+ * corresponding elements.
+ ********************************************************************/
+double maxError(const double * reference, const double * array, long count) {
+  double error = 0.0;
+  long i;
+
+  for (i=0; i < count; i++) {
+    if (fabs(reference[i] - array[i]) > error) {
+      error = fabs(reference[i] - array[i]);
+    } // end if
+  } // end for
+  return error;
+} // end maxError
+
+
+/*******************************************************************
+ * Function partitionImbalance returns the largest # nonzeros any of
+ * parts threads would get over the average, when the rows of A are
+ * split into equal row counts or (byNonzeros) by sparsePartition.
+ ********************************************************************/
+double partitionImbalance(const SPARSE_MATRIX * A, int parts, BOOL byNonzeros) {
+  int * bounds;
+  long most = 0;
+  int p;
+
+  if (A->nnz == 0) {
+    return 1.0;
+  } // end if
+  bounds = (int *) malloc(sizeof(int)*(parts+1));
+  if (byNonzeros) {
+    sparsePartition(A->start, A->rows, parts, bounds);
+  } else {
+    for (p=0; p <= parts; p++) {
+      bounds[p] = (int) ((long) p*A->rows/parts);
+    } // end for
+  } // end if
+  for (p=0; p < parts; p++) {
+    if (A->start[bounds[p+1]] - A->start[bounds[p]] > most) {
+      most = A->start[bounds[p+1]] - A->start[bounds[p]];
+    } // end if
+  } // end for
+
+  free(bounds);
+  return (double) most / ((double) A->nnz / parts);
+} // end partitionImbalance
+
+
+/*******************************************************************
+ * Function convertFile reads a write2DArray file as CSR and as CSC,
+ * checks that both expand back to the file's contents, and writes
+ * the CSC form out in write2DArray layout if an output is given.
+ ********************************************************************/
+int convertFile(int argc, char ** argv) {
+  SPARSE_MATRIX * csr, * csc;
+  MATRIX * fromCsr, * fromCsc;
+  double startTime, endTime, error = 0.0, e;
+  int r;
+
+  if (argc < 3 || argc > 4) {
+    printf("Usage: %s file <matrix file> [<output file>]\n", argv[0]);
+    exit(-1);
+  } // end if
+
+  GET_TIME(startTime);
+  if ((csr = readSparseFile(argv[2], SPARSE_CSR)) == NULL) {
+    exit(-1);
+  } // end if
+  GET_TIME(endTime);
+  csc = sparseConvert(csr, SPARSE_CSC);
+  printf("%s: %d x %d, %ld nonzeros (%1.3f%%), read as CSR in %1.3f seconds\n",
+	 argv[2], csr->rows, csr->columns, csr->nnz,
+	 100.0*csr->nnz / ((double) csr->rows*csr->columns), endTime - startTime);
+  printf("CSR %1.1f MB, CSC %1.1f MB, dense %1.1f MB\n",
+	 (csr->nnz*(sizeof(double)+sizeof(int)) + (csr->rows+1)*sizeof(long)) / 1.0e6,
+	 (csc->nnz*(sizeof(double)+sizeof(int)) + (csc->columns+1)*sizeof(long)) / 1.0e6,
+	 (double) csr->rows*csr->columns*sizeof(double) / 1.0e6);
+
+  fromCsr = sparseToMatrix(csr);
+  fromCsc = sparseToMatrix(csc);
+  for (r=0; r < csr->rows; r++) {
+    e = maxError(MATRIX_ROW(fromCsr, r), MATRIX_ROW(fromCsc, r), csr->columns);
+    error = (e > error) ? e : error;
+  } // end for
+  printf("CSR and CSC round trips %s\n", (error == 0.0) ? "match" : "DON'T match");
+
+  if (argc == 4 && writeSparseFile(csc, argv[3])) {
+    printf("Wrote %s\n", argv[3]);
+  } // end if
+
+  freeMatrix(fromCsr);
+  freeMatrix(fromCsc);
+  freeSparse(csr);
+  freeSparse(csc);
+  return 0;
+} // end convertFile
@@ -1,13 +1,20 @@
 /* Program to write a random 2D array of doubles to a file.
    Command-line arguments are used to specify the # of rows,
-   columns, and file name.
-   Compile by:  gcc -o write2D writeRandom2DArray.c -lm
-   Run by:  ./write2D 10 10 myFile.dat 5.0 9.0
+   columns, and file name.  With "mapped" the file is written in the
+   page-aligned version 1 layout of matrixFile.h through a memory
+   mapping instead of with fwrite.  Either file is read back both with
+   read2DArray and as a zero-copy mapped view, and the two are timed.
+   Compile by:  gcc -O3 -I../common -o write2D writeRandom2DArray.c
+                  ../common/matrixFile.c ../common/matrix.c -lm
+   Run by:  ./write2D 10 10 myFile.dat 5.0 9.0 [mapped]
 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
+#include <string.h>
+#include "timer.h"
+#include "matrixFile.h"  // memory-mapped matrix files
 
 #define TRUE 1
 #define FALSE 0
@@ -20,6 +27,8 @@ void generateRandom2DArray(int rows, int columns,
 			   double min, double max, double ** random2DArray);
 void write2DArray(int rows, int columns, double ** random2DArray, 
 		  FILE * outputFilePtr);
+BOOL write2DArrayMapped(int rows, int columns, double ** random2DArray,
+			char * fileName);
 void read2DArray(int * rows, int * columns, double *** array2DRead, 
 		 FILE * inputFilePtr);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
@@ -32,24 +41,23 @@ int main(int argc, char ** argv) {
   double **  random2DArray;  // dynamically allocated array
   double ** array2DRead;
   double minRandom, maxRandom;
+  double startTime, endTime;
   int rows, columns;
   int rowsRead, columnsRead;
+  BOOL mapped = FALSE;
+  MATRIX_FILE * mappedFile;
   
-  if (argc !=6) {
-    printf("Usage: %s <# rows> <# columns> <filename.dat> <min. random> <max. random>\n"
+  if (argc < 6 || argc > 7 || (argc == 7 && strcmp(argv[6], "mapped") != 0)) {
+    printf("Usage: %s <# rows> <# columns> <filename.dat> <min. random> <max. random> [mapped]\n"
 	   , argv[0]);
     exit(-1);     
   } // end if
 
-  if ((outputFilePtr = fopen(argv[3], "wb")) == NULL) {
-    printf("%s cannot be opened for writing\n", argv[3]);
-    exit(-1);
-  } // end if
-
   sscanf(argv[1], "%d", &rows);
   sscanf(argv[2], "%d", &columns);
   sscanf(argv[4], "%lf", &minRandom);
   sscanf(argv[5], "%lf", &maxRandom);
+  mapped = (argc == 7);
 
   random2DArray = allocate2DArray(rows, columns);
   generateRandom2DArray(rows, columns, minRandom, maxRandom, random2DArray);
@@ -60,27 +68,75 @@ int main(int argc, char ** argv) {
     print2DArray(rows, columns, random2DArray);
   } // end if
 
-  write2DArray(rows, columns, random2DArray, outputFilePtr);
-
-  fclose(outputFilePtr);  // close the file --> flush to disk
+  GET_TIME(startTime);
+  if (mapped) {
+    if (!write2DArrayMapped(rows, columns, random2DArray, argv[3])) {
+      exit(-1);
+    } // end if
+  } else {
+    if ((outputFilePtr = fopen(argv[3], "wb")) == NULL) {
+      printf("%s cannot be opened for writing\n", argv[3]);
+      exit(-1);
+    } // end if
+    write2DArray(rows, columns, random2DArray, outputFilePtr);
+    fclose(outputFilePtr);  // close the file --> flush to disk
+  } // end if
+  GET_TIME(endTime);
+  printf("Time to write %s file: %3.5f seconds\n",
+	 mapped ? "mapped (version 1)" : "legacy", endTime - startTime);
+
+  // the old fread path only understands the legacy layout
+  if (!mapped) {
+    if ((inputFilePtr = fopen(argv[3], "rb")) == NULL) {
+      printf("%s cannot be opened for reading\n", argv[3]);
+      exit(-1);
+    } // end if
+
+    GET_TIME(startTime);
+    read2DArray(&rowsRead, &columnsRead, &array2DRead, inputFilePtr);
+    GET_TIME(endTime);
+    printf("Time for read2DArray: %3.5f seconds\n", endTime - startTime);
+
+    if (rows < 10 && columns < 10) {
+      printf("\n2D array of doubles read from file:\n");
+      print2DArray(rowsRead, columnsRead, array2DRead);
+    } // end if
+
+    fclose(inputFilePtr);
+
+    if (equal2DArrays(rows, columns, random2DArray, array2DRead, 0.0)) {
+      printf("Arrays match with tolerance of %.10f\n", 0.0);
+    } else {
+      printf("Arrays DON'T match with tolerance of %.10f\n", 0.0);
+    } // end if
+  } // end if
 
-  if ((inputFilePtr = fopen(argv[3], "rb")) == NULL) {
-    printf("%s cannot be opened for reading\n", argv[3]);
+  // zero-copy view: the comparison below is what pulls pages in
+  GET_TIME(startTime);
+  if ((mappedFile = mapMatrixFile(argv[3])) == NULL) {
     exit(-1);
   } // end if
+  GET_TIME(endTime);
+  printf("Time for mapMatrixFile (version %d): %3.5f seconds\n",
+	 mappedFile->version, endTime - startTime);
 
-  read2DArray(&rowsRead, &columnsRead, &array2DRead, inputFilePtr);
-
-  printf("\n2D array of doubles read from file:\n");
-  print2DArray(rowsRead, columnsRead, array2DRead);
-
-  fclose(inputFilePtr);
+  if (rows < 10 && columns < 10) {
+    printf("\n2D array of doubles mapped from file:\n");
+    print2DArray(mappedFile->matrix.rows, mappedFile->matrix.columns,
+		 mappedFile->matrix.row);
+  } // end if
 
-  if (equal2DArrays(rows, columns, random2DArray, array2DRead, 0.0)) {
-    printf("Arrays match with tolerance of %.10f\n", 0.0);
+  GET_TIME(startTime);
+  if (mappedFile->matrix.rows == rows && mappedFile->matrix.columns == columns
+      && equal2DArrays(rows, columns, random2DArray, mappedFile->matrix.row, 0.0)) {
+    printf("Mapped arrays match with tolerance of %.10f\n", 0.0);
   } else {
-    printf("Arrays DON'T match with tolerance of %.10f\n", 0.0);
+    printf("Mapped arrays DON'T match with tolerance of %.10f\n", 0.0);
   } // end if
+  GET_TIME(endTime);
+  printf("Time to compare through the mapping: %3.5f seconds\n",
+	 endTime - startTime);
+  unmapMatrixFile(mappedFile);
 
   return 0;
 
@@ -125,6 +181,30 @@ void write2DArray(int rows, int columns, double ** random2DArray,
 } // end write2DArray
 
 
+/*******************************************************************
+ * Function write2DArrayMapped is passed the # rows, the # columns,
+ * the 2D array, and a file name.  It creates a version 1 matrix file
+ * of the right size (see matrixFile.h) and copies the rows straight
+ * into its mapping, so there is no stdio buffering or per-row write
+ * call.  Returns FALSE if the file can't be created.
+ ********************************************************************/
+BOOL write2DArrayMapped(int rows, int columns, double ** random2DArray,
+			char * fileName) {
+  MATRIX_FILE * file;
+  int r;
+
+  if ((file = createMatrixFile(fileName, rows, columns)) == NULL) {
+    return FALSE;
+  } // end if
+  for (r=0; r < rows; r++) {
+    memcpy(file->matrix.row[r], random2DArray[r], sizeof(double)*columns);
+  } // end for
+  unmapMatrixFile(file);  // msync --> flush to disk
+
+  return TRUE;
+} // end write2DArrayMapped
+
+
 
 
 /*******************************************************************
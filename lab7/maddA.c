@@ -2,7 +2,8 @@
    threads and time their addition sequentially and using pthreads.
    The resulting sum matrix is assigned to threads by blocks of
    whole rows.  
-   Compile by:  gcc -O5 -o maddA maddA.c -lm -lpthread
+   Compile by:  gcc -O5 -I../common -o maddA maddA.c ../common/matrix.c
+                ../common/counterRandom.c -lm -lpthread
    Run by:  ./maddA 100 200 8
 */
 #include <stdio.h>
@@ -10,6 +11,8 @@
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
 #include <pthread.h>
+#include "matrix.h"  // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
 
 #define TRUE 1
 #define FALSE 0
@@ -27,10 +30,7 @@ typedef struct {
 
 
 // function prototypes
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
-void generateRandom2DArray(int rows, int columns, 
-			   double min, double max, double ** random2DArray);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
 void matrixAddition(int rows1, int columns1, double ** array1, double ** array2,
@@ -48,6 +48,7 @@ int rows, columns;
 
 
 int main(int argc, char ** argv) {
+  MATRIX * matrixA, * matrixB, * matrixSum, * matrixSum_seq;
   double ** C_seq;
   long i, initializationTime, startTime, endTime, seqTime, parallelTime;
   pthread_t * threadHandles;
@@ -64,17 +65,19 @@ int main(int argc, char ** argv) {
   sscanf(argv[2], "%d", &columns);
   sscanf(argv[3], "%d", &numberOfThreads);
 
-  // seed the random number generator
-  srand( 5 );
-
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  Sum = allocate2DArray(rows, columns);
-  Sum_seq = allocate2DArray(rows, columns);
+  matrixA = allocateMatrix(rows, columns);
+  matrixB = allocateMatrix(rows, columns);
+  matrixSum = allocateMatrix(rows, columns);
+  matrixSum_seq = allocateMatrix(rows, columns);
+  A = matrixA->row;
+  B = matrixB->row;
+  Sum = matrixSum->row;
+  Sum_seq = matrixSum_seq->row;
 
   time(&startTime);
-  generateRandom2DArray(rows, columns, 0.0, 5.0, A);
-  generateRandom2DArray(rows, columns, 0.0, 5.0, B);
+  // counter-based streams 5 (A) and 6 (B): same matrices for any # threads
+  generateCounterRandom2DArray(rows, columns, 0.0, 5.0, 5, A, numberOfThreads);
+  generateCounterRandom2DArray(rows, columns, 0.0, 5.0, 6, B, numberOfThreads);
 
   time(&endTime);
   initializationTime = endTime-startTime;
@@ -140,6 +143,11 @@ int main(int argc, char ** argv) {
     print2DArray(rows, columns, Sum);
   } // end if
 
+  freeMatrix(matrixA);
+  freeMatrix(matrixB);
+  freeMatrix(matrixSum);
+  freeMatrix(matrixSum_seq);
+
   return 0;
 
 } // end main
@@ -187,44 +195,6 @@ void * threadMAdd(void * arg) {
 
 
 
-/*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
- ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
-
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
-
-  return local2DArray;
-} // end allocate2DArray
-
-
-/*******************************************************************
- * Function generateRandom2DArray is passed the # rows, the # columns,
- * min. value, max. value, and returns random2DArray containing 
- * randomly generated doubles.
- ********************************************************************/
-void generateRandom2DArray(int rows, int columns, 
-			   double min, double max, double ** random2DArray) {
-  int r, c;
-  double range, div;
-
-  for (r = 0; r < rows; r++) {
-    for (c = 0; c < columns; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      random2DArray[r][c] = min + (rand() / div);
-    } // end for (c...
-  } // end for (r...
-} // end generateRandom2DArray
-
-
 /*******************************************************************
  * Function print2DArray is passed the # rows, # columns, and the
  * array2D.  It prints the 2D array to the screen.
@@ -2,7 +2,8 @@
    threads and time their addition sequentially and using pthreads.
    The resulting sum matrix is assigned to threads by blocks of
    whole rows.  
-   Compile by:  gcc -O5 -o maddB maddB.c -lm -lpthread
+   Compile by:  gcc -O5 -I../common -o maddB maddB.c ../common/matrix.c
+                ../common/counterRandom.c -lm -lpthread
    Run by:  ./mmultB 1000 2000 8
 */
 #include <stdio.h>
@@ -10,6 +11,8 @@
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
 #include <pthread.h>
+#include "matrix.h"  // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
 
 #define TRUE 1
 #define FALSE 0
@@ -24,11 +27,11 @@ typedef struct {
   double ** array;
   double min;
   double max;
+  uint64_t seed;  // counter-based stream
 } BLOCK;
 
 
 // function prototypes
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
@@ -47,6 +50,7 @@ int rows, columns;
 
 
 int main(int argc, char ** argv) {
+  MATRIX * matrixA, * matrixB, * matrixSum, * matrixSum_seq;
   double ** C_seq;
   long i, initializationTime, startTime, endTime, seqTime, parallelTime;
   pthread_t * threadHandles;
@@ -70,13 +74,14 @@ int main(int argc, char ** argv) {
   threadsA = numberOfThreads / 2;
   threadsB = numberOfThreads - threadsA;
 
-  // seed the random number generator
-  srand( 5 );
-
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  Sum = allocate2DArray(rows, columns);
-  Sum_seq = allocate2DArray(rows, columns);
+  matrixA = allocateMatrix(rows, columns);
+  matrixB = allocateMatrix(rows, columns);
+  matrixSum = allocateMatrix(rows, columns);
+  matrixSum_seq = allocateMatrix(rows, columns);
+  A = matrixA->row;
+  B = matrixB->row;
+  Sum = matrixSum->row;
+  Sum_seq = matrixSum_seq->row;
 
   time(&startTime);
    // Generate arrays for threads handles
@@ -94,6 +99,7 @@ int main(int argc, char ** argv) {
     blocksA[i].array = A;
     blocksA[i].min = 0.0;
     blocksA[i].max = +5.0;
+    blocksA[i].seed = 5;
     pthread_create(&threadHandles[i], NULL, threadGenerate2DBlock, &blocksA[i]);
   } // end for
 
@@ -107,6 +113,7 @@ int main(int argc, char ** argv) {
     blocksB[i].array = B;
     blocksB[i].min = 0.0;
     blocksB[i].max = +5.0;
+    blocksB[i].seed = 6;
     pthread_create(&threadHandles[threadsA+i], NULL, threadGenerate2DBlock, &blocksB[i]);
   } // end for
 
@@ -178,6 +185,11 @@ int main(int argc, char ** argv) {
     print2DArray(rows, columns, Sum);
   } // end if
 
+  freeMatrix(matrixA);
+  freeMatrix(matrixB);
+  freeMatrix(matrixSum);
+  freeMatrix(matrixSum_seq);
+
   return 0;
 
 } // end main
@@ -185,11 +197,11 @@ int main(int argc, char ** argv) {
 /*******************************************************************
  * Function threadGenerate2DBlock - each thread is passed a BLOCK structure
  * define the block of an array to randomly generate.
- * NOTE:  rand_r is used to generate random #'s because it is "thread safe"
+ * Element (r, c) comes from the counter-based stream block->seed, so
+ * the arrays are the same whatever the # of threads.
  ********************************************************************/
 void * threadGenerate2DBlock(void * arg) {
   BLOCK * block = (BLOCK *) arg;
-  int threadId = block->threadId;
   int startRow = block->start_row;
   int endRow = block->end_row;
   int startCol = block->start_col;
@@ -197,17 +209,9 @@ void * threadGenerate2DBlock(void * arg) {
   double ** array = block->array;
   double min = block->min;
   double max = block->max;
-  int r, c;
-  double range, div;
-  int seed = (threadId+1)*1000;
 
-  for (r = startRow; r <= endRow; r++) {
-    for (c = startCol; c <= endCol; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      array[r][c] = min + (rand_r(&seed) / div);
-    } // end for (c...
-  } // end for (r...
+  generateCounterRandomBlock(array, columns, startRow, endRow, startCol, endCol,
+			     block->seed, min, max);
 
 
 } // threadGenerate2DBlock
@@ -255,24 +259,6 @@ void * threadMAdd(void * arg) {
 
 
 
-/*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
- ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
-
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
-
-  return local2DArray;
-} // end allocate2DArray
-
-
 /*******************************************************************
  * Function print2DArray is passed the # rows, # columns, and the
  * array2D.  It prints the 2D array to the screen.
@@ -1,19 +1,32 @@
 /* Program to generate two square 2D arrays of random doubles using
    threads and time their addition sequentially and using pthreads.
    The resulting sum matrix is assigned to threads by blocks of
-   whole rows.  
-   Compile by:  gcc -O5 -o maddC maddC.c -lm -lpthread
-   Run by:  ./mmultC 1000 2000 8
+   whole rows.
+   With "steal" the static blocks give way to a work-stealing pool
+   (workSteal.h): one run generates A and B, a second adds, each a
+   tree of tasks split down to STEAL_ROWS rows that idle threads
+   steal from the busy ones.
+   Compile by:  gcc -O5 -I../common -o maddC maddC.c ../common/matrix.c
+                ../common/counterRandom.c ../common/vectorAdd.c
+                ../common/workSteal.c ../common/barrier.c -lm -lpthread
+   Run by:  ./mmultC 1000 2000 8 [steal]
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
 #include <pthread.h>
+#include "matrix.h"  // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
+#include "vectorAdd.h"  // SIMD row add
+#include "workSteal.h"  // Chase-Lev work-stealing pool
+#include "barrier.h"  // sense-reversing spin barriers
 
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
+#define STEAL_ROWS 16  // rows per task in work-stealing mode
 
 typedef struct {
   int threadId;
@@ -24,11 +37,11 @@ typedef struct {
   double ** array;
   double min;
   double max;
+  uint64_t seed;  // counter-based stream
 } BLOCK;
 
 
 // function prototypes
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
@@ -36,34 +49,39 @@ void matrixAddition(int rows1, int columns1, double ** array1, double ** array2,
                     double ** arraySum);
 void * threadGenerate2DBlockThenAdd(void * block);
 void barrier(long i);
+void generateTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+		  int threadId);
+void addTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+	     int threadId);
 
 
 // Global variables
 double ** A;
 double ** B;
 double ** Sum;
+BOOL streamSum;  // Sum is bigger than the LLC: non-temporal stores
 int numberOfThreads;
 int rows, columns;
 pthread_mutex_t update_lock;
-pthread_mutex_t barrier_lock;   /* mutex for the barrier */
-pthread_cond_t all_here;        /* condition variable for barrier */
-int count=0;                    /* counter for barrier */
+BARRIER * generateBarrier;      /* A and B done before the adds */
 
 
 int main(int argc, char ** argv) {
+  MATRIX * matrixA, * matrixB, * matrixSum, * matrixSum_seq;
   double ** C_seq;
   long i, initializationTime, startTime, endTime, seqTime, parallelTime;
   pthread_t * threadHandles;
   int errorCode, threadsA, threadsB;
   double ** Sum_seq;
   double tolerance;
+  WORK_STEAL_POOL * pool;
   BLOCK * blocksOfWork;
   BLOCK * blocksA;
   BLOCK * blocksB;
 
   
-  if (argc !=4) {
-    printf("Usage: %s <# rows> <# columns> <# threads>\n", argv[0]);
+  if (argc !=4 && (argc != 5 || strcmp(argv[4], "steal") != 0)) {
+    printf("Usage: %s <# rows> <# columns> <# threads> [steal]\n", argv[0]);
     exit(-1);     
   } // end if
 
@@ -74,49 +92,66 @@ int main(int argc, char ** argv) {
   threadsA = numberOfThreads / 2;
   threadsB = numberOfThreads - threadsA;
 
-  // seed the random number generator
-  srand( 5 );
-
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  Sum = allocate2DArray(rows, columns);
-  Sum_seq = allocate2DArray(rows, columns);
+  matrixA = allocateMatrix(rows, columns);
+  matrixB = allocateMatrix(rows, columns);
+  matrixSum = allocateMatrix(rows, columns);
+  matrixSum_seq = allocateMatrix(rows, columns);
+  A = matrixA->row;
+  B = matrixB->row;
+  Sum = matrixSum->row;
+  Sum_seq = matrixSum_seq->row;
+  streamSum = vectorAddNonTemporal((size_t) rows*columns*sizeof(double));
+  printf("Rows added by the %s kernel%s\n", vectorAddKernelName(),
+	 streamSum ? " with non-temporal stores" : "");
 
   time(&startTime);
-   // Generate arrays for threads handles
-  threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
-  blocksA = (BLOCK *) malloc(threadsA*sizeof(BLOCK));
-  blocksB = (BLOCK *) malloc(threadsB*sizeof(BLOCK));
-
-  // create threads to randomly generate A
-  for (i=0; i < threadsA; i++) {
-    blocksA[i].threadId = i;
-    blocksA[i].start_row = i*rows/threadsA;
-    blocksA[i].end_row = (i+1)*rows/threadsA - 1;
-    blocksA[i].start_col = 0;
-    blocksA[i].end_col = columns - 1;
-    blocksA[i].array = A;
-    blocksA[i].min = 0.0;
-    blocksA[i].max = +5.0;
-    pthread_create(&threadHandles[i], NULL, threadGenerate2DBlockThenAdd, &blocksA[i]);
-  } // end for
-
-  // create threads to randomly generate B
-  for (i=0; i < threadsB; i++) {
-    blocksB[i].threadId = i+threadsA; // +threadsA makes all threadId's unique
-    blocksB[i].start_row = i*rows/threadsB;
-    blocksB[i].end_row = (i+1)*rows/threadsB - 1;
-    blocksB[i].start_col = 0;
-    blocksB[i].end_col = columns - 1;
-    blocksB[i].array = B;
-    blocksB[i].min = 0.0;
-    blocksB[i].max = +5.0;
-    pthread_create(&threadHandles[threadsA+i], NULL, threadGenerate2DBlockThenAdd, &blocksB[i]);
-  } // end for
-
-  for (i=0; i < numberOfThreads; i++) {
-    pthread_join(threadHandles[i], (void **) NULL);
-  } // end for
+  if (argc == 5) {
+    // A and B in one run, the adds in a second: the end of the first
+    // run is the barrier between them
+    pool = workStealCreate(numberOfThreads);
+    workStealRun(pool, generateTask, NULL, 0, 2*rows);
+    workStealRun(pool, addTask, NULL, 0, rows);
+    workStealDestroy(pool);
+  } else {
+    // Generate arrays for threads handles
+    generateBarrier = barrierCreate(numberOfThreads, BARRIER_DEFAULT);
+    threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+    blocksA = (BLOCK *) malloc(threadsA*sizeof(BLOCK));
+    blocksB = (BLOCK *) malloc(threadsB*sizeof(BLOCK));
+
+    // create threads to randomly generate A
+    for (i=0; i < threadsA; i++) {
+      blocksA[i].threadId = i;
+      blocksA[i].start_row = i*rows/threadsA;
+      blocksA[i].end_row = (i+1)*rows/threadsA - 1;
+      blocksA[i].start_col = 0;
+      blocksA[i].end_col = columns - 1;
+      blocksA[i].array = A;
+      blocksA[i].min = 0.0;
+      blocksA[i].max = +5.0;
+      blocksA[i].seed = 5;
+      pthread_create(&threadHandles[i], NULL, threadGenerate2DBlockThenAdd, &blocksA[i]);
+    } // end for
+
+    // create threads to randomly generate B
+    for (i=0; i < threadsB; i++) {
+      blocksB[i].threadId = i+threadsA; // +threadsA makes all threadId's unique
+      blocksB[i].start_row = i*rows/threadsB;
+      blocksB[i].end_row = (i+1)*rows/threadsB - 1;
+      blocksB[i].start_col = 0;
+      blocksB[i].end_col = columns - 1;
+      blocksB[i].array = B;
+      blocksB[i].min = 0.0;
+      blocksB[i].max = +5.0;
+      blocksB[i].seed = 6;
+      pthread_create(&threadHandles[threadsA+i], NULL, threadGenerate2DBlockThenAdd, &blocksB[i]);
+    } // end for
+
+    for (i=0; i < numberOfThreads; i++) {
+      pthread_join(threadHandles[i], (void **) NULL);
+    } // end for
+    barrierDestroy(generateBarrier);
+  } // end if
 
   time(&endTime);
   initializationTime = endTime-startTime;
@@ -146,6 +181,11 @@ int main(int argc, char ** argv) {
     print2DArray(rows, columns, Sum);
   } // end if
 
+  freeMatrix(matrixA);
+  freeMatrix(matrixB);
+  freeMatrix(matrixSum);
+  freeMatrix(matrixSum_seq);
+
   return 0;
 
 } // end main
@@ -153,7 +193,8 @@ int main(int argc, char ** argv) {
 /*******************************************************************
  * Function threadGenerate2DBlock - each thread is passed a BLOCK structure
  * define the block of an array to randomly generate.
- * NOTE:  rand_r is used to generate random #'s because it is "thread safe"
+ * Element (r, c) comes from the counter-based stream block->seed, so
+ * the arrays are the same whatever the # of threads.
  ********************************************************************/
 void * threadGenerate2DBlockThenAdd(void * arg) {
   BLOCK * block = (BLOCK *) arg;
@@ -165,17 +206,10 @@ void * threadGenerate2DBlockThenAdd(void * arg) {
   double ** array = block->array;
   double min = block->min;
   double max = block->max;
-  int r, c, blockSize;
-  double range, div;
-  int seed = (threadId+1)*1000;
-
-  for (r = startRow; r <= endRow; r++) {
-    for (c = startCol; c <= endCol; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      array[r][c] = min + (rand_r(&seed) / div);
-    } // end for (c...
-  } // end for (r...
+  int r, blockSize;
+
+  generateCounterRandomBlock(array, columns, startRow, endRow, startCol, endCol,
+			     block->seed, min, max);
   // thread changes it's role to start computing matrix addition on
   // a block of rows of Sum matrix
 
@@ -193,9 +227,7 @@ void * threadGenerate2DBlockThenAdd(void * arg) {
   // thread's block Matrix Multiplication uses A and B_transpose
   // Matrix Multiplication uses array1 and array2_transpose
   for (r=startRow; r <= endRow; r++) {
-    for (c=0; c < columns; c++) {
-        Sum[r][c] += A[r][c]+B[r][c];
-    } /* end for (j */
+    vectorAdd(Sum[r], A[r], B[r], columns, streamSum);
   } /* end for (i */
 
 
@@ -204,24 +236,58 @@ void * threadGenerate2DBlockThenAdd(void * arg) {
 
 
 /*******************************************************************
- * Function barrier passed the thread id for debugging purposes.
- * Implements barrier synchronization using global variables:
- * count - # of thread that have arrived at the barrier
- * numberOfThreads - # of threads we are synchronizing
- * barrier_lock - the mutex ensuring mutual exclusion
- * all_here - the condition variable where threads wait for all to arrive
+ * Function generateTask - work-stealing mode: index r < rows is row
+ * r of A, rows + r is row r of B.  Splits [start, end) in half,
+ * spawning the upper half, down to STEAL_ROWS rows and generates
+ * those rows.
  ********************************************************************/
-void barrier(long id) {
-  pthread_mutex_lock(&barrier_lock);
-  count++;
-  //printf("count %d, id %d\n", count, id);
-  if (count == numberOfThreads) {
-    count = 0;
-    pthread_cond_broadcast(&all_here);
-  } else {
-    while(pthread_cond_wait(&all_here, &barrier_lock) != 0);
+void generateTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+		  int threadId) {
+  int middle;
+
+  while (end - start > STEAL_ROWS) {
+    middle = start + (end - start) / 2;
+    workStealSpawn(pool, threadId, generateTask, arg, middle, end);
+    end = middle;
+  } // end while
+  if (start < rows) {
+    generateCounterRandomBlock(A, columns, start, (end < rows ? end : rows) - 1,
+			       0, columns - 1, 5, 0.0, +5.0);
+  } // end if
+  if (end > rows) {
+    generateCounterRandomBlock(B, columns, (start > rows ? start : rows) - rows,
+			       end - rows - 1, 0, columns - 1, 6, 0.0, +5.0);
   } // end if
-  pthread_mutex_unlock(&barrier_lock);
+} // end generateTask
+
+
+/*******************************************************************
+ * Function addTask - work-stealing mode: Sum = A + B on rows
+ * [start, end), split in half down to STEAL_ROWS rows.
+ ********************************************************************/
+void addTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+	     int threadId) {
+  int middle, r;
+
+  while (end - start > STEAL_ROWS) {
+    middle = start + (end - start) / 2;
+    workStealSpawn(pool, threadId, addTask, arg, middle, end);
+    end = middle;
+  } // end while
+  for (r=start; r < end; r++) {
+    vectorAdd(Sum[r], A[r], B[r], columns, streamSum);
+  } // end for
+} // end addTask
+
+
+
+/*******************************************************************
+ * Function barrier passed the thread id, which the barrier module
+ * needs (see barrier.h): returns once all numberOfThreads threads
+ * have arrived at generateBarrier.
+ ********************************************************************/
+void barrier(long id) {
+  barrierWait(generateBarrier, (int) id);
 } // end barrier
 
 
@@ -244,24 +310,6 @@ void matrixAddition(int rows, int columns, double ** array1, double ** array2,
 
 
 
-/*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
- ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
-
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
-
-  return local2DArray;
-} // end allocate2DArray
-
-
 /*******************************************************************
  * Function print2DArray is passed the # rows, # columns, and the
  * array2D.  It prints the 2D array to the screen.
@@ -3,19 +3,31 @@
    Program to generate two square 2D arrays of random doubles using
    threads and time their addition sequentially and using pthreads.
    The resulting sum matrix is assigned to threads by blocks of
-   whole rows.  
-   Compile by:  gcc -O5 -o maddC maddC.c -lm -lpthread
-   Run by:  ./mmultC 1000 2000 8
+   whole rows.
+   With "steal" the static blocks give way to a work-stealing pool
+   (workSteal.h): each block of STEAL_ROWS rows is generated by a
+   task that spawns the block's add on its own deque, and idle
+   threads steal the unsplit halves from the busy ones.
+   Compile by:  gcc -O5 -I../common -o maddD maddD.c ../common/matrix.c
+                ../common/counterRandom.c ../common/vectorAdd.c
+                ../common/workSteal.c -lm -lpthread
+   Run by:  ./mmultC 1000 2000 8 [steal]
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>  // use the time to seed the random # generator
 #include <math.h>  // needed for fabs function
 #include <pthread.h>
+#include "matrix.h"  // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
+#include "vectorAdd.h"  // SIMD row add
+#include "workSteal.h"  // Chase-Lev work-stealing pool
 
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
+#define STEAL_ROWS 16  // rows per task in work-stealing mode
 
 typedef struct {
   int threadId;
@@ -27,11 +39,11 @@ typedef struct {
   double ** array2;
   double min;
   double max;
+  uint64_t seed;  // counter-based stream of array (array2 uses seed+1)
 } BLOCK;
 
 
 // function prototypes
-double ** allocate2DArray(int rows, int columns);
 void print2DArray(int rows, int columns, double ** array2D);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
 		   double tolerance);
@@ -39,12 +51,17 @@ void matrixAddition(int rows1, int columns1, double ** array1, double ** array2,
                     double ** arraySum);
 void * threadGenerate2DBlockThenAdd(void * block);
 void barrier(long i);
+void generateTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+		  int threadId);
+void addTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+	     int threadId);
 
 
 // Global variables
 double ** A;
 double ** B;
 double ** Sum;
+BOOL streamSum;  // Sum is bigger than the LLC: non-temporal stores
 int numberOfThreads;
 int rows, columns;
 pthread_mutex_t update_lock;
@@ -54,18 +71,20 @@ int count=0;                    /* counter for barrier */
 
 
 int main(int argc, char ** argv) {
+  MATRIX * matrixA, * matrixB, * matrixSum, * matrixSum_seq;
   double ** C_seq;
   long i, initializationTime, startTime, endTime, seqTime, parallelTime;
   pthread_t * threadHandles;
   int errorCode;
   double ** Sum_seq;
   double tolerance;
+  WORK_STEAL_POOL * pool;
   BLOCK * blocksOfWork;
   BLOCK * block;
   
   
-  if (argc !=4) {
-    printf("Usage: %s <# rows> <# columns> <# threads>\n", argv[0]);
+  if (argc !=4 && (argc != 5 || strcmp(argv[4], "steal") != 0)) {
+    printf("Usage: %s <# rows> <# columns> <# threads> [steal]\n", argv[0]);
     exit(-1);     
   } // end if
 
@@ -73,36 +92,48 @@ int main(int argc, char ** argv) {
   sscanf(argv[2], "%d", &columns);
   sscanf(argv[3], "%d", &numberOfThreads);
 
-  // seed the random number generator
-  srand( 5 );
-
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  Sum = allocate2DArray(rows, columns);
-  Sum_seq = allocate2DArray(rows, columns);
+  matrixA = allocateMatrix(rows, columns);
+  matrixB = allocateMatrix(rows, columns);
+  matrixSum = allocateMatrix(rows, columns);
+  matrixSum_seq = allocateMatrix(rows, columns);
+  A = matrixA->row;
+  B = matrixB->row;
+  Sum = matrixSum->row;
+  Sum_seq = matrixSum_seq->row;
+  streamSum = vectorAddNonTemporal((size_t) rows*columns*sizeof(double));
+  printf("Rows added by the %s kernel%s\n", vectorAddKernelName(),
+	 streamSum ? " with non-temporal stores" : "");
 
   time(&startTime);
-   // Generate arrays for threads handles
-  threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
-  block = (BLOCK *) malloc(numberOfThreads*sizeof(BLOCK));
-  
-    // create threads to randomly generate A and B
-  for (i=0; i < numberOfThreads; i++) {
-    block[i].threadId = i;
-    block[i].start_row = i*rows/numberOfThreads;
-    block[i].end_row = (i+1)*rows/numberOfThreads - 1;
-    block[i].start_col = 0;
-    block[i].end_col = columns - 1;
-    block[i].array = A;
-    block[i].array2 = B;
-    block[i].min = 0.0;
-    block[i].max = +5.0;
-    pthread_create(&threadHandles[i], NULL, threadGenerate2DBlockThenAdd, &block[i]);
-  } // end for
-  
-  for (i=0; i < numberOfThreads; i++) {
-    pthread_join(threadHandles[i], (void **) NULL);
-  } // end for
+  if (argc == 5) {
+    // every block of rows is generated, then added by the same thread
+    pool = workStealCreate(numberOfThreads);
+    workStealRun(pool, generateTask, NULL, 0, rows);
+    workStealDestroy(pool);
+  } else {
+    // Generate arrays for threads handles
+    threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
+    block = (BLOCK *) malloc(numberOfThreads*sizeof(BLOCK));
+
+      // create threads to randomly generate A and B
+    for (i=0; i < numberOfThreads; i++) {
+      block[i].threadId = i;
+      block[i].start_row = i*rows/numberOfThreads;
+      block[i].end_row = (i+1)*rows/numberOfThreads - 1;
+      block[i].start_col = 0;
+      block[i].end_col = columns - 1;
+      block[i].array = A;
+      block[i].array2 = B;
+      block[i].min = 0.0;
+      block[i].max = +5.0;
+      block[i].seed = 5;
+      pthread_create(&threadHandles[i], NULL, threadGenerate2DBlockThenAdd, &block[i]);
+    } // end for
+
+    for (i=0; i < numberOfThreads; i++) {
+      pthread_join(threadHandles[i], (void **) NULL);
+    } // end for
+  } // end if
 
   time(&endTime);
   initializationTime = endTime-startTime;
@@ -132,6 +163,11 @@ int main(int argc, char ** argv) {
     print2DArray(rows, columns, Sum);
   } // end if
 
+  freeMatrix(matrixA);
+  freeMatrix(matrixB);
+  freeMatrix(matrixSum);
+  freeMatrix(matrixSum_seq);
+
   return 0;
 
 } // end main
@@ -139,11 +175,11 @@ int main(int argc, char ** argv) {
 /*******************************************************************
  * Function threadGenerate2DBlock - each thread is passed a BLOCK structure
  * define the block of an array to randomly generate.
- * NOTE:  rand_r is used to generate random #'s because it is "thread safe"
+ * Element (r, c) comes from the counter-based stream block->seed, so
+ * the arrays are the same whatever the # of threads.
  ********************************************************************/
 void * threadGenerate2DBlockThenAdd(void * arg) {
   BLOCK * block = (BLOCK *) arg;
-  int threadId = block->threadId;
   int startRow = block->start_row;
   int endRow = block->end_row;
   int startCol = block->start_col;
@@ -152,40 +188,68 @@ void * threadGenerate2DBlockThenAdd(void * arg) {
   double ** array2 = block->array2;
   double min = block->min;
   double max = block->max;
-  int r, c, blockSize;
-  double range, div;
-  int seed = (threadId+1)*1000;
+  int r, blockSize;
 
-  for (r = startRow; r <= endRow; r++) {
-    for (c = startCol; c <= endCol; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      array[r][c] = min + (rand_r(&seed) / div);
-    } // end for (c...
-  } // end for (r...
+  generateCounterRandomBlock(array, columns, startRow, endRow, startCol, endCol,
+			     block->seed, min, max);
   // thread changes it's role to start computing matrix addition on
   // a block of rows of Sum matrix
   
-  for (r = startRow; r <= endRow; r++) {
-    for (c = startCol; c <= endCol; c++) {
-      range = max - min;
-      div = RAND_MAX / range;
-      array2[r][c] = min + (rand_r(&seed) / div);
-    }
-  }
+  generateCounterRandomBlock(array2, columns, startRow, endRow, startCol, endCol,
+			     block->seed+1, min, max);
 
   // thread's block Matrix Multiplication uses A and B_transpose
   // Matrix Multiplication uses array1 and array2_transpose
   for (r = startRow; r <= endRow; r++) {
-    for (c = startCol; c <= endCol; c++) {
-        Sum[r][c] += A[r][c]+B[r][c];
-    } /* end for (j */
+    vectorAdd(Sum[r] + startCol, A[r] + startCol, B[r] + startCol,
+	      endCol - startCol + 1, streamSum);
   } /* end for (i */
 
 } // threadGenerate2DBlockThenAdd
 
 
 
+/*******************************************************************
+ * Function generateTask - work-stealing mode: splits rows [start,
+ * end) in half, spawning the upper half, down to STEAL_ROWS rows,
+ * generates those rows of A and B and spawns their add task, which
+ * this thread pops next while the rows are still in its cache.
+ ********************************************************************/
+void generateTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+		  int threadId) {
+  int middle;
+
+  while (end - start > STEAL_ROWS) {
+    middle = start + (end - start) / 2;
+    workStealSpawn(pool, threadId, generateTask, arg, middle, end);
+    end = middle;
+  } // end while
+  generateCounterRandomBlock(A, columns, start, end - 1, 0, columns - 1,
+			     5, 0.0, +5.0);
+  generateCounterRandomBlock(B, columns, start, end - 1, 0, columns - 1,
+			     6, 0.0, +5.0);
+  workStealSpawn(pool, threadId, addTask, arg, start, end);
+} // end generateTask
+
+
+/*******************************************************************
+ * Function addTask - work-stealing mode: Sum = A + B on rows
+ * [start, end).
+ ********************************************************************/
+void addTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+	     int threadId) {
+  int r;
+
+  (void) pool;      // an add task spawns nothing
+  (void) arg;
+  (void) threadId;
+  for (r=start; r < end; r++) {
+    vectorAdd(Sum[r], A[r], B[r], columns, streamSum);
+  } // end for
+} // end addTask
+
+
+
 /*******************************************************************
  * Function barrier passed the thread id for debugging purposes.
  * Implements barrier synchronization using global variables:
@@ -227,24 +291,6 @@ void matrixAddition(int rows, int columns, double ** array1, double ** array2,
 
 
 
-/*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
- ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
-
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
-
-  return local2DArray;
-} // end allocate2DArray
-
-
 /*******************************************************************
  * Function print2DArray is passed the # rows, # columns, and the
  * array2D.  It prints the 2D array to the screen.
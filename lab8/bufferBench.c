@@ -0,0 +1,334 @@
+/*  File:        bufferBench.c
+    Description: Throughput of the bounded buffer between producer and
+    consumer threads: the mutex + nonFull/nonEmpty condition variable
+    buffer that maddE/maddF/hw8 used (one global lock and a signal per
+    item) against the lock-free ring of ringBuffer.h, for every
+    producer count x consumer count in the sweep.  Producers push
+    their share of WORK items as fast as they can, consumers pop until
+    they get a poison pill (rowStart < 0), and the rate is items
+    moved per second from the first push to the last pop.  With a
+    batch size K > 1 a third column moves the items through the ring
+    K per reservation (ringBufferPushBatch / ringBufferPopBatch).
+    Compile by:  gcc -O3 -I../common -o bufferBench bufferBench.c
+                 ../common/ringBuffer.c -lpthread
+    Run by:      ./bufferBench 2000000 1,2,4,8 20 [8]
+                 (# items, producer / consumer counts, buffer slots,
+                  items per batch)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "timer.h"
+#include "ringBuffer.h"
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+#define MAX_LIST 16
+#define MAX_THREADS 256
+
+typedef struct {
+  int rowStart;
+  int rowEnd;
+} WORK;
+
+// the mutex / condition variable bounded buffer, as in maddE.c
+typedef struct {
+  WORK * buffer;
+  int size;
+  int count;
+  int front;
+  int rear;
+  pthread_mutex_t lock;
+  pthread_cond_t nonFull;
+  pthread_cond_t nonEmpty;
+} LOCKED_BUFFER;
+
+typedef struct {
+  BOOL useRing;
+  LOCKED_BUFFER * locked;
+  RING_BUFFER * ring;
+  int batch;          // items per ring operation
+  long items;         // per producer
+  long checksum;      // per consumer: sum of rowStart popped
+} THREAD_ARGS;
+
+// function prototypes
+int parseList(const char * text, int * list);
+double runSweepPoint(BOOL useRing, int batch, int producers, int consumers,
+		     long items, int slots);
+void * producerWork(void * args);
+void * consumerWork(void * args);
+void put(THREAD_ARGS * args, WORK item);
+WORK take(THREAD_ARGS * args);
+void lockedAdd(LOCKED_BUFFER * b, WORK item);
+WORK lockedRemove(LOCKED_BUFFER * b);
+
+int main(int argc, char * argv[]) {
+  int counts[MAX_LIST], numberOfCounts, slots, requested, batch = 1, p, c;
+  long items;
+  double lockedRate, ringRate, batchRate;
+
+  if (argc != 4 && argc != 5) {
+    printf("usage: %s <# items> <thread counts, e.g. 1,2,4,8> <# buffer slots> [<items per batch>]\n",
+	   argv[0]);
+    exit(1);
+  } // end if
+  sscanf(argv[1], "%ld", &items);
+  numberOfCounts = parseList(argv[2], counts);
+  sscanf(argv[3], "%d", &slots);
+  if (argc == 5) {
+    sscanf(argv[4], "%d", &batch);
+  } // end if
+  if (numberOfCounts == 0 || slots < 1 || items < 1 || batch < 1) {
+    printf("Thread counts (1-%d) must be separated by commas; items and slots positive\n",
+	   MAX_THREADS);
+    exit(1);
+  } // end if
+
+  // the ring rounds its capacity up to a power of two (at least 2):
+  // give the locked buffer the same number of slots
+  requested = slots;
+  for (slots=2; slots < requested; slots *= 2);
+  printf("%ld items, %d slots in both buffers (%d requested, rounded up to a power of two)\n",
+	 items, slots, requested);
+  printf("producers consumers   mutex+condvar (Mitems/s)   ring (Mitems/s)   speedup");
+  if (batch > 1) {
+    printf("   ring, batches of %d   speedup", batch);
+  } // end if
+  printf("\n");
+  for (p=0; p < numberOfCounts; p++) {
+    for (c=0; c < numberOfCounts; c++) {
+      lockedRate = runSweepPoint(FALSE, 1, counts[p], counts[c], items, slots);
+      ringRate = runSweepPoint(TRUE, 1, counts[p], counts[c], items, slots);
+      printf("%9d %9d   %24.3f   %15.3f   %7.2f", counts[p], counts[c],
+	     lockedRate * 1.0e-6, ringRate * 1.0e-6, ringRate / lockedRate);
+      if (batch > 1) {
+	batchRate = runSweepPoint(TRUE, batch, counts[p], counts[c], items, slots);
+	printf("   %19.3f   %7.2f", batchRate * 1.0e-6, batchRate / lockedRate);
+      } // end if
+      printf("\n");
+    } // end for c
+  } // end for p
+
+  return 0;
+} // end main
+
+
+/*******************************************************************
+ * Function parseList reads a comma-separated list of thread counts
+ * into list and returns how many, 0 if any is bad.
+ ********************************************************************/
+int parseList(const char * text, int * list) {
+  int count = 0, value, used;
+
+  while (count < MAX_LIST && sscanf(text, "%d%n", &value, &used) == 1) {
+    if (value <= 0 || value > MAX_THREADS) {
+      return 0;
+    } // end if
+    list[count++] = value;
+    text += used;
+    if (*text != ',') {
+      break;
+    } // end if
+    text++;
+  } // end while
+  return (*text == '\0') ? count : 0;
+} // end parseList
+
+
+/*******************************************************************
+ * Function runSweepPoint moves items WORK items from producers
+ * producer threads to consumers consumer threads through one buffer
+ * and returns the items per second.  Every item is checked through
+ * the sum of its rowStart values.
+ ********************************************************************/
+double runSweepPoint(BOOL useRing, int batch, int producers, int consumers,
+		     long items, int slots) {
+  pthread_t threadHandles[2*MAX_THREADS];
+  THREAD_ARGS args[2*MAX_THREADS];
+  LOCKED_BUFFER locked;
+  RING_BUFFER * ring = NULL;
+  WORK pill = {-1, -1};
+  THREAD_ARGS mainArgs;
+  double startTime, endTime;
+  long perProducer = items / producers, checksum = 0, expected;
+  int i;
+
+  locked.buffer = (WORK *) malloc(slots*sizeof(WORK));
+  locked.size = slots;
+  locked.count = 0;
+  locked.front = -1;
+  locked.rear = 0;
+  pthread_mutex_init(&locked.lock, NULL);
+  pthread_cond_init(&locked.nonFull, NULL);
+  pthread_cond_init(&locked.nonEmpty, NULL);
+  if (useRing) {
+    ring = ringBufferCreate(slots, sizeof(WORK));
+  } // end if
+
+  for (i=0; i < producers + consumers; i++) {
+    args[i].useRing = useRing;
+    args[i].locked = &locked;
+    args[i].ring = ring;
+    args[i].batch = batch;
+    args[i].items = perProducer;
+    args[i].checksum = 0;
+  } // end for
+  mainArgs = args[0];
+
+  GET_TIME(startTime);
+  for (i=0; i < producers + consumers; i++) {
+    if (pthread_create(&threadHandles[i], NULL,
+		       (i < producers) ? producerWork : consumerWork, &args[i]) != 0) {
+      printf("pthread %d failed to be created\n", i);
+      exit(-1);
+    } // end if
+  } // end for
+  for (i=0; i < producers; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+  } // end for
+  for (i=0; i < consumers; i++) {
+    put(&mainArgs, pill);
+  } // end for
+  for (i=producers; i < producers + consumers; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+    checksum += args[i].checksum;
+  } // end for
+  GET_TIME(endTime);
+
+  expected = (long) producers * (perProducer * (perProducer - 1) / 2);
+  if (checksum != expected) {
+    printf("%s buffer lost or duplicated items (checksum %ld, expected %ld)\n",
+	   useRing ? "Ring" : "Locked", checksum, expected);
+    exit(-1);
+  } // end if
+
+  if (useRing) {
+    ringBufferDestroy(ring);
+  } // end if
+  pthread_mutex_destroy(&locked.lock);
+  pthread_cond_destroy(&locked.nonFull);
+  pthread_cond_destroy(&locked.nonEmpty);
+  free(locked.buffer);
+  return (double) producers * perProducer / (endTime - startTime);
+} // end runSweepPoint
+
+
+void * producerWork(void * args) {
+  THREAD_ARGS * myArgs = (THREAD_ARGS *) args;
+  WORK * items = (WORK *) malloc(myArgs->batch*sizeof(WORK));
+  long i;
+  int count = 0;
+
+  for (i=0; i < myArgs->items; i++) {
+    items[count].rowStart = (int) i;
+    items[count].rowEnd = (int) i + 1;
+    count++;
+    if (count == myArgs->batch || i == myArgs->items - 1) {
+      if (myArgs->batch > 1) {
+	ringBufferPushBatch(myArgs->ring, items, count);
+      } else {
+	put(myArgs, items[0]);
+      } // end if
+      count = 0;
+    } // end if
+  } // end for
+  free(items);
+  return NULL;
+} // end producerWork
+
+
+void * consumerWork(void * args) {
+  THREAD_ARGS * myArgs = (THREAD_ARGS *) args;
+  WORK * items = (WORK *) malloc(myArgs->batch*sizeof(WORK));
+  WORK pill = {-1, -1};
+  int count, i, pills = 0;
+
+  while (pills == 0) {
+    if (myArgs->batch > 1) {
+      count = ringBufferPopBatch(myArgs->ring, items, myArgs->batch);
+    } else {
+      items[0] = take(myArgs);
+      count = 1;
+    } // end if
+    for (i=0; i < count; i++) {
+      if (items[i].rowStart < 0) {
+	pills++;
+      } else {
+	myArgs->checksum += items[i].rowStart;
+      } // end if
+    } // end for
+  } // end while
+  // a batch can hold other consumers' pills: hand them back
+  for (i=1; i < pills; i++) {
+    put(myArgs, pill);
+  } // end for
+  free(items);
+  return NULL;
+} // end consumerWork
+
+
+/*******************************************************************
+ * Function put / take - push or pop on whichever buffer is tested.
+ ********************************************************************/
+void put(THREAD_ARGS * args, WORK item) {
+  if (args->useRing) {
+    ringBufferPush(args->ring, &item);
+  } else {
+    lockedAdd(args->locked, item);
+  } // end if
+} // end put
+
+WORK take(THREAD_ARGS * args) {
+  WORK item;
+
+  if (args->useRing) {
+    ringBufferPop(args->ring, &item);
+  } else {
+    item = lockedRemove(args->locked);
+  } // end if
+  return item;
+} // end take
+
+
+/*******************************************************************
+ * Function lockedAdd / lockedRemove - the bufferAdd / bufferRemove
+ * of maddE.c on a LOCKED_BUFFER.
+ ********************************************************************/
+void lockedAdd(LOCKED_BUFFER * b, WORK item) {
+
+  pthread_mutex_lock(&b->lock);
+  while(b->count == b->size) {
+    while(pthread_cond_wait(&b->nonFull, &b->lock) != 0);
+  } // end while
+  if (b->count == 0) {
+    b->front = 0;
+    b->rear = 0;
+  } else {
+    b->rear = (b->rear + 1) % b->size;
+  } // end if
+  b->buffer[b->rear] = item;
+  b->count++;
+  pthread_cond_signal(&b->nonEmpty);
+  pthread_mutex_unlock(&b->lock);
+
+} // end lockedAdd
+
+WORK lockedRemove(LOCKED_BUFFER * b) {
+  WORK returnValue;
+
+  pthread_mutex_lock(&b->lock);
+  while(b->count == 0) {
+    while(pthread_cond_wait(&b->nonEmpty, &b->lock) != 0);
+  } // end while
+  returnValue = b->buffer[b->front];
+  b->front = (b->front + 1) % b->size;
+  b->count--;
+  pthread_cond_signal(&b->nonFull);
+  pthread_mutex_unlock(&b->lock);
+  return returnValue;
+
+} // end lockedRemove
@@ -1,8 +1,12 @@
 /*  Programmer:  Mark Fienup
     File:        maddE.c
-    Compiled by: gcc -O3 -o madd maddE.c -lpthread -lm
-    Description:  Bounded buffer using pthread condition variables to 
-    avoid over or underflowing the bounded buffer.
+    Compiled by: gcc -O3 -I../common -o madd maddE.c ../common/matrix.c
+                 ../common/counterRandom.c ../common/ringBuffer.c ../common/vectorAdd.c
+                 -lpthread -lm
+    Description:  Bounded buffer between the producer and consumer
+    threads, a lock-free ring (ringBuffer.h) that parks on a futex
+    instead of using a mutex and condition variables to avoid over or
+    underflowing the bounded buffer.
 */
 #include <unistd.h>
 #include <stdio.h>
@@ -12,9 +16,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include "timer.h"  // Textbook timer MACROs
+#include "matrix.h"  // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
+#include "ringBuffer.h"  // lock-free bounded buffer
+#include "vectorAdd.h"  // SIMD row add
 
 
-#define SIZE 20    // # of slots in the bounded buffer
+#define SIZE 20    // # of slots asked for: the ring rounds it up to 32
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
@@ -25,22 +33,18 @@ typedef struct {
 } WORK;
 
 // Global Bounded Buffer
-WORK buffer[SIZE];
-int count = 0;
-int front = -1;
-int rear = 0;
-pthread_mutex_t lock;
-pthread_cond_t nonFull;
-pthread_cond_t nonEmpty;
+RING_BUFFER * buffer;  // lock-free MPMC ring of SIZE (rounded up) WORK items
 
 void  *producerWork(void *);
 void  *consumerWork(void *);
-void bufferAdd(WORK);
-WORK bufferRemove();
+void bufferAddBatch(WORK *, int);
+int bufferRemoveBatch(WORK *, int);
 
 // Global next row # to be produced
 pthread_mutex_t nextRowNumberLock;
 int nextRowNumber = 0;
+int batch = 1;  // WORK items moved per buffer operation
+BOOL streamSum;  // Sum is bigger than the LLC: non-temporal stores
 
 // Global count of rows consumed
 pthread_mutex_t rowsConsumedCountLock;
@@ -48,15 +52,12 @@ int rowsConsumedCount = 0;
 pthread_mutex_t allRowsConsumedLock;
 
 // prototypes
-double ** allocate2DArray(int rows, int columns);
 void free2DArray(unsigned char ** array2D, int rows, int columns);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
                    double tolerance);
 void matrixAddition(int rows1, int columns1, double ** array1, double ** array2,
                     double ** arraySum);
 void print2DArray(int rows, int columns, double ** array2D);
-void generateRandomRow(double * rowArray, int length, double min, 
-		       double max, unsigned int * seed);
 void addRows(double * row1, double * row2, double * rowSum, int length);
 
 // Global variables
@@ -66,6 +67,7 @@ double ** Sum;
 int rows, columns;
 
 int main(int argc, char * argv[]) {
+  MATRIX * matrixA, * matrixB, * matrixSum, * matrixSum_seq;
   int numberOfProducerThreads, numberOfConsumerThreads, numberOfThreads;
   long i;
   double initializationTime, startTime, endTime, seqTime, parallelTime;
@@ -74,8 +76,8 @@ int main(int argc, char * argv[]) {
   double ** Sum_seq;
   double tolerance;
 
-  if (argc != 5) {
-    printf("usage: %s <# rows> <# columns> <# producer threads> <# consumer threads>\n",
+  if (argc != 5 && argc != 6) {
+    printf("usage: %s <# rows> <# columns> <# producer threads> <# consumer threads> [<# rows per batch>]\n",
 	   argv[0]);
     exit(1);
   } // end if
@@ -84,25 +86,36 @@ int main(int argc, char * argv[]) {
   sscanf(argv[2], "%d", &columns);
   sscanf(argv[3], "%d", &numberOfProducerThreads);
   sscanf(argv[4], "%d", &numberOfConsumerThreads);
+  if (argc == 6) {
+    sscanf(argv[5], "%d", &batch);
+  } // end if
+  if (batch < 1) {
+    printf("Batch size must be at least 1\n");
+    exit(1);
+  } // end if
 
   // initialize mutexes
   pthread_mutex_init(&nextRowNumberLock, NULL);
   pthread_mutex_init(&rowsConsumedCountLock, NULL);
 
   // Bounded Buffer initialization
-  pthread_mutex_init(&lock, NULL);
-  pthread_cond_init(&nonFull, NULL);
-  pthread_cond_init(&nonEmpty, NULL);
+  buffer = ringBufferCreate(SIZE, sizeof(WORK));
 
   // allocate threadHandles and attributes
   numberOfThreads = numberOfProducerThreads + numberOfConsumerThreads;
   threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
 
-  srand(5);
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  Sum = allocate2DArray(rows, columns);
-  Sum_seq = allocate2DArray(rows, columns);
+  matrixA = allocateMatrix(rows, columns);
+  matrixB = allocateMatrix(rows, columns);
+  matrixSum = allocateMatrix(rows, columns);
+  matrixSum_seq = allocateMatrix(rows, columns);
+  A = matrixA->row;
+  B = matrixB->row;
+  Sum = matrixSum->row;
+  Sum_seq = matrixSum_seq->row;
+  streamSum = vectorAddNonTemporal((size_t) rows*columns*sizeof(double));
+  printf("Rows added by the %s kernel%s\n", vectorAddKernelName(),
+	 streamSum ? " with non-temporal stores" : "");
 
   printf("Array allocations done\n");
   GET_TIME(startTime);
@@ -127,8 +140,8 @@ int main(int argc, char * argv[]) {
   pthread_mutex_lock(&allRowsConsumedLock);
 
   GET_TIME(endTime);
-  printf("Parallel Time with %d Producers and %d Consumers = %1.3f\n", 
-	 numberOfProducerThreads, numberOfConsumerThreads, endTime-startTime);
+  printf("Parallel Time with %d Producers and %d Consumers (batches of %d) = %1.3f\n",
+	 numberOfProducerThreads, numberOfConsumerThreads, batch, endTime-startTime);
 
   matrixAddition(rows, columns, A, B, Sum_seq);
 
@@ -147,6 +160,11 @@ int main(int argc, char * argv[]) {
     print2DArray(rows, columns, Sum);
   } // end if
 
+  freeMatrix(matrixA);
+  freeMatrix(matrixB);
+  freeMatrix(matrixSum);
+  freeMatrix(matrixSum_seq);
+
   return 0;
 
 
@@ -156,51 +174,56 @@ int main(int argc, char * argv[]) {
 
 void  *producerWork(void * args) {
   
-  long threadId = (long) args;
-  int rowNumber;
-  WORK blockOfWork;
-  unsigned int seed;
-
-  seed = (threadId+1)*1000;
+  int rowNumber, count;
+  WORK * blocksOfWork = (WORK *) malloc(batch*sizeof(WORK));
 
+  (void) args;  // producers share the row counter: no id needed
   while (TRUE) {
+    // claim a batch of rows with one lock round trip
     pthread_mutex_lock(&nextRowNumberLock);
     rowNumber = nextRowNumber;
-    nextRowNumber++;
+    nextRowNumber += batch;
     pthread_mutex_unlock(&nextRowNumberLock);
+
+    for (count = 0; count < batch && rowNumber < rows; count++, rowNumber++) {
+      // element (r, c) is index r*columns + c of streams 5 (A) and 6 (B)
+      generateCounterRandomRow(A[rowNumber], columns, (uint64_t) rowNumber*columns, 5, 0.0, +5.0);
+      generateCounterRandomRow(B[rowNumber], columns, (uint64_t) rowNumber*columns, 6, 0.0, +5.0);
+
+      blocksOfWork[count].rowStart = rowNumber;
+      blocksOfWork[count].rowEnd = rowNumber;
+    } // end for
+    if (count > 0) {
+      bufferAddBatch(blocksOfWork, count);
+    } // end if
     if (rowNumber >= rows) {
       break;
     } // end if
 
-    generateRandomRow(A[rowNumber], columns, 0.0, +5.0, &seed);
-    generateRandomRow(B[rowNumber], columns, 0.0, +5.0, &seed);
-
-    blockOfWork.rowStart=rowNumber;
-    blockOfWork.rowEnd = rowNumber;
-
-    bufferAdd(blockOfWork);
-
   } // end while
-  
+  free(blocksOfWork);
+  return NULL;
 
 } // end producerWork
 
 void  *consumerWork(void * args) {
   
-  long threadId = (long) args;
-  int rowNumber;
-  int counter = 0;
-  WORK blockOfWork;
+  int rowNumber, i, count;
+  WORK * blocksOfWork = (WORK *) malloc(batch*sizeof(WORK));
 
+  (void) args;  // consumers take whatever work comes next: no id needed
   while (TRUE) {
     
-    blockOfWork = bufferRemove(threadId);
+    // drain up to a batch of rows at once
+    count = bufferRemoveBatch(blocksOfWork, batch);
 
-    rowNumber = blockOfWork.rowStart;
-    addRows(A[rowNumber], B[rowNumber], Sum[rowNumber], columns);
+    for (i = 0; i < count; i++) {
+      rowNumber = blocksOfWork[i].rowStart;
+      addRows(A[rowNumber], B[rowNumber], Sum[rowNumber], columns);
+    } // end for
 
     pthread_mutex_lock(&rowsConsumedCountLock);
-    rowsConsumedCount++;
+    rowsConsumedCount += count;
     if (rowsConsumedCount >= rows) {
       pthread_mutex_unlock(&allRowsConsumedLock);
     }  
@@ -210,93 +233,38 @@ void  *consumerWork(void * args) {
 } // end consumerWork
 
 
-void bufferAdd(WORK item) {
-
-  pthread_mutex_lock(&lock);
-  while(count == SIZE) {
-    while(pthread_cond_wait(&nonFull, &lock) != 0);
-  } // end while
-  if (count == 0) {
-    front = 0;
-    rear = 0;
-  } else {
-    rear = (rear + 1) % SIZE;
-  } // end if
-  buffer[rear] = item;
-  count++;
-  pthread_cond_signal(&nonEmpty);
-  pthread_mutex_unlock(&lock);
-
-} // end bufferAdd
-
-WORK bufferRemove() {
-  WORK returnValue;
+/*******************************************************************
+ * Function bufferAddBatch puts count WORK items into the bounded
+ * buffer, as many per reservation as there is room for.
+ ********************************************************************/
+void bufferAddBatch(WORK * items, int count) {
 
-  pthread_mutex_lock(&lock);
-  while(count == 0) {
-    while(pthread_cond_wait(&nonEmpty, &lock) != 0);
-  } // end while
-  returnValue = buffer[front];
-  front = (front + 1) % SIZE;
-  count--;
-  pthread_cond_signal(&nonFull);
-  pthread_mutex_unlock(&lock);
-  return returnValue;
+  ringBufferPushBatch(buffer, items, count);
 
-} // end bufferRemove
+} // end bufferAddBatch
 
-   
 /*******************************************************************
- * Function generatesRandomRow randomly assigns doubles to a 1D array of
- * size length.
+ * Function bufferRemoveBatch takes between 1 and max WORK items out
+ * of the bounded buffer (waiting while it is empty), returns how many.
  ********************************************************************/
-void generateRandomRow(double * rowArray, int length, double min, 
-		       double max, unsigned int * seed) {
-  int index;
-  double range, div;
-
-  for (index = 0; index < length; index++) {
-    range = max - min;
-    div = RAND_MAX / range;
-    rowArray[index] = min + (rand_r(seed) / div);
-  } // end for (index...
- 
-} // generateRandomRow
+int bufferRemoveBatch(WORK * items, int max) {
 
+  return ringBufferPopBatch(buffer, items, max);
 
+} // end bufferRemoveBatch
 
+   
 /*******************************************************************
  * Function addRows adds two 1D  arrays of size length, and returns
- * their sum in the 1D array rowSum.
+ * their sum in the 1D array rowSum, with the SIMD kernel of vectorAdd.h.
  ********************************************************************/
 void addRows(double * row1, double * row2, double * rowSum, int length) {
-  int index;
 
-  for (index = 0; index < length; index++) {
-    rowSum[index] = row1[index] + row2[index];
-  } // end for (index...
+  vectorAdd(rowSum, row1, row2, length, streamSum);
 
 } // end addRows
 
 
-/*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
- ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
-
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
-
-  return local2DArray;
-} // end allocate2DArray
-
-
 /*******************************************************************
  * Function free2DArray dynamically deallocates a 2D array of
  * size rows x columns, and returns it.
@@ -1,9 +1,31 @@
 /*  Edited by:   Vincent Mossman
 	Programmer:  Mark Fienup
     File:        maddE.c
-    Compiled by: gcc -O3 -o madd maddE.c -lpthread -lm
-    Description:  Bounded buffer using pthread condition variables to 
-    avoid over or underflowing the bounded buffer.
+    Compiled by: gcc -O3 -I../common -o madd maddF.c ../common/matrix.c
+                 ../common/counterRandom.c ../common/ringBuffer.c ../common/vectorAdd.c
+                 ../common/workSteal.c -lpthread -lm
+    Description:  Bounded buffer between the producer and consumer
+    threads, a lock-free ring (ringBuffer.h) that parks on a futex
+    instead of using a mutex and condition variables to avoid over or
+    underflowing the bounded buffer.  When the producers are done main
+    queues one poison pill per consumer and joins them, so nothing is
+    left running and the pipeline can run again: an optional number
+    of iterations repeats the whole run in the same process and
+    reports each one's thread startup, producing and shutdown times.
+    With "stream" as the last argument A and B are never allocated:
+    producers generate each block into a row buffer taken from a small
+    pool, consumers add it into Sum and return the buffer to a free
+    list (a second ring), so the inputs take O(threads * block * row)
+    memory instead of two full matrices.  Sum is then checked one row
+    at a time against freshly generated rows.
+    With "steal" as the last argument there is no buffer and no
+    nextRowNumber: the producer + consumer threads form one
+    work-stealing pool (workSteal.h).  A generate task splits its row
+    range in half until it is one block, spawning the other half on
+    its own deque, generates the block and spawns the block's add
+    task, which the same thread then pops while the rows are still
+    in its cache; idle threads steal the big halves from the top of
+    the others' deques.
 */
 #include <unistd.h>
 #include <stdio.h>
@@ -13,9 +35,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include "timer.h"  // Textbook timer MACROs
+#include "matrix.h"  // contiguous MATRIX type
+#include "counterRandom.h"  // counter-based random numbers
+#include "ringBuffer.h"  // lock-free bounded buffer
+#include "vectorAdd.h"  // SIMD row add
+#include "workSteal.h"  // Chase-Lev work-stealing pool
 
 
-#define SIZE 20    // # of slots in the bounded buffer
+#define SIZE 20    // # of slots asked for: the ring rounds it up to 32
 #define TRUE 1
 #define FALSE 0
 #define BOOL int
@@ -23,43 +50,51 @@
 typedef struct {
   int rowStart;
   int rowEnd;
+  int rowBuffer;   // index into the row buffer pool, -1 if rows of A and B
 } WORK;
 
 // Global Bounded Buffer
-WORK buffer[SIZE];
-int count = 0;
-int front = -1;
-int rear = 0;
-pthread_mutex_t lock;
-pthread_cond_t nonFull;
-pthread_cond_t nonEmpty;
+RING_BUFFER * buffer;  // lock-free MPMC ring of SIZE (rounded up) WORK items
+
+// Streaming mode: pool of row buffers recycled through a free list
+BOOL streaming = FALSE;
+RING_BUFFER * freeList;  // indices of the row buffers not in use
+int poolSize;
+double ** poolA;   // poolA[k], poolB[k]: blockSize rows of A / B
+double ** poolB;
+
+// Work-stealing mode: generate tasks spawn add tasks
+BOOL stealing = FALSE;
 
 void  *producerWork(void *);
 void  *consumerWork(void *);
-void bufferAdd(WORK);
-WORK bufferRemove();
+void generateTask(WORK_STEAL_POOL *, void *, int, int, int);
+void addTask(WORK_STEAL_POOL *, void *, int, int, int);
+void runPipeline(int, int, pthread_t *, double *, double *, double *);
+void bufferAddBatch(WORK *, int);
+int bufferRemoveBatch(WORK *, int);
 
 // Global next row # to be produced
 pthread_mutex_t nextRowNumberLock;
 int nextRowNumber = 0;
+int batch = 1;  // WORK items moved per buffer operation
+BOOL streamSum;  // Sum is bigger than the LLC: non-temporal stores
 int blockSize;
 
-// Global count of rows consumed
-pthread_mutex_t rowsConsumedCountLock;
-int rowsConsumedCount = 0;
-pthread_mutex_t allRowsConsumedLock;
+// Repeated runs of the whole pipeline in one process
+#define MAX_ITERATIONS 1000
+int iterations = 1;
 
 // prototypes
-double ** allocate2DArray(int rows, int columns);
 void free2DArray(unsigned char ** array2D, int rows, int columns);
 BOOL equal2DArrays(int rows, int columns, double ** array1, double ** array2,
                    double tolerance);
 void matrixAddition(int rows1, int columns1, double ** array1, double ** array2,
                     double ** arraySum);
 void print2DArray(int rows, int columns, double ** array2D);
-void generateRandomRow(double * rowArray, int length, double min, 
-		       double max, unsigned int * seed);
 void addRows(double * row1, double * row2, double * rowSum, int length);
+BOOL verifyStreamedSum(int rows, int columns, double ** arraySum,
+		       double tolerance);
 
 // Global variables
 double ** A;
@@ -68,16 +103,28 @@ double ** Sum;
 int rows, columns;
 
 int main(int argc, char * argv[]) {
+  MATRIX * matrixA = NULL, * matrixB = NULL, * matrixSum, * matrixSum_seq = NULL;
   int numberOfProducerThreads, numberOfConsumerThreads, numberOfThreads;
-  long i;
   double initializationTime, startTime, endTime, seqTime, parallelTime;
   pthread_t * threadHandles;
-  int errorCode;
-  double ** Sum_seq;
+  int errorCode, k;
+  double ** Sum_seq = NULL;
   double tolerance;
-
-  if (argc != 6) {
-    printf("usage: %s <# rows> <# columns> <# producer threads> <# consumer threads> <block size>\n",
+  BOOL match;
+  WORK_STEAL_POOL * stealPool;
+  int iteration;
+  double iterationTime[MAX_ITERATIONS] = {0.0}, startupTime, runTime, teardownTime;
+  double totalTime, minTime, maxTime;
+
+  if (argc > 6 && strcmp(argv[argc-1], "stream") == 0) {
+    streaming = TRUE;
+    argc--;
+  } else if (argc > 6 && strcmp(argv[argc-1], "steal") == 0) {
+    stealing = TRUE;
+    argc--;
+  } // end if
+  if (argc < 6 || argc > 8) {
+    printf("usage: %s <# rows> <# columns> <# producer threads> <# consumer threads> <block size> [<# blocks per batch> [<# iterations>]] [stream | steal]\n",
 	   argv[0]);
     exit(1);
   } // end if
@@ -87,69 +134,149 @@ int main(int argc, char * argv[]) {
   sscanf(argv[3], "%d", &numberOfProducerThreads);
   sscanf(argv[4], "%d", &numberOfConsumerThreads);
   sscanf(argv[5], "%d", &blockSize);
+  if (argc >= 7) {
+    sscanf(argv[6], "%d", &batch);
+  } // end if
+  if (argc == 8) {
+    sscanf(argv[7], "%d", &iterations);
+  } // end if
+  if (blockSize < 1 || batch < 1 || iterations < 1 || iterations > MAX_ITERATIONS) {
+    printf("Block size and batch size must be at least 1, iterations 1 to %d\n",
+	   MAX_ITERATIONS);
+    exit(1);
+  } // end if
+  if (blockSize > rows) {
+    blockSize = rows;  // one block already holds every row
+  } // end if
 
   // initialize mutexes
   pthread_mutex_init(&nextRowNumberLock, NULL);
-  pthread_mutex_init(&rowsConsumedCountLock, NULL);
 
   // Bounded Buffer initialization
-  pthread_mutex_init(&lock, NULL);
-  pthread_cond_init(&nonFull, NULL);
-  pthread_cond_init(&nonEmpty, NULL);
+  buffer = ringBufferCreate(SIZE, sizeof(WORK));
 
   // allocate threadHandles and attributes
   numberOfThreads = numberOfProducerThreads + numberOfConsumerThreads;
   threadHandles = (pthread_t *) malloc(numberOfThreads*sizeof(pthread_t));
 
-  srand(5);
-  A = allocate2DArray(rows, columns);
-  B = allocate2DArray(rows, columns);
-  Sum = allocate2DArray(rows, columns);
-  Sum_seq = allocate2DArray(rows, columns);
+  matrixSum = allocateMatrix(rows, columns);
+  Sum = matrixSum->row;
+  streamSum = vectorAddNonTemporal((size_t) rows*columns*sizeof(double));
+  printf("Rows added by the %s kernel%s\n", vectorAddKernelName(),
+	 streamSum ? " with non-temporal stores" : "");
+  if (streaming) {
+    // enough buffers for every thread to hold a batch, but no more
+    // than there are blocks (producers claim only the buffers they get)
+    poolSize = numberOfThreads * batch;
+    if (poolSize > (rows + blockSize - 1) / blockSize) {
+      poolSize = (rows + blockSize - 1) / blockSize;
+    } // end if
+    freeList = ringBufferCreate(poolSize, sizeof(int));
+    poolA = (double **) malloc(poolSize*sizeof(double *));
+    poolB = (double **) malloc(poolSize*sizeof(double *));
+    for (k=0; k < poolSize; k++) {
+      poolA[k] = allocateAligned((size_t) blockSize*columns);
+      poolB[k] = allocateAligned((size_t) blockSize*columns);
+      ringBufferPush(freeList, &k);
+    } // end for
+    printf("Streaming through %d row buffers of %d rows (%.3f MB instead of %.3f MB for A and B)\n",
+	   poolSize, blockSize, 2.0*poolSize*blockSize*columns*sizeof(double)/1.0e6,
+	   2.0*rows*columns*sizeof(double)/1.0e6);
+  } else {
+    matrixA = allocateMatrix(rows, columns);
+    matrixB = allocateMatrix(rows, columns);
+    matrixSum_seq = allocateMatrix(rows, columns);
+    A = matrixA->row;
+    B = matrixB->row;
+    Sum_seq = matrixSum_seq->row;
+  } // end if
 
   printf("Array allocations done\n");
-  GET_TIME(startTime);
 
-  // create Producer threads
-  for (i=0; i < numberOfProducerThreads; i++) {
-    pthread_create(&threadHandles[i], NULL, producerWork, (void*) i);
-  } // end for
+  if (stealing) {
+    // the pool lives across the iterations: only the first pays for
+    // creating its threads
+    GET_TIME(startTime);
+    stealPool = workStealCreate(numberOfThreads);
+    GET_TIME(endTime);
+    printf("Work-stealing pool of %d threads created in %1.6f\n", numberOfThreads,
+	   endTime-startTime);
+    for (iteration=0; iteration < iterations; iteration++) {
+      GET_TIME(startTime);
+      workStealRun(stealPool, generateTask, NULL, 0, rows);
+      GET_TIME(endTime);
+      iterationTime[iteration] = endTime-startTime;
+      printf("Iteration %2d: %1.6f\n", iteration, iterationTime[iteration]);
+    } // end for
+    workStealPrintStats(stealPool);
+    workStealDestroy(stealPool);
+  } else {
+    // threads are created and shut down every iteration
+    for (iteration=0; iteration < iterations; iteration++) {
+      runPipeline(numberOfProducerThreads, numberOfConsumerThreads, threadHandles,
+		  &startupTime, &runTime, &teardownTime);
+      iterationTime[iteration] = startupTime + runTime + teardownTime;
+      printf("Iteration %2d: %1.6f (thread startup %1.6f, producing %1.6f, drain and join %1.6f)\n",
+	     iteration, iterationTime[iteration], startupTime, runTime, teardownTime);
+    } // end for
+  } // end if
 
-  pthread_mutex_lock(&allRowsConsumedLock);
-    
-  // create Consumer threads
-  for (i=numberOfProducerThreads; i < numberOfThreads; i++) {
-    pthread_create(&threadHandles[i], NULL, consumerWork, (void*) i);
+  totalTime = minTime = maxTime = iterationTime[0];
+  for (iteration=1; iteration < iterations; iteration++) {
+    totalTime += iterationTime[iteration];
+    minTime = (iterationTime[iteration] < minTime) ? iterationTime[iteration] : minTime;
+    maxTime = (iterationTime[iteration] > maxTime) ? iterationTime[iteration] : maxTime;
   } // end for
-    
-  for (i=0; i < numberOfProducerThreads; i++) {
-    pthread_join(threadHandles[i], (void **) NULL);
-  } // end for
-  // printf("After join of Produceers in main!\n");
-
-  pthread_mutex_lock(&allRowsConsumedLock);
-
-  GET_TIME(endTime);
-  printf("Parallel Time with %d Producers and %d Consumers = %1.3f\n", 
-	 numberOfProducerThreads, numberOfConsumerThreads, endTime-startTime);
-
-  matrixAddition(rows, columns, A, B, Sum_seq);
+  if (stealing) {
+    printf("Parallel Time with %d work-stealing threads = %1.3f\n",
+	   numberOfThreads, totalTime/iterations);
+  } else {
+    printf("Parallel Time with %d Producers and %d Consumers (batches of %d) = %1.3f\n",
+	   numberOfProducerThreads, numberOfConsumerThreads, batch, totalTime/iterations);
+  } // end if
+  if (iterations > 1) {
+    printf("Per iteration over %d: first %1.6f, min %1.6f, mean %1.6f, max %1.6f\n",
+	   iterations, iterationTime[0], minTime, totalTime/iterations, maxTime);
+  } // end if
+  printf("Sustained rate %1.0f rows/sec (%1.3f GB/s of A, B and Sum)\n",
+	 rows*iterations/totalTime,
+	 3.0*rows*columns*sizeof(double)*iterations/totalTime/1.0e9);
 
   tolerance = 0.0000001;
-  if (equal2DArrays(rows, columns, Sum, Sum_seq, tolerance)) {
+  if (streaming) {
+    match = verifyStreamedSum(rows, columns, Sum, tolerance);
+  } else {
+    matrixAddition(rows, columns, A, B, Sum_seq);
+    match = equal2DArrays(rows, columns, Sum, Sum_seq, tolerance);
+  } // end if
+  if (match) {
     printf("Arrays match with tolerance of %.10f\n", tolerance);
   } else {
     printf("Arrays DON'T match with tolerance of %.10f\n", tolerance);
   } // end if
 
   // if small enough, print to screen
-  if (rows < 10 && columns < 10) {
+  if (!streaming && rows < 10 && columns < 10) {
     printf("Matrix Sum sequential:\n");
     print2DArray(rows, columns, Sum_seq);
     printf("\nMatrix Sum parallel:\n");
     print2DArray(rows, columns, Sum);
   } // end if
 
+  freeMatrix(matrixA);   // NULL when streaming
+  freeMatrix(matrixB);
+  freeMatrix(matrixSum);
+  freeMatrix(matrixSum_seq);
+  if (streaming) {
+    for (k=0; k < poolSize; k++) {
+      free(poolA[k]);
+      free(poolB[k]);
+    } // end for
+    free(poolA);
+    free(poolB);
+    ringBufferDestroy(freeList);
+  } // end if
+
   return 0;
 
 
@@ -159,158 +286,258 @@ int main(int argc, char * argv[]) {
 
 void  *producerWork(void * args) {
   
-  long threadId = (long) args;
-  int rowNumber, i;
-  WORK blockOfWork;
-  unsigned int seed;
-
-  seed = (threadId+1)*1000;
+  int rowNumber, rowEnd, i, count, claimed, k;
+  int * rowBuffers = (int *) malloc(batch*sizeof(int));
+  WORK * blocksOfWork = (WORK *) malloc(batch*sizeof(WORK));
+  double * rowA, * rowB;
 
+  (void) args;  // producers share the row counter: no id needed
   while (TRUE) {
+    // in streaming mode only claim as many blocks as there are free buffers
+    claimed = batch;
+    if (streaming) {
+      claimed = ringBufferPopBatch(freeList, rowBuffers, batch);
+    }
+
+    // claim a batch of blocks with one lock round trip
     pthread_mutex_lock(&nextRowNumberLock);
     rowNumber = nextRowNumber;
-    nextRowNumber+=blockSize;
+    nextRowNumber += blockSize*claimed;
     pthread_mutex_unlock(&nextRowNumberLock);
 
-    for (i = rowNumber; i < nextRowNumber; i++) {
-      if (i >= rows) {
-        break;
+    for (count = 0; count < claimed && rowNumber < rows; count++) {
+      rowEnd = (rowNumber + blockSize < rows) ? rowNumber + blockSize : rows;
+      k = streaming ? rowBuffers[count] : -1;
+      for (i = rowNumber; i < rowEnd; i++) {
+        // printf("Thread %d producing row %d\n",threadId,i);
+        rowA = streaming ? poolA[k] + (size_t) (i - rowNumber)*columns : A[i];
+        rowB = streaming ? poolB[k] + (size_t) (i - rowNumber)*columns : B[i];
+        // element (r, c) is index r*columns + c of streams 5 (A) and 6 (B)
+        generateCounterRandomRow(rowA, columns, (uint64_t) i*columns, 5, 0.0, +5.0);
+        generateCounterRandomRow(rowB, columns, (uint64_t) i*columns, 6, 0.0, +5.0);
       }
-      // printf("Thread %d producing row %d\n",threadId,i);
-      generateRandomRow(A[i], columns, 0.0, +5.0, &seed);
-      generateRandomRow(B[i], columns, 0.0, +5.0, &seed);
+      blocksOfWork[count].rowStart = rowNumber;
+      blocksOfWork[count].rowEnd = rowEnd;
+      blocksOfWork[count].rowBuffer = k;
+      rowNumber = rowEnd;
+    }
+    if (count > 0) {
+      bufferAddBatch(blocksOfWork, count);
+    }
+    if (streaming && count < claimed) {
+      // ran past the last row: hand the unused buffers back
+      ringBufferPushBatch(freeList, rowBuffers + count, claimed - count);
     }
 
-    blockOfWork.rowStart=rowNumber;
-    blockOfWork.rowEnd = i;
-
-    bufferAdd(blockOfWork);
-
-    if (i >= rows) {
+    if (rowNumber >= rows) {
       break;
     }
-    
-    i++;
 
   } // end while
-  
+  free(blocksOfWork);
+  free(rowBuffers);
+  return NULL;
 
 } // end producerWork
 
 void  *consumerWork(void * args) {
   
-  long threadId = (long) args;
-  int rowStart, rowEnd, i;
-  int counter = 0;
-  WORK blockOfWork;
+  int i, b, k, count, pills = 0, buffersUsed;
+  int * rowBuffers = (int *) malloc(batch*sizeof(int));
+  WORK * blocksOfWork = (WORK *) malloc(batch*sizeof(WORK));
+  WORK pill = {-1, -1, -1};
 
-  while (TRUE) {
+  (void) args;  // consumers take whatever work comes next: no id needed
+  while (pills == 0) {
     
-    blockOfWork = bufferRemove(threadId);
-
-    rowStart = blockOfWork.rowStart;
-    rowEnd   = blockOfWork.rowEnd;
-    for (i = rowStart; i < rowEnd; i++) {
-      addRows(A[i], B[i], Sum[i], columns);
-      // printf("Thread %d consuming row %d\n",threadId,i);
+    // drain up to a batch of blocks at once
+    count = bufferRemoveBatch(blocksOfWork, batch);
+
+    buffersUsed = 0;
+    for (b = 0; b < count; b++) {
+      if (blocksOfWork[b].rowStart < 0) {
+        pills++;   // no more work
+        continue;
+      }
+      k = blocksOfWork[b].rowBuffer;
+      for (i = blocksOfWork[b].rowStart; i < blocksOfWork[b].rowEnd; i++) {
+        if (k < 0) {
+          addRows(A[i], B[i], Sum[i], columns);
+        } else {
+          addRows(poolA[k] + (size_t) (i - blocksOfWork[b].rowStart)*columns,
+                  poolB[k] + (size_t) (i - blocksOfWork[b].rowStart)*columns,
+                  Sum[i], columns);
+        }
+        // printf("Thread %d consuming row %d\n",threadId,i);
+      }
+      rowBuffers[buffersUsed++] = k;
+    }
+    if (streaming && buffersUsed > 0) {
+      // the rows are in Sum: recycle the buffers
+      ringBufferPushBatch(freeList, rowBuffers, buffersUsed);
     }
-
-    pthread_mutex_lock(&rowsConsumedCountLock);
-    rowsConsumedCount+=blockSize;
-    if (rowsConsumedCount >= rows) {
-      pthread_mutex_unlock(&allRowsConsumedLock);
-    }  
-    pthread_mutex_unlock(&rowsConsumedCountLock);
   } // end while
 
+  // a batch can hold other consumers' pills: hand them back
+  for (i = 1; i < pills; i++) {
+    bufferAddBatch(&pill, 1);
+  }
+  free(blocksOfWork);
+  free(rowBuffers);
+  return NULL;
+
 } // end consumerWork
 
 
-void bufferAdd(WORK item) {
+/*******************************************************************
+ * Function runPipeline runs the producers and consumers once over
+ * all the rows.  After the producers are joined every row is in the
+ * buffer, so one poison pill (rowStart < 0) per consumer behind
+ * them shuts the consumers down once the rows are drained, and
+ * joining them means every row is in Sum.  Returns the seconds spent
+ * creating the threads, producing, and draining / joining.
+ ********************************************************************/
+void runPipeline(int numberOfProducerThreads, int numberOfConsumerThreads,
+		 pthread_t * threadHandles, double * startupTime, double * runTime,
+		 double * teardownTime) {
+  int numberOfThreads = numberOfProducerThreads + numberOfConsumerThreads;
+  WORK pill = {-1, -1, -1};
+  double startTime, createdTime, producedTime, endTime;
+  long i;
 
-  pthread_mutex_lock(&lock);
-  while(count == SIZE) {
-    while(pthread_cond_wait(&nonFull, &lock) != 0);
-  } // end while
-  if (count == 0) {
-    front = 0;
-    rear = 0;
-  } else {
-    rear = (rear + 1) % SIZE;
-  } // end if
-  buffer[rear] = item;
-  count++;
-  pthread_cond_signal(&nonEmpty);
-  pthread_mutex_unlock(&lock);
+  nextRowNumber = 0;
+  GET_TIME(startTime);
+
+  // create Producer threads
+  for (i=0; i < numberOfProducerThreads; i++) {
+    pthread_create(&threadHandles[i], NULL, producerWork, (void*) i);
+  } // end for
+
+  // create Consumer threads
+  for (i=numberOfProducerThreads; i < numberOfThreads; i++) {
+    pthread_create(&threadHandles[i], NULL, consumerWork, (void*) i);
+  } // end for
+  GET_TIME(createdTime);
+
+  for (i=0; i < numberOfProducerThreads; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+  } // end for
+  GET_TIME(producedTime);
+
+  for (i=0; i < numberOfConsumerThreads; i++) {
+    bufferAddBatch(&pill, 1);
+  } // end for
+  for (i=numberOfProducerThreads; i < numberOfThreads; i++) {
+    pthread_join(threadHandles[i], (void **) NULL);
+  } // end for
+  GET_TIME(endTime);
 
-} // end bufferAdd
+  *startupTime = createdTime - startTime;
+  *runTime = producedTime - createdTime;
+  *teardownTime = endTime - producedTime;
+} // end runPipeline
 
-WORK bufferRemove() {
-  WORK returnValue;
 
-  pthread_mutex_lock(&lock);
-  while(count == 0) {
-    while(pthread_cond_wait(&nonEmpty, &lock) != 0);
+/*******************************************************************
+ * Function generateTask - work-stealing mode: splits rows [start,
+ * end) in half, spawning the upper half, until one block is left,
+ * then generates that block of A and B and spawns its add task.
+ ********************************************************************/
+void generateTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+		  int threadId) {
+  int middle, i;
+
+  while (end - start > blockSize) {
+    middle = start + (end - start) / 2;
+    workStealSpawn(pool, threadId, generateTask, arg, middle, end);
+    end = middle;
   } // end while
-  returnValue = buffer[front];
-  front = (front + 1) % SIZE;
-  count--;
-  pthread_cond_signal(&nonFull);
-  pthread_mutex_unlock(&lock);
-  return returnValue;
+  for (i = start; i < end; i++) {
+    generateCounterRandomRow(A[i], columns, (uint64_t) i*columns, 5, 0.0, +5.0);
+    generateCounterRandomRow(B[i], columns, (uint64_t) i*columns, 6, 0.0, +5.0);
+  } // end for
+  workStealSpawn(pool, threadId, addTask, arg, start, end);
+
+} // end generateTask
 
-} // end bufferRemove
 
-   
 /*******************************************************************
- * Function generatesRandomRow randomly assigns doubles to a 1D array of
- * size length.
+ * Function addTask - work-stealing mode: Sum = A + B on rows
+ * [start, end).
  ********************************************************************/
-void generateRandomRow(double * rowArray, int length, double min, 
-		       double max, unsigned int * seed) {
-  int index;
-  double range, div;
+void addTask(WORK_STEAL_POOL * pool, void * arg, int start, int end,
+	     int threadId) {
+  int i;
+
+  (void) pool;      // an add task spawns nothing
+  (void) arg;
+  (void) threadId;
+  for (i = start; i < end; i++) {
+    addRows(A[i], B[i], Sum[i], columns);
+  } // end for
+
+} // end addTask
 
-  for (index = 0; index < length; index++) {
-    range = max - min;
-    div = RAND_MAX / range;
-    rowArray[index] = min + (rand_r(seed) / div);
-  } // end for (index...
- 
-} // generateRandomRow
 
+/*******************************************************************
+ * Function bufferAddBatch puts count WORK items into the bounded
+ * buffer, as many per reservation as there is room for.
+ ********************************************************************/
+void bufferAddBatch(WORK * items, int count) {
 
+  ringBufferPushBatch(buffer, items, count);
+
+} // end bufferAddBatch
 
+/*******************************************************************
+ * Function bufferRemoveBatch takes between 1 and max WORK items out
+ * of the bounded buffer (waiting while it is empty), returns how many.
+ ********************************************************************/
+int bufferRemoveBatch(WORK * items, int max) {
+
+  return ringBufferPopBatch(buffer, items, max);
+
+} // end bufferRemoveBatch
+
+   
 /*******************************************************************
  * Function addRows adds two 1D  arrays of size length, and returns
- * their sum in the 1D array rowSum.
+ * their sum in the 1D array rowSum, with the SIMD kernel of vectorAdd.h.
  ********************************************************************/
 void addRows(double * row1, double * row2, double * rowSum, int length) {
-  int index;
 
-  for (index = 0; index < length; index++) {
-    rowSum[index] = row1[index] + row2[index];
-  } // end for (index...
+  vectorAdd(rowSum, row1, row2, length, streamSum);
 
 } // end addRows
 
 
 /*******************************************************************
- * Function allocate2DArray dynamically allocates a 2D array of
- * size rows x columns, and returns it.
+ * Function verifyStreamedSum regenerates A and B one row at a time
+ * and returns TRUE if every element of arraySum is their sum within
+ * tolerance, the check for streaming mode where A and B are gone.
  ********************************************************************/
-double ** allocate2DArray(int rows, int columns) {
-  double ** local2DArray;
-  int r;
-
-  local2DArray = (double **) malloc(sizeof(double *)*rows);
+BOOL verifyStreamedSum(int rows, int columns, double ** arraySum,
+		       double tolerance) {
+  double * rowA = (double *) malloc(columns*sizeof(double));
+  double * rowB = (double *) malloc(columns*sizeof(double));
+  BOOL match = TRUE;
+  int r, c;
 
-  for (r=0; r < rows; r++) {
-    local2DArray[r] = (double *) malloc(sizeof(double)*columns);
-  } // end for
+  for (r = 0; r < rows && match; r++) {
+    generateCounterRandomRow(rowA, columns, (uint64_t) r*columns, 5, 0.0, +5.0);
+    generateCounterRandomRow(rowB, columns, (uint64_t) r*columns, 6, 0.0, +5.0);
+    for (c = 0; c < columns; c++) {
+      if (fabs(arraySum[r][c] - (rowA[c] + rowB[c])) > tolerance) {
+        match = FALSE;
+        break;
+      } // end if
+    } // end for (c...
+  } // end for (r...
+  free(rowA);
+  free(rowB);
+  return match;
 
-  return local2DArray;
-} // end allocate2DArray
+} // end verifyStreamedSum
 
 
 /*******************************************************************
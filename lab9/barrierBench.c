@@ -0,0 +1,171 @@
+/*  File:        barrierBench.c
+    Description: Cost of one barrier episode for each kind in
+    barrier.h, for every thread count in the sweep.  The threads do
+    nothing but pass the barrier episodes times back to back, so the
+    time per episode is all synchronization.  Before each episode a
+    thread stamps its slot with the episode number and after it checks
+    that its neighbour has stamped at least as far, which catches a
+    barrier that lets a thread through early.
+    Compile by:  gcc -O3 -I../common -o barrierBench barrierBench.c
+                 ../common/barrier.c -lpthread
+    Run by:      ./barrierBench 100000 1,2,4,8
+                 (# episodes, thread counts)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "timer.h"
+#include "barrier.h"
+
+#define TRUE 1
+#define FALSE 0
+#define BOOL int
+
+#define MAX_LIST 16
+#define MAX_THREADS 256
+
+typedef struct {
+  _Alignas(BARRIER_LINE) atomic_long episode;   // last episode this thread reached
+} STAMP;
+
+typedef struct {
+  BARRIER * barrier;
+  STAMP * stamps;
+  int numberOfThreads;
+  int threadId;
+  long episodes;
+  BOOL early;         // set if a neighbour lagged behind a finished episode
+} THREAD_ARGS;
+
+// function prototypes
+int parseList(const char * text, int * list);
+double timeBarrier(int kind, int numberOfThreads, long episodes);
+void * barrierWork(void * args);
+
+int main(int argc, char * argv[]) {
+  int counts[MAX_LIST], numberOfCounts, kind, c;
+  long episodes;
+  double time;
+
+  if (argc != 3) {
+    printf("usage: %s <# episodes> <thread counts, e.g. 1,2,4,8>\n", argv[0]);
+    exit(1);
+  } // end if
+  sscanf(argv[1], "%ld", &episodes);
+  numberOfCounts = parseList(argv[2], counts);
+  if (numberOfCounts == 0 || episodes < 1) {
+    printf("Thread counts (1-%d) must be separated by commas; episodes positive\n",
+	   MAX_THREADS);
+    exit(1);
+  } // end if
+
+  printf("%ld episodes, ns per barrier\n", episodes);
+  printf("threads");
+  for (kind=0; kind < BARRIER_KINDS; kind++) {
+    printf(" %14s", barrierName(kind));
+  } // end for
+  printf("\n");
+  for (c=0; c < numberOfCounts; c++) {
+    printf("%7d", counts[c]);
+    for (kind=0; kind < BARRIER_KINDS; kind++) {
+      time = timeBarrier(kind, counts[c], episodes);
+      printf(" %14.1f", time / episodes * 1.0e9);
+      fflush(stdout);
+    } // end for kind
+    printf("\n");
+  } // end for c
+
+  return 0;
+} // end main
+
+
+/*******************************************************************
+ * Function parseList reads a comma-separated list of thread counts
+ * into list and returns how many, 0 if any is bad.
+ ********************************************************************/
+int parseList(const char * text, int * list) {
+  int count = 0, value, used;
+
+  while (count < MAX_LIST && sscanf(text, "%d%n", &value, &used) == 1) {
+    if (value <= 0 || value > MAX_THREADS) {
+      return 0;
+    } // end if
+    list[count++] = value;
+    text += used;
+    if (*text != ',') {
+      break;
+    } // end if
+    text++;
+  } // end while
+  return (*text == '\0') ? count : 0;
+} // end parseList
+
+
+/*******************************************************************
+ * Function timeBarrier runs numberOfThreads threads through episodes
+ * barrier episodes of the given kind and returns the seconds taken.
+ ********************************************************************/
+double timeBarrier(int kind, int numberOfThreads, long episodes) {
+  pthread_t threadHandles[MAX_THREADS];
+  THREAD_ARGS args[MAX_THREADS];
+  STAMP * stamps;
+  BARRIER * barrier;
+  double startTime, endTime;
+  int i;
+
+  barrier = barrierCreate(numberOfThreads, kind);
+  if (posix_memalign((void **) &stamps, BARRIER_LINE, numberOfThreads*sizeof(STAMP)) != 0) {
+    printf("Could not allocate the stamps\n");
+    exit(-1);
+  } // end if
+  for (i=0; i < numberOfThreads; i++) {
+    atomic_init(&stamps[i].episode, 0);
+    args[i].barrier = barrier;
+    args[i].stamps = stamps;
+    args[i].numberOfThreads = numberOfThreads;
+    args[i].threadId = i;
+    args[i].episodes = episodes;
+    args[i].early = FALSE;
+  } // end for
+
+  GET_TIME(startTime);
+  for (i=0; i < numberOfThreads; i++) {
+    pthread_create(&threadHandles[i], NULL, barrierWork, &args[i]);
+  } // end for
+  for (i=0; i < numberOfThreads; i++) {
+    pthread_join(threadHandles[i], NULL);
+  } // end for
+  GET_TIME(endTime);
+
+  for (i=0; i < numberOfThreads; i++) {
+    if (args[i].early) {
+      printf("\n%s barrier let thread %d through early with %d threads\n",
+	     barrierName(kind), i, numberOfThreads);
+      exit(-1);
+    } // end if
+  } // end for
+  barrierDestroy(barrier);
+  free(stamps);
+  return endTime - startTime;
+} // end timeBarrier
+
+
+/*******************************************************************
+ * Function barrierWork - one thread's episodes.
+ ********************************************************************/
+void * barrierWork(void * args) {
+  THREAD_ARGS * myArgs = (THREAD_ARGS *) args;
+  STAMP * neighbour = &myArgs->stamps[(myArgs->threadId + 1) % myArgs->numberOfThreads];
+  long e;
+
+  for (e=1; e <= myArgs->episodes; e++) {
+    atomic_store_explicit(&myArgs->stamps[myArgs->threadId].episode, e,
+			  memory_order_relaxed);
+    barrierWait(myArgs->barrier, myArgs->threadId);
+    if (atomic_load_explicit(&neighbour->episode, memory_order_relaxed) < e) {
+      myArgs->early = TRUE;
+    } // end if
+  } // end for
+  return NULL;
+} // end barrierWork
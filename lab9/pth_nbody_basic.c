@@ -3,7 +3,8 @@
  * Purpose:  Use Pthreads to parallelize a 2-dimensional n-body solver 
  *           that uses the basic algorithm. 
  *
- * Compile:  gcc -g -Wall -o pth_nbody_basic pth_nbody_basic.c -lm -lpthread
+ * Compile:  gcc -g -Wall -I../common -o pth_nbody_basic pth_nbody_basic.c
+ *              ../common/barrier.c -lm -lpthread
  *           To turn off output (e.g., when timing), define NO_OUTPUT
  *           To get verbose output, define DEBUG
  *           Needs timer.h
@@ -51,6 +52,7 @@
 #include <math.h>
 #include <pthread.h>
 #include "timer.h"
+#include "barrier.h"
 
 #define DIM 2  /* Two-dimensional system */
 #define X 0    /* x-coordinate subscript */
@@ -78,9 +80,7 @@ double delta_t;          /* Size of each time step                        */
 int output_freq;         /* Number of steps between output                */
 struct particle_s* curr; /* Array containing states of particles          */
 vect_t* forces;          /* Array containing total force on each particle */
-int b_thread_count = 0;  /* Number of threads that have entered barrier   */
-pthread_mutex_t b_mutex; /* Mutex used by barrier                         */
-pthread_cond_t b_cond_var;  /* Condition variable used by barrier         */
+BARRIER* barrier;        /* Shared by the threads, see barrier.h          */
 
 void Usage(char* prog_name);
 void Get_args(int argc, char* argv[], char* g_i_p);
@@ -93,7 +93,7 @@ void* Thread_work(void* rank);
 void Compute_force(int part);
 void Update_part(int part);
 void Barrier_init(void);
-void Barrier(void);
+void Barrier(long my_rank);
 void Barrier_destroy(void);
 
 /*--------------------------------------------------------------------*/
@@ -319,10 +319,10 @@ void* Thread_work(void* rank) {
        * Compute_force(n-2, . . .) */
       for (part = first; part < last; part += incr)
          Compute_force(part);
-      Barrier();
+      Barrier(my_rank);
       for (part = first; part < last; part += incr)
          Update_part(part);
-      Barrier();
+      Barrier(my_rank);
 #     ifndef NO_OUTPUT
       if (step % output_freq == 0 && my_rank == 0) {
          Output_state(t);
@@ -453,52 +453,33 @@ void Update_part(int part) {
 
 /*---------------------------------------------------------------------
  * Function:    Barrier_init
- * Purpose:     Initialize data structures needed for Barrier
- * Global vars (all out):  
- *    b_thread_count:  number of threads in the barrier
- *    b_mutex:         mutex used by barrier
- *    b_cond_var:      condition variable used by barrier
+ * Purpose:     Create the barrier the threads sync on
+ * Global vars:  
+ *    thread_count (in):  number of threads in the barrier
+ *    barrier (out):      the barrier, of kind BARRIER_DEFAULT
  */
 void Barrier_init(void) {
-   b_thread_count = 0;
-   pthread_mutex_init(&b_mutex, NULL);
-   pthread_cond_init(&b_cond_var, NULL);
+   barrier = barrierCreate(thread_count, BARRIER_DEFAULT);
 }  /* Barrier_init */
 
 /*---------------------------------------------------------------------
  * Function:    Barrier
  * Purpose:     Block until all threads have entered the barrier
+ * In arg:      
+ *    my_rank:  rank of calling thread
  * Global vars:  
- *    thread_count (in):       total number of threads
- *    b_thread_count (in/out): number of threads in the barrier
- *    b_mutex (in/out):        mutex used by barrier
- *    b_cond_var (in/out):     condition variable used by barrier
+ *    barrier (in/out):  the barrier
  */
-void Barrier(void) {
-      pthread_mutex_lock(&b_mutex);
-      b_thread_count++;
-      if (b_thread_count == thread_count) {
-         b_thread_count = 0;
-         pthread_cond_broadcast(&b_cond_var);
-      } else {
-         // Wait unlocks mutex and puts thread to sleep.
-         //    Put wait in while loop in case some other
-         // event awakens thread.
-         while (pthread_cond_wait(&b_cond_var, &b_mutex) != 0);
-         // Mutex is relocked at this point.
-      }
-      pthread_mutex_unlock(&b_mutex);
-
+void Barrier(long my_rank) {
+   barrierWait(barrier, (int) my_rank);
 }  /* Barrier */
 
 /*---------------------------------------------------------------------
  * Function:    Barrier_destroy
- * Purpose:     Destroy data structures needed for Barrier
- * Global vars (all out):  
- *    b_mutex:         mutex used by barrier
- *    b_cond_var:      condition variable used by barrier
+ * Purpose:     Destroy the barrier
+ * Global vars:  
+ *    barrier (in/out):  the barrier
  */
 void Barrier_destroy(void) {
-   pthread_mutex_destroy(&b_mutex);
-   pthread_cond_destroy(&b_cond_var);
+   barrierDestroy(barrier);
 }  /* Barrier_destroy */
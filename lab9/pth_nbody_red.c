@@ -6,7 +6,8 @@
  *           of the iterations in the Compute_force loop.  The other
  *           loops use a block partition.
  *
- * Compile:  gcc -g -Wall -o pth_nbody_red pth_nbody_red.c -lm -lpthread
+ * Compile:  gcc -g -Wall -I../common -o pth_nbody_red pth_nbody_red.c
+ *              ../common/barrier.c -lm -lpthread
  *           To turn off output (e.g., when timing), define NO_OUTPUT
  *           To get verbose output, define DEBUG
  *           Needs timer.h
@@ -54,6 +55,7 @@
 #include <math.h>
 #include <pthread.h>
 #include "timer.h"
+#include "barrier.h"
 
 #define DIM 2  /* Two-dimensional system */
 #define X 0    /* x-coordinate subscript */
@@ -82,9 +84,7 @@ int output_freq;           /* Number of steps between output                 */
 struct particle_s* curr;   /* Array containing states of particles           */
 vect_t* forces;            /* Array containing total force on each particle  */
 vect_t* loc_forces;        /* Array containing force computed by each thread */
-int b_thread_count = 0;    /* Number of threads that have entered barrier    */
-pthread_mutex_t b_mutex;   /* Mutex used by barrier                          */
-pthread_cond_t b_cond_var; /* Condition variable used by barrier             */
+BARRIER* barrier;          /* Shared by the threads, see barrier.h           */
 
 void Usage(char* prog_name);
 void Get_args(int argc, char* argv[], char* g_i_p);
@@ -97,7 +97,7 @@ void* Thread_work(void* rank);
 void Compute_force(int part, vect_t forces[]);
 void Update_part(int part);
 void Barrier_init(void);
-void Barrier(void);
+void Barrier(long my_rank);
 void Barrier_destroy(void);
 
 /*--------------------------------------------------------------------*/
@@ -330,10 +330,10 @@ void* Thread_work(void* rank) {
       memset(loc_forces + my_rank*n, 0, n*sizeof(vect_t));
       /* Barrier isn't needed:  Next loop will only work with
        * my part of loc_forces */
-      Barrier();
+      Barrier(my_rank);
       for (part = cfirst; part < clast; part += cincr)
          Compute_force(part, loc_forces + my_rank*n);
-      Barrier();
+      Barrier(my_rank);
       for (part = bfirst; part < blast; part += bincr) {
          forces[part][X] = forces[part][Y] = 0.0;
          for (thread = 0; thread < thread_count; thread++) {
@@ -341,10 +341,10 @@ void* Thread_work(void* rank) {
             forces[part][Y] += loc_forces[thread*n + part][Y];
          }
       }
-      Barrier();
+      Barrier(my_rank);
       for (part = bfirst; part < blast; part += bincr)
          Update_part(part);
-      Barrier();
+      Barrier(my_rank);
 #     ifndef NO_OUTPUT
       if (step % output_freq == 0 && my_rank == 0) {
          Output_state(t);
@@ -477,52 +477,33 @@ void Update_part(int part) {
 
 /*---------------------------------------------------------------------
  * Function:    Barrier_init
- * Purpose:     Initialize data structures needed for Barrier
- * Global vars (all out):  
- *    b_thread_count:  number of threads in the barrier
- *    b_mutex:         mutex used by barrier
- *    b_cond_var:      condition variable used by barrier
+ * Purpose:     Create the barrier the threads sync on
+ * Global vars:  
+ *    thread_count (in):  number of threads in the barrier
+ *    barrier (out):      the barrier, of kind BARRIER_DEFAULT
  */
 void Barrier_init(void) {
-   b_thread_count = 0;
-   pthread_mutex_init(&b_mutex, NULL);
-   pthread_cond_init(&b_cond_var, NULL);
+   barrier = barrierCreate(thread_count, BARRIER_DEFAULT);
 }  /* Barrier_init */
 
 /*---------------------------------------------------------------------
  * Function:    Barrier
  * Purpose:     Block until all threads have entered the barrier
+ * In arg:      
+ *    my_rank:  rank of calling thread
  * Global vars:  
- *    thread_count (in):       total number of threads
- *    b_thread_count (in/out): number of threads in the barrier
- *    b_mutex (in/out):        mutex used by barrier
- *    b_cond_var (in/out):     condition variable used by barrier
+ *    barrier (in/out):  the barrier
  */
-void Barrier(void) {
-      pthread_mutex_lock(&b_mutex);
-      b_thread_count++;
-      if (b_thread_count == thread_count) {
-         b_thread_count = 0;
-         pthread_cond_broadcast(&b_cond_var);
-      } else {
-         // Wait unlocks mutex and puts thread to sleep.
-         //    Put wait in while loop in case some other
-         // event awakens thread.
-         while (pthread_cond_wait(&b_cond_var, &b_mutex) != 0);
-         // Mutex is relocked at this point.
-      }
-      pthread_mutex_unlock(&b_mutex);
-
+void Barrier(long my_rank) {
+   barrierWait(barrier, (int) my_rank);
 }  /* Barrier */
 
 /*---------------------------------------------------------------------
  * Function:    Barrier_destroy
- * Purpose:     Destroy data structures needed for Barrier
- * Global vars (all out):  
- *    b_mutex:         mutex used by barrier
- *    b_cond_var:      condition variable used by barrier
+ * Purpose:     Destroy the barrier
+ * Global vars:  
+ *    barrier (in/out):  the barrier
  */
 void Barrier_destroy(void) {
-   pthread_mutex_destroy(&b_mutex);
-   pthread_cond_destroy(&b_cond_var);
+   barrierDestroy(barrier);
 }  /* Barrier_destroy */